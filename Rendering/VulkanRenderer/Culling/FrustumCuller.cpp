@@ -0,0 +1,359 @@
+#include "../VulkanRenderer.h"
+
+#include <random>
+#include <limits>
+
+#include "Simd.h"
+#include "FrustumCuller.h"
+
+
+// Lane indices of the set bits of every 8-bit visibility mask, used to compact the visible spheres without branching
+struct sCompactionTables
+{
+	alignas(32) uint32_t indices8[256][8];
+	alignas(16) uint32_t indices4[16][4];
+	uint8_t popCount[256];
+
+	sCompactionTables()
+	{
+		for (uint32_t mask = 0; mask < 256; mask++)
+		{
+			uint8_t count = 0;
+			for (uint32_t lane = 0; lane < 8; lane++)
+			{
+				indices8[mask][lane] = 0;
+				if (mask & (1u << lane)) indices8[mask][count++] = lane;
+			}
+			popCount[mask] = count;
+
+			if (mask < 16)
+			{
+				for (uint32_t lane = 0; lane < 4; lane++) indices4[mask][lane] = indices8[mask][lane];
+			}
+		}
+	}
+};
+
+static const sCompactionTables sm_compactionTables;
+static const uint32_t (&sm_compactTable8)[256][8] = sm_compactionTables.indices8;
+static const uint32_t (&sm_compactTable4)[16][4] = sm_compactionTables.indices4;
+static const uint8_t (&sm_popCount)[256] = sm_compactionTables.popCount;
+
+
+FrustumCuller::FrustumCuller() : m_pUtilities(Utilities::getInstance())
+{
+	m_cullingPath = detectCullingPath();
+	mDebugPrint(std::format("Frustum culling path: {}", getCullingPathName(m_cullingPath)));
+}
+
+FrustumCuller::eCullingPath FrustumCuller::detectCullingPath()
+{
+#if defined(NEBULA_SIMD_X86)
+#if defined(_MSC_VER)
+	int cpuInfo[4];
+	__cpuid(cpuInfo, 0);
+	int maxLeaf = cpuInfo[0];
+
+	__cpuid(cpuInfo, 1);
+	bool hasOSXSAVE = (cpuInfo[2] & (1 << 27)) != 0;
+	bool hasAVX = (cpuInfo[2] & (1 << 28)) != 0;
+	bool hasFMA = (cpuInfo[2] & (1 << 12)) != 0;
+
+	bool hasAVX2 = false;
+	if (maxLeaf >= 7 && hasAVX && hasOSXSAVE)
+	{
+		// Make sure the OS saves the YMM registers before trusting the AVX2 bit
+		bool ymmEnabled = (_xgetbv(0) & 0x6) == 0x6;
+		__cpuidex(cpuInfo, 7, 0);
+		hasAVX2 = ymmEnabled && hasFMA && (cpuInfo[1] & (1 << 5)) != 0;
+	}
+#else
+	__builtin_cpu_init();
+	bool hasAVX2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+
+	// Every AVX2 CPU we target also has FMA, which the AVX2 path relies on
+	if (hasAVX2) return eCullingPath::AVX2;
+	// The SSE path only needs SSE2, which every x64 CPU has
+	return eCullingPath::SSE;
+#else
+	return eCullingPath::SCALAR;
+#endif
+}
+
+const char* FrustumCuller::getCullingPathName(eCullingPath path)
+{
+	switch (path)
+	{
+	case eCullingPath::AVX2: return "AVX2";
+	case eCullingPath::SSE: return "SSE";
+	default: return "Scalar";
+	}
+}
+
+
+
+FrustumCuller::sFrustum FrustumCuller::extractFrustum(const glm::mat4& viewProj)
+{
+	// glm matrices are column major, so row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+	auto row = [&viewProj](int i) { return glm::vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]); };
+
+	sFrustum frustum{};
+	frustum.planes[0] = row(3) + row(0); // Left
+	frustum.planes[1] = row(3) - row(0); // Right
+	frustum.planes[2] = row(3) + row(1); // Bottom
+	frustum.planes[3] = row(3) - row(1); // Top
+	// Uses the -w <= z near plane, which also stays conservative for zero-to-one projections
+	frustum.planes[4] = row(3) + row(2); // Near
+	frustum.planes[5] = row(3) - row(2); // Far
+
+	for (glm::vec4& plane : frustum.planes)
+	{
+		plane /= glm::length(glm::vec3(plane));
+	}
+
+	return frustum;
+}
+
+
+
+void FrustumCuller::clear()
+{
+	m_centerX.clear();
+	m_centerY.clear();
+	m_centerZ.clear();
+	m_radius.clear();
+	m_sphereCount = 0;
+}
+
+uint32_t FrustumCuller::addSphere(glm::vec3 center, float radius)
+{
+	m_centerX.push_back(center.x);
+	m_centerY.push_back(center.y);
+	m_centerZ.push_back(center.z);
+	m_radius.push_back(radius);
+
+	return static_cast<uint32_t>(m_sphereCount++);
+}
+
+size_t FrustumCuller::cull(const sFrustum& frustum, std::vector<uint32_t>& visibleIndices)
+{
+	// Pad with spheres that fail every plane test
+	size_t paddedCount = (m_sphereCount + 7) & ~static_cast<size_t>(7);
+	m_centerX.resize(paddedCount, 0.0f);
+	m_centerY.resize(paddedCount, 0.0f);
+	m_centerZ.resize(paddedCount, 0.0f);
+	m_radius.resize(paddedCount, -std::numeric_limits<float>::max());
+
+	// The SIMD paths always store a full register of indices, so leave room past the last group
+	if (m_scratchIndices.size() < paddedCount + 8) m_scratchIndices.resize(paddedCount + 8);
+
+	size_t visibleCount = 0;
+	switch (m_cullingPath)
+	{
+	case eCullingPath::AVX2:
+		visibleCount = cullAVX2(m_centerX.data(), m_centerY.data(), m_centerZ.data(), m_radius.data(), paddedCount, frustum, m_scratchIndices.data());
+		break;
+	case eCullingPath::SSE:
+		visibleCount = cullSSE(m_centerX.data(), m_centerY.data(), m_centerZ.data(), m_radius.data(), paddedCount, frustum, m_scratchIndices.data());
+		break;
+	default:
+		visibleCount = cullScalar(m_centerX.data(), m_centerY.data(), m_centerZ.data(), m_radius.data(), paddedCount, frustum, m_scratchIndices.data());
+		break;
+	}
+
+	// Drop the padding again so spheres can keep being appended
+	m_centerX.resize(m_sphereCount);
+	m_centerY.resize(m_sphereCount);
+	m_centerZ.resize(m_sphereCount);
+	m_radius.resize(m_sphereCount);
+
+	visibleIndices.assign(m_scratchIndices.begin(), m_scratchIndices.begin() + visibleCount);
+	return visibleCount;
+}
+
+size_t FrustumCuller::cull(const std::vector<sFrustum>& frusta, std::vector<uint32_t>& visibleIndices)
+{
+	if (frusta.size() == 1) return cull(frusta[0], visibleIndices);
+
+	// Views mostly overlap, so merging through a flag per sphere is cheaper than sorting and deduplicating the lists
+	m_scratchVisible.assign(m_sphereCount, 0);
+	for (const sFrustum& frustum : frusta) {
+		cull(frustum, m_scratchFrustumIndices);
+		for (uint32_t index : m_scratchFrustumIndices) {
+			m_scratchVisible[index] = 1;
+		}
+	}
+
+	visibleIndices.clear();
+	for (uint32_t i = 0; i < m_sphereCount; i++) {
+		if (m_scratchVisible[i]) visibleIndices.push_back(i);
+	}
+	return visibleIndices.size();
+}
+
+
+
+size_t FrustumCuller::cullScalar(const float* pX, const float* pY, const float* pZ, const float* pR, size_t count, const sFrustum& frustum, uint32_t* pOutIndices)
+{
+	size_t visibleCount = 0;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		bool visible = true;
+		for (const glm::vec4& plane : frustum.planes)
+		{
+			float distance = plane.x * pX[i] + plane.y * pY[i] + plane.z * pZ[i] + plane.w;
+			if (distance < -pR[i])
+			{
+				visible = false;
+				break;
+			}
+		}
+
+		pOutIndices[visibleCount] = static_cast<uint32_t>(i);
+		visibleCount += visible ? 1 : 0;
+	}
+
+	return visibleCount;
+}
+
+size_t FrustumCuller::cullSSE(const float* pX, const float* pY, const float* pZ, const float* pR, size_t count, const sFrustum& frustum, uint32_t* pOutIndices)
+{
+#if defined(NEBULA_SIMD_X86)
+	__m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int p = 0; p < 6; p++)
+	{
+		planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+		planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+		planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+		planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+	}
+
+	const __m128 zero = _mm_setzero_ps();
+	size_t visibleCount = 0;
+
+	for (size_t i = 0; i < count; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(pX + i);
+		__m128 y = _mm_loadu_ps(pY + i);
+		__m128 z = _mm_loadu_ps(pZ + i);
+		__m128 r = _mm_loadu_ps(pR + i);
+
+		// Inside if (n.c + d + r) >= 0 for every plane
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int p = 0; p < 6; p++)
+		{
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], x), _mm_mul_ps(planeY[p], y)), _mm_add_ps(_mm_mul_ps(planeZ[p], z), planeW[p]));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, r), zero));
+		}
+
+		// Branchless compaction: store the visible lanes' indices from the lookup table and advance by the popcount
+		int mask = _mm_movemask_ps(inside);
+		__m128i indices = _mm_add_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(sm_compactTable4[mask])), _mm_set1_epi32(static_cast<int>(i)));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(pOutIndices + visibleCount), indices);
+		visibleCount += sm_popCount[mask];
+	}
+
+	return visibleCount;
+#else
+	return cullScalar(pX, pY, pZ, pR, count, frustum, pOutIndices);
+#endif
+}
+
+NEBULA_TARGET_AVX2 size_t FrustumCuller::cullAVX2(const float* pX, const float* pY, const float* pZ, const float* pR, size_t count, const sFrustum& frustum, uint32_t* pOutIndices)
+{
+#if defined(NEBULA_SIMD_X86)
+	__m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int p = 0; p < 6; p++)
+	{
+		planeX[p] = _mm256_set1_ps(frustum.planes[p].x);
+		planeY[p] = _mm256_set1_ps(frustum.planes[p].y);
+		planeZ[p] = _mm256_set1_ps(frustum.planes[p].z);
+		planeW[p] = _mm256_set1_ps(frustum.planes[p].w);
+	}
+
+	const __m256 zero = _mm256_setzero_ps();
+	size_t visibleCount = 0;
+
+	for (size_t i = 0; i < count; i += 8)
+	{
+		__m256 x = _mm256_loadu_ps(pX + i);
+		__m256 y = _mm256_loadu_ps(pY + i);
+		__m256 z = _mm256_loadu_ps(pZ + i);
+		__m256 r = _mm256_loadu_ps(pR + i);
+
+		__m256 negR = _mm256_sub_ps(zero, r);
+
+		// Two independent chains so the compares of neighbouring planes can overlap
+		__m256 insideA = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		__m256 insideB = insideA;
+		for (int p = 0; p < 6; p += 2)
+		{
+			__m256 distanceA = _mm256_fmadd_ps(planeX[p], x, _mm256_fmadd_ps(planeY[p], y, _mm256_fmadd_ps(planeZ[p], z, planeW[p])));
+			__m256 distanceB = _mm256_fmadd_ps(planeX[p + 1], x, _mm256_fmadd_ps(planeY[p + 1], y, _mm256_fmadd_ps(planeZ[p + 1], z, planeW[p + 1])));
+			insideA = _mm256_and_ps(insideA, _mm256_cmp_ps(distanceA, negR, _CMP_GE_OQ));
+			insideB = _mm256_and_ps(insideB, _mm256_cmp_ps(distanceB, negR, _CMP_GE_OQ));
+		}
+		__m256 inside = _mm256_and_ps(insideA, insideB);
+
+		int mask = _mm256_movemask_ps(inside);
+		__m256i indices = _mm256_add_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(sm_compactTable8[mask])), _mm256_set1_epi32(static_cast<int>(i)));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(pOutIndices + visibleCount), indices);
+		visibleCount += sm_popCount[mask];
+	}
+
+	return visibleCount;
+#else
+	return cullScalar(pX, pY, pZ, pR, count, frustum, pOutIndices);
+#endif
+}
+
+
+
+double FrustumCuller::benchmark(size_t sphereCount, int iterations)
+{
+	using std::chrono::high_resolution_clock, std::chrono::duration;
+
+	// Keep the real batch intact
+	std::vector<float> savedX = m_centerX, savedY = m_centerY, savedZ = m_centerZ, savedR = m_radius;
+	size_t savedCount = m_sphereCount;
+
+	clear();
+
+	std::mt19937 rng(1337);
+	std::uniform_real_distribution<float> positionDist(-500.0f, 500.0f);
+	std::uniform_real_distribution<float> radiusDist(0.5f, 5.0f);
+	for (size_t i = 0; i < sphereCount; i++)
+	{
+		addSphere(glm::vec3(positionDist(rng), positionDist(rng), positionDist(rng)), radiusDist(rng));
+	}
+
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 proj = glm::perspective(glm::radians(70.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+	sFrustum frustum = extractFrustum(proj * view);
+
+	std::vector<uint32_t> visibleIndices;
+	visibleIndices.reserve(sphereCount + 8);
+	cull(frustum, visibleIndices); // Warm up
+
+	auto startTime = high_resolution_clock::now();
+	size_t visibleTotal = 0;
+	for (int i = 0; i < iterations; i++)
+	{
+		visibleTotal += cull(frustum, visibleIndices);
+	}
+	double elapsedMs = duration<double, std::milli>(high_resolution_clock::now() - startTime).count();
+
+	double spheresPerMs = (static_cast<double>(sphereCount) * iterations) / elapsedMs;
+	mDebugPrint(std::format("Culled {} spheres x{} in {:.3f} ms ({} path, {:.1f}% visible): {:.2f}M spheres/ms",
+		sphereCount, iterations, elapsedMs, getCullingPathName(m_cullingPath), 100.0 * visibleTotal / (static_cast<double>(sphereCount) * iterations), spheresPerMs / 1e6));
+
+	m_centerX = savedX;
+	m_centerY = savedY;
+	m_centerZ = savedZ;
+	m_radius = savedR;
+	m_sphereCount = savedCount;
+
+	return spheresPerMs;
+}
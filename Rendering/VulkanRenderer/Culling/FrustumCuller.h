@@ -0,0 +1,73 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+#include "../Utilities/Utilities.h"
+
+
+// Batched frustum culling of bounding spheres.
+// Spheres are stored as a structure of arrays so the SSE/AVX2 paths can test 4/8 spheres per plane at once.
+// The widest path supported by the CPU is picked once at startup, with a scalar fallback.
+class FrustumCuller
+{
+public:
+	enum class eCullingPath
+	{
+		SCALAR,
+		SSE,
+		AVX2
+	};
+
+	struct sFrustum
+	{
+		glm::vec4 planes[6]; // Normalised planes (xyz = inward facing normal, w = distance).
+	};
+
+	FrustumCuller();
+
+	// Extracts the six frustum planes from a combined view projection matrix (Gribb/Hartmann).
+	static sFrustum extractFrustum(const glm::mat4& viewProj);
+
+	void clear();
+	// Adds a world space bounding sphere to the batch and returns its index within the batch.
+	uint32_t addSphere(glm::vec3 center, float radius);
+	// Tests the batch against the frustum and writes the indices of the visible spheres. Returns the visible count.
+	size_t cull(const sFrustum& frustum, std::vector<uint32_t>& visibleIndices);
+	// Same against the union of several frusta, a sphere inside any of them is visible. Indices stay in ascending order.
+	size_t cull(const std::vector<sFrustum>& frusta, std::vector<uint32_t>& visibleIndices);
+
+	size_t getSphereCount() { return m_sphereCount; }
+	glm::vec4 getSphere(uint32_t index) { return glm::vec4(m_centerX[index], m_centerY[index], m_centerZ[index], m_radius[index]); }
+	eCullingPath getCullingPath() { return m_cullingPath; }
+	static const char* getCullingPathName(eCullingPath path);
+
+	// Culls a synthetic batch with the active path and returns the throughput in spheres per millisecond.
+	double benchmark(size_t sphereCount, int iterations);
+
+private:
+	Utilities* m_pUtilities = nullptr;
+
+	eCullingPath m_cullingPath = eCullingPath::SCALAR;
+
+	// Padded to a multiple of 8 with spheres that can never be visible, so the SIMD paths have no remainder loop
+	std::vector<float> m_centerX = {};
+	std::vector<float> m_centerY = {};
+	std::vector<float> m_centerZ = {};
+	std::vector<float> m_radius = {};
+	size_t m_sphereCount = 0;
+	std::vector<uint32_t> m_scratchIndices = {}; // Kernel output, kept around so it isn't zero filled every frame
+	std::vector<uint32_t> m_scratchFrustumIndices = {}; // One frustum's visible indices when culling against several
+	std::vector<uint8_t> m_scratchVisible = {}; // Per sphere flag the frusta's results are merged into
+
+
+	static eCullingPath detectCullingPath();
+
+	static size_t cullScalar(const float* pX, const float* pY, const float* pZ, const float* pR, size_t count, const sFrustum& frustum, uint32_t* pOutIndices);
+	static size_t cullSSE(const float* pX, const float* pY, const float* pZ, const float* pR, size_t count, const sFrustum& frustum, uint32_t* pOutIndices);
+	static size_t cullAVX2(const float* pX, const float* pY, const float* pZ, const float* pR, size_t count, const sFrustum& frustum, uint32_t* pOutIndices);
+};
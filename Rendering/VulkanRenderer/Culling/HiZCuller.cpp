@@ -0,0 +1,538 @@
+#include "../VulkanRenderer.h"
+#include "../Graphics/Buffers.h"
+#include "../Graphics/Image.h"
+#include "../Graphics/GraphicsPipeline.h"
+#include "FrustumCuller.h"
+
+#include "HiZCuller.h"
+
+
+
+HiZCuller::HiZCuller(uint32_t objectCount) : m_pLogicalDevice(VulkanEngine::getInstance()->m_pLogicalDevice->getVkDevice()), m_pBufferManager(VulkanEngine::getInstance()->m_pBufferManager),
+	m_pGraphicsSettings(&VulkanEngine::getInstance()->m_settings->graphicsSettings), m_MAX_FRAMES_IN_FLIGHT(VulkanEngine::getInstance()->m_MAX_FRAMES_IN_FLIGHT),
+	m_objectCount(objectCount), m_pUtilities(Utilities::getInstance())
+{
+	createBuffers();
+	createPipelines();
+	sizeDepthPyramid();
+	createDescriptorSets();
+}
+
+
+void HiZCuller::createBuffers()
+{
+	mDebugPrint("Creating occlusion culling buffers...");
+
+	// Vulkan doesn't allow empty buffers
+	VkDeviceSize objectCount = std::max(m_objectCount, 1u);
+
+	VkDeviceSize boundsSize = objectCount * sizeof(sObjectBounds);
+	m_boundsBuffers.resize(m_MAX_FRAMES_IN_FLIGHT);
+	m_boundsBuffersMemory.resize(m_MAX_FRAMES_IN_FLIGHT);
+	m_boundsBuffersMapped.resize(m_MAX_FRAMES_IN_FLIGHT);
+
+	for (size_t i = 0; i < m_MAX_FRAMES_IN_FLIGHT; i++) {
+		m_pBufferManager->createBuffer(boundsSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_boundsBuffers[i], m_boundsBuffersMemory[i]);
+		vkMapMemory(*m_pLogicalDevice, m_boundsBuffersMemory[i], 0, boundsSize, 0, &m_boundsBuffersMapped[i]);
+	}
+
+	m_pBufferManager->createBuffer(objectCount * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_visibilityBuffer, m_visibilityBufferMemory);
+	m_pBufferManager->createBuffer(objectCount * sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_earlyDrawBuffer, m_earlyDrawBufferMemory);
+	m_pBufferManager->createBuffer(objectCount * sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_lateDrawBuffer, m_lateDrawBufferMemory);
+
+	// Nothing was visible before the first frame, so everything gets drawn by the late phase
+	CommandBuffer* pCommandBuffer = m_pBufferManager->getCommandBuffer();
+	VkCommandBuffer commandBuffer = pCommandBuffer->beginSingleTimeCommands();
+	vkCmdFillBuffer(commandBuffer, m_visibilityBuffer, 0, VK_WHOLE_SIZE, 0);
+	pCommandBuffer->endSingleTimeCommands(commandBuffer);
+
+
+	VkSamplerCreateInfo samplerInfo{
+		.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+		.magFilter = VK_FILTER_NEAREST,
+		.minFilter = VK_FILTER_NEAREST,
+		.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+		.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+		.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+		.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+		.mipLodBias = 0.0f,
+		.anisotropyEnable = VK_FALSE,
+		.maxAnisotropy = 1.0f,
+		.compareEnable = VK_FALSE,
+		.compareOp = VK_COMPARE_OP_ALWAYS,
+		.minLod = 0.0f,
+		.maxLod = VK_LOD_CLAMP_NONE,
+		.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE,
+		.unnormalizedCoordinates = VK_FALSE,
+	};
+
+	if (vkCreateSampler(*m_pLogicalDevice, &samplerInfo, nullptr, &m_depthSampler) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create depth pyramid sampler!");
+	}
+}
+
+void HiZCuller::sizeDepthPyramid()
+{
+	m_depthExtent = *m_pBufferManager->m_pSwapchain->getSwapchainExtent();
+
+	// Level 0 is half the depth buffer, rounded up so the edge pixels are always covered
+	m_pyramidExtent = {
+		.width = std::max((m_depthExtent.width + 1) / 2, 1u),
+		.height = std::max((m_depthExtent.height + 1) / 2, 1u)
+	};
+
+	m_pyramidLevels = 1;
+	for (uint32_t width = m_pyramidExtent.width, height = m_pyramidExtent.height; width > 1 || height > 1; m_pyramidLevels++) {
+		width = std::max((width + 1) / 2, 1u);
+		height = std::max((height + 1) / 2, 1u);
+	}
+
+	mDebugPrint(std::format("Sizing depth pyramid ({}x{}, {} levels)...", m_pyramidExtent.width, m_pyramidExtent.height, m_pyramidLevels));
+}
+
+RenderGraph::sImageDesc HiZCuller::getDepthPyramidDesc()
+{
+	return RenderGraph::sImageDesc{
+		.format = sm_pyramidFormat,
+		.width = m_pyramidExtent.width,
+		.height = m_pyramidExtent.height,
+		.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+		.mipLevels = m_pyramidLevels
+	};
+}
+
+void HiZCuller::createPipelines()
+{
+	mDebugPrint("Creating occlusion culling pipelines...");
+
+	// Downsample: previous level (or depth buffer) -> next level
+	std::array<VkDescriptorSetLayoutBinding, 2> downsampleBindings{
+		VkDescriptorSetLayoutBinding{
+			.binding = 0,
+			.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+		},
+		VkDescriptorSetLayoutBinding{
+			.binding = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+		}
+	};
+
+	// Cull: bounds, visibility, early draws, late draws, depth pyramid
+	std::array<VkDescriptorSetLayoutBinding, 5> cullBindings{};
+	for (uint32_t i = 0; i < cullBindings.size(); i++) {
+		cullBindings[i] = VkDescriptorSetLayoutBinding{
+			.binding = i,
+			.descriptorType = i < 4 ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+		};
+	}
+
+	VkDescriptorSetLayoutCreateInfo downsampleLayoutInfo{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.bindingCount = static_cast<uint32_t>(downsampleBindings.size()),
+		.pBindings = downsampleBindings.data()
+	};
+
+	VkDescriptorSetLayoutCreateInfo cullLayoutInfo{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.bindingCount = static_cast<uint32_t>(cullBindings.size()),
+		.pBindings = cullBindings.data()
+	};
+
+	if (vkCreateDescriptorSetLayout(*m_pLogicalDevice, &downsampleLayoutInfo, nullptr, &m_downsampleSetLayout) != VK_SUCCESS ||
+		vkCreateDescriptorSetLayout(*m_pLogicalDevice, &cullLayoutInfo, nullptr, &m_cullSetLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create occlusion culling descriptor set layouts!");
+	}
+
+
+	VkPushConstantRange downsamplePushConstants{
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+		.offset = 0,
+		.size = sizeof(sDownsamplePushConstants)
+	};
+
+	VkPushConstantRange cullPushConstants{
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+		.offset = 0,
+		.size = sizeof(sCullPushConstants)
+	};
+
+	VkPipelineLayoutCreateInfo downsamplePipelineLayoutInfo{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.setLayoutCount = 1,
+		.pSetLayouts = &m_downsampleSetLayout,
+		.pushConstantRangeCount = 1,
+		.pPushConstantRanges = &downsamplePushConstants
+	};
+
+	VkPipelineLayoutCreateInfo cullPipelineLayoutInfo{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.setLayoutCount = 1,
+		.pSetLayouts = &m_cullSetLayout,
+		.pushConstantRangeCount = 1,
+		.pPushConstantRanges = &cullPushConstants
+	};
+
+	if (vkCreatePipelineLayout(*m_pLogicalDevice, &downsamplePipelineLayoutInfo, nullptr, &m_downsamplePipelineLayout) != VK_SUCCESS ||
+		vkCreatePipelineLayout(*m_pLogicalDevice, &cullPipelineLayoutInfo, nullptr, &m_cullPipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create occlusion culling pipeline layouts!");
+	}
+
+
+	VkShaderModule downsampleShaderModule = GraphicsPipeline::loadShaderModule(*m_pLogicalDevice, "hizDownsample.comp");
+	VkShaderModule cullShaderModule = GraphicsPipeline::loadShaderModule(*m_pLogicalDevice, "hizCull.comp");
+
+	std::array<VkComputePipelineCreateInfo, 2> pipelineInfos{
+		VkComputePipelineCreateInfo{
+			.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+			.stage {
+				.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+				.stage = VK_SHADER_STAGE_COMPUTE_BIT,
+				.module = downsampleShaderModule,
+				.pName = "main"
+			},
+			.layout = m_downsamplePipelineLayout
+		},
+		VkComputePipelineCreateInfo{
+			.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+			.stage {
+				.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+				.stage = VK_SHADER_STAGE_COMPUTE_BIT,
+				.module = cullShaderModule,
+				.pName = "main"
+			},
+			.layout = m_cullPipelineLayout
+		}
+	};
+
+	std::array<VkPipeline, 2> pipelines{};
+	if (vkCreateComputePipelines(*m_pLogicalDevice, VK_NULL_HANDLE, static_cast<uint32_t>(pipelineInfos.size()), pipelineInfos.data(), nullptr, pipelines.data()) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create occlusion culling pipelines!");
+	}
+	m_downsamplePipeline = pipelines[0];
+	m_cullPipeline = pipelines[1];
+
+	vkDestroyShaderModule(*m_pLogicalDevice, downsampleShaderModule, nullptr);
+	vkDestroyShaderModule(*m_pLogicalDevice, cullShaderModule, nullptr);
+}
+
+void HiZCuller::createDescriptorSets()
+{
+	uint32_t frameCount = static_cast<uint32_t>(m_MAX_FRAMES_IN_FLIGHT);
+
+	std::array<VkDescriptorPoolSize, 3> poolSizes{
+		VkDescriptorPoolSize{
+			.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.descriptorCount = (m_pyramidLevels + 1) * frameCount
+		},
+		VkDescriptorPoolSize{
+			.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+			.descriptorCount = m_pyramidLevels * frameCount
+		},
+		VkDescriptorPoolSize{
+			.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.descriptorCount = 4 * frameCount
+		}
+	};
+
+	VkDescriptorPoolCreateInfo poolInfo{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.maxSets = (m_pyramidLevels + 1) * frameCount,
+		.poolSizeCount = static_cast<uint32_t>(poolSizes.size()),
+		.pPoolSizes = poolSizes.data()
+	};
+
+	if (vkCreateDescriptorPool(*m_pLogicalDevice, &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create occlusion culling descriptor pool!");
+	}
+
+
+	std::vector<VkDescriptorSetLayout> downsampleLayouts(m_pyramidLevels * frameCount, m_downsampleSetLayout);
+	std::vector<VkDescriptorSetLayout> cullLayouts(frameCount, m_cullSetLayout);
+	m_downsampleSets.resize(m_pyramidLevels * frameCount);
+	m_cullSets.resize(frameCount);
+	m_pyramidViews.resize(frameCount);
+
+	VkDescriptorSetAllocateInfo downsampleAllocInfo{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.descriptorPool = m_descriptorPool,
+		.descriptorSetCount = m_pyramidLevels * frameCount,
+		.pSetLayouts = downsampleLayouts.data()
+	};
+
+	VkDescriptorSetAllocateInfo cullAllocInfo{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.descriptorPool = m_descriptorPool,
+		.descriptorSetCount = frameCount,
+		.pSetLayouts = cullLayouts.data()
+	};
+
+	if (vkAllocateDescriptorSets(*m_pLogicalDevice, &downsampleAllocInfo, m_downsampleSets.data()) != VK_SUCCESS ||
+		vkAllocateDescriptorSets(*m_pLogicalDevice, &cullAllocInfo, m_cullSets.data()) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate occlusion culling descriptor sets!");
+	}
+
+
+	// The pyramid bindings wait for the frame's transient, see setDepthPyramid
+	for (uint32_t i = 0; i < frameCount; i++)
+	{
+		std::array<VkDescriptorBufferInfo, 4> bufferInfos{
+			VkDescriptorBufferInfo{ .buffer = m_boundsBuffers[i], .offset = 0, .range = VK_WHOLE_SIZE },
+			VkDescriptorBufferInfo{ .buffer = m_visibilityBuffer, .offset = 0, .range = VK_WHOLE_SIZE },
+			VkDescriptorBufferInfo{ .buffer = m_earlyDrawBuffer, .offset = 0, .range = VK_WHOLE_SIZE },
+			VkDescriptorBufferInfo{ .buffer = m_lateDrawBuffer, .offset = 0, .range = VK_WHOLE_SIZE }
+		};
+
+		std::array<VkWriteDescriptorSet, 4> descriptorWrites{};
+		for (uint32_t binding = 0; binding < descriptorWrites.size(); binding++) {
+			descriptorWrites[binding] = VkWriteDescriptorSet{
+				.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+				.dstSet = m_cullSets[i],
+				.dstBinding = binding,
+				.descriptorCount = 1,
+				.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				.pBufferInfo = &bufferInfos[binding]
+			};
+		}
+
+		vkUpdateDescriptorSets(*m_pLogicalDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+	}
+}
+
+void HiZCuller::setDepthPyramid(uint32_t frameIndex, VkImage pyramidImage, VkImageView pyramidView)
+{
+	// The frame's last use of its level views has finished by the time it's recorded again, so they can go right away
+	sPyramidViews& pyramidViews = m_pyramidViews[frameIndex];
+	uint64_t transientGeneration = m_pBufferManager->getRenderGraph()->getTransientGeneration(frameIndex);
+	if (pyramidViews.levelViews.empty() || pyramidViews.transientGeneration != transientGeneration)
+	{
+		for (VkImageView levelView : pyramidViews.levelViews) {
+			vkDestroyImageView(*m_pLogicalDevice, levelView, nullptr);
+		}
+
+		pyramidViews.levelViews.resize(m_pyramidLevels);
+		for (uint32_t level = 0; level < m_pyramidLevels; level++) {
+			pyramidViews.levelViews[level] = Image::createImageView(pyramidImage, sm_pyramidFormat, VK_IMAGE_ASPECT_COLOR_BIT, level, 1);
+		}
+		pyramidViews.transientGeneration = transientGeneration;
+	}
+
+	// Two writes per level and the cull set's pyramid, the infos have to stay where they are until the update
+	std::vector<VkDescriptorImageInfo> imageInfos;
+	std::vector<VkWriteDescriptorSet> descriptorWrites;
+	imageInfos.reserve(2 * m_pyramidLevels + 1);
+	descriptorWrites.reserve(2 * m_pyramidLevels + 1);
+
+	for (uint32_t level = 0; level < m_pyramidLevels; level++)
+	{
+		VkDescriptorSet downsampleSet = m_downsampleSets[frameIndex * m_pyramidLevels + level];
+
+		// Level 0 reads the depth buffer, which the first render pass leaves in a read only layout
+		imageInfos.push_back(VkDescriptorImageInfo{
+			.sampler = m_depthSampler,
+			.imageView = level == 0 ? *m_pBufferManager->getDepthBuffer()->getVkImageView() : pyramidViews.levelViews[level - 1],
+			.imageLayout = level == 0 ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL
+		});
+		descriptorWrites.push_back(VkWriteDescriptorSet{
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = downsampleSet,
+			.dstBinding = 0,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.pImageInfo = &imageInfos.back()
+		});
+
+		imageInfos.push_back(VkDescriptorImageInfo{
+			.imageView = pyramidViews.levelViews[level],
+			.imageLayout = VK_IMAGE_LAYOUT_GENERAL
+		});
+		descriptorWrites.push_back(VkWriteDescriptorSet{
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = downsampleSet,
+			.dstBinding = 1,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+			.pImageInfo = &imageInfos.back()
+		});
+	}
+
+	imageInfos.push_back(VkDescriptorImageInfo{
+		.sampler = m_depthSampler,
+		.imageView = pyramidView,
+		.imageLayout = VK_IMAGE_LAYOUT_GENERAL
+	});
+	descriptorWrites.push_back(VkWriteDescriptorSet{
+		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+		.dstSet = m_cullSets[frameIndex],
+		.dstBinding = 4,
+		.descriptorCount = 1,
+		.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		.pImageInfo = &imageInfos.back()
+	});
+
+	vkUpdateDescriptorSets(*m_pLogicalDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+}
+
+
+
+void HiZCuller::updateObjects(uint32_t frameIndex, const glm::mat4& viewProj, FrustumCuller* pFrustumCuller, const std::vector<uint32_t>& visibleIndices, std::vector<Model*>& models)
+{
+	m_frameIndex = frameIndex;
+	m_renderExtent = *m_pBufferManager->m_pSwapchain->getRenderExtent();
+
+	// Safe to write, the frame's fence has already been waited on
+	sObjectBounds* pBounds = static_cast<sObjectBounds*>(m_boundsBuffersMapped[frameIndex]);
+	for (uint32_t i = 0; i < m_objectCount; i++) {
+		pBounds[i] = sObjectBounds{
+			.sphere = pFrustumCuller->getSphere(i),
+			.indexCount = static_cast<uint32_t>(models[i]->m_pIndexBuffer->m_indices.size()),
+			.firstIndex = 0,
+			.vertexOffset = 0,
+			.frustumVisible = 0
+		};
+	}
+
+	for (uint32_t index : visibleIndices) pBounds[index].frustumVisible = 1;
+
+	m_cullConstants = sCullPushConstants{
+		.viewProj = viewProj,
+		.depthSize = glm::vec2(m_renderExtent.width, m_renderExtent.height), // Screen UVs map onto the drawn part only
+		.nearClip = m_pGraphicsSettings->nearClip,
+		.objectCount = m_objectCount,
+		.pyramidLevels = m_pyramidLevels,
+		.phase = 0
+	};
+}
+
+void HiZCuller::recordEarlyCull(VkCommandBuffer commandBuffer)
+{
+	recordCull(commandBuffer, 0);
+}
+
+void HiZCuller::recordDepthPyramid(VkCommandBuffer commandBuffer)
+{
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_downsamplePipeline);
+
+	// Levels are built over the drawn part of the depth buffer only. Its edges are clamped like an odd size would be, so
+	// depth left outside it from an earlier, larger frame never reaches the pyramid.
+	VkExtent2D inputExtent = m_renderExtent;
+	VkExtent2D outputExtent = {
+		.width = std::max((inputExtent.width + 1) / 2, 1u),
+		.height = std::max((inputExtent.height + 1) / 2, 1u)
+	};
+
+	for (uint32_t level = 0; level < m_pyramidLevels; level++)
+	{
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_downsamplePipelineLayout, 0, 1, &m_downsampleSets[m_frameIndex * m_pyramidLevels + level], 0, nullptr);
+
+		sDownsamplePushConstants pushConstants{
+			.inputSize = glm::ivec2(inputExtent.width, inputExtent.height),
+			.outputSize = glm::ivec2(outputExtent.width, outputExtent.height)
+		};
+		vkCmdPushConstants(commandBuffer, m_downsamplePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+
+		vkCmdDispatch(commandBuffer, (outputExtent.width + 7) / 8, (outputExtent.height + 7) / 8, 1);
+
+		// The next level reads what was just written, the render graph covers the late cull after the last one
+		if (level + 1 < m_pyramidLevels) {
+			VkMemoryBarrier barrier{
+				.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+				.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+				.dstAccessMask = VK_ACCESS_SHADER_READ_BIT
+			};
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+		}
+
+		inputExtent = outputExtent;
+		outputExtent = {
+			.width = std::max((outputExtent.width + 1) / 2, 1u),
+			.height = std::max((outputExtent.height + 1) / 2, 1u)
+		};
+	}
+}
+
+void HiZCuller::recordLateCull(VkCommandBuffer commandBuffer)
+{
+	recordCull(commandBuffer, 1);
+}
+
+void HiZCuller::recordCull(VkCommandBuffer commandBuffer, uint32_t phase)
+{
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_cullPipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_cullPipelineLayout, 0, 1, &m_cullSets[m_frameIndex], 0, nullptr);
+
+	sCullPushConstants pushConstants = m_cullConstants;
+	pushConstants.phase = phase;
+	vkCmdPushConstants(commandBuffer, m_cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+
+	vkCmdDispatch(commandBuffer, (m_objectCount + 63) / 64, 1, 1);
+}
+
+
+
+void HiZCuller::recreateDepthPyramid()
+{
+	retireDepthPyramid();
+
+	sizeDepthPyramid();
+	createDescriptorSets();
+}
+
+void HiZCuller::cleanupDepthPyramid()
+{
+	vkDestroyDescriptorPool(*m_pLogicalDevice, m_descriptorPool, nullptr);
+
+	// The pyramids themselves belong to the render graph
+	for (sPyramidViews& pyramidViews : m_pyramidViews) {
+		for (VkImageView levelView : pyramidViews.levelViews) {
+			vkDestroyImageView(*m_pLogicalDevice, levelView, nullptr);
+		}
+	}
+	m_pyramidViews.clear();
+}
+
+void HiZCuller::retireDepthPyramid()
+{
+	// The render graph replaces the pyramids themselves once their size changes
+	VulkanEngine::getInstance()->m_pDeletionQueue->push([device = *m_pLogicalDevice, descriptorPool = m_descriptorPool, pyramidViews = m_pyramidViews]() {
+		vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+
+		for (const sPyramidViews& frameViews : pyramidViews) {
+			for (VkImageView levelView : frameViews.levelViews) {
+				vkDestroyImageView(device, levelView, nullptr);
+			}
+		}
+	});
+	m_pyramidViews.clear();
+}
+
+void HiZCuller::cleanup()
+{
+	cleanupDepthPyramid();
+
+	vkDestroySampler(*m_pLogicalDevice, m_depthSampler, nullptr);
+
+	vkDestroyPipeline(*m_pLogicalDevice, m_downsamplePipeline, nullptr);
+	vkDestroyPipeline(*m_pLogicalDevice, m_cullPipeline, nullptr);
+	vkDestroyPipelineLayout(*m_pLogicalDevice, m_downsamplePipelineLayout, nullptr);
+	vkDestroyPipelineLayout(*m_pLogicalDevice, m_cullPipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(*m_pLogicalDevice, m_downsampleSetLayout, nullptr);
+	vkDestroyDescriptorSetLayout(*m_pLogicalDevice, m_cullSetLayout, nullptr);
+
+	for (size_t i = 0; i < m_MAX_FRAMES_IN_FLIGHT; i++) {
+		vkDestroyBuffer(*m_pLogicalDevice, m_boundsBuffers[i], nullptr);
+		vkFreeMemory(*m_pLogicalDevice, m_boundsBuffersMemory[i], nullptr);
+	}
+
+	vkDestroyBuffer(*m_pLogicalDevice, m_visibilityBuffer, nullptr);
+	vkFreeMemory(*m_pLogicalDevice, m_visibilityBufferMemory, nullptr);
+	vkDestroyBuffer(*m_pLogicalDevice, m_earlyDrawBuffer, nullptr);
+	vkFreeMemory(*m_pLogicalDevice, m_earlyDrawBufferMemory, nullptr);
+	vkDestroyBuffer(*m_pLogicalDevice, m_lateDrawBuffer, nullptr);
+	vkFreeMemory(*m_pLogicalDevice, m_lateDrawBufferMemory, nullptr);
+}
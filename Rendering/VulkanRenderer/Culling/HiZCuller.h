@@ -0,0 +1,139 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <cstdint>
+
+#include "../Utilities/Utilities.h"
+#include "../Graphics/RenderGraph.h"
+
+
+class BufferManager;
+class FrustumCuller;
+class Model;
+
+// GPU occlusion culling against a hierarchical depth (Hi-Z) pyramid.
+// The frame is drawn in two phases: models visible last frame are drawn first, a max depth mip chain is built from that
+// depth, then every model is tested against the pyramid and the ones the first phase missed are drawn on top.
+// Occluded models are left with an indirect draw of zero instances, so they never reach the vertex shader.
+class HiZCuller
+{
+public:
+	// Matches ObjectBounds in hizCull.comp
+	struct sObjectBounds
+	{
+		glm::vec4 sphere; // World space centre (xyz) and radius (w)
+		uint32_t indexCount;
+		uint32_t firstIndex;
+		int32_t vertexOffset;
+		uint32_t frustumVisible;
+	};
+
+	static constexpr VkFormat sm_pyramidFormat = VK_FORMAT_R32_SFLOAT;
+
+	HiZCuller(uint32_t objectCount);
+
+	// Uploads this frame's bounds. The frustum culler's batch indices must match the model indices.
+	void updateObjects(uint32_t frameIndex, const glm::mat4& viewProj, FrustumCuller* pFrustumCuller, const std::vector<uint32_t>& visibleIndices, std::vector<Model*>& models);
+
+	// Barriers between these and the draws are left to the render graph, see CommandBuffer::recordCommandBuffer
+	void recordEarlyCull(VkCommandBuffer commandBuffer);
+	void recordDepthPyramid(VkCommandBuffer commandBuffer);
+	void recordLateCull(VkCommandBuffer commandBuffer);
+
+	// The pyramid is a render graph transient, it only lives from the early draw to the late cull
+	RenderGraph::sImageDesc getDepthPyramidDesc();
+	// Points the frame's descriptor sets at its pyramid. Call after the graph is compiled and before it's executed, the early
+	// cull already binds the set the late cull samples the pyramid through.
+	void setDepthPyramid(uint32_t frameIndex, VkImage pyramidImage, VkImageView pyramidView);
+
+	// The pyramid follows the depth buffer's size, call after the depth buffer has been recreated.
+	// The old level views and descriptor sets are retired through the deletion queue, frames in flight may still be using them.
+	void recreateDepthPyramid();
+	void cleanup();
+
+	VkBuffer* getEarlyDrawBuffer() { return &m_earlyDrawBuffer; }
+	VkBuffer* getLateDrawBuffer() { return &m_lateDrawBuffer; }
+	VkBuffer* getVisibilityBuffer() { return &m_visibilityBuffer; }
+
+private:
+	// Matches the push constants in hizCull.comp
+	struct sCullPushConstants
+	{
+		glm::mat4 viewProj;
+		glm::vec2 depthSize;
+		float nearClip;
+		uint32_t objectCount;
+		uint32_t pyramidLevels;
+		uint32_t phase;
+	};
+
+	// Matches the push constants in hizDownsample.comp
+	struct sDownsamplePushConstants
+	{
+		glm::ivec2 inputSize;
+		glm::ivec2 outputSize;
+	};
+
+	// Views of every level of a frame's pyramid
+	struct sPyramidViews
+	{
+		std::vector<VkImageView> levelViews;
+		uint64_t transientGeneration = 0; // Of the render graph's transients they were created on
+	};
+
+	Utilities* m_pUtilities = nullptr;
+	VkDevice* m_pLogicalDevice = nullptr;
+	BufferManager* m_pBufferManager = nullptr;
+	sSettings::sGraphicsSettings* m_pGraphicsSettings = nullptr;
+	int m_MAX_FRAMES_IN_FLIGHT = 1;
+
+	uint32_t m_objectCount = 0;
+	uint32_t m_frameIndex = 0;
+	sCullPushConstants m_cullConstants = {};
+
+	// Depth pyramid, every level is kept in VK_IMAGE_LAYOUT_GENERAL so it can be written and sampled without transitions
+	VkExtent2D m_depthExtent = {};
+	VkExtent2D m_renderExtent = {}; // Part of the depth buffer this frame draws to, the pyramid is only built over it
+	VkExtent2D m_pyramidExtent = {};
+	uint32_t m_pyramidLevels = 0;
+	std::vector<sPyramidViews> m_pyramidViews = {}; // One per frame in flight
+	VkSampler m_depthSampler = VK_NULL_HANDLE;
+
+	// Bounds are written by the CPU every frame, the rest only ever lives on the GPU
+	std::vector<VkBuffer> m_boundsBuffers = {};
+	std::vector<VkDeviceMemory> m_boundsBuffersMemory = {};
+	std::vector<void*> m_boundsBuffersMapped = {};
+	VkBuffer m_visibilityBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory m_visibilityBufferMemory = VK_NULL_HANDLE;
+	VkBuffer m_earlyDrawBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory m_earlyDrawBufferMemory = VK_NULL_HANDLE;
+	VkBuffer m_lateDrawBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory m_lateDrawBufferMemory = VK_NULL_HANDLE;
+
+	VkDescriptorSetLayout m_downsampleSetLayout = VK_NULL_HANDLE;
+	VkPipelineLayout m_downsamplePipelineLayout = VK_NULL_HANDLE;
+	VkPipeline m_downsamplePipeline = VK_NULL_HANDLE;
+	VkDescriptorSetLayout m_cullSetLayout = VK_NULL_HANDLE;
+	VkPipelineLayout m_cullPipelineLayout = VK_NULL_HANDLE;
+	VkPipeline m_cullPipeline = VK_NULL_HANDLE;
+
+	VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+	std::vector<VkDescriptorSet> m_downsampleSets = {}; // One per pyramid level of every frame in flight
+	std::vector<VkDescriptorSet> m_cullSets = {}; // One per frame in flight
+
+
+	void createBuffers();
+	void sizeDepthPyramid();
+	void createPipelines();
+	void createDescriptorSets();
+	void cleanupDepthPyramid();
+	void retireDepthPyramid();
+
+	void recordCull(VkCommandBuffer commandBuffer, uint32_t phase);
+};
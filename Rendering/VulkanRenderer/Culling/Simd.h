@@ -0,0 +1,18 @@
+#pragma once
+
+// SIMD support shared by the CPU culling paths
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define NEBULA_SIMD_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC allows AVX2/FMA intrinsics in any function, GCC/Clang need the target enabled per function
+#if defined(NEBULA_SIMD_X86) && !defined(_MSC_VER)
+#define NEBULA_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define NEBULA_TARGET_AVX2
+#endif
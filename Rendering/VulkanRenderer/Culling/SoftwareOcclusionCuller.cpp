@@ -0,0 +1,331 @@
+#include "../VulkanRenderer.h"
+
+#include <random>
+#include <limits>
+#include <algorithm>
+
+#include "Simd.h"
+#include "FrustumCuller.h"
+#include "SoftwareOcclusionCuller.h"
+
+
+
+SoftwareOcclusionCuller::SoftwareOcclusionCuller(ThreadPool* pThreadPool, uint32_t width, uint32_t height) : m_pUtilities(Utilities::getInstance()), m_pThreadPool(pThreadPool)
+{
+	m_tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+	m_tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+	m_width = m_tilesX * TILE_SIZE;
+	m_height = m_tilesY * TILE_SIZE;
+
+	m_depth.resize(static_cast<size_t>(m_width) * m_height);
+	m_tileMaxDepth.resize(static_cast<size_t>(m_tilesX) * m_tilesY);
+	m_bandTriangles.resize(m_tilesY);
+
+	mDebugPrint(std::format("Software occlusion buffer: {}x{} ({} bands, {} worker threads)", m_width, m_height, m_tilesY, m_pThreadPool->getThreadCount()));
+
+	clear();
+}
+
+
+void SoftwareOcclusionCuller::clear()
+{
+	std::fill(m_depth.begin(), m_depth.end(), std::numeric_limits<float>::max());
+	std::fill(m_tileMaxDepth.begin(), m_tileMaxDepth.end(), std::numeric_limits<float>::max());
+	m_triangles.clear();
+	for (std::vector<uint32_t>& band : m_bandTriangles) band.clear();
+}
+
+void SoftwareOcclusionCuller::addOccluder(const glm::mat4& modelViewProj, float nearClip, const std::vector<glm::vec3>& vertices, const std::vector<uint32_t>& indices)
+{
+	m_scratchVertices.resize(vertices.size());
+	for (size_t i = 0; i < vertices.size(); i++) {
+		m_scratchVertices[i] = modelViewProj * glm::vec4(vertices[i], 1.0f);
+	}
+
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		const glm::vec4& clip0 = m_scratchVertices[indices[i]];
+		const glm::vec4& clip1 = m_scratchVertices[indices[i + 1]];
+		const glm::vec4& clip2 = m_scratchVertices[indices[i + 2]];
+
+		// Triangles crossing the near plane are dropped rather than clipped, losing an occluder is always safe
+		if (clip0.w < nearClip || clip1.w < nearClip || clip2.w < nearClip) continue;
+
+		glm::vec3 screen[3];
+		const glm::vec4* clips[3] = { &clip0, &clip1, &clip2 };
+		for (int v = 0; v < 3; v++) {
+			glm::vec3 ndc = glm::vec3(*clips[v]) / clips[v]->w;
+			screen[v] = glm::vec3((ndc.x * 0.5f + 0.5f) * m_width, (ndc.y * 0.5f + 0.5f) * m_height, ndc.z);
+		}
+
+		// Wind every triangle the same way so the inside is always positive, both faces occlude
+		float area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) - (screen[1].y - screen[0].y) * (screen[2].x - screen[0].x);
+		if (std::abs(area) < 1e-6f) continue;
+		if (area < 0.0f) std::swap(screen[1], screen[2]);
+
+		sTriangle triangle{};
+		for (int edge = 0; edge < 3; edge++) {
+			const glm::vec3& from = screen[edge];
+			const glm::vec3& to = screen[(edge + 1) % 3];
+			float a = from.y - to.y;
+			float b = to.x - from.x;
+
+			// Coverage is tested at pixel centres like the GPU does, so triangles sharing an edge leave no cracks
+			triangle.edgeA[edge] = a;
+			triangle.edgeB[edge] = b;
+			triangle.edgeC[edge] = -(a * from.x + b * from.y);
+		}
+
+		triangle.depth = std::max(screen[0].z, std::max(screen[1].z, screen[2].z));
+
+		float minX = std::min(screen[0].x, std::min(screen[1].x, screen[2].x));
+		float maxX = std::max(screen[0].x, std::max(screen[1].x, screen[2].x));
+		float minY = std::min(screen[0].y, std::min(screen[1].y, screen[2].y));
+		float maxY = std::max(screen[0].y, std::max(screen[1].y, screen[2].y));
+		if (maxX < 0.0f || maxY < 0.0f || minX >= m_width || minY >= m_height) continue;
+
+		triangle.minX = static_cast<int>(std::max(minX, 0.0f));
+		triangle.minY = static_cast<int>(std::max(minY, 0.0f));
+		triangle.maxX = static_cast<int>(std::min(maxX, static_cast<float>(m_width - 1)));
+		triangle.maxY = static_cast<int>(std::min(maxY, static_cast<float>(m_height - 1)));
+
+		uint32_t triangleIndex = static_cast<uint32_t>(m_triangles.size());
+		m_triangles.push_back(triangle);
+		for (int band = triangle.minY / TILE_SIZE; band <= triangle.maxY / static_cast<int>(TILE_SIZE); band++) {
+			m_bandTriangles[band].push_back(triangleIndex);
+		}
+	}
+}
+
+void SoftwareOcclusionCuller::rasterise()
+{
+	// Bands don't share pixels or tiles, so they need no synchronisation
+	m_pThreadPool->parallelFor(m_tilesY, [this](uint32_t band) { rasteriseBand(band); });
+}
+
+void SoftwareOcclusionCuller::rasteriseBand(uint32_t band)
+{
+	int bandMinY = static_cast<int>(band * TILE_SIZE);
+	int bandMaxY = bandMinY + static_cast<int>(TILE_SIZE) - 1;
+
+	for (uint32_t triangleIndex : m_bandTriangles[band])
+	{
+		const sTriangle& triangle = m_triangles[triangleIndex];
+		int minY = std::max(triangle.minY, bandMinY);
+		int maxY = std::min(triangle.maxY, bandMaxY);
+
+		for (int y = minY; y <= maxY; y++) {
+			rasteriseRow(&m_depth[static_cast<size_t>(y) * m_width], triangle, triangle.minX, triangle.maxX, static_cast<float>(y) + 0.5f);
+		}
+	}
+
+	for (uint32_t tileX = 0; tileX < m_tilesX; tileX++)
+	{
+		float tileMax = 0.0f;
+		for (uint32_t y = 0; y < TILE_SIZE; y++) {
+			const float* pRow = &m_depth[static_cast<size_t>(bandMinY + y) * m_width + tileX * TILE_SIZE];
+			for (uint32_t x = 0; x < TILE_SIZE; x++) tileMax = std::max(tileMax, pRow[x]);
+		}
+		m_tileMaxDepth[band * m_tilesX + tileX] = tileMax;
+	}
+}
+
+void SoftwareOcclusionCuller::rasteriseRow(float* pRow, const sTriangle& triangle, int minX, int maxX, float pixelY)
+{
+	float rowC[3];
+	for (int edge = 0; edge < 3; edge++) rowC[edge] = triangle.edgeB[edge] * pixelY + triangle.edgeC[edge];
+
+#if defined(NEBULA_SIMD_X86)
+	// The buffer width is a multiple of 4, so a group starting inside the row never runs past its end
+	const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 depth = _mm_set1_ps(triangle.depth);
+	const __m128 a0 = _mm_set1_ps(triangle.edgeA[0]), a1 = _mm_set1_ps(triangle.edgeA[1]), a2 = _mm_set1_ps(triangle.edgeA[2]);
+	const __m128 c0 = _mm_set1_ps(rowC[0]), c1 = _mm_set1_ps(rowC[1]), c2 = _mm_set1_ps(rowC[2]);
+
+	for (int x = minX & ~3; x <= maxX; x += 4)
+	{
+		__m128 pixelX = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), laneOffsets);
+		__m128 inside0 = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a0, pixelX), c0), zero);
+		__m128 inside1 = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a1, pixelX), c1), zero);
+		__m128 inside2 = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a2, pixelX), c2), zero);
+		__m128 coverage = _mm_and_ps(_mm_and_ps(inside0, inside1), inside2);
+		if (_mm_movemask_ps(coverage) == 0) continue;
+
+		// Masked depth write, only covered pixels move closer
+		__m128 oldDepth = _mm_loadu_ps(pRow + x);
+		__m128 newDepth = _mm_min_ps(oldDepth, depth);
+		_mm_storeu_ps(pRow + x, _mm_or_ps(_mm_and_ps(coverage, newDepth), _mm_andnot_ps(coverage, oldDepth)));
+	}
+#else
+	for (int x = minX; x <= maxX; x++)
+	{
+		float pixelX = static_cast<float>(x) + 0.5f;
+		if (triangle.edgeA[0] * pixelX + rowC[0] >= 0.0f && triangle.edgeA[1] * pixelX + rowC[1] >= 0.0f && triangle.edgeA[2] * pixelX + rowC[2] >= 0.0f) {
+			pRow[x] = std::min(pRow[x], triangle.depth);
+		}
+	}
+#endif
+}
+
+bool SoftwareOcclusionCuller::isVisible(const glm::mat4& viewProj, float nearClip, glm::vec4 sphere)
+{
+	glm::vec2 minPixel(std::numeric_limits<float>::max());
+	glm::vec2 maxPixel(-std::numeric_limits<float>::max());
+	float nearestDepth = std::numeric_limits<float>::max();
+
+	// Project the sphere's world space box, which is looser than the sphere but always contains it
+	for (int i = 0; i < 8; i++)
+	{
+		glm::vec3 corner = glm::vec3(sphere) + sphere.w * glm::vec3((i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? 1.0f : -1.0f);
+		glm::vec4 clip = viewProj * glm::vec4(corner, 1.0f);
+		if (clip.w < nearClip) return true;
+
+		glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		glm::vec2 pixel = (glm::vec2(ndc) * 0.5f + 0.5f) * glm::vec2(m_width, m_height);
+		minPixel = glm::min(minPixel, pixel);
+		maxPixel = glm::max(maxPixel, pixel);
+		nearestDepth = std::min(nearestDepth, ndc.z);
+	}
+
+	// Off screen bounds are the frustum culler's call
+	if (maxPixel.x < 0.0f || maxPixel.y < 0.0f || minPixel.x >= m_width || minPixel.y >= m_height) return true;
+
+	// Occluders cover whole pixels whose centres they contain, a one pixel guard band catches bounds peeking past their edges
+	minPixel -= 1.0f;
+	maxPixel += 1.0f;
+
+	int minX = static_cast<int>(std::max(minPixel.x, 0.0f));
+	int minY = static_cast<int>(std::max(minPixel.y, 0.0f));
+	int maxX = static_cast<int>(std::min(maxPixel.x, static_cast<float>(m_width - 1)));
+	int maxY = static_cast<int>(std::min(maxPixel.y, static_cast<float>(m_height - 1)));
+
+	for (int tileY = minY / static_cast<int>(TILE_SIZE); tileY <= maxY / static_cast<int>(TILE_SIZE); tileY++)
+	{
+		for (int tileX = minX / static_cast<int>(TILE_SIZE); tileX <= maxX / static_cast<int>(TILE_SIZE); tileX++)
+		{
+			if (m_tileMaxDepth[tileY * m_tilesX + tileX] < nearestDepth) continue;
+
+			// The tile can't hide the bounds on its own, check the pixels the bounds actually touch
+			int pixelMinY = std::max(minY, tileY * static_cast<int>(TILE_SIZE));
+			int pixelMaxY = std::min(maxY, (tileY + 1) * static_cast<int>(TILE_SIZE) - 1);
+			int pixelMinX = std::max(minX, tileX * static_cast<int>(TILE_SIZE));
+			int pixelMaxX = std::min(maxX, (tileX + 1) * static_cast<int>(TILE_SIZE) - 1);
+
+			for (int y = pixelMinY; y <= pixelMaxY; y++) {
+				const float* pRow = &m_depth[static_cast<size_t>(y) * m_width];
+				for (int x = pixelMinX; x <= pixelMaxX; x++) {
+					if (pRow[x] >= nearestDepth) return true;
+				}
+			}
+		}
+	}
+
+	return false;
+}
+
+size_t SoftwareOcclusionCuller::cull(const glm::mat4& viewProj, float nearClip, FrustumCuller* pFrustumCuller, std::vector<Model*>& models, std::vector<uint32_t>& visibleIndices)
+{
+	clear();
+
+	// Models outside the frustum can't cover anything on screen, so only visible ones are drawn as occluders. Transparent
+	// ones don't hide what's behind them.
+	for (uint32_t index : visibleIndices)
+	{
+		Model* model = models[index];
+		if (model->m_occluderIndices.empty() || model->isTransparent()) continue;
+
+		addOccluder(viewProj * model->getTransform(), nearClip, model->m_occluderVertices, model->m_occluderIndices);
+	}
+
+	rasterise();
+
+	size_t visibleCount = visibleIndices.size();
+	std::erase_if(visibleIndices, [&](uint32_t index) { return !isVisible(viewProj, nearClip, pFrustumCuller->getSphere(index)); });
+
+	return visibleCount - visibleIndices.size();
+}
+
+double SoftwareOcclusionCuller::benchmark(uint32_t occludeeCount, int iterations)
+{
+	using std::chrono::high_resolution_clock, std::chrono::duration;
+
+	const std::vector<glm::vec3> cubeVertices = {
+		{ -1.0f, -1.0f, -1.0f }, { 1.0f, -1.0f, -1.0f }, { 1.0f, 1.0f, -1.0f }, { -1.0f, 1.0f, -1.0f },
+		{ -1.0f, -1.0f, 1.0f }, { 1.0f, -1.0f, 1.0f }, { 1.0f, 1.0f, 1.0f }, { -1.0f, 1.0f, 1.0f }
+	};
+	const std::vector<uint32_t> cubeIndices = {
+		0, 1, 2, 0, 2, 3, 4, 6, 5, 4, 7, 6, 0, 4, 5, 0, 5, 1,
+		3, 2, 6, 3, 6, 7, 0, 3, 7, 0, 7, 4, 1, 5, 6, 1, 6, 2
+	};
+
+	const float nearClip = 0.1f;
+	const float aspectRatio = 16.0f / 9.0f;
+	const float tanHalfFov = glm::tan(glm::radians(35.0f));
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 proj = glm::perspective(glm::radians(70.0f), aspectRatio, nearClip, 1000.0f);
+	glm::mat4 viewProj = proj * view;
+
+	std::mt19937 rng(1337);
+	std::uniform_real_distribution<float> unitDist(-1.0f, 1.0f);
+
+	// Walls between the camera and the field of bounds
+	std::vector<glm::mat4> occluderTransforms;
+	std::uniform_real_distribution<float> wallDepthDist(15.0f, 40.0f);
+	std::uniform_real_distribution<float> wallWidthDist(3.0f, 10.0f);
+	std::uniform_real_distribution<float> wallHeightDist(2.0f, 6.0f);
+	for (int i = 0; i < 32; i++)
+	{
+		float depth = wallDepthDist(rng);
+		glm::vec3 position(unitDist(rng) * depth * tanHalfFov * aspectRatio, unitDist(rng) * depth * tanHalfFov, -depth);
+		occluderTransforms.push_back(glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(wallWidthDist(rng), wallHeightDist(rng), 0.5f)));
+	}
+
+	// Bounds spread over the view so frustum culling alone wouldn't remove them
+	std::vector<glm::vec4> spheres(occludeeCount);
+	std::uniform_real_distribution<float> fieldDepthDist(50.0f, 300.0f);
+	std::uniform_real_distribution<float> radiusDist(0.5f, 3.0f);
+	for (glm::vec4& sphere : spheres)
+	{
+		float depth = fieldDepthDist(rng);
+		sphere = glm::vec4(unitDist(rng) * depth * tanHalfFov * aspectRatio * 0.9f, unitDist(rng) * depth * tanHalfFov * 0.9f, -depth, radiusDist(rng));
+	}
+
+	double rasteriseMs = 0.0;
+	double testMs = 0.0;
+	size_t culledCount = 0;
+	for (int i = 0; i < iterations; i++)
+	{
+		auto startTime = high_resolution_clock::now();
+
+		clear();
+		for (const glm::mat4& transform : occluderTransforms) addOccluder(viewProj * transform, nearClip, cubeVertices, cubeIndices);
+		rasterise();
+
+		auto rasteriseTime = high_resolution_clock::now();
+
+		culledCount = 0;
+		for (const glm::vec4& sphere : spheres) {
+			if (!isVisible(viewProj, nearClip, sphere)) culledCount++;
+		}
+
+		auto endTime = high_resolution_clock::now();
+		rasteriseMs += duration<double, std::milli>(rasteriseTime - startTime).count();
+		testMs += duration<double, std::milli>(endTime - rasteriseTime).count();
+	}
+
+	double culledFraction = occludeeCount > 0 ? static_cast<double>(culledCount) / occludeeCount : 0.0;
+	mDebugPrint(std::format("Software occlusion: {} occluder triangles, {}/{} draws culled ({:.1f}%), rasterise {:.3f} ms + test {:.3f} ms per frame ({} path)",
+		m_triangles.size(), culledCount, occludeeCount, culledFraction * 100.0, rasteriseMs / iterations, testMs / iterations,
+#if defined(NEBULA_SIMD_X86)
+		"SSE"
+#else
+		"scalar"
+#endif
+	));
+
+	// Leave nothing behind for the next real frame
+	clear();
+
+	return culledFraction;
+}
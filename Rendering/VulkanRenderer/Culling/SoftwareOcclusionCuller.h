@@ -0,0 +1,72 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+#include "../Utilities/Utilities.h"
+#include "../Utilities/ThreadPool.h"
+
+
+class FrustumCuller;
+class Model;
+
+// CPU occlusion culling for machines where the GPU is too weak for the depth pyramid path to pay off.
+// Simplified occluder meshes are rasterised into a small depth buffer, one band of tiles per worker, 4 pixels at a time
+// with the edge tests producing a coverage mask for a masked depth write. Bounds are then tested against the tiles.
+// Both halves lean towards keeping models: occluders write their furthest depth, and bounds are tested with their
+// nearest depth over every pixel they touch plus a one pixel guard band for occluder edges that only cover part of a pixel.
+class SoftwareOcclusionCuller
+{
+public:
+	static constexpr uint32_t TILE_SIZE = 8; // Tiles are TILE_SIZE x TILE_SIZE pixels, each row of tiles is one band of work
+
+	// Width and height are rounded up to whole tiles.
+	SoftwareOcclusionCuller(ThreadPool* pThreadPool, uint32_t width = 320, uint32_t height = 184);
+
+	// Rasterises the occluders of the visible models and removes the models hidden behind them. Returns the culled count.
+	// The frustum culler's batch indices must match the model indices.
+	size_t cull(const glm::mat4& viewProj, float nearClip, FrustumCuller* pFrustumCuller, std::vector<Model*>& models, std::vector<uint32_t>& visibleIndices);
+
+	void clear();
+	void addOccluder(const glm::mat4& modelViewProj, float nearClip, const std::vector<glm::vec3>& vertices, const std::vector<uint32_t>& indices);
+	void rasterise();
+	// Tests a world space bounding sphere against the rasterised occluders.
+	bool isVisible(const glm::mat4& viewProj, float nearClip, glm::vec4 sphere);
+
+	// Rasterises a synthetic scene of box occluders, tests a field of bounds against it and reports how many it culls.
+	// Returns the culled fraction.
+	double benchmark(uint32_t occludeeCount, int iterations);
+
+private:
+	// Edge functions are A * x + B * y + C, positive inside
+	struct sTriangle
+	{
+		float edgeA[3];
+		float edgeB[3];
+		float edgeC[3];
+		float depth; // Furthest vertex depth
+		int minX, minY, maxX, maxY; // Inclusive pixel bounds
+	};
+
+	Utilities* m_pUtilities = nullptr;
+	ThreadPool* m_pThreadPool = nullptr;
+
+	uint32_t m_width = 0;
+	uint32_t m_height = 0;
+	uint32_t m_tilesX = 0;
+	uint32_t m_tilesY = 0;
+
+	std::vector<float> m_depth = {}; // Per pixel, FLT_MAX where no occluder has been drawn
+	std::vector<float> m_tileMaxDepth = {}; // Furthest depth of every tile, rejects most tests without touching pixels
+	std::vector<sTriangle> m_triangles = {};
+	std::vector<std::vector<uint32_t>> m_bandTriangles = {}; // Triangles binned by the bands they overlap
+	std::vector<glm::vec4> m_scratchVertices = {};
+
+
+	void rasteriseBand(uint32_t band);
+	static void rasteriseRow(float* pRow, const sTriangle& triangle, int minX, int maxX, float pixelY);
+};
@@ -0,0 +1,213 @@
+#include "../VulkanRenderer.h"
+#include "GpuTimeline.h"
+
+#include "AsyncCompute.h"
+
+
+AsyncCompute::AsyncCompute(uint32_t frameCount) : m_pUtilities(Utilities::getInstance()), m_pLogicalDevice(VulkanEngine::getInstance()->m_pLogicalDevice->getVkDevice()),
+	m_pComputeQueue(VulkanEngine::getInstance()->m_pLogicalDevice->getComputeQueue()), m_pGraphicsTimeline(VulkanEngine::getInstance()->m_pGpuTimeline)
+{
+	m_computeFamily = VulkanEngine::getInstance()->m_pLogicalDevice->getComputeFamily();
+	m_graphicsFamily = VulkanEngine::getInstance()->m_pLogicalDevice->getGraphicsFamily();
+
+	mDebugPrint(isDedicated() ? std::format("Creating async compute on queue family {}...", m_computeFamily) : "Creating async compute on the graphics queue...");
+
+	m_pTimeline = new GpuTimeline();
+
+	m_commandPools.resize(frameCount);
+	m_commandBuffers.resize(frameCount);
+	m_frameValues.resize(frameCount, 0);
+
+	for (uint32_t i = 0; i < frameCount; i++) {
+		VkCommandPoolCreateInfo poolInfo{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+			.pNext = nullptr,
+			.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+			.queueFamilyIndex = m_computeFamily
+		};
+
+		if (vkCreateCommandPool(*m_pLogicalDevice, &poolInfo, nullptr, &m_commandPools[i]) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create compute command pool!");
+		}
+
+		VkCommandBufferAllocateInfo allocInfo{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+			.commandPool = m_commandPools[i],
+			.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+			.commandBufferCount = 1
+		};
+
+		if (vkAllocateCommandBuffers(*m_pLogicalDevice, &allocInfo, &m_commandBuffers[i]) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate compute command buffer!");
+		}
+	}
+}
+
+VkCommandBuffer AsyncCompute::begin(uint32_t frameIndex)
+{
+	m_pTimeline->wait(m_frameValues[frameIndex]);
+	vkResetCommandPool(*m_pLogicalDevice, m_commandPools[frameIndex], 0);
+
+	VkCommandBufferBeginInfo beginInfo{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+	};
+
+	if (vkBeginCommandBuffer(m_commandBuffers[frameIndex], &beginInfo) != VK_SUCCESS) {
+		throw std::runtime_error("failed to begin recording compute command buffer!");
+	}
+
+	return m_commandBuffers[frameIndex];
+}
+
+uint64_t AsyncCompute::submit(uint32_t frameIndex, uint64_t waitGraphicsValue, VkPipelineStageFlags waitStage)
+{
+	if (vkEndCommandBuffer(m_commandBuffers[frameIndex]) != VK_SUCCESS) {
+		throw std::runtime_error("failed to record compute command buffer!");
+	}
+
+	uint64_t signalValue = m_pTimeline->nextSubmissionValue();
+	uint32_t waitCount = waitGraphicsValue != 0 ? 1 : 0;
+
+	VkTimelineSemaphoreSubmitInfo timelineInfo{
+		.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+		.waitSemaphoreValueCount = waitCount,
+		.pWaitSemaphoreValues = &waitGraphicsValue,
+		.signalSemaphoreValueCount = 1,
+		.pSignalSemaphoreValues = &signalValue
+	};
+
+	VkSubmitInfo submitInfo{
+		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+		.pNext = &timelineInfo,
+		.waitSemaphoreCount = waitCount,
+		.pWaitSemaphores = m_pGraphicsTimeline->getVkSemaphore(),
+		.pWaitDstStageMask = &waitStage,
+		.commandBufferCount = 1,
+		.pCommandBuffers = &m_commandBuffers[frameIndex],
+		.signalSemaphoreCount = 1,
+		.pSignalSemaphores = m_pTimeline->getVkSemaphore()
+	};
+
+	if (vkQueueSubmit(*m_pComputeQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+		throw std::runtime_error("failed to submit compute command buffer!");
+	}
+
+	m_frameValues[frameIndex] = signalValue;
+	return signalValue;
+}
+
+void AsyncCompute::addGraphicsWait(uint64_t computeValue, VkPipelineStageFlags waitStage)
+{
+	// A later value on the same timeline covers an earlier one, so one wait with the stages merged is enough
+	m_pendingWaitValue = std::max(m_pendingWaitValue, computeValue);
+	m_pendingWaitStages |= waitStage;
+}
+
+void AsyncCompute::takeGraphicsWaits(std::vector<VkSemaphore>& semaphores, std::vector<uint64_t>& values, std::vector<VkPipelineStageFlags>& stages)
+{
+	if (m_pendingWaitValue == 0) return;
+
+	values.resize(semaphores.size(), 0);
+
+	semaphores.push_back(*m_pTimeline->getVkSemaphore());
+	values.push_back(m_pendingWaitValue);
+	stages.push_back(m_pendingWaitStages);
+
+	m_pendingWaitValue = 0;
+	m_pendingWaitStages = 0;
+}
+
+void AsyncCompute::releaseBuffer(VkCommandBuffer commandBuffer, VkBuffer buffer, uint32_t srcFamily, uint32_t dstFamily, VkPipelineStageFlags srcStages, VkAccessFlags srcAccess)
+{
+	if (srcFamily == dstFamily) return;
+
+	// The destination access is ignored by a release
+	VkBufferMemoryBarrier barrier{
+		.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+		.srcAccessMask = srcAccess,
+		.dstAccessMask = 0,
+		.srcQueueFamilyIndex = srcFamily,
+		.dstQueueFamilyIndex = dstFamily,
+		.buffer = buffer,
+		.offset = 0,
+		.size = VK_WHOLE_SIZE
+	};
+
+	vkCmdPipelineBarrier(commandBuffer, srcStages, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+void AsyncCompute::acquireBuffer(VkCommandBuffer commandBuffer, VkBuffer buffer, uint32_t srcFamily, uint32_t dstFamily, VkPipelineStageFlags dstStages, VkAccessFlags dstAccess)
+{
+	if (srcFamily == dstFamily) return;
+
+	// The source access is ignored by an acquire. Starting at dstStages chains the barrier onto the semaphore wait, which must cover those stages.
+	VkBufferMemoryBarrier barrier{
+		.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+		.srcAccessMask = 0,
+		.dstAccessMask = dstAccess,
+		.srcQueueFamilyIndex = srcFamily,
+		.dstQueueFamilyIndex = dstFamily,
+		.buffer = buffer,
+		.offset = 0,
+		.size = VK_WHOLE_SIZE
+	};
+
+	vkCmdPipelineBarrier(commandBuffer, dstStages, dstStages, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+void AsyncCompute::releaseImage(VkCommandBuffer commandBuffer, VkImage image, VkImageAspectFlags aspect, VkImageLayout oldLayout, VkImageLayout newLayout,
+	uint32_t srcFamily, uint32_t dstFamily, VkPipelineStageFlags srcStages, VkAccessFlags srcAccess)
+{
+	if (srcFamily == dstFamily) return;
+
+	VkImageMemoryBarrier barrier{
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+		.srcAccessMask = srcAccess,
+		.dstAccessMask = 0,
+		.oldLayout = oldLayout,
+		.newLayout = newLayout,
+		.srcQueueFamilyIndex = srcFamily,
+		.dstQueueFamilyIndex = dstFamily,
+		.image = image,
+		.subresourceRange = { aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS }
+	};
+
+	vkCmdPipelineBarrier(commandBuffer, srcStages, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+void AsyncCompute::acquireImage(VkCommandBuffer commandBuffer, VkImage image, VkImageAspectFlags aspect, VkImageLayout oldLayout, VkImageLayout newLayout,
+	uint32_t srcFamily, uint32_t dstFamily, VkPipelineStageFlags dstStages, VkAccessFlags dstAccess)
+{
+	if (srcFamily == dstFamily && oldLayout == newLayout) return;
+
+	// Between identical families this is a plain layout transition, chained onto the semaphore wait like the acquire
+	if (srcFamily == dstFamily) {
+		srcFamily = VK_QUEUE_FAMILY_IGNORED;
+		dstFamily = VK_QUEUE_FAMILY_IGNORED;
+	}
+
+	VkImageMemoryBarrier barrier{
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+		.srcAccessMask = 0,
+		.dstAccessMask = dstAccess,
+		.oldLayout = oldLayout,
+		.newLayout = newLayout,
+		.srcQueueFamilyIndex = srcFamily,
+		.dstQueueFamilyIndex = dstFamily,
+		.image = image,
+		.subresourceRange = { aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS }
+	};
+
+	vkCmdPipelineBarrier(commandBuffer, dstStages, dstStages, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+void AsyncCompute::cleanup()
+{
+	for (VkCommandPool commandPool : m_commandPools) {
+		vkDestroyCommandPool(*m_pLogicalDevice, commandPool, nullptr);
+	}
+
+	m_pTimeline->cleanup();
+	delete m_pTimeline;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <vector>
+#include <cstdint>
+
+#include "../Utilities/Utilities.h"
+
+
+class GpuTimeline;
+
+// Compute work that doesn't depend on the frame's rasterisation (light culling, particles, post processing of the previous
+// frame) is recorded here and submitted to the dedicated compute queue, where it overlaps the graphics queue's work.
+// The compute queue has a timeline of its own, both queues signalling one would have them race over its value order.
+// Without a dedicated family (or with asyncCompute off) the same calls submit to the graphics queue, which keeps the
+// callers' code path identical and the ownership transfers turn into no-ops.
+class AsyncCompute
+{
+public:
+	AsyncCompute(uint32_t frameCount);
+
+	bool isDedicated() { return m_computeFamily != m_graphicsFamily; }
+	uint32_t getComputeFamily() { return m_computeFamily; }
+	uint32_t getGraphicsFamily() { return m_graphicsFamily; }
+	GpuTimeline* getTimeline() { return m_pTimeline; }
+
+	// Starts the frame's compute command buffer, after waiting for the compute work the frame submitted last time round
+	VkCommandBuffer begin(uint32_t frameIndex);
+	// Submits the frame's compute command buffer once the graphics timeline has reached waitGraphicsValue (0 doesn't wait).
+	// Returns the compute timeline value signalled on completion.
+	uint64_t submit(uint32_t frameIndex, uint64_t waitGraphicsValue = 0, VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+	// Makes the next graphics submission wait for the compute timeline value before waitStage
+	void addGraphicsWait(uint64_t computeValue, VkPipelineStageFlags waitStage);
+	// Appends the pending wait to a graphics submission and clears it. If there is one, the values list is filled with 0 for
+	// the binary semaphores already in the list.
+	void takeGraphicsWaits(std::vector<VkSemaphore>& semaphores, std::vector<uint64_t>& values, std::vector<VkPipelineStageFlags>& stages);
+
+	// Queue family ownership transfer for resources with exclusive sharing. The release is recorded on the queue giving
+	// the resource up and the acquire on the queue taking it over, and the acquiring submission has to wait on the releasing one.
+	// Both sides must pass the same families (and layouts for images). Between identical families the release records nothing
+	// and the acquire only records a layout transition if there is one, the semaphore wait covers the memory dependency.
+	static void releaseBuffer(VkCommandBuffer commandBuffer, VkBuffer buffer, uint32_t srcFamily, uint32_t dstFamily, VkPipelineStageFlags srcStages, VkAccessFlags srcAccess);
+	static void acquireBuffer(VkCommandBuffer commandBuffer, VkBuffer buffer, uint32_t srcFamily, uint32_t dstFamily, VkPipelineStageFlags dstStages, VkAccessFlags dstAccess);
+	static void releaseImage(VkCommandBuffer commandBuffer, VkImage image, VkImageAspectFlags aspect, VkImageLayout oldLayout, VkImageLayout newLayout,
+		uint32_t srcFamily, uint32_t dstFamily, VkPipelineStageFlags srcStages, VkAccessFlags srcAccess);
+	static void acquireImage(VkCommandBuffer commandBuffer, VkImage image, VkImageAspectFlags aspect, VkImageLayout oldLayout, VkImageLayout newLayout,
+		uint32_t srcFamily, uint32_t dstFamily, VkPipelineStageFlags dstStages, VkAccessFlags dstAccess);
+
+	void cleanup();
+
+private:
+	Utilities* m_pUtilities = nullptr;
+	VkDevice* m_pLogicalDevice = nullptr;
+	VkQueue* m_pComputeQueue = nullptr;
+	GpuTimeline* m_pGraphicsTimeline = nullptr;
+	GpuTimeline* m_pTimeline = nullptr;
+
+	uint32_t m_computeFamily = 0;
+	uint32_t m_graphicsFamily = 0;
+
+	// One pool per frame in flight, reset as a whole like the frame contexts' pools
+	std::vector<VkCommandPool> m_commandPools = {};
+	std::vector<VkCommandBuffer> m_commandBuffers = {};
+	std::vector<uint64_t> m_frameValues = {}; // Compute timeline value of each frame's last submission
+
+	uint64_t m_pendingWaitValue = 0; // 0 when the next graphics submission has nothing to wait for
+	VkPipelineStageFlags m_pendingWaitStages = 0;
+};
@@ -16,20 +16,27 @@ VkPhysicalDevice* BufferManager::m_pPhysicalDevice = nullptr;
 BufferManager::BufferManager() : m_pLogicalDevice(VulkanEngine::getInstance()->m_pLogicalDevice->getVkDevice()), m_pSurface(VulkanEngine::getInstance()->m_pVkSurface),
 m_pRenderPass(VulkanEngine::getInstance()->m_pGraphicsPipeline->getRenderPass()), m_pSwapchain(VulkanEngine::getInstance()->m_pSwapchain), m_pSettings(VulkanEngine::getInstance()->m_settings),
 m_MAX_FRAMES_IN_FLIGHT(VulkanEngine::getInstance()->m_MAX_FRAMES_IN_FLIGHT), m_pGraphicsPipeline(VulkanEngine::getInstance()->m_pGraphicsPipeline->getGraphicsPipeline()),
-m_pGraphicsQueue(VulkanEngine::getInstance()->m_pLogicalDevice->getGraphicsQueue()), m_pDescriptorSetLayout(VulkanEngine::getInstance()->m_pGraphicsPipeline->getDescriptorSetLayout()),
-m_pPipelineLayout(VulkanEngine::getInstance()->m_pGraphicsPipeline->getVkPipelineLayout()), m_pUtilities(Utilities::getInstance())
+m_pGraphicsQueue(VulkanEngine::getInstance()->m_pLogicalDevice->getGraphicsQueue()), m_pGpuTimeline(VulkanEngine::getInstance()->m_pGpuTimeline), m_pDescriptorSetLayout(VulkanEngine::getInstance()->m_pGraphicsPipeline->getDescriptorSetLayout()),
+m_pPipelineLayout(VulkanEngine::getInstance()->m_pGraphicsPipeline->getVkPipelineLayout()), m_vkCmdBeginRendering(VulkanEngine::getInstance()->m_pLogicalDevice->m_vkCmdBeginRendering),
+m_vkCmdEndRendering(VulkanEngine::getInstance()->m_pLogicalDevice->m_vkCmdEndRendering), m_pUtilities(Utilities::getInstance())
 {
 	if (m_pPhysicalDevice == nullptr)
 		m_pPhysicalDevice = VulkanEngine::getInstance()->m_pPhysicalDevice->getVkPhysicalDevice();
 };
 
-void BufferManager::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& pBuffer, VkDeviceMemory& pBufferMemory)
+void BufferManager::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& pBuffer, VkDeviceMemory& pBufferMemory,
+	const std::vector<uint32_t>& sharedQueueFamilies)
 {
+	// Concurrent sharing needs distinct families, e.g. the compute family is the graphics one without a dedicated compute queue
+	bool concurrent = sharedQueueFamilies.size() > 1 && sharedQueueFamilies[0] != sharedQueueFamilies[1];
+
 	VkBufferCreateInfo bufferInfo{
 	.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
 	.size = size,
 	.usage = usage,
-	.sharingMode = VK_SHARING_MODE_EXCLUSIVE
+	.sharingMode = concurrent ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE,
+	.queueFamilyIndexCount = concurrent ? static_cast<uint32_t>(sharedQueueFamilies.size()) : 0,
+	.pQueueFamilyIndices = concurrent ? sharedQueueFamilies.data() : nullptr
 	};
 
 	if (vkCreateBuffer(*m_pLogicalDevice, &bufferInfo, nullptr, &pBuffer) != VK_SUCCESS)
@@ -81,6 +88,20 @@ uint32_t BufferManager::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlag
 	throw std::runtime_error("failed to find suitable memory type!");
 }
 
+bool BufferManager::hasMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
+{
+	VkPhysicalDeviceMemoryProperties memProperties;
+	vkGetPhysicalDeviceMemoryProperties(*m_pPhysicalDevice, &memProperties);
+
+	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+		if (typeFilter & (1 << i) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
 
 
 
@@ -89,7 +110,6 @@ uint32_t BufferManager::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlag
 // ----------------------------------------------------- //
 
 VkCommandPool CommandBuffer::sm_commandPool = VK_NULL_HANDLE;
-std::vector<VkCommandBuffer> CommandBuffer::sm_commandBuffers = {};
 
 void CommandBuffer::createCommandPool()
 {
@@ -135,37 +155,37 @@ void CommandBuffer::endSingleTimeCommands(VkCommandBuffer commandBuffer)
 {
 	vkEndCommandBuffer(commandBuffer);
 
+	// Wait for this submission only rather than the whole queue
+	GpuTimeline* pGpuTimeline = m_pBufferManager->m_pGpuTimeline;
+	uint64_t signalValue = pGpuTimeline->nextSubmissionValue();
+
+	VkTimelineSemaphoreSubmitInfo timelineInfo{
+		.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+		.signalSemaphoreValueCount = 1,
+		.pSignalSemaphoreValues = &signalValue
+	};
+
 	VkSubmitInfo submitInfo{
 		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+		.pNext = &timelineInfo,
 		.commandBufferCount = 1,
-		.pCommandBuffers = &commandBuffer
+		.pCommandBuffers = &commandBuffer,
+		.signalSemaphoreCount = 1,
+		.pSignalSemaphores = pGpuTimeline->getVkSemaphore()
 	};
 
 	vkQueueSubmit(*m_pBufferManager->m_pGraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-	vkQueueWaitIdle(*m_pBufferManager->m_pGraphicsQueue);
+	pGpuTimeline->wait(signalValue);
 
 	vkFreeCommandBuffers(*m_pBufferManager->m_pLogicalDevice, sm_commandPool, 1, &commandBuffer);
 }
 
-void CommandBuffer::createCommandBuffers()
+VkPipelineStageFlags CommandBuffer::getSwapchainWaitStage()
 {
-	mfDebugPrint("Creating command buffers...");
-
-	sm_commandBuffers.resize(m_pBufferManager->m_MAX_FRAMES_IN_FLIGHT);
-
-	VkCommandBufferAllocateInfo allocInfo{
-		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-		.commandPool = sm_commandPool,
-		.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-		.commandBufferCount = (uint32_t)sm_commandBuffers.size()
-	};
-
-	if (vkAllocateCommandBuffers(*m_pBufferManager->m_pLogicalDevice, &allocInfo, sm_commandBuffers.data()) != VK_SUCCESS) {
-		throw std::runtime_error("failed to allocate command buffers!");
-	}
+	return m_pBufferManager->m_pPostProcessChain != nullptr || m_pBufferManager->m_pMultiviewTarget != nullptr ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 }
 
-void CommandBuffer::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+void CommandBuffer::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t frameIndex, uint32_t imageIndex)
 {
 	VkCommandBufferBeginInfo beginInfo{
 		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
@@ -178,32 +198,429 @@ void CommandBuffer::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t
 		throw std::runtime_error("failed to begin recording command buffer!");
 	}
 
-	std::vector<VkFramebuffer> framebuffers = *m_pBufferManager->m_pFramebuffer->getFramebuffers();
+	GpuTimer* pGpuTimer = VulkanEngine::getInstance()->getGpuTimer();
+	pGpuTimer->begin(commandBuffer, frameIndex);
+
+	// The light clusters are synchronised by the compute queue's semaphore rather than the render graph, see ClusteredLighting::update
+	m_pBufferManager->m_pClusteredLighting->recordAcquire(commandBuffer, frameIndex);
+
+	HiZCuller* pHiZCuller = m_pBufferManager->m_pHiZCuller;
+	RenderGraph* pRenderGraph = m_pBufferManager->m_pRenderGraph;
+	Swapchain* pSwapchain = m_pBufferManager->m_pSwapchain;
+	m_pBufferManager->m_drawEncoder.resetStats();
+
+	// The acquire semaphore is waited on at the first stage that writes the swapchain image, see Window::drawFrame.
+	// With post-processing the passes draw to the scene colour image instead and the chain copies it over at the end.
+	// With multiview they draw to the layered views, which are copied side by side into whichever of the two is the frame.
+	PostProcessChain* pPostProcessChain = m_pBufferManager->m_pPostProcessChain;
+	MultiviewTarget* pMultiviewTarget = m_pBufferManager->m_pMultiviewTarget;
+	VkImage swapchainImage = pSwapchain->getSwapchainImages()->at(imageIndex);
+	RenderGraph::ResourceHandle swapchainTarget = pRenderGraph->importSwapchainImage("swapchain", swapchainImage, *pSwapchain->getSwapchainImageFormat(), getSwapchainWaitStage());
+	RenderGraph::ResourceHandle frameTarget = swapchainTarget;
+	VkImage frameImage = swapchainImage;
+	if (pPostProcessChain != nullptr) {
+		frameTarget = pRenderGraph->importImage("scene color", *pPostProcessChain->getSceneColorImage(), PostProcessChain::sm_sceneColorFormat, 1, VK_IMAGE_LAYOUT_UNDEFINED);
+		frameImage = *pPostProcessChain->getSceneColorImage();
+	}
+	RenderGraph::ResourceHandle colorTarget = frameTarget;
+	RenderGraph::ResourceHandle depthTarget = 0;
+	if (pMultiviewTarget != nullptr) {
+		colorTarget = pRenderGraph->importImage("multiview color", *pMultiviewTarget->getColorImage(), VulkanEngine::getInstance()->getGraphicsPipeline()->getColorFormat(), 1,
+			VK_IMAGE_LAYOUT_UNDEFINED);
+		depthTarget = pRenderGraph->importImage("multiview depth", *pMultiviewTarget->getDepthImage(), DepthBuffer::findDepthFormat(m_pBufferManager->m_pPhysicalDevice), 1,
+			VK_IMAGE_LAYOUT_UNDEFINED);
+	}
+	else {
+		depthTarget = pRenderGraph->importImage("depth", *m_pBufferManager->m_pDepthBuffer->getVkImage(), DepthBuffer::findDepthFormat(m_pBufferManager->m_pPhysicalDevice), 1,
+			VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+	}
+	// Headless there's no presentation engine to hand the image to, it's left ready to be read back instead
+	pRenderGraph->markOutput(swapchainTarget, pSwapchain->isHeadless() ? eResourceUsage::TRANSFER_READ : eResourceUsage::PRESENT);
+
+	// With MSAA the passes draw to these and resolve into the two above
+	MultisampleBuffer* pMultisampleBuffer = m_pBufferManager->m_pMultisampleBuffer;
+	RenderGraph::ResourceHandle msaaColorTarget = 0;
+	RenderGraph::ResourceHandle msaaDepthTarget = 0;
+	if (pMultisampleBuffer != nullptr) {
+		msaaColorTarget = pRenderGraph->importImage("msaa color", *pMultisampleBuffer->getColorImage(), VulkanEngine::getInstance()->getGraphicsPipeline()->getColorFormat(), 1,
+			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+		msaaDepthTarget = pRenderGraph->importImage("msaa depth", *pMultisampleBuffer->getDepthImage(), DepthBuffer::findDepthFormat(m_pBufferManager->m_pPhysicalDevice), 1,
+			VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+	}
+
+	// Cached cascades keep their contents between frames, so the pass only draws the ones CascadedShadows::update picked
+	CascadedShadows* pCascadedShadows = m_pBufferManager->m_pCascadedShadows;
+	RenderGraph::ResourceHandle shadowMap = pRenderGraph->importImage("shadow map", *pCascadedShadows->getShadowMap(), CascadedShadows::sm_format, 1, VK_IMAGE_LAYOUT_UNDEFINED);
+	if (pCascadedShadows->hasCascadesToDraw()) {
+		pRenderGraph->addPass("Shadow cascades",
+			[&](RenderGraph::PassBuilder& builder) {
+				builder.write(shadowMap, eResourceUsage::DEPTH_ATTACHMENT);
+			},
+			[pCascadedShadows](VkCommandBuffer commandBuffer) { pCascadedShadows->recordCascades(commandBuffer); });
+	}
+
+	RenderGraph::ResourceHandle depthPyramid = 0;
+
+	// Replaces the main pass: the ids and depth first, then every covered pixel shaded once. Hi-Z culling, MSAA and
+	// multiview are turned off with it, see VulkanEngine::validateSettings.
+	VisibilityBuffer* pVisibilityBuffer = m_pBufferManager->m_pVisibilityBuffer;
+	if (pVisibilityBuffer != nullptr) {
+		// Swapchain sized like the depth buffer it's drawn with, only the render extent is used while dynamic resolution scales the frame down
+		RenderGraph::ResourceHandle visibilityIds = pRenderGraph->createImage("visibility ids", RenderGraph::sImageDesc{
+			.format = VisibilityBuffer::sm_format,
+			.width = pSwapchain->getSwapchainExtent()->width,
+			.height = pSwapchain->getSwapchainExtent()->height,
+			.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT
+		});
+
+		pRenderGraph->addPass("Visibility",
+			[&](RenderGraph::PassBuilder& builder) {
+				builder.overwrite(visibilityIds, eResourceUsage::COLOR_ATTACHMENT);
+				builder.overwrite(depthTarget, eResourceUsage::DEPTH_ATTACHMENT);
+			},
+			[pVisibilityBuffer, pRenderGraph, frameIndex, visibilityIds](VkCommandBuffer commandBuffer) {
+				pVisibilityBuffer->recordVisibility(commandBuffer, frameIndex, pRenderGraph->getImageView(visibilityIds));
+			});
+
+		pRenderGraph->addPass("Visibility shading",
+			[&](RenderGraph::PassBuilder& builder) {
+				builder.read(visibilityIds, eResourceUsage::SAMPLED_FRAGMENT);
+				builder.read(shadowMap, eResourceUsage::SAMPLED_FRAGMENT);
+				builder.overwrite(colorTarget, eResourceUsage::COLOR_ATTACHMENT);
+			},
+			[pVisibilityBuffer, pRenderGraph, frameIndex, imageIndex, visibilityIds](VkCommandBuffer commandBuffer) {
+				pVisibilityBuffer->recordShading(commandBuffer, frameIndex, imageIndex, pRenderGraph->getImageView(visibilityIds));
+			});
+	}
+	else if (pHiZCuller == nullptr) {
+		pRenderGraph->addPass("Main",
+			[&](RenderGraph::PassBuilder& builder) {
+				builder.read(shadowMap, eResourceUsage::SAMPLED_FRAGMENT);
+				builder.overwrite(colorTarget, eResourceUsage::COLOR_ATTACHMENT);
+				if (pMultisampleBuffer == nullptr) {
+					builder.overwrite(depthTarget, eResourceUsage::DEPTH_ATTACHMENT);
+				}
+				else {
+					builder.overwrite(depthTarget, eResourceUsage::DEPTH_RESOLVE);
+					builder.overwrite(msaaColorTarget, eResourceUsage::COLOR_ATTACHMENT);
+					builder.overwrite(msaaDepthTarget, eResourceUsage::DEPTH_ATTACHMENT);
+				}
+			},
+			[this, frameIndex, imageIndex](VkCommandBuffer commandBuffer) {
+				beginRenderPass(commandBuffer, imageIndex, false);
+				recordModelDraws(commandBuffer, frameIndex, VK_NULL_HANDLE);
+				endRenderPass(commandBuffer);
+			});
+	}
+	else {
+		RenderGraph::ResourceHandle visibility = pRenderGraph->importBuffer("visibility", *pHiZCuller->getVisibilityBuffer());
+		RenderGraph::ResourceHandle earlyDraws = pRenderGraph->importBuffer("early draws", *pHiZCuller->getEarlyDrawBuffer());
+		RenderGraph::ResourceHandle lateDraws = pRenderGraph->importBuffer("late draws", *pHiZCuller->getLateDrawBuffer());
+		depthPyramid = pRenderGraph->createImage("depth pyramid", pHiZCuller->getDepthPyramidDesc());
+		pRenderGraph->markOutput(visibility); // Read by next frame's early phase
+
+		// Early phase: models that were visible last frame
+		pRenderGraph->addPass("Early cull",
+			[&](RenderGraph::PassBuilder& builder) {
+				builder.read(visibility, eResourceUsage::COMPUTE_READ);
+				builder.write(earlyDraws, eResourceUsage::COMPUTE_WRITE);
+			},
+			[pHiZCuller](VkCommandBuffer commandBuffer) { pHiZCuller->recordEarlyCull(commandBuffer); });
+
+		pRenderGraph->addPass("Early draw",
+			[&](RenderGraph::PassBuilder& builder) {
+				builder.read(earlyDraws, eResourceUsage::INDIRECT_READ);
+				builder.read(shadowMap, eResourceUsage::SAMPLED_FRAGMENT);
+				builder.overwrite(colorTarget, eResourceUsage::COLOR_ATTACHMENT);
+				builder.overwrite(depthTarget, pMultisampleBuffer == nullptr ? eResourceUsage::DEPTH_ATTACHMENT : eResourceUsage::DEPTH_RESOLVE);
+				if (pMultisampleBuffer != nullptr) {
+					builder.overwrite(msaaColorTarget, eResourceUsage::COLOR_ATTACHMENT);
+					builder.overwrite(msaaDepthTarget, eResourceUsage::DEPTH_ATTACHMENT);
+				}
+			},
+			[this, frameIndex, imageIndex, pHiZCuller](VkCommandBuffer commandBuffer) {
+				beginRenderPass(commandBuffer, imageIndex, false);
+				recordModelDraws(commandBuffer, frameIndex, *pHiZCuller->getEarlyDrawBuffer());
+				endRenderPass(commandBuffer);
+			});
+
+		// Late phase: models the early phase missed that aren't hidden behind what it drew
+		pRenderGraph->addPass("Depth pyramid",
+			[&](RenderGraph::PassBuilder& builder) {
+				builder.read(depthTarget, eResourceUsage::SAMPLED_COMPUTE);
+				builder.overwrite(depthPyramid, eResourceUsage::COMPUTE_WRITE);
+			},
+			[pHiZCuller](VkCommandBuffer commandBuffer) { pHiZCuller->recordDepthPyramid(commandBuffer); });
+
+		pRenderGraph->addPass("Late cull",
+			[&](RenderGraph::PassBuilder& builder) {
+				builder.read(depthPyramid, eResourceUsage::COMPUTE_READ);
+				builder.write(visibility, eResourceUsage::COMPUTE_WRITE);
+				builder.write(lateDraws, eResourceUsage::COMPUTE_WRITE);
+			},
+			[pHiZCuller](VkCommandBuffer commandBuffer) { pHiZCuller->recordLateCull(commandBuffer); });
+
+		pRenderGraph->addPass("Late draw",
+			[&](RenderGraph::PassBuilder& builder) {
+				builder.read(lateDraws, eResourceUsage::INDIRECT_READ);
+				builder.read(shadowMap, eResourceUsage::SAMPLED_FRAGMENT);
+				builder.write(colorTarget, eResourceUsage::COLOR_ATTACHMENT);
+				builder.write(depthTarget, pMultisampleBuffer == nullptr ? eResourceUsage::DEPTH_ATTACHMENT : eResourceUsage::DEPTH_RESOLVE);
+				if (pMultisampleBuffer != nullptr) {
+					builder.write(msaaColorTarget, eResourceUsage::COLOR_ATTACHMENT);
+					builder.write(msaaDepthTarget, eResourceUsage::DEPTH_ATTACHMENT);
+				}
+			},
+			[this, frameIndex, imageIndex, pHiZCuller](VkCommandBuffer commandBuffer) {
+				beginRenderPass(commandBuffer, imageIndex, true);
+				recordModelDraws(commandBuffer, frameIndex, *pHiZCuller->getLateDrawBuffer());
+				endRenderPass(commandBuffer);
+			});
+	}
+
+	// Transparent models go over the finished opaque frame, tested against its depth and accumulated in whatever order they
+	// were culled in
+	WeightedBlendedOIT* pWeightedBlendedOIT = m_pBufferManager->m_pWeightedBlendedOIT;
+	if (pWeightedBlendedOIT != nullptr && !m_pBufferManager->m_drawQueue.getPassPackets(DrawQueue::PASS_TRANSPARENT).empty()) {
+		// Swapchain sized like the depth buffer they're drawn with, only the render extent is used while dynamic resolution scales the frame down
+		RenderGraph::sImageDesc targetDesc{
+			.width = pSwapchain->getSwapchainExtent()->width,
+			.height = pSwapchain->getSwapchainExtent()->height,
+			.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT
+		};
+		targetDesc.format = WeightedBlendedOIT::sm_accumulationFormat;
+		RenderGraph::ResourceHandle accumulation = pRenderGraph->createImage("accumulation", targetDesc);
+		targetDesc.format = WeightedBlendedOIT::sm_revealageFormat;
+		RenderGraph::ResourceHandle revealage = pRenderGraph->createImage("revealage", targetDesc);
+
+		pRenderGraph->addPass("Transparent accumulate",
+			[&](RenderGraph::PassBuilder& builder) {
+				builder.read(shadowMap, eResourceUsage::SAMPLED_FRAGMENT);
+				builder.read(depthTarget, eResourceUsage::DEPTH_READ);
+				builder.overwrite(accumulation, eResourceUsage::COLOR_ATTACHMENT);
+				builder.overwrite(revealage, eResourceUsage::COLOR_ATTACHMENT);
+			},
+			[this, frameIndex, pWeightedBlendedOIT, pRenderGraph, accumulation, revealage](VkCommandBuffer commandBuffer) {
+				pWeightedBlendedOIT->beginAccumulation(commandBuffer, frameIndex, pRenderGraph->getImageView(accumulation), pRenderGraph->getImageView(revealage));
+				recordTransparentDraws(commandBuffer, frameIndex);
+				pWeightedBlendedOIT->endAccumulation(commandBuffer);
+			});
+
+		pRenderGraph->addPass("Transparent composite",
+			[&](RenderGraph::PassBuilder& builder) {
+				builder.read(accumulation, eResourceUsage::SAMPLED_FRAGMENT);
+				builder.read(revealage, eResourceUsage::SAMPLED_FRAGMENT);
+				builder.write(colorTarget, eResourceUsage::COLOR_ATTACHMENT);
+			},
+			[pWeightedBlendedOIT, pRenderGraph, frameIndex, imageIndex, accumulation, revealage](VkCommandBuffer commandBuffer) {
+				pWeightedBlendedOIT->recordComposite(commandBuffer, frameIndex, imageIndex, pRenderGraph->getImageView(accumulation), pRenderGraph->getImageView(revealage));
+			});
+	}
+
+	// Everything after works on the composed frame, as if it had been drawn as one view
+	if (pMultiviewTarget != nullptr) {
+		pRenderGraph->addPass("Compose views",
+			[&](RenderGraph::PassBuilder& builder) {
+				builder.read(colorTarget, eResourceUsage::TRANSFER_READ);
+				builder.overwrite(frameTarget, eResourceUsage::TRANSFER_WRITE);
+			},
+			[pMultiviewTarget, frameImage](VkCommandBuffer commandBuffer) { pMultiviewTarget->recordCompose(commandBuffer, frameImage); });
+
+		colorTarget = frameTarget;
+	}
+
+	// Resolves the jittered frame at the swapchain's resolution, so the chain after it runs on the full image
+	TemporalAA* pTemporalAA = m_pBufferManager->m_pTemporalAA;
+	VkExtent2D postProcessExtent = *pSwapchain->getRenderExtent();
+	if (pTemporalAA != nullptr) {
+		// Swapchain sized like the other attachments, only the render extent is written while dynamic resolution scales the frame down
+		RenderGraph::ResourceHandle motionVectors = pRenderGraph->createImage("motion vectors", RenderGraph::sImageDesc{
+			.format = TemporalAA::sm_motionVectorFormat,
+			.width = pSwapchain->getSwapchainExtent()->width,
+			.height = pSwapchain->getSwapchainExtent()->height,
+			.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT
+		});
+		RenderGraph::ResourceHandle previousHistory = pRenderGraph->importImage("previous history", *pTemporalAA->getPreviousHistoryImage(), PostProcessChain::sm_sceneColorFormat, 1, VK_IMAGE_LAYOUT_UNDEFINED);
+		RenderGraph::ResourceHandle currentHistory = pRenderGraph->importImage("current history", *pTemporalAA->getCurrentHistoryImage(), PostProcessChain::sm_sceneColorFormat, 1, VK_IMAGE_LAYOUT_UNDEFINED);
+
+		pRenderGraph->addPass("Motion vectors",
+			[&](RenderGraph::PassBuilder& builder) {
+				builder.read(depthTarget, eResourceUsage::SAMPLED_COMPUTE);
+				builder.overwrite(motionVectors, eResourceUsage::COMPUTE_WRITE);
+			},
+			[pTemporalAA, pRenderGraph, frameIndex, motionVectors](VkCommandBuffer commandBuffer) {
+				pTemporalAA->recordMotionVectors(commandBuffer, frameIndex, pRenderGraph->getImageView(motionVectors));
+			});
+
+		pRenderGraph->addPass("Temporal resolve",
+			[&](RenderGraph::PassBuilder& builder) {
+				builder.read(colorTarget, eResourceUsage::SAMPLED_COMPUTE);
+				builder.read(motionVectors, eResourceUsage::SAMPLED_COMPUTE);
+				builder.read(previousHistory, eResourceUsage::SAMPLED_COMPUTE);
+				builder.overwrite(currentHistory, eResourceUsage::COMPUTE_WRITE);
+			},
+			[pTemporalAA, pRenderGraph, frameIndex, motionVectors](VkCommandBuffer commandBuffer) {
+				pTemporalAA->recordResolve(commandBuffer, frameIndex, pRenderGraph->getImageView(motionVectors));
+			});
+
+		VkImage sceneColorImage = *pPostProcessChain->getSceneColorImage();
+		pRenderGraph->addPass("Copy resolve",
+			[&](RenderGraph::PassBuilder& builder) {
+				builder.read(currentHistory, eResourceUsage::TRANSFER_READ);
+				builder.overwrite(colorTarget, eResourceUsage::TRANSFER_WRITE);
+			},
+			[pTemporalAA, sceneColorImage](VkCommandBuffer commandBuffer) { pTemporalAA->recordCopyToSceneColor(commandBuffer, sceneColorImage); });
+
+		postProcessExtent = *pSwapchain->getSwapchainExtent();
+	}
+
+	if (pPostProcessChain != nullptr) {
+		// Each fused run of effects reads and writes the frame once, in place
+		pPostProcessChain->prepare(postProcessExtent);
+		for (size_t stage = 0; stage < pPostProcessChain->getStageCount(); stage++) {
+			pRenderGraph->addPass("Post-process",
+				[&](RenderGraph::PassBuilder& builder) {
+					builder.write(colorTarget, eResourceUsage::COMPUTE_WRITE);
+				},
+				[pPostProcessChain, stage](VkCommandBuffer commandBuffer) { pPostProcessChain->recordStage(commandBuffer, stage); });
+		}
+
+		pRenderGraph->addPass("Copy to swapchain",
+			[&](RenderGraph::PassBuilder& builder) {
+				builder.read(colorTarget, eResourceUsage::TRANSFER_READ);
+				builder.overwrite(swapchainTarget, eResourceUsage::TRANSFER_WRITE);
+			},
+			[pPostProcessChain, swapchainImage](VkCommandBuffer commandBuffer) { pPostProcessChain->recordCopyToSwapchain(commandBuffer, swapchainImage); });
+	}
+
+	// Copied out once the frame is finished. The readback buffer is only read on the host when the frame context comes round
+	// again, FrameCapture synchronises that itself.
+	FrameCapture* pFrameCapture = VulkanEngine::getInstance()->getFrameCapture();
+	if (pFrameCapture != nullptr && pFrameCapture->beginCapture(frameIndex, *pSwapchain->getSwapchainImageFormat(), *pSwapchain->getSwapchainExtent())) {
+		pRenderGraph->addPass("Capture",
+			[&](RenderGraph::PassBuilder& builder) {
+				builder.read(swapchainTarget, eResourceUsage::TRANSFER_READ);
+				builder.sideEffect();
+			},
+			[pFrameCapture, frameIndex, swapchainImage](VkCommandBuffer commandBuffer) { pFrameCapture->recordCopy(commandBuffer, frameIndex, swapchainImage); });
+	}
+
+	pRenderGraph->compile(frameIndex);
+	if (pHiZCuller != nullptr) pHiZCuller->setDepthPyramid(frameIndex, pRenderGraph->getImage(depthPyramid), pRenderGraph->getImageView(depthPyramid));
+	pRenderGraph->execute(commandBuffer);
+
+	pGpuTimer->end(commandBuffer, frameIndex);
+
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to record command buffer!");
+	}
+}
+
+void CommandBuffer::beginRenderPass(VkCommandBuffer commandBuffer, uint32_t imageIndex, bool loadAttachments)
+{
+	// Only the top left of the attachments is drawn to while dynamic resolution has scaled the frame down. With multiview
+	// the pass covers a single view, every layer at once.
+	MultiviewTarget* pMultiviewTarget = m_pBufferManager->m_pMultiviewTarget;
+	VkExtent2D renderExtent = pMultiviewTarget != nullptr ? pMultiviewTarget->getViewExtent() : *m_pBufferManager->m_pSwapchain->getRenderExtent();
 	std::array<VkClearValue, 2> clearValues{
 		VkClearValue{{{0.1f, 0.1f, 0.1f, 1.0f}}},
 		VkClearValue{{{1.0f, 0}}}
 	};
 
-	VkRenderPassBeginInfo renderPassInfo{
-		.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-		.renderPass = *m_pBufferManager->m_pRenderPass,
-		.framebuffer = framebuffers[imageIndex],
-		.renderArea {
-			.offset = { 0, 0 },
-			.extent = *m_pBufferManager->m_pSwapchain->getSwapchainExtent(),
-		},
-		.clearValueCount = static_cast<uint32_t>(clearValues.size()),
-		.pClearValues = clearValues.data()
-	};
+	if (m_pBufferManager->m_pSettings->graphicsSettings.dynamicRendering) {
+		// Same load and store ops as the render passes in GraphicsPipeline::createRenderPass, the render graph has already
+		// moved the images into their attachment layouts
+		VkAttachmentLoadOp loadOp = loadAttachments ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+		// Read by the depth pyramid after the first pass, and by the transparent models and temporal AA's motion vectors after the last
+		bool keepDepth = (!loadAttachments && m_pBufferManager->m_pHiZCuller != nullptr) || m_pBufferManager->m_pTemporalAA != nullptr || m_pBufferManager->m_pWeightedBlendedOIT != nullptr;
+		bool finalPass = loadAttachments || m_pBufferManager->m_pHiZCuller == nullptr;
+
+		PostProcessChain* pPostProcessChain = m_pBufferManager->m_pPostProcessChain;
+		VkImageView colorImageView = pPostProcessChain != nullptr ? *pPostProcessChain->getSceneColorImageView() : m_pBufferManager->m_pSwapchain->getSwapchainImageViews()->at(imageIndex);
+		VkImageView depthImageView = *m_pBufferManager->m_pDepthBuffer->getVkImageView();
+		if (pMultiviewTarget != nullptr) {
+			colorImageView = *pMultiviewTarget->getColorImageView();
+			depthImageView = *pMultiviewTarget->getDepthImageView();
+		}
+
+		VkRenderingAttachmentInfoKHR colorAttachment{
+			.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR,
+			.imageView = colorImageView,
+			.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+			.resolveMode = VK_RESOLVE_MODE_NONE,
+			.loadOp = loadOp,
+			.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+			.clearValue = clearValues[0]
+		};
+
+		VkRenderingAttachmentInfoKHR depthAttachment{
+			.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR,
+			.imageView = depthImageView,
+			.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+			.resolveMode = VK_RESOLVE_MODE_NONE,
+			.loadOp = loadOp,
+			.storeOp = keepDepth ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE,
+			.clearValue = clearValues[1]
+		};
+
+		// With MSAA only the last pass resolves colour and only the pass before the depth pyramid resolves depth. The multisampled
+		// attachments are kept between the two passes.
+		MultisampleBuffer* pMultisampleBuffer = m_pBufferManager->m_pMultisampleBuffer;
+		if (pMultisampleBuffer != nullptr) {
+			colorAttachment.imageView = *pMultisampleBuffer->getColorImageView();
+			colorAttachment.storeOp = finalPass ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
+			if (finalPass) {
+				colorAttachment.resolveMode = VK_RESOLVE_MODE_AVERAGE_BIT;
+				colorAttachment.resolveImageView = colorImageView;
+				colorAttachment.resolveImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			}
+
+			depthAttachment.imageView = *pMultisampleBuffer->getDepthImageView();
+			if (keepDepth) {
+				depthAttachment.resolveMode = VulkanEngine::getInstance()->getGraphicsPipeline()->getDepthResolveMode();
+				depthAttachment.resolveImageView = depthImageView;
+				depthAttachment.resolveImageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+			}
+		}
+
+		VkRenderingInfoKHR renderingInfo{
+			.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR,
+			.renderArea {
+				.offset = { 0, 0 },
+				.extent = renderExtent
+			},
+			.layerCount = 1,
+			.viewMask = pMultiviewTarget != nullptr ? MultiviewTarget::sm_viewMask : 0,
+			.colorAttachmentCount = 1,
+			.pColorAttachments = &colorAttachment,
+			.pDepthAttachment = &depthAttachment,
+			.pStencilAttachment = nullptr
+		};
+
+		m_pBufferManager->m_vkCmdBeginRendering(commandBuffer, &renderingInfo);
+	}
+	else {
+		VkRenderPassBeginInfo renderPassInfo{
+			.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+			.renderPass = loadAttachments ? *m_pBufferManager->m_pOcclusionRenderPass : *m_pBufferManager->m_pRenderPass,
+			.framebuffer = m_pBufferManager->m_pFramebuffer->getFramebuffers()->at(imageIndex),
+			.renderArea {
+				.offset = { 0, 0 },
+				.extent = renderExtent,
+			},
+			.clearValueCount = static_cast<uint32_t>(clearValues.size()),
+			.pClearValues = clearValues.data()
+		};
 
-	vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+	}
 
 
 	VkViewport viewport{
 		.x = 0.0f,
 		.y = 0.0f,
-		.width = static_cast<float>(m_pBufferManager->m_pSwapchain->getSwapchainExtent()->width),
-		.height = static_cast<float>(m_pBufferManager->m_pSwapchain->getSwapchainExtent()->height),
+		.width = static_cast<float>(renderExtent.width),
+		.height = static_cast<float>(renderExtent.height),
 		.minDepth = 0.0f,
 		.maxDepth = 1.0f
 	};
@@ -211,29 +628,93 @@ void CommandBuffer::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t
 
 	VkRect2D scissor{
 		.offset = { 0, 0 },
-		.extent = *m_pBufferManager->m_pSwapchain->getSwapchainExtent()
+		.extent = renderExtent
 	};
 	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+}
 
-	
+void CommandBuffer::endRenderPass(VkCommandBuffer commandBuffer)
+{
+	if (m_pBufferManager->m_pSettings->graphicsSettings.dynamicRendering) {
+		m_pBufferManager->m_vkCmdEndRendering(commandBuffer);
+	}
+	else {
+		vkCmdEndRenderPass(commandBuffer);
+	}
+}
 
-	
-	for (int i = 0; i < m_pBufferManager->m_pLoadedModels->size(); i++) {
-		Model* model = m_pBufferManager->m_pLoadedModels->at(i);
-		VkDeviceSize offsets[] = { 0 };
+void CommandBuffer::recordModelDraws(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkBuffer indirectBuffer)
+{
+	DrawEncoder& drawEncoder = m_pBufferManager->m_drawEncoder;
+	GraphicsPipeline* pGraphicsPipeline = VulkanEngine::getInstance()->getGraphicsPipeline();
+	drawEncoder.begin(commandBuffer);
+	pGraphicsPipeline->recordDynamicState(commandBuffer);
+
+	// The light clusters and shadows are the same for every draw, binding set 0 per model leaves sets 1 and 2 bound
+	std::array<VkDescriptorSet, 2> frameSets = {
+		*m_pBufferManager->m_pClusteredLighting->getDescriptorSet(frameIndex),
+		*m_pBufferManager->m_pCascadedShadows->getDescriptorSet(frameIndex)
+	};
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, *m_pBufferManager->m_pPipelineLayout, 1, static_cast<uint32_t>(frameSets.size()),
+		frameSets.data(), 0, nullptr);
 
-		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, *m_pBufferManager->m_pGraphicsPipeline);
+	// Transparent models are drawn separately, after every opaque one, when there's order independent transparency
+	std::span<const sDrawPacket> packets = m_pBufferManager->m_drawQueue.getPassPackets(DrawQueue::PASS_MAIN);
 
-		vkCmdBindVertexBuffers(commandBuffer, 0, 1, model->m_pVertexBuffer->getVkVertexBuffer(), offsets);
-		vkCmdBindIndexBuffer(commandBuffer, *model->m_pIndexBuffer->getVkIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
-		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, *m_pBufferManager->m_pPipelineLayout, 0, 1, &(*model->m_pDescriptorSets->getVkDescriptorSets())[imageIndex], 0, nullptr);
-		vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(model->m_pIndexBuffer->m_indices.size()), 1, 0, 0, 0);
-	}
+	auto recordDraws = [&](bool depthOnly) {
+		for (const sDrawPacket& packet : packets) {
+			Model* model = m_pBufferManager->m_pLoadedModels->at(packet.modelIndex);
 
-	vkCmdEndRenderPass(commandBuffer);
+			if (depthOnly) {
+				drawEncoder.bindPipeline(*pGraphicsPipeline->getDepthPrepassPipeline());
+				drawEncoder.bindVertexBuffer(*model->m_pVertexBuffer->getVkPositionBuffer());
+			}
+			else {
+				drawEncoder.bindPipeline(*m_pBufferManager->m_pGraphicsPipeline);
+				drawEncoder.bindVertexBuffer(*model->m_pVertexBuffer->getVkVertexBuffer());
+			}
+			drawEncoder.bindIndexBuffer(*model->m_pIndexBuffer->getVkIndexBuffer());
+			drawEncoder.bindDescriptorSet(*m_pBufferManager->m_pPipelineLayout, (*model->m_pDescriptorSets->getVkDescriptorSets())[frameIndex]);
 
-	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
-		throw std::runtime_error("failed to record command buffer!");
+			if (indirectBuffer == VK_NULL_HANDLE) {
+				vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(model->m_pIndexBuffer->m_indices.size()), 1, 0, 0, 0);
+			}
+			else {
+				// The culling pass wrote an instance count of 0 if the model is occluded or belongs to the other phase
+				vkCmdDrawIndexedIndirect(commandBuffer, indirectBuffer, packet.modelIndex * sizeof(VkDrawIndexedIndirectCommand), 1, sizeof(VkDrawIndexedIndirectCommand));
+			}
+		}
+	};
+
+	// With the pre-pass every model is drawn twice in the same pass, first only its depth, then shaded where its depth
+	// matches, so overlapping surfaces cost vertex work instead of fragment shading
+	if (pGraphicsPipeline->usesDepthPrepass()) recordDraws(true);
+	recordDraws(false);
+}
+
+void CommandBuffer::recordTransparentDraws(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+{
+	DrawEncoder& drawEncoder = m_pBufferManager->m_drawEncoder;
+	GraphicsPipeline* pGraphicsPipeline = VulkanEngine::getInstance()->getGraphicsPipeline();
+	drawEncoder.begin(commandBuffer);
+	pGraphicsPipeline->recordDynamicState(commandBuffer);
+
+	std::array<VkDescriptorSet, 2> frameSets = {
+		*m_pBufferManager->m_pClusteredLighting->getDescriptorSet(frameIndex),
+		*m_pBufferManager->m_pCascadedShadows->getDescriptorSet(frameIndex)
+	};
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, *m_pBufferManager->m_pPipelineLayout, 1, static_cast<uint32_t>(frameSets.size()),
+		frameSets.data(), 0, nullptr);
+
+	// Frustum and software occlusion culled only, so drawn directly even with HiZ culling
+	drawEncoder.bindPipeline(*pGraphicsPipeline->getTransparentPipeline());
+	for (const sDrawPacket& packet : m_pBufferManager->m_drawQueue.getPassPackets(DrawQueue::PASS_TRANSPARENT)) {
+		Model* model = m_pBufferManager->m_pLoadedModels->at(packet.modelIndex);
+
+		drawEncoder.bindVertexBuffer(*model->m_pVertexBuffer->getVkVertexBuffer());
+		drawEncoder.bindIndexBuffer(*model->m_pIndexBuffer->getVkIndexBuffer());
+		drawEncoder.bindDescriptorSet(*m_pBufferManager->m_pPipelineLayout, (*model->m_pDescriptorSets->getVkDescriptorSets())[frameIndex]);
+		vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(model->m_pIndexBuffer->m_indices.size()), 1, 0, 0, 0);
 	}
 }
 
@@ -285,20 +766,30 @@ void VertexBuffer::createVertexBuffer()
 {
 	mfDebugPrint("Creating vertex buffer...");
 
-	VkDeviceSize bufferSize = sizeof(m_vertices[0]) * m_vertices.size();
+	uploadBuffer(m_vertices.data(), sizeof(m_vertices[0]) * m_vertices.size(), m_vertexBuffer, m_vertexBufferMemory);
+
+	// A third of the size of the full vertices, so the depth pre-pass fetches less and fits more of the mesh in the vertex cache
+	std::vector<glm::vec3> positions;
+	positions.reserve(m_vertices.size());
+	for (const Vertex& vertex : m_vertices) positions.push_back(vertex.pos);
+
+	uploadBuffer(positions.data(), sizeof(positions[0]) * positions.size(), m_positionBuffer, m_positionBufferMemory);
+}
 
+void VertexBuffer::uploadBuffer(const void* pData, VkDeviceSize bufferSize, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+{
 	VkBuffer stagingBuffer;
 	VkDeviceMemory stagingBufferMemory;
 	m_pBufferManager->createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
 
 	void* data;
 	vkMapMemory(*m_pBufferManager->m_pLogicalDevice, stagingBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, m_vertices.data(), (size_t)bufferSize);
+	memcpy(data, pData, (size_t)bufferSize);
 	vkUnmapMemory(*m_pBufferManager->m_pLogicalDevice, stagingBufferMemory);
 
-	m_pBufferManager->createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_vertexBuffer, m_vertexBufferMemory);
+	m_pBufferManager->createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, bufferMemory);
 
-	m_pBufferManager->copyBuffer(stagingBuffer, m_vertexBuffer, bufferSize);
+	m_pBufferManager->copyBuffer(stagingBuffer, buffer, bufferSize);
 
 	vkDestroyBuffer(*m_pBufferManager->m_pLogicalDevice, stagingBuffer, nullptr);
 	vkFreeMemory(*m_pBufferManager->m_pLogicalDevice, stagingBufferMemory, nullptr);
@@ -309,6 +800,8 @@ void VertexBuffer::cleanup()
 
 	vkDestroyBuffer(*m_pBufferManager->m_pLogicalDevice, m_vertexBuffer, nullptr);
 	vkFreeMemory(*m_pBufferManager->m_pLogicalDevice, m_vertexBufferMemory, nullptr);
+	vkDestroyBuffer(*m_pBufferManager->m_pLogicalDevice, m_positionBuffer, nullptr);
+	vkFreeMemory(*m_pBufferManager->m_pLogicalDevice, m_positionBufferMemory, nullptr);
 }
 
 void VertexBuffer::recreateVertexBuffer(std::vector<Vertex> vertices)
@@ -382,8 +875,12 @@ void DepthBuffer::createDepthResources()
 	VkExtent2D swapchainExtent = *m_pBufferManager->m_pSwapchain->getSwapchainExtent();
 
 	VkFormat depthFormat = findDepthFormat(m_pBufferManager->m_pPhysicalDevice);
+	VkImageUsageFlags usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+	if (m_pBufferManager->m_pSettings->graphicsSettings.occlusionCulling == eOcclusionCulling::HIERARCHICAL_Z) usage |= VK_IMAGE_USAGE_SAMPLED_BIT; // Read when building the depth pyramid
+	if (m_pBufferManager->m_pSettings->graphicsSettings.temporalAA) usage |= VK_IMAGE_USAGE_SAMPLED_BIT; // Read when building motion vectors
+
 	Image::createImage(swapchainExtent.width, swapchainExtent.height, depthFormat, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_TILING_OPTIMAL,
-		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_depthImage, m_depthImageMemory);
+		usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_depthImage, m_depthImageMemory);
 
 	m_depthImageView = Image::createImageView(m_depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
 	Image::transitionImageLayout(m_depthImage, depthFormat, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
@@ -424,6 +921,72 @@ void DepthBuffer::cleanup()
 	vkFreeMemory(*m_pBufferManager->m_pLogicalDevice, m_depthImageMemory, nullptr);
 }
 
+void DepthBuffer::retire(DeletionQueue* pDeletionQueue)
+{
+	pDeletionQueue->push([device = *m_pBufferManager->m_pLogicalDevice, imageView = m_depthImageView, image = m_depthImage, memory = m_depthImageMemory]() {
+		vkDestroyImageView(device, imageView, nullptr);
+		vkDestroyImage(device, image, nullptr);
+		vkFreeMemory(device, memory, nullptr);
+	});
+}
+
+
+
+
+
+
+//// ----------------------------------------------------- //
+/// ----------------- Multisample Buffer ---------------- //
+// ----------------------------------------------------- //
+
+void MultisampleBuffer::createMultisampleResources()
+{
+	VkExtent2D swapchainExtent = *m_pBufferManager->m_pSwapchain->getSwapchainExtent();
+	VkFormat colorFormat = VulkanEngine::getInstance()->getGraphicsPipeline()->getColorFormat();
+	VkFormat depthFormat = DepthBuffer::findDepthFormat(m_pBufferManager->m_pPhysicalDevice);
+
+	// The occlusion render pass loads what the first pass drew, so with occlusion culling the attachments are stored between
+	// the two passes and have to be backed by real memory
+	VkImageUsageFlags transientUsage = 0;
+	VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	if (m_pBufferManager->m_pSettings->graphicsSettings.occlusionCulling != eOcclusionCulling::HIERARCHICAL_Z) {
+		transientUsage = VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+		properties |= VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+	}
+
+	Image::createImage(swapchainExtent.width, swapchainExtent.height, colorFormat, m_sampleCount, VK_IMAGE_TILING_OPTIMAL,
+		transientUsage | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, properties, m_colorImage, m_colorImageMemory);
+	m_colorImageView = Image::createImageView(m_colorImage, colorFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+
+	Image::createImage(swapchainExtent.width, swapchainExtent.height, depthFormat, m_sampleCount, VK_IMAGE_TILING_OPTIMAL,
+		transientUsage | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, properties, m_depthImage, m_depthImageMemory);
+	m_depthImageView = Image::createImageView(m_depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
+}
+
+void MultisampleBuffer::cleanup()
+{
+	vkDestroyImageView(*m_pBufferManager->m_pLogicalDevice, m_colorImageView, nullptr);
+	vkDestroyImage(*m_pBufferManager->m_pLogicalDevice, m_colorImage, nullptr);
+	vkFreeMemory(*m_pBufferManager->m_pLogicalDevice, m_colorImageMemory, nullptr);
+
+	vkDestroyImageView(*m_pBufferManager->m_pLogicalDevice, m_depthImageView, nullptr);
+	vkDestroyImage(*m_pBufferManager->m_pLogicalDevice, m_depthImage, nullptr);
+	vkFreeMemory(*m_pBufferManager->m_pLogicalDevice, m_depthImageMemory, nullptr);
+}
+
+void MultisampleBuffer::retire(DeletionQueue* pDeletionQueue)
+{
+	pDeletionQueue->push([device = *m_pBufferManager->m_pLogicalDevice, colorImageView = m_colorImageView, colorImage = m_colorImage, colorMemory = m_colorImageMemory,
+		depthImageView = m_depthImageView, depthImage = m_depthImage, depthMemory = m_depthImageMemory]() {
+		vkDestroyImageView(device, colorImageView, nullptr);
+		vkDestroyImage(device, colorImage, nullptr);
+		vkFreeMemory(device, colorMemory, nullptr);
+		vkDestroyImageView(device, depthImageView, nullptr);
+		vkDestroyImage(device, depthImage, nullptr);
+		vkFreeMemory(device, depthMemory, nullptr);
+	});
+}
+
 
 
 
@@ -441,13 +1004,39 @@ void Framebuffer::createFramebuffers()
 
 	m_framebuffers.resize(swapchainImageViews.size());
 
+	// Same order as the attachments in GraphicsPipeline::createRenderPass
+	MultisampleBuffer* pMultisampleBuffer = m_pBufferManager->m_pMultisampleBuffer;
+	bool resolveDepth = pMultisampleBuffer != nullptr && m_pBufferManager->m_pSettings->graphicsSettings.occlusionCulling == eOcclusionCulling::HIERARCHICAL_Z;
+
+	// With post-processing every framebuffer draws to the same scene colour image, which is copied to the swapchain image afterwards
+	PostProcessChain* pPostProcessChain = m_pBufferManager->m_pPostProcessChain;
+	if (pPostProcessChain != nullptr) std::fill(swapchainImageViews.begin(), swapchainImageViews.end(), *pPostProcessChain->getSceneColorImageView());
+
+	// Multiview draws to the layered views instead, a framebuffer is still a single layer and the view mask picks the rest
+	MultiviewTarget* pMultiviewTarget = m_pBufferManager->m_pMultiviewTarget;
+	VkImageView depthImageView = *m_pBufferManager->m_pDepthBuffer->getVkImageView();
+	if (pMultiviewTarget != nullptr) {
+		std::fill(swapchainImageViews.begin(), swapchainImageViews.end(), *pMultiviewTarget->getColorImageView());
+		depthImageView = *pMultiviewTarget->getDepthImageView();
+		swapchainExtent = pMultiviewTarget->getViewExtent();
+	}
+
 	for (size_t i = 0; i < swapchainImageViews.size(); i++)
 	{
-		std::array<VkImageView, 2> attachments = {
+		std::vector<VkImageView> attachments = {
 			swapchainImageViews[i],
-			*m_pBufferManager->m_pDepthBuffer->getVkImageView()
+			depthImageView
 		};
 
+		if (pMultisampleBuffer != nullptr) {
+			attachments = {
+				*pMultisampleBuffer->getColorImageView(),
+				*pMultisampleBuffer->getDepthImageView(),
+				swapchainImageViews[i]
+			};
+			if (resolveDepth) attachments.push_back(*m_pBufferManager->m_pDepthBuffer->getVkImageView());
+		}
+
 		VkFramebufferCreateInfo framebufferInfo{
 			.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
 			.renderPass = *m_pBufferManager->m_pRenderPass,
@@ -471,44 +1060,16 @@ void Framebuffer::cleanup()
 	}
 }
 
-
-
-
-
-
-
-
-//// ----------------------------------------------------- //
-/// ------------------ Uniform Buffers ------------------ //
-// ----------------------------------------------------- //
-
-
-void UniformBufferObject::createUniformBuffers()
+void Framebuffer::retire(DeletionQueue* pDeletionQueue)
 {
-	mfDebugPrint("Creating uniform buffers...");
-
-	VkDeviceSize bufferSize = sizeof(sUniformBufferObject);
-
-	m_uniformBuffers.resize(m_pBufferManager->m_MAX_FRAMES_IN_FLIGHT);
-	m_uniformBuffersMemory.resize(m_pBufferManager->m_MAX_FRAMES_IN_FLIGHT);
-	m_uniformBuffersMapped.resize(m_pBufferManager->m_MAX_FRAMES_IN_FLIGHT);
-
-	for (size_t i = 0; i < m_pBufferManager->m_MAX_FRAMES_IN_FLIGHT; i++) {
-		m_pBufferManager->createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_uniformBuffers[i], m_uniformBuffersMemory[i]);
-
-		vkMapMemory(*m_pBufferManager->m_pLogicalDevice, m_uniformBuffersMemory[i], 0, bufferSize, 0, &m_uniformBuffersMapped[i]);
-	}
-
-	m_uniformBuffersMapped.resize(m_pBufferManager->m_MAX_FRAMES_IN_FLIGHT);
+	pDeletionQueue->push([device = *m_pBufferManager->m_pLogicalDevice, framebuffers = m_framebuffers]() {
+		for (VkFramebuffer framebuffer : framebuffers) {
+			vkDestroyFramebuffer(device, framebuffer, nullptr);
+		}
+	});
 }
 
-void UniformBufferObject::cleanup()
-{
-	for (size_t i = 0; i < m_pBufferManager->m_MAX_FRAMES_IN_FLIGHT; i++) {
-		vkDestroyBuffer(*m_pBufferManager->m_pLogicalDevice, m_uniformBuffers[i], nullptr);
-		vkFreeMemory(*m_pBufferManager->m_pLogicalDevice, m_uniformBuffersMemory[i], nullptr);
-	}
-}
+
 
 
 
@@ -557,7 +1118,7 @@ void DescriptorSets::createDescriptorPool()
 	m_pDescriptorPool = descriptorPool;
 }
 
-void DescriptorSets::createDescriptorSets(VkImageView* pImageView, VkSampler* pImageSampler, UniformBufferObject* pUniformBuffer)
+void DescriptorSets::createDescriptorSets(VkImageView* pImageView, VkSampler* pImageSampler, uint32_t uniformSlot)
 {
 	mfDebugPrint("Creating descriptor sets...");
 
@@ -578,9 +1139,10 @@ void DescriptorSets::createDescriptorSets(VkImageView* pImageView, VkSampler* pI
 
 	for (size_t i = 0; i < m_pBufferManager->m_MAX_FRAMES_IN_FLIGHT; i++)
 	{
+		FrameContextRing* pFrameContexts = m_pBufferManager->m_pFrameContexts;
 		VkDescriptorBufferInfo bufferInfo{
-			.buffer = (*pUniformBuffer->getUniformBuffers())[i],
-			.offset = 0,
+			.buffer = pFrameContexts->getContext(static_cast<uint32_t>(i)).uniformBuffer,
+			.offset = pFrameContexts->getUniformSlotOffset(uniformSlot),
 			.range = sizeof(UniformBufferObject::sUniformBufferObject)
 		};
 
@@ -9,6 +9,9 @@
 
 #include "Vertex.h"
 #include "Swapchain.h"
+#include "DrawQueue.h"
+#include "RenderGraph.h"
+#include "MultiviewTarget.h"
 
 
 #define mfDebugPrint(x) m_pBufferManager->m_pUtilities->debugPrint(x,this)
@@ -26,10 +29,21 @@ class CommandBuffer;
 class VertexBuffer;
 class IndexBuffer;
 class DepthBuffer;
+class MultisampleBuffer;
 class Framebuffer;
 class UniformBufferObject;
 class DescriptorSets;
 class Model;
+class HiZCuller;
+class ClusteredLighting;
+class CascadedShadows;
+class PostProcessChain;
+class TemporalAA;
+class WeightedBlendedOIT;
+class VisibilityBuffer;
+class GpuTimeline;
+class FrameContextRing;
+class DeletionQueue;
 
 
 class BufferManager
@@ -37,22 +51,28 @@ class BufferManager
 public:
 	BufferManager();
 
-	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& pBuffer, VkDeviceMemory& pDeviceMemory);
+	// Buffers are exclusive to one queue family unless two different families are given to share it between
+	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& pBuffer, VkDeviceMemory& pDeviceMemory,
+		const std::vector<uint32_t>& sharedQueueFamilies = {});
 	void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
 	static uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+	static bool hasMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
 
 	CommandBuffer* getCommandBuffer() { return m_pCommandBuffer; }
 	std::vector<VertexBuffer*>* getVertexBuffers() { return &m_pVertexBuffers; }
 	std::vector<IndexBuffer*>* getIndexBuffers() { return &m_pIndexBuffers; }
 	DepthBuffer* getDepthBuffer() { return m_pDepthBuffer; }
+	MultisampleBuffer* getMultisampleBuffer() { return m_pMultisampleBuffer; }
 	Framebuffer* getFramebuffer() { return m_pFramebuffer; }
-	std::vector<UniformBufferObject*>* getUniformBufferObjects() { return &m_pUniformBufferObjects; }
+	RenderGraph* getRenderGraph() { return m_pRenderGraph; }
+	FrameContextRing* getFrameContexts() { return m_pFrameContexts; }
 
 private:
 	VkDevice* m_pLogicalDevice = nullptr;
 	static VkPhysicalDevice* m_pPhysicalDevice;
 	VkSurfaceKHR* m_pSurface = nullptr;
 	VkRenderPass* m_pRenderPass = nullptr;
+	VkRenderPass* m_pOcclusionRenderPass = nullptr;
 	Swapchain* m_pSwapchain = nullptr;
 	VkPipeline* m_pGraphicsPipeline = nullptr;
 	VkPipelineLayout* m_pPipelineLayout = nullptr;
@@ -60,24 +80,49 @@ private:
 	sSettings* m_pSettings = nullptr;
 	int m_MAX_FRAMES_IN_FLIGHT = 1;
 	VkQueue* m_pGraphicsQueue = nullptr;
+	GpuTimeline* m_pGpuTimeline = nullptr;
 	VkDescriptorSetLayout* m_pDescriptorSetLayout = nullptr;
+	PFN_vkCmdBeginRenderingKHR m_vkCmdBeginRendering = nullptr; // Only loaded with dynamic rendering
+	PFN_vkCmdEndRenderingKHR m_vkCmdEndRendering = nullptr;
 
 
 	CommandBuffer* m_pCommandBuffer = nullptr;
 	std::vector<VertexBuffer*> m_pVertexBuffers;
 	std::vector<IndexBuffer*> m_pIndexBuffers;
-	std::vector<UniformBufferObject*> m_pUniformBufferObjects;
 	std::vector<Model*>* m_pLoadedModels = nullptr;
+	std::vector<uint32_t> m_visibleModelIndices = {}; // Indices into m_pLoadedModels that survived culling this frame
 	DepthBuffer* m_pDepthBuffer = nullptr;
-	Framebuffer* m_pFramebuffer = nullptr;
+	MultisampleBuffer* m_pMultisampleBuffer = nullptr; // Only created with MSAA
+	Framebuffer* m_pFramebuffer = nullptr; // Not created with dynamic rendering
+	HiZCuller* m_pHiZCuller = nullptr; // Only set when occlusion culling is enabled
+	ClusteredLighting* m_pClusteredLighting = nullptr;
+	CascadedShadows* m_pCascadedShadows = nullptr;
+	PostProcessChain* m_pPostProcessChain = nullptr; // Only created with post-processing
+	TemporalAA* m_pTemporalAA = nullptr; // Only created with temporal anti-aliasing
+	MultiviewTarget* m_pMultiviewTarget = nullptr; // Only created with multiview, the passes draw into it instead of the frame
+	WeightedBlendedOIT* m_pWeightedBlendedOIT = nullptr; // Only created with order independent transparency
+	VisibilityBuffer* m_pVisibilityBuffer = nullptr; // Only created with the visibility buffer, it replaces the main pass
+	DrawQueue m_drawQueue = {}; // The visible models in the order they are drawn this frame
+	DrawEncoder m_drawEncoder = {};
+	RenderGraph* m_pRenderGraph = nullptr;
+	FrameContextRing* m_pFrameContexts = nullptr;
 
 	friend class VulkanEngine;
+	friend class Window;
+	friend class HiZCuller;
+	friend class ClusteredLighting;
+	friend class CascadedShadows;
+	friend class PostProcessChain;
+	friend class TemporalAA;
+	friend class MultiviewTarget;
+	friend class WeightedBlendedOIT;
+	friend class VisibilityBuffer;
 	friend class CommandBuffer;
 	friend class VertexBuffer;
 	friend class IndexBuffer;
 	friend class DepthBuffer;
+	friend class MultisampleBuffer;
 	friend class Framebuffer;
-	friend class UniformBufferObject;
 	friend class DescriptorSets;
 };
 
@@ -127,19 +172,31 @@ public:
 	void createCommandPool();
 	VkCommandBuffer beginSingleTimeCommands();
 	void endSingleTimeCommands(VkCommandBuffer commandBuffer);
-	void createCommandBuffers();
-	void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+	// Builds this frame's render graph and records it. frameIndex is the frame in flight, imageIndex the swapchain image.
+	void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t frameIndex, uint32_t imageIndex);
+	// Stage of the first write to the swapchain image, where the acquire semaphore has to be waited on. A transfer when the
+	// passes draw elsewhere and the frame is copied in, the colour attachment output otherwise.
+	VkPipelineStageFlags getSwapchainWaitStage();
 
 	void cleanup();
 
 	VkCommandPool* getVkCommandPool() { return &sm_commandPool; }
-	std::vector<VkCommandBuffer>* getCommandBuffers() { return &sm_commandBuffers; }
 
 private:
 	BufferManager* m_pBufferManager = nullptr;
 
+
+	// Starts drawing to the swapchain image and depth buffer, either clearing them or keeping what an earlier pass drew.
+	// Uses dynamic rendering when it is enabled, otherwise the matching render pass and framebuffer.
+	void beginRenderPass(VkCommandBuffer commandBuffer, uint32_t imageIndex, bool loadAttachments);
+	void endRenderPass(VkCommandBuffer commandBuffer);
+	// Draws the models that survived culling in draw queue order, after a depth only pass over them if the pipeline variant
+	// uses the depth pre-pass. With an indirect buffer the draw parameters come from the GPU.
+	void recordModelDraws(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkBuffer indirectBuffer);
+	// Draws the transparent models that survived culling with the weighted blended pipeline, inside WeightedBlendedOIT's accumulation pass
+	void recordTransparentDraws(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+
 	static VkCommandPool sm_commandPool;
-	static std::vector<VkCommandBuffer> sm_commandBuffers;
 };
 
 
@@ -169,12 +226,20 @@ public:
 	void recreateVertexBuffer(std::vector<Vertex> vertices);
 
 	VkBuffer* getVkVertexBuffer() { return &m_vertexBuffer; }
+	// Tightly packed positions of the same vertices, all the depth pre-pass reads
+	VkBuffer* getVkPositionBuffer() { return &m_positionBuffer; }
 
 private:
 	BufferManager* m_pBufferManager = nullptr;
 
 	VkBuffer m_vertexBuffer = VK_NULL_HANDLE;
 	VkDeviceMemory m_vertexBufferMemory = VK_NULL_HANDLE;
+	VkBuffer m_positionBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory m_positionBufferMemory = VK_NULL_HANDLE;
+
+
+	// Copies the data into a new device local vertex buffer through a staging buffer
+	void uploadBuffer(const void* pData, VkDeviceSize bufferSize, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
 };
 
 
@@ -237,7 +302,10 @@ public:
 	static VkFormat findSupportedFormat(VkPhysicalDevice* pPhysicalDevice, const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
 
 	void cleanup();
+	// Hands the current image to the deletion queue, for recreating it while frames in flight still use it
+	void retire(DeletionQueue* pDeletionQueue);
 
+	VkImage* getVkImage() { return &m_depthImage; }
 	VkImageView* getVkImageView() { return &m_depthImageView; }
 private:
 	BufferManager* m_pBufferManager = nullptr;
@@ -252,6 +320,49 @@ private:
 
 
 
+//// ----------------------------------------------------- //
+/// ----------------- Multisample Buffer ---------------- //
+// ----------------------------------------------------- //
+
+// Multisampled colour and depth attachments drawn to with MSAA, resolved into the swapchain image (and the depth buffer
+// when the depth pyramid needs it) at the end of the pass. When the frame is drawn in a single pass they never leave the
+// pass, so they are transient and lazily allocated, which keeps them in tile memory on GPUs that have it.
+class MultisampleBuffer
+{
+public:
+	MultisampleBuffer(BufferManager* pBufferManager, VkSampleCountFlagBits sampleCount) : m_pBufferManager(pBufferManager), m_sampleCount(sampleCount)
+	{
+		createMultisampleResources();
+	};
+
+	void createMultisampleResources();
+
+	void cleanup();
+	// Hands the current images to the deletion queue, for recreating them while frames in flight still use them
+	void retire(DeletionQueue* pDeletionQueue);
+
+	VkSampleCountFlagBits getSampleCount() { return m_sampleCount; }
+	VkImage* getColorImage() { return &m_colorImage; }
+	VkImageView* getColorImageView() { return &m_colorImageView; }
+	VkImage* getDepthImage() { return &m_depthImage; }
+	VkImageView* getDepthImageView() { return &m_depthImageView; }
+private:
+	BufferManager* m_pBufferManager = nullptr;
+	VkSampleCountFlagBits m_sampleCount = VK_SAMPLE_COUNT_1_BIT;
+
+	VkImage m_colorImage = VK_NULL_HANDLE;
+	VkDeviceMemory m_colorImageMemory = VK_NULL_HANDLE;
+	VkImageView m_colorImageView = VK_NULL_HANDLE;
+	VkImage m_depthImage = VK_NULL_HANDLE;
+	VkDeviceMemory m_depthImageMemory = VK_NULL_HANDLE;
+	VkImageView m_depthImageView = VK_NULL_HANDLE;
+};
+
+
+
+
+
+
 //// ----------------------------------------------------- //
 /// -------------------- Frame Buffer ------------------- //
 // ----------------------------------------------------- //
@@ -267,6 +378,7 @@ public:
 
 	void createFramebuffers();
 	void cleanup();
+	void retire(DeletionQueue* pDeletionQueue);
 
 	std::vector<VkFramebuffer>* getFramebuffers() { return &m_framebuffers; }
 private:
@@ -286,36 +398,17 @@ private:
 // ----------------------------------------------------- //
 
 
+// Layout of a model's uniforms. They live in the frame contexts' uniform buffers, one slot per model, see FrameContextRing.
 class UniformBufferObject
 {
 public:
 	struct sUniformBufferObject
 	{
 		alignas(16) glm::mat4 model;
-		alignas(16) glm::mat4 view;
-		alignas(16) glm::mat4 proj;
-	};
-
-	UniformBufferObject(BufferManager* pBufferManager) : m_pBufferManager(pBufferManager)
-	{
-		createUniformBuffers();
+		alignas(16) glm::mat4 view[MultiviewTarget::sm_viewCount]; // Indexed by gl_ViewIndex, only the first is used without multiview
+		alignas(16) glm::mat4 proj[MultiviewTarget::sm_viewCount];
+		alignas(16) float opacity;
 	};
-
-	void createUniformBuffers();
-
-	void cleanup();
-
-
-	std::vector<VkBuffer>* getUniformBuffers() { return &m_uniformBuffers; };
-	std::vector<void*>* getUniformBuffersMapped() { return &m_uniformBuffersMapped; };
-
-private:
-	BufferManager* m_pBufferManager = nullptr;
-
-
-	std::vector<VkBuffer> m_uniformBuffers = {};
-	std::vector<VkDeviceMemory> m_uniformBuffersMemory = {};
-	std::vector<void*> m_uniformBuffersMapped = {};
 };
 
 
@@ -339,7 +432,8 @@ public:
 	};
 
 	void createDescriptorPool();
-	void createDescriptorSets(VkImageView* pImageView, VkSampler* pImageSampler, UniformBufferObject* pUniformBuffer);
+	// One set per frame context, each pointing at the model's uniform slot in that context's uniform buffer
+	void createDescriptorSets(VkImageView* pImageView, VkSampler* pImageSampler, uint32_t uniformSlot);
 
 	void cleanup();
 
@@ -0,0 +1,42 @@
+#include "../VulkanRenderer.h"
+#include "GpuTimeline.h"
+
+#include "DeletionQueue.h"
+
+
+DeletionQueue::DeletionQueue() : m_pUtilities(Utilities::getInstance()), m_pGpuTimeline(VulkanEngine::getInstance()->m_pGpuTimeline)
+{
+}
+
+void DeletionQueue::push(std::function<void()>&& destroy)
+{
+	push(m_pGpuTimeline->getLastSubmittedValue(), std::move(destroy));
+}
+
+void DeletionQueue::push(uint64_t timelineValue, std::function<void()>&& destroy)
+{
+	// Values are nearly always pushed in order, so the insertion point is found from the back
+	auto it = m_entries.end();
+	while (it != m_entries.begin() && std::prev(it)->timelineValue > timelineValue) it--;
+
+	m_entries.insert(it, sEntry{ .timelineValue = timelineValue, .destroy = std::move(destroy) });
+}
+
+void DeletionQueue::collect()
+{
+	while (!m_entries.empty() && m_pGpuTimeline->isComplete(m_entries.front().timelineValue)) {
+		m_entries.front().destroy();
+		m_entries.pop_front();
+	}
+}
+
+void DeletionQueue::flush()
+{
+	if (!m_entries.empty()) mDebugPrint(std::format("Flushing {} retired object(s)...", m_entries.size()));
+
+	for (sEntry& entry : m_entries) {
+		entry.destroy();
+	}
+
+	m_entries.clear();
+}
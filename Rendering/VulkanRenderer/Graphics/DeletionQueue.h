@@ -0,0 +1,44 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <deque>
+#include <functional>
+#include <cstdint>
+
+#include "../Utilities/Utilities.h"
+
+
+class GpuTimeline;
+
+// Destroys objects the GPU may still be using once the GPU timeline says it's done with them, instead of waiting for the
+// device to go idle. Whatever is retired captures its handles in the destroy function, so the owner can create the
+// replacements straight away.
+class DeletionQueue
+{
+public:
+	DeletionQueue();
+
+	// Destroyed after everything submitted so far has finished
+	void push(std::function<void()>&& destroy);
+	// Destroyed once the GPU timeline reaches the value, which may belong to a submission that hasn't happened yet
+	void push(uint64_t timelineValue, std::function<void()>&& destroy);
+
+	// Runs the destroy functions whose value has been reached, called once per frame
+	void collect();
+	// Runs all of them, the device has to be idle
+	void flush();
+
+private:
+	struct sEntry
+	{
+		uint64_t timelineValue;
+		std::function<void()> destroy;
+	};
+
+	Utilities* m_pUtilities = nullptr;
+	GpuTimeline* m_pGpuTimeline = nullptr;
+
+	std::deque<sEntry> m_entries = {}; // Ordered by timeline value
+};
@@ -50,8 +50,9 @@ bool PhysicalDevice::isDeviceSuitable(VkPhysicalDevice candidateDevice)
 
 	mDebugPrint("Extensions supported: " + std::to_string(extensionsSupported));
 
-	bool swapChainAdequate = false;
-	if (extensionsSupported)
+	// Headless runs don't need to present, so any device that can draw will do, e.g. a software rasteriser
+	bool swapChainAdequate = *m_pSurface == VK_NULL_HANDLE;
+	if (extensionsSupported && !swapChainAdequate)
 	{
 		SwapChainSupportDetails swapChainSupport = querySwapChainSupport(candidateDevice);
 		swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
@@ -60,7 +61,33 @@ bool PhysicalDevice::isDeviceSuitable(VkPhysicalDevice candidateDevice)
 	VkPhysicalDeviceFeatures supportedFeatures;
 	vkGetPhysicalDeviceFeatures(candidateDevice, &supportedFeatures);
 
-	bool finalResult = indices.isComplete() && extensionsSupported && swapChainAdequate && supportedFeatures.samplerAnisotropy;
+	// Frames and uploads are synchronised with a timeline semaphore, core since Vulkan 1.2. The scene shaders always read
+	// gl_ViewIndex, so multiview (core since 1.1) is needed even when only one view is drawn.
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(candidateDevice, &properties);
+	bool timelineSemaphoreSupported = false;
+	bool multiviewSupported = false;
+	if (properties.apiVersion >= VK_API_VERSION_1_2)
+	{
+		VkPhysicalDeviceVulkan12Features vulkan12Features{
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES
+		};
+		VkPhysicalDeviceVulkan11Features vulkan11Features{
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES,
+			.pNext = &vulkan12Features
+		};
+		VkPhysicalDeviceFeatures2 features2{
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+			.pNext = &vulkan11Features
+		};
+		vkGetPhysicalDeviceFeatures2(candidateDevice, &features2);
+		timelineSemaphoreSupported = vulkan12Features.timelineSemaphore;
+		multiviewSupported = vulkan11Features.multiview;
+	}
+	mDebugPrint("Timeline semaphores supported: " + std::to_string(timelineSemaphoreSupported));
+	mDebugPrint("Multiview supported: " + std::to_string(multiviewSupported));
+
+	bool finalResult = indices.isComplete() && extensionsSupported && swapChainAdequate && supportedFeatures.samplerAnisotropy && timelineSemaphoreSupported && multiviewSupported;
 	mDebugPrint("Device suitable: " + std::to_string(finalResult));
 
 	return finalResult;
@@ -77,7 +104,8 @@ bool PhysicalDevice::checkDeviceExtensionSupport(VkPhysicalDevice candidateDevic
 	std::vector<VkExtensionProperties> availableExtensions(extensionCount);
 	vkEnumerateDeviceExtensionProperties(candidateDevice, nullptr, &extensionCount, availableExtensions.data());
 
-	std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
+	std::vector<const char*> extensions = getRequiredExtensions();
+	std::set<std::string> requiredExtensions(extensions.begin(), extensions.end());
 
 	for (const auto& extension : availableExtensions)
 	{
@@ -124,6 +152,28 @@ SwapChainSupportDetails PhysicalDevice::querySwapChainSupport(VkPhysicalDevice p
 	return details;
 }
 
+std::vector<const char*> PhysicalDevice::getRequiredExtensions()
+{
+	if (*m_pSurface == VK_NULL_HANDLE) return {};
+	return deviceExtensions;
+}
+
+bool PhysicalDevice::isExtensionSupported(const char* extensionName)
+{
+	uint32_t extensionCount;
+	vkEnumerateDeviceExtensionProperties(m_physicalDevice, nullptr, &extensionCount, nullptr);
+
+	std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(m_physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+
+	for (const auto& extension : availableExtensions)
+	{
+		if (strcmp(extension.extensionName, extensionName) == 0) return true;
+	}
+
+	return false;
+}
+
 VkSampleCountFlagBits PhysicalDevice::getMaxUsableSampleCount() {
 	VkPhysicalDeviceProperties physicalDeviceProperties;
 	vkGetPhysicalDeviceProperties(m_physicalDevice, &physicalDeviceProperties);
@@ -157,6 +207,11 @@ void LogicalDevice::createLogicalDevice()
 	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
 	std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
 
+	// validateSettings has turned async compute off if there's no dedicated family
+	m_graphicsFamily = indices.graphicsFamily.value();
+	m_computeFamily = pSettings->graphicsSettings.asyncCompute ? indices.computeFamily.value() : m_graphicsFamily;
+	uniqueQueueFamilies.insert(m_computeFamily);
+
 	float queuePriority = 1.0f;
 	for (uint32_t queueFamily : uniqueQueueFamilies)
 	{
@@ -169,12 +224,92 @@ void LogicalDevice::createLogicalDevice()
 		queueCreateInfos.push_back(queueCreateInfo);
 	}
 
+	// Optional extensions, validateSettings has already turned off whatever the device doesn't support
+	std::vector<const char*> enabledExtensions = m_pPhysicalDevice->getRequiredExtensions();
+
+	VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR,
+		.pNext = nullptr,
+		.dynamicRendering = VK_TRUE
+	};
+
+	VkPhysicalDeviceVulkan12Features vulkan12Features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+		.pNext = nullptr,
+		.timelineSemaphore = VK_TRUE // Checked by PhysicalDevice::isDeviceSuitable
+	};
+
+	VkPhysicalDeviceVulkan11Features vulkan11Features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES,
+		.pNext = &vulkan12Features,
+		.multiview = VK_TRUE // Checked by PhysicalDevice::isDeviceSuitable, the scene shaders use gl_ViewIndex
+	};
+
+	VkPhysicalDeviceExtendedDynamicState3FeaturesEXT extendedDynamicState3Features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT,
+		.pNext = nullptr,
+		.extendedDynamicState3PolygonMode = VK_TRUE
+	};
+
+	VkPhysicalDeviceExtendedDynamicStateFeaturesEXT extendedDynamicStateFeatures{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT,
+		.pNext = &extendedDynamicState3Features,
+		.extendedDynamicState = VK_TRUE
+	};
+
+	VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT graphicsPipelineLibraryFeatures{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT,
+		.pNext = nullptr,
+		.graphicsPipelineLibrary = VK_TRUE
+	};
+
+	// Each enabled extension adds its features to the front of the chain
+	void* pFeatureChain = nullptr;
+
+	if (pSettings->graphicsSettings.dynamicRendering)
+	{
+		mDebugPrint("Enabling dynamic rendering...");
+		enabledExtensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+		dynamicRenderingFeatures.pNext = pFeatureChain;
+		pFeatureChain = &dynamicRenderingFeatures;
+	}
+
+	// Cull mode comes from VK_EXT_extended_dynamic_state, polygon mode from VK_EXT_extended_dynamic_state3
+	if (pSettings->graphicsSettings.extendedDynamicState)
+	{
+		mDebugPrint("Enabling extended dynamic state...");
+		enabledExtensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+		enabledExtensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME);
+		extendedDynamicState3Features.pNext = pFeatureChain;
+		pFeatureChain = &extendedDynamicStateFeatures;
+	}
+
+	if (pSettings->graphicsSettings.graphicsPipelineLibrary)
+	{
+		mDebugPrint("Enabling graphics pipeline libraries...");
+		enabledExtensions.push_back(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME);
+		enabledExtensions.push_back(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+		graphicsPipelineLibraryFeatures.pNext = pFeatureChain;
+		pFeatureChain = &graphicsPipelineLibraryFeatures;
+	}
+
+	// gl_PrimitiveID in the fragment shader needs the geometry shader feature, even without a geometry stage
+	if (pSettings->graphicsSettings.visibilityBuffer)
+	{
+		mDebugPrint("Enabling visibility buffer features...");
+		deviceFeatures.geometryShader = VK_TRUE;
+		vulkan12Features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+	}
+
+	vulkan12Features.pNext = pFeatureChain;
+
 	VkDeviceCreateInfo createInfo{
 		.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+		.pNext = &vulkan11Features,
 		.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size()),
 		.pQueueCreateInfos = queueCreateInfos.data(),
-		.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size()),
-		.ppEnabledExtensionNames = deviceExtensions.data(),
+		.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size()),
+		.ppEnabledExtensionNames = enabledExtensions.data(),
 		.pEnabledFeatures = &deviceFeatures
 	};
 
@@ -197,6 +332,29 @@ void LogicalDevice::createLogicalDevice()
 
 	vkGetDeviceQueue(m_logicalDevice, indices.graphicsFamily.value(), 0, &m_graphicsQueue);
 	vkGetDeviceQueue(m_logicalDevice, indices.presentFamily.value(), 0, &m_presentQueue);
+	vkGetDeviceQueue(m_logicalDevice, m_computeFamily, 0, &m_computeQueue);
+
+	if (pSettings->graphicsSettings.dynamicRendering)
+	{
+		m_vkCmdBeginRendering = reinterpret_cast<PFN_vkCmdBeginRenderingKHR>(vkGetDeviceProcAddr(m_logicalDevice, "vkCmdBeginRenderingKHR"));
+		m_vkCmdEndRendering = reinterpret_cast<PFN_vkCmdEndRenderingKHR>(vkGetDeviceProcAddr(m_logicalDevice, "vkCmdEndRenderingKHR"));
+
+		if (m_vkCmdBeginRendering == nullptr || m_vkCmdEndRendering == nullptr)
+		{
+			throw std::runtime_error("failed to load dynamic rendering functions!");
+		}
+	}
+
+	if (pSettings->graphicsSettings.extendedDynamicState)
+	{
+		m_vkCmdSetPolygonMode = reinterpret_cast<PFN_vkCmdSetPolygonModeEXT>(vkGetDeviceProcAddr(m_logicalDevice, "vkCmdSetPolygonModeEXT"));
+		m_vkCmdSetCullMode = reinterpret_cast<PFN_vkCmdSetCullModeEXT>(vkGetDeviceProcAddr(m_logicalDevice, "vkCmdSetCullModeEXT"));
+
+		if (m_vkCmdSetPolygonMode == nullptr || m_vkCmdSetCullMode == nullptr)
+		{
+			throw std::runtime_error("failed to load extended dynamic state functions!");
+		}
+	}
 }
 
 void LogicalDevice::cleanup()
@@ -13,6 +13,7 @@
 
 
 
+// Only needed to present, headless runs go without, see PhysicalDevice::getRequiredExtensions
 const std::vector<const char*> deviceExtensions = {
 	VK_KHR_SWAPCHAIN_EXTENSION_NAME
 };
@@ -38,6 +39,10 @@ public:
 
 	VkPhysicalDevice* getVkPhysicalDevice() { return &m_physicalDevice; };
 	VkSampleCountFlagBits getMaxUsableSampleCount();
+	// Whether the picked device supports an optional extension, the ones in getRequiredExtensions are always supported.
+	bool isExtensionSupported(const char* extensionName);
+	// deviceExtensions, or none when running headless
+	std::vector<const char*> getRequiredExtensions();
 
 private:
 	VkInstance* m_pVkInstance = nullptr;
@@ -66,6 +71,16 @@ public:
 	VkDevice* getVkDevice() { return &m_logicalDevice; };
 	PhysicalDevice* getPhysicalDevice() { return m_pPhysicalDevice; };
 	VkQueue* getGraphicsQueue() { return &m_graphicsQueue; };
+	// The dedicated compute queue with async compute, otherwise the graphics queue
+	VkQueue* getComputeQueue() { return &m_computeQueue; };
+	uint32_t getComputeFamily() { return m_computeFamily; };
+	uint32_t getGraphicsFamily() { return m_graphicsFamily; };
+
+	// Only loaded when dynamic rendering is enabled, see sGraphicsSettings::dynamicRendering
+	PFN_vkCmdBeginRenderingKHR m_vkCmdBeginRendering = nullptr;
+	PFN_vkCmdEndRenderingKHR m_vkCmdEndRendering = nullptr;
+	PFN_vkCmdSetPolygonModeEXT m_vkCmdSetPolygonMode = nullptr;
+	PFN_vkCmdSetCullModeEXT m_vkCmdSetCullMode = nullptr;
 
 private:
 	PhysicalDevice* m_pPhysicalDevice = nullptr;
@@ -78,6 +93,9 @@ private:
 
 	VkQueue m_graphicsQueue = VK_NULL_HANDLE;
 	VkQueue m_presentQueue = VK_NULL_HANDLE;
+	VkQueue m_computeQueue = VK_NULL_HANDLE;
+	uint32_t m_graphicsFamily = 0;
+	uint32_t m_computeFamily = 0;
 
 
 	void createLogicalDevice();
@@ -0,0 +1,115 @@
+#include "../VulkanRenderer.h"
+
+#include <algorithm>
+
+#include "DrawQueue.h"
+
+
+uint64_t DrawQueue::makeSortKey(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth)
+{
+	uint64_t quantisedDepth = static_cast<uint64_t>(std::clamp(depth, 0.0f, 1.0f) * 65535.0f);
+
+	return (static_cast<uint64_t>(pass & 0xF) << 60)
+		| (static_cast<uint64_t>(pipeline & 0xFFF) << 48)
+		| (static_cast<uint64_t>(material & 0xFFFF) << 32)
+		| (static_cast<uint64_t>(mesh & 0xFFFF) << 16)
+		| quantisedDepth;
+}
+
+void DrawQueue::sort()
+{
+	if (m_packets.size() < 2) return;
+
+	m_scratchPackets.resize(m_packets.size());
+
+	for (uint32_t shift = 0; shift < 64; shift += 8)
+	{
+		uint32_t counts[256] = {};
+		for (const sDrawPacket& packet : m_packets) counts[(packet.sortKey >> shift) & 0xFF]++;
+
+		// Every key has the same byte here, this pass wouldn't move anything
+		if (counts[(m_packets[0].sortKey >> shift) & 0xFF] == m_packets.size()) continue;
+
+		uint32_t offset = 0;
+		for (uint32_t& count : counts) {
+			uint32_t bucketSize = count;
+			count = offset;
+			offset += bucketSize;
+		}
+
+		for (const sDrawPacket& packet : m_packets) m_scratchPackets[counts[(packet.sortKey >> shift) & 0xFF]++] = packet;
+		m_packets.swap(m_scratchPackets);
+	}
+}
+
+std::span<const sDrawPacket> DrawQueue::getPassPackets(uint32_t pass)
+{
+	auto keyPass = [](const sDrawPacket& packet) { return static_cast<uint32_t>(packet.sortKey >> 60); };
+
+	auto first = std::partition_point(m_packets.begin(), m_packets.end(), [&](const sDrawPacket& packet) { return keyPass(packet) < pass; });
+	auto last = std::partition_point(first, m_packets.end(), [&](const sDrawPacket& packet) { return keyPass(packet) == pass; });
+	return std::span<const sDrawPacket>(first, last);
+}
+
+
+
+void DrawEncoder::begin(VkCommandBuffer commandBuffer)
+{
+	m_commandBuffer = commandBuffer;
+	m_boundPipeline = VK_NULL_HANDLE;
+	m_boundDescriptorSet = VK_NULL_HANDLE;
+	m_boundVertexBuffer = VK_NULL_HANDLE;
+	m_boundIndexBuffer = VK_NULL_HANDLE;
+}
+
+void DrawEncoder::bindPipeline(VkPipeline pipeline)
+{
+	if (pipeline == m_boundPipeline) {
+		m_stats.skippedBinds++;
+		return;
+	}
+
+	vkCmdBindPipeline(m_commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+	m_boundPipeline = pipeline;
+	m_stats.issuedBinds++;
+
+	// Descriptor sets stay bound across pipelines with compatible layouts, but there's only one layout to track so play it safe
+	m_boundDescriptorSet = VK_NULL_HANDLE;
+}
+
+void DrawEncoder::bindDescriptorSet(VkPipelineLayout pipelineLayout, VkDescriptorSet descriptorSet)
+{
+	if (descriptorSet == m_boundDescriptorSet) {
+		m_stats.skippedBinds++;
+		return;
+	}
+
+	vkCmdBindDescriptorSets(m_commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+	m_boundDescriptorSet = descriptorSet;
+	m_stats.issuedBinds++;
+}
+
+void DrawEncoder::bindVertexBuffer(VkBuffer vertexBuffer)
+{
+	if (vertexBuffer == m_boundVertexBuffer) {
+		m_stats.skippedBinds++;
+		return;
+	}
+
+	VkDeviceSize offsets[] = { 0 };
+	vkCmdBindVertexBuffers(m_commandBuffer, 0, 1, &vertexBuffer, offsets);
+	m_boundVertexBuffer = vertexBuffer;
+	m_stats.issuedBinds++;
+}
+
+void DrawEncoder::bindIndexBuffer(VkBuffer indexBuffer)
+{
+	if (indexBuffer == m_boundIndexBuffer) {
+		m_stats.skippedBinds++;
+		return;
+	}
+
+	vkCmdBindIndexBuffer(m_commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+	m_boundIndexBuffer = indexBuffer;
+	m_stats.issuedBinds++;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <vector>
+#include <span>
+#include <cstdint>
+
+
+struct sDrawPacket
+{
+	uint64_t sortKey;
+	uint32_t modelIndex; // Index into the loaded models
+};
+
+// Per frame list of draws, sorted by a 64 bit state key so draws sharing state end up next to each other.
+// Key layout, most significant bits first: pass (4) | pipeline (12) | material (16) | mesh (16) | depth (16)
+class DrawQueue
+{
+public:
+	static constexpr uint32_t PASS_MAIN = 0;
+	static constexpr uint32_t PASS_TRANSPARENT = 1; // Weighted blended, see WeightedBlendedOIT. Accumulated in any order, so they aren't depth sorted.
+
+	// Depth is normalised to [0, 1], nearer draws sort first within the same state.
+	static uint64_t makeSortKey(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth);
+
+	void clear() { m_packets.clear(); }
+	void push(uint64_t sortKey, uint32_t modelIndex) { m_packets.push_back({ sortKey, modelIndex }); }
+	// LSD radix sort, 8 bits per pass. Passes where every key shares the same byte are skipped.
+	void sort();
+
+	const std::vector<sDrawPacket>& getPackets() { return m_packets; }
+	// The sorted packets of a single pass, which sit next to each other since the pass is the key's top bits
+	std::span<const sDrawPacket> getPassPackets(uint32_t pass);
+
+private:
+	std::vector<sDrawPacket> m_packets = {};
+	std::vector<sDrawPacket> m_scratchPackets = {};
+};
+
+// Wraps the bind commands of a command buffer and drops the ones that would rebind the state already bound.
+// Tracking restarts at every begin(), so nothing is assumed to survive between render passes.
+class DrawEncoder
+{
+public:
+	struct sStats
+	{
+		uint32_t issuedBinds = 0;
+		uint32_t skippedBinds = 0;
+	};
+
+	void begin(VkCommandBuffer commandBuffer);
+
+	void bindPipeline(VkPipeline pipeline);
+	void bindDescriptorSet(VkPipelineLayout pipelineLayout, VkDescriptorSet descriptorSet);
+	void bindVertexBuffer(VkBuffer vertexBuffer);
+	void bindIndexBuffer(VkBuffer indexBuffer);
+
+	// Stats add up over every begin() until reset, i.e. over one recorded command buffer.
+	void resetStats() { m_stats = {}; }
+	sStats getStats() { return m_stats; }
+
+private:
+	VkCommandBuffer m_commandBuffer = VK_NULL_HANDLE;
+	VkPipeline m_boundPipeline = VK_NULL_HANDLE;
+	VkDescriptorSet m_boundDescriptorSet = VK_NULL_HANDLE;
+	VkBuffer m_boundVertexBuffer = VK_NULL_HANDLE;
+	VkBuffer m_boundIndexBuffer = VK_NULL_HANDLE;
+	sStats m_stats = {};
+};
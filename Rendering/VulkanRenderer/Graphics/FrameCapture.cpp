@@ -0,0 +1,179 @@
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#pragma warning(push, 0)
+#include <stb_image_write.h>
+#pragma warning(pop)
+
+#include "../VulkanRenderer.h"
+
+#include <filesystem>
+#include <fstream>
+
+#include "FrameCapture.h"
+
+
+
+FrameCapture::FrameCapture(uint32_t frameCount) : m_pUtilities(Utilities::getInstance()), m_pLogicalDevice(VulkanEngine::getInstance()->m_pLogicalDevice->getVkDevice()),
+	m_pBufferManager(VulkanEngine::getInstance()->m_pBufferManager), m_pDebugSettings(&VulkanEngine::getInstance()->m_settings->debugSettings), m_encoders(sm_encoderThreads)
+{
+	mDebugPrint(std::format("Creating frame capture, writing to \"{}\"...", m_pDebugSettings->captureDirectory));
+
+	m_readbacks.resize(frameCount);
+	std::filesystem::create_directories(m_pDebugSettings->captureDirectory);
+
+	// Cached memory makes reading the pixels back on the CPU much faster, it's only made coherent by the invalidate in collect
+	VkMemoryPropertyFlags cached = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+	m_memoryProperties = BufferManager::hasMemoryType(UINT32_MAX, cached) ? cached : VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+}
+
+
+bool FrameCapture::beginCapture(uint32_t frameIndex, VkFormat format, VkExtent2D extent)
+{
+	uint64_t frameNumber = m_frameNumber++;
+
+	bool requested = m_captureRequested.exchange(false);
+	uint32_t interval = m_pDebugSettings->captureInterval;
+	if (!requested && (interval == 0 || frameNumber % interval != 0)) return false;
+
+	sReadback& readback = m_readbacks[frameIndex];
+	if (readback.encode.valid() && readback.encode.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+		m_droppedFrames++;
+		return false;
+	}
+
+	ensureCapacity(readback, static_cast<VkDeviceSize>(extent.width) * extent.height * getBytesPerPixel(format));
+
+	readback.pending = true;
+	readback.frameNumber = frameNumber;
+	readback.format = format;
+	readback.extent = extent;
+	return true;
+}
+
+void FrameCapture::recordCopy(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkImage image)
+{
+	sReadback& readback = m_readbacks[frameIndex];
+
+	// Zero row length and height pack the rows tightly
+	VkBufferImageCopy region{
+		.bufferOffset = 0,
+		.bufferRowLength = 0,
+		.bufferImageHeight = 0,
+		.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+		.imageOffset = { 0, 0, 0 },
+		.imageExtent = { readback.extent.width, readback.extent.height, 1 }
+	};
+	vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback.buffer, 1, &region);
+
+	// Waiting on the timeline doesn't make the copy visible to the host by itself
+	VkBufferMemoryBarrier hostBarrier{
+		.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.buffer = readback.buffer,
+		.offset = 0,
+		.size = VK_WHOLE_SIZE
+	};
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &hostBarrier, 0, nullptr);
+}
+
+void FrameCapture::collect(uint32_t frameIndex)
+{
+	sReadback& readback = m_readbacks[frameIndex];
+	if (!readback.pending) return;
+
+	readback.pending = false;
+	m_capturedFrames++;
+
+	if (!(m_memoryProperties & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
+		VkMappedMemoryRange range{
+			.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+			.memory = readback.memory,
+			.offset = 0,
+			.size = VK_WHOLE_SIZE
+		};
+		vkInvalidateMappedMemoryRanges(*m_pLogicalDevice, 1, &range);
+	}
+
+	const uint8_t* pPixels = static_cast<const uint8_t*>(readback.pMapped);
+	readback.encode = m_encoders.enqueue([this, pPixels, format = readback.format, extent = readback.extent, frameNumber = readback.frameNumber]() {
+		encode(pPixels, format, extent, frameNumber);
+	});
+}
+
+void FrameCapture::ensureCapacity(sReadback& readback, VkDeviceSize size)
+{
+	if (readback.size >= size) return;
+
+	// Nothing else uses the buffer, so it can go straight away
+	if (readback.buffer != VK_NULL_HANDLE) {
+		vkDestroyBuffer(*m_pLogicalDevice, readback.buffer, nullptr);
+		vkFreeMemory(*m_pLogicalDevice, readback.memory, nullptr);
+	}
+
+	m_pBufferManager->createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, m_memoryProperties, readback.buffer, readback.memory);
+	vkMapMemory(*m_pLogicalDevice, readback.memory, 0, size, 0, &readback.pMapped);
+	readback.size = size;
+}
+
+void FrameCapture::encode(const uint8_t* pPixels, VkFormat format, VkExtent2D extent, uint64_t frameNumber)
+{
+	std::filesystem::path directory(m_pDebugSettings->captureDirectory);
+	size_t pixelCount = static_cast<size_t>(extent.width) * extent.height;
+
+	bool swizzle = format == VK_FORMAT_B8G8R8A8_SRGB || format == VK_FORMAT_B8G8R8A8_UNORM;
+	bool encodable = swizzle || format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_R8G8B8A8_UNORM;
+
+	if (m_pDebugSettings->captureRaw || !encodable) {
+		std::ofstream file(directory / std::format("frame_{:06}_{}x{}.raw", frameNumber, extent.width, extent.height), std::ios::binary);
+		file.write(reinterpret_cast<const char*>(pPixels), pixelCount * getBytesPerPixel(format));
+		return;
+	}
+
+	// PNGs are RGBA, and the frame is opaque whatever ended up in the swapchain's alpha
+	std::vector<uint8_t> rgba(pixelCount * 4);
+	for (size_t i = 0; i < pixelCount; i++) {
+		const uint8_t* pSource = pPixels + i * 4;
+		uint8_t* pDestination = rgba.data() + i * 4;
+		pDestination[0] = swizzle ? pSource[2] : pSource[0];
+		pDestination[1] = pSource[1];
+		pDestination[2] = swizzle ? pSource[0] : pSource[2];
+		pDestination[3] = 255;
+	}
+
+	std::string path = (directory / std::format("frame_{:06}.png", frameNumber)).string();
+	if (stbi_write_png(path.c_str(), static_cast<int>(extent.width), static_cast<int>(extent.height), 4, rgba.data(), static_cast<int>(extent.width * 4)) == 0) {
+		mDebugPrint("Failed to write frame capture " + path);
+	}
+}
+
+uint32_t FrameCapture::getBytesPerPixel(VkFormat format)
+{
+	// Every other format a swapchain is likely to have, 8 or 10 bit colour, packs a pixel into 4 bytes
+	switch (format)
+	{
+	case VK_FORMAT_R16G16B16A16_SFLOAT:
+		return 8;
+	default:
+		return 4;
+	}
+}
+
+
+void FrameCapture::cleanup()
+{
+	for (uint32_t i = 0; i < m_readbacks.size(); i++) {
+		collect(i);
+	}
+
+	for (sReadback& readback : m_readbacks) {
+		if (readback.encode.valid()) readback.encode.wait();
+		if (readback.buffer == VK_NULL_HANDLE) continue;
+
+		vkDestroyBuffer(*m_pLogicalDevice, readback.buffer, nullptr);
+		vkFreeMemory(*m_pLogicalDevice, readback.memory, nullptr);
+	}
+
+	mDebugPrint(std::format("Captured {} frame(s), dropped {} while the encoders were busy.", m_capturedFrames, m_droppedFrames));
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <atomic>
+#include <future>
+#include <vector>
+#include <cstdint>
+
+#include "../Utilities/Utilities.h"
+#include "../Utilities/ThreadPool.h"
+
+
+class BufferManager;
+
+// Reads finished frames back from the swapchain image and writes them to disk without stalling the render thread. Each
+// frame context has its own host visible readback buffer the frame's image is copied into at the end of its command
+// buffer. The copy is picked up when the context comes round again, by which point its submission has finished, and
+// the encoding is left to a worker. A capture is dropped rather than waited for if the worker is still busy with the
+// context's last one. Raw captures are the image's rows tightly packed in the swapchain's format.
+class FrameCapture
+{
+public:
+	FrameCapture(uint32_t frameCount);
+
+	// Captures the next frame recorded, whatever the interval. Safe to call from any thread.
+	void requestCapture() { m_captureRequested = true; }
+
+	// Call once per recorded frame. Returns whether it's captured, in which case record the copy with recordCopy.
+	bool beginCapture(uint32_t frameIndex, VkFormat format, VkExtent2D extent);
+	// The render graph has the image as a transfer source
+	void recordCopy(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkImage image);
+	// Hands the capture the context recorded last time it was used to a worker, call after FrameContextRing::beginFrame
+	void collect(uint32_t frameIndex);
+
+	// Writes out the captures still waiting to be collected and waits for every worker, call once the device is idle
+	void cleanup();
+
+private:
+	struct sReadback
+	{
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+		void* pMapped = nullptr;
+
+		bool pending = false; // Copy recorded and not collected yet
+		uint64_t frameNumber = 0;
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		VkExtent2D extent = {};
+		std::future<void> encode = {}; // The buffer isn't copied to again until this is done with it
+	};
+
+	static constexpr uint32_t sm_encoderThreads = 2; // Separate from the engine's pool, a long encode mustn't hold up culling
+
+	Utilities* m_pUtilities = nullptr;
+	VkDevice* m_pLogicalDevice = nullptr;
+	BufferManager* m_pBufferManager = nullptr;
+	sSettings::sDebugSettings* m_pDebugSettings = nullptr;
+
+	ThreadPool m_encoders;
+	std::vector<sReadback> m_readbacks = {}; // One per frame context
+	VkMemoryPropertyFlags m_memoryProperties = 0;
+
+	std::atomic<bool> m_captureRequested = false;
+	uint64_t m_frameNumber = 0;
+	uint32_t m_capturedFrames = 0;
+	uint32_t m_droppedFrames = 0;
+
+
+	// Grows the readback buffer to fit, the context's last copy and encode have finished by the time this is called
+	void ensureCapacity(sReadback& readback, VkDeviceSize size);
+	// Runs on a worker, the pixels are the readback buffer's mapped memory
+	void encode(const uint8_t* pPixels, VkFormat format, VkExtent2D extent, uint64_t frameNumber);
+
+	static uint32_t getBytesPerPixel(VkFormat format);
+};
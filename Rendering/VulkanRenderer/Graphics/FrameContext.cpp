@@ -0,0 +1,114 @@
+#include "../VulkanRenderer.h"
+#include "Buffers.h"
+#include "GpuTimeline.h"
+
+#include "FrameContext.h"
+
+
+FrameContextRing::FrameContextRing(uint32_t frameCount) : m_pUtilities(Utilities::getInstance()), m_pLogicalDevice(VulkanEngine::getInstance()->m_pLogicalDevice->getVkDevice()),
+	m_pBufferManager(VulkanEngine::getInstance()->m_pBufferManager), m_pGpuTimeline(VulkanEngine::getInstance()->m_pGpuTimeline)
+{
+	mDebugPrint(std::format("Creating {} frame context(s)...", frameCount));
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(*VulkanEngine::getInstance()->m_pVkPhysicalDevice, &properties);
+	VkDeviceSize alignment = properties.limits.minUniformBufferOffsetAlignment;
+	m_uniformSlotStride = (sizeof(UniformBufferObject::sUniformBufferObject) + alignment - 1) / alignment * alignment;
+
+	m_contexts.resize(frameCount);
+	for (uint32_t i = 0; i < frameCount; i++) {
+		m_contexts[i].index = i;
+		createContext(m_contexts[i]);
+	}
+
+	m_activeFrameCount = frameCount;
+	m_currentIndex = frameCount - 1; // The first beginFrame() moves on to context 0
+}
+
+void FrameContextRing::createContext(sFrameContext& context)
+{
+	QueueFamilyIndices::sQueueFamilyIndices queueFamilyIndices = QueueFamilyIndices::findQueueFamilies(*VulkanEngine::getInstance()->m_pVkPhysicalDevice, *VulkanEngine::getInstance()->m_pVkSurface);
+
+	// Buffers are never reset one by one, the whole pool is reset when the context comes round again
+	VkCommandPoolCreateInfo poolInfo{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+		.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value()
+	};
+
+	if (vkCreateCommandPool(*m_pLogicalDevice, &poolInfo, nullptr, &context.commandPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create frame command pool!");
+	}
+
+	VkCommandBufferAllocateInfo allocInfo{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+		.commandPool = context.commandPool,
+		.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+		.commandBufferCount = 1
+	};
+
+	if (vkAllocateCommandBuffers(*m_pLogicalDevice, &allocInfo, &context.commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate frame command buffer!");
+	}
+
+	VkSemaphoreCreateInfo semaphoreInfo{
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO
+	};
+
+	if (vkCreateSemaphore(*m_pLogicalDevice, &semaphoreInfo, nullptr, &context.imageAvailableSemaphore) != VK_SUCCESS ||
+		vkCreateSemaphore(*m_pLogicalDevice, &semaphoreInfo, nullptr, &context.renderFinishedSemaphore) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create synchronization objects for a frame!");
+	}
+
+	VkDeviceSize uniformBufferSize = m_uniformSlotStride * sm_maxUniformSlots;
+	m_pBufferManager->createBuffer(uniformBufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		context.uniformBuffer, context.uniformBufferMemory);
+
+	void* pMapped;
+	vkMapMemory(*m_pLogicalDevice, context.uniformBufferMemory, 0, uniformBufferSize, 0, &pMapped);
+	context.pUniformBufferMapped = static_cast<uint8_t*>(pMapped);
+}
+
+sFrameContext& FrameContextRing::beginFrame(double& waitSeconds)
+{
+	m_currentIndex = (m_currentIndex + 1) % m_activeFrameCount;
+	sFrameContext& context = m_contexts[m_currentIndex];
+
+	double waitStart = glfwGetTime();
+	m_pGpuTimeline->wait(context.timelineValue);
+	waitSeconds = glfwGetTime() - waitStart;
+
+	vkResetCommandPool(*m_pLogicalDevice, context.commandPool, 0);
+
+	return context;
+}
+
+void FrameContextRing::setActiveFrameCount(uint32_t frameCount)
+{
+	m_activeFrameCount = std::clamp(frameCount, 1u, getFrameCount());
+	m_currentIndex = m_activeFrameCount - 1;
+}
+
+uint32_t FrameContextRing::allocateUniformSlot()
+{
+	if (m_uniformSlotCount == sm_maxUniformSlots) {
+		throw std::runtime_error("ran out of frame uniform slots!");
+	}
+
+	return m_uniformSlotCount++;
+}
+
+void FrameContextRing::cleanup()
+{
+	for (sFrameContext& context : m_contexts) {
+		vkDestroyBuffer(*m_pLogicalDevice, context.uniformBuffer, nullptr);
+		vkFreeMemory(*m_pLogicalDevice, context.uniformBufferMemory, nullptr);
+
+		vkDestroySemaphore(*m_pLogicalDevice, context.renderFinishedSemaphore, nullptr);
+		vkDestroySemaphore(*m_pLogicalDevice, context.imageAvailableSemaphore, nullptr);
+
+		vkDestroyCommandPool(*m_pLogicalDevice, context.commandPool, nullptr);
+	}
+}
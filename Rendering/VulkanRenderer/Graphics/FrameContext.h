@@ -0,0 +1,74 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <vector>
+#include <cstdint>
+
+#include "../Utilities/Utilities.h"
+
+
+class BufferManager;
+class GpuTimeline;
+
+// Everything the CPU writes or records for one frame in flight. All of it is indexed by the same frame index, so a frame
+// never touches what the GPU may still be reading for another one.
+struct sFrameContext
+{
+	uint32_t index = 0;
+
+	VkCommandPool commandPool = VK_NULL_HANDLE; // Reset as a whole when the context is reused
+	VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+
+	VkSemaphore imageAvailableSemaphore = VK_NULL_HANDLE;
+	VkSemaphore renderFinishedSemaphore = VK_NULL_HANDLE;
+	uint64_t timelineValue = 0; // Signalled by the context's last submission, 0 counts as reached from the start
+
+	// One slot of model uniforms per model, see FrameContextRing::getUniformSlot
+	VkBuffer uniformBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory uniformBufferMemory = VK_NULL_HANDLE;
+	uint8_t* pUniformBufferMapped = nullptr;
+};
+
+// Ring of frame contexts, one per frame in flight. beginFrame() moves on to the next context and waits on the GPU timeline
+// until the frame that last used it has finished, which is the only point the CPU ever waits on the GPU while rendering.
+class FrameContextRing
+{
+public:
+	static constexpr uint32_t sm_maxUniformSlots = 4096;
+
+	FrameContextRing(uint32_t frameCount);
+
+	// Returns the next context once it's free to reuse, and how long that took
+	sFrameContext& beginFrame(double& waitSeconds);
+	sFrameContext& getCurrent() { return m_contexts[m_currentIndex]; }
+	sFrameContext& getContext(uint32_t index) { return m_contexts[index]; }
+	uint32_t getFrameCount() { return static_cast<uint32_t>(m_contexts.size()); }
+
+	// Cycling through fewer contexts than were created limits how far the CPU gets ahead, see Window::benchmarkFramesInFlight
+	void setActiveFrameCount(uint32_t frameCount);
+
+	// Reserves a uniform slot in every context, the slot index stays valid for the ring's lifetime
+	uint32_t allocateUniformSlot();
+	VkDeviceSize getUniformSlotOffset(uint32_t slot) { return slot * m_uniformSlotStride; }
+	void* getUniformSlot(uint32_t frameIndex, uint32_t slot) { return m_contexts[frameIndex].pUniformBufferMapped + getUniformSlotOffset(slot); }
+
+	void cleanup();
+
+private:
+	Utilities* m_pUtilities = nullptr;
+	VkDevice* m_pLogicalDevice = nullptr;
+	BufferManager* m_pBufferManager = nullptr;
+	GpuTimeline* m_pGpuTimeline = nullptr;
+
+	std::vector<sFrameContext> m_contexts = {};
+	uint32_t m_currentIndex = 0;
+	uint32_t m_activeFrameCount = 0;
+
+	VkDeviceSize m_uniformSlotStride = 0; // Uniform size rounded up to the device's offset alignment
+	uint32_t m_uniformSlotCount = 0;
+
+
+	void createContext(sFrameContext& context);
+};
@@ -0,0 +1,65 @@
+#include "../VulkanRenderer.h"
+
+#include "GpuTimeline.h"
+
+
+GpuTimeline::GpuTimeline() : m_pUtilities(Utilities::getInstance()), m_pLogicalDevice(VulkanEngine::getInstance()->m_pLogicalDevice->getVkDevice())
+{
+	mDebugPrint("Creating GPU timeline...");
+
+	VkSemaphoreTypeCreateInfo timelineInfo{
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+		.pNext = nullptr,
+		.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+		.initialValue = 0
+	};
+
+	VkSemaphoreCreateInfo semaphoreInfo{
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+		.pNext = &timelineInfo
+	};
+
+	if (vkCreateSemaphore(*m_pLogicalDevice, &semaphoreInfo, nullptr, &m_semaphore) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create timeline semaphore!");
+	}
+}
+
+bool GpuTimeline::isComplete(uint64_t value)
+{
+	if (value <= m_completedValue) return true;
+
+	return value <= getCompletedValue();
+}
+
+uint64_t GpuTimeline::getCompletedValue()
+{
+	if (vkGetSemaphoreCounterValue(*m_pLogicalDevice, m_semaphore, &m_completedValue) != VK_SUCCESS) {
+		throw std::runtime_error("failed to query timeline semaphore!");
+	}
+
+	return m_completedValue;
+}
+
+void GpuTimeline::wait(uint64_t value)
+{
+	if (isComplete(value)) return;
+
+	VkSemaphoreWaitInfo waitInfo{
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+		.flags = 0,
+		.semaphoreCount = 1,
+		.pSemaphores = &m_semaphore,
+		.pValues = &value
+	};
+
+	if (vkWaitSemaphores(*m_pLogicalDevice, &waitInfo, UINT64_MAX) != VK_SUCCESS) {
+		throw std::runtime_error("failed to wait for timeline semaphore!");
+	}
+
+	m_completedValue = std::max(m_completedValue, value);
+}
+
+void GpuTimeline::cleanup()
+{
+	vkDestroySemaphore(*m_pLogicalDevice, m_semaphore, nullptr);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+
+#include "../Utilities/Utilities.h"
+
+
+// A single timeline semaphore that every submission to the graphics queue signals with the next value.
+// Whatever needs to know whether the GPU is done with something keeps the value of the submission that used it and asks
+// isComplete(), so frames, uploads and recycled resources all share one counter instead of a fence each.
+class GpuTimeline
+{
+public:
+	GpuTimeline();
+
+	// Reserves the value the next submission signals. Values must be signalled in the order they were reserved.
+	uint64_t nextSubmissionValue() { return ++m_lastSubmittedValue; }
+	uint64_t getLastSubmittedValue() { return m_lastSubmittedValue; }
+
+	// Only queries the semaphore if the cached value isn't recent enough
+	bool isComplete(uint64_t value);
+	uint64_t getCompletedValue();
+	// Blocks until the GPU has signalled the value
+	void wait(uint64_t value);
+
+	VkSemaphore* getVkSemaphore() { return &m_semaphore; }
+
+	void cleanup();
+
+private:
+	Utilities* m_pUtilities = nullptr;
+	VkDevice* m_pLogicalDevice = nullptr;
+
+	VkSemaphore m_semaphore = VK_NULL_HANDLE;
+	uint64_t m_lastSubmittedValue = 0;
+	uint64_t m_completedValue = 0;
+};
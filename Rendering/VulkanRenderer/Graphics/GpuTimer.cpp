@@ -0,0 +1,80 @@
+#include "../VulkanRenderer.h"
+
+#include "GpuTimer.h"
+
+
+GpuTimer::GpuTimer(uint32_t frameCount) : m_pUtilities(Utilities::getInstance()), m_pLogicalDevice(VulkanEngine::getInstance()->m_pLogicalDevice->getVkDevice())
+{
+	VkPhysicalDevice physicalDevice = *VulkanEngine::getInstance()->m_pVkPhysicalDevice;
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+	uint32_t validBits = queueFamilies[VulkanEngine::getInstance()->m_pLogicalDevice->getGraphicsFamily()].timestampValidBits;
+	if (validBits == 0) {
+		mDebugPrint("The graphics queue doesn't support timestamps. GPU frame times won't be measured.");
+		return;
+	}
+
+	mDebugPrint("Creating GPU timer...");
+
+	m_nanosecondsPerTick = properties.limits.timestampPeriod;
+	m_timestampMask = validBits >= 64 ? UINT64_MAX : (1ull << validBits) - 1;
+	m_recorded.resize(frameCount, false);
+
+	VkQueryPoolCreateInfo poolInfo{
+		.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+		.queryType = VK_QUERY_TYPE_TIMESTAMP,
+		.queryCount = frameCount * 2
+	};
+
+	if (vkCreateQueryPool(*m_pLogicalDevice, &poolInfo, nullptr, &m_queryPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create timestamp query pool!");
+	}
+}
+
+void GpuTimer::begin(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+{
+	if (!isSupported()) return;
+
+	vkCmdResetQueryPool(commandBuffer, m_queryPool, frameIndex * 2, 2);
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_queryPool, frameIndex * 2);
+}
+
+void GpuTimer::end(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+{
+	if (!isSupported()) return;
+
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_queryPool, frameIndex * 2 + 1);
+	m_recorded[frameIndex] = true;
+}
+
+bool GpuTimer::collect(uint32_t frameIndex)
+{
+	if (!isSupported() || !m_recorded[frameIndex]) return false;
+
+	// The context's submission has finished, so this doesn't need VK_QUERY_RESULT_WAIT_BIT
+	std::array<uint64_t, 2> timestamps = {};
+	VkResult result = vkGetQueryPoolResults(*m_pLogicalDevice, m_queryPool, frameIndex * 2, 2, sizeof(timestamps), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+	if (result == VK_NOT_READY) return false;
+	if (result != VK_SUCCESS) {
+		throw std::runtime_error("failed to read timestamp queries!");
+	}
+
+	m_recorded[frameIndex] = false;
+
+	// Masked subtraction copes with the counter wrapping between the two
+	uint64_t ticks = (timestamps[1] - timestamps[0]) & m_timestampMask;
+	m_lastFrameMilliseconds = ticks * m_nanosecondsPerTick / 1000000.0;
+	return true;
+}
+
+void GpuTimer::cleanup()
+{
+	if (m_queryPool != VK_NULL_HANDLE) vkDestroyQueryPool(*m_pLogicalDevice, m_queryPool, nullptr);
+}
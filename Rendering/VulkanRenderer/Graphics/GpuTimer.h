@@ -0,0 +1,44 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <vector>
+#include <cstdint>
+
+#include "../Utilities/Utilities.h"
+
+
+// Measures how long the GPU spends on each frame's command buffer with a pair of timestamp queries per frame context.
+// Results are read when the context comes round again, by which point its submission has finished, so reading them
+// never waits. Devices whose graphics queue can't write timestamps report no timings.
+class GpuTimer
+{
+public:
+	GpuTimer(uint32_t frameCount);
+
+	bool isSupported() { return m_queryPool != VK_NULL_HANDLE; }
+
+	// Recorded first and last in the frame's command buffer, outside any render pass
+	void begin(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+	void end(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+	// Reads the timings the context recorded last time it was used, call after FrameContextRing::beginFrame.
+	// Returns false if it recorded none.
+	bool collect(uint32_t frameIndex);
+
+	// GPU time of the most recently collected frame
+	double getLastFrameMilliseconds() { return m_lastFrameMilliseconds; }
+
+	void cleanup();
+
+private:
+	Utilities* m_pUtilities = nullptr;
+	VkDevice* m_pLogicalDevice = nullptr;
+
+	VkQueryPool m_queryPool = VK_NULL_HANDLE; // Two queries per frame context, start and end
+	double m_nanosecondsPerTick = 1.0;
+	uint64_t m_timestampMask = UINT64_MAX; // Only the queue's valid bits are written
+
+	std::vector<bool> m_recorded = {}; // Whether the context's queries were written since they were last collected
+	double m_lastFrameMilliseconds = 0.0;
+};
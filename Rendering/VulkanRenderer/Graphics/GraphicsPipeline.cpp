@@ -1,5 +1,6 @@
 #include "../VulkanRenderer.h"
 #include "Buffers.h"
+#include "DeletionQueue.h"
 
 #include "GraphicsPipeline.h"
 
@@ -7,9 +8,15 @@
 GraphicsPipeline::GraphicsPipeline() : m_pLogicalDevice(VulkanEngine::getInstance()->m_pLogicalDevice->getVkDevice()), m_pPhysicalDevice(VulkanEngine::getInstance()->m_pPhysicalDevice->getVkPhysicalDevice()),
 m_pSwapchain(VulkanEngine::getInstance()->m_pSwapchain), m_pGraphicsSettings(&VulkanEngine::getInstance()->m_settings->graphicsSettings), m_pUtilities(Utilities::getInstance())
 {
-	m_msaaSamples = VulkanEngine::getInstance()->m_pPhysicalDevice->getMaxUsableSampleCount();
-
-	createRenderPass();
+	m_msaaSamples = chooseSampleCount();
+	m_depthResolveMode = chooseDepthResolveMode();
+	m_viewMask = m_pGraphicsSettings->multiview != eMultiview::NONE ? MultiviewTarget::sm_viewMask : 0;
+	m_transparency = m_pGraphicsSettings->orderIndependentTransparency;
+	m_vkCmdSetPolygonMode = VulkanEngine::getInstance()->m_pLogicalDevice->m_vkCmdSetPolygonMode;
+	m_vkCmdSetCullMode = VulkanEngine::getInstance()->m_pLogicalDevice->m_vkCmdSetCullMode;
+
+	// Dynamic rendering passes the attachments when recording, see CommandBuffer::beginRenderPass
+	if (!m_pGraphicsSettings->dynamicRendering) createRenderPass();
 	createDescriptorSetLayout();
 	createGraphicsPipeline();
 };
@@ -18,74 +25,217 @@ void GraphicsPipeline::createRenderPass()
 {
 	mDebugPrint("Creating render pass...");
 
-	// Attachment setup
-	VkAttachmentDescription colorAttachment{
-		.format = *m_pSwapchain->getSwapchainImageFormat(),
-		.samples = VK_SAMPLE_COUNT_1_BIT,
+	// Layout changes and synchronisation around the pass are done by the render graph, so attachments start and end in the
+	// layout the subpass uses and there are no external dependencies.
+	// With MSAA the subpass draws to multisampled attachments and resolves them into the swapchain image and, for the depth
+	// pyramid, the depth buffer. Without it, it draws straight to those two.
+	bool msaa = m_msaaSamples != VK_SAMPLE_COUNT_1_BIT;
+	bool hiZ = m_pGraphicsSettings->occlusionCulling == eOcclusionCulling::HIERARCHICAL_Z;
+	// Temporal AA builds motion vectors from the depth the frame finishes with and transparent models are tested against it,
+	// neither with MSAA
+	bool keepDepth = m_pGraphicsSettings->temporalAA || m_transparency;
+
+	VkAttachmentDescription2 colorAttachment{
+		.sType = VK_STRUCTURE_TYPE_ATTACHMENT_DESCRIPTION_2,
+		.format = getColorFormat(),
+		.samples = m_msaaSamples,
 		.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-		.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+		.storeOp = msaa ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE, // Only the resolved colour is presented
 		.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
 		.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-		.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-		.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
+		.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+		.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
 	};
 
-	VkAttachmentDescription depthAttachment{
+	VkAttachmentDescription2 depthAttachment{
+		.sType = VK_STRUCTURE_TYPE_ATTACHMENT_DESCRIPTION_2,
 		.format = DepthBuffer::findDepthFormat(m_pPhysicalDevice),
-		.samples = VK_SAMPLE_COUNT_1_BIT,
+		.samples = m_msaaSamples,
 		.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-		.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE, // We don't need the depth buffer after drawing has finished
+		.storeOp = keepDepth ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE, // Otherwise we don't need the depth buffer after drawing has finished
 		.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
 		.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-		.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+		.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
 		.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
 	};
 
+	// Resolve attachments are written whole, what was in them before doesn't matter
+	VkAttachmentDescription2 colorResolveAttachment = colorAttachment;
+	colorResolveAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	colorResolveAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	colorResolveAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+
+	VkAttachmentDescription2 depthResolveAttachment = depthAttachment;
+	depthResolveAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	depthResolveAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	depthResolveAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+
+	// With occlusion culling this pass only draws what was visible last frame, its depth is kept for building the depth pyramid
+	// and the occlusion render pass finishes the frame on top of it. The multisampled attachments have to be kept for that too,
+	// while the resolved colour is only stored by the occlusion render pass.
+	if (hiZ) {
+		depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		colorResolveAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	}
+
 	// Attachment reference
-	VkAttachmentReference colorAttachmentRef{
+	VkAttachmentReference2 colorAttachmentRef{
+		.sType = VK_STRUCTURE_TYPE_ATTACHMENT_REFERENCE_2,
 		.attachment = 0,
-		.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+		.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+		.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT
 	};
 
-	VkAttachmentReference depthAttachmentRef{
+	VkAttachmentReference2 depthAttachmentRef{
+		.sType = VK_STRUCTURE_TYPE_ATTACHMENT_REFERENCE_2,
 		.attachment = 1,
-		.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+		.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+		.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT
 	};
 
-	// Subpass
-	VkSubpassDescription subpass{
+	VkAttachmentReference2 colorResolveAttachmentRef = colorAttachmentRef;
+	colorResolveAttachmentRef.attachment = 2;
+
+	VkAttachmentReference2 depthResolveAttachmentRef = depthAttachmentRef;
+	depthResolveAttachmentRef.attachment = 3;
+
+	// Only needed when the depth pyramid reads the resolved depth
+	VkSubpassDescriptionDepthStencilResolve depthResolve{
+		.sType = VK_STRUCTURE_TYPE_SUBPASS_DESCRIPTION_DEPTH_STENCIL_RESOLVE,
+		.depthResolveMode = m_depthResolveMode,
+		.stencilResolveMode = VK_RESOLVE_MODE_NONE,
+		.pDepthStencilResolveAttachment = &depthResolveAttachmentRef
+	};
+
+	// Subpass, with multiview it draws every view into its own layer of the attachments
+	VkSubpassDescription2 subpass{
+		.sType = VK_STRUCTURE_TYPE_SUBPASS_DESCRIPTION_2,
+		.pNext = msaa && hiZ ? &depthResolve : nullptr,
 		.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+		.viewMask = m_viewMask,
 		.colorAttachmentCount = 1,
 		.pColorAttachments = &colorAttachmentRef,
+		.pResolveAttachments = msaa ? &colorResolveAttachmentRef : nullptr,
 		.pDepthStencilAttachment = &depthAttachmentRef
 	};
 
-	// Subpass dependency
-	VkSubpassDependency dependency{
-		.srcSubpass = VK_SUBPASS_EXTERNAL,
-		.dstSubpass = 0,
-		.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
-		.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
-		.srcAccessMask = 0,
-		.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT
-	};
+	// Render pass, attachments in the order Framebuffer::createFramebuffers gives the views
+	std::vector<VkAttachmentDescription2> attachments = { colorAttachment, depthAttachment };
+	if (msaa) attachments.push_back(colorResolveAttachment);
+	if (msaa && hiZ) attachments.push_back(depthResolveAttachment);
+
+	// Stereo eyes see nearly the same thing, which lets the implementation share work between them. Split-screen views don't.
+	uint32_t correlatedViewMask = m_viewMask;
+	bool correlated = m_pGraphicsSettings->multiview == eMultiview::STEREO;
 
-	// Render pass
-	std::array<VkAttachmentDescription, 2> attachments = { colorAttachment, depthAttachment };
-	VkRenderPassCreateInfo renderPassInfo{
-		.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+	VkRenderPassCreateInfo2 renderPassInfo{
+		.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO_2,
 		.attachmentCount = static_cast<uint32_t>(attachments.size()),
 		.pAttachments = attachments.data(),
 		.subpassCount = 1,
 		.pSubpasses = &subpass,
-		.dependencyCount = 1,
-		.pDependencies = &dependency
+		.dependencyCount = 0,
+		.pDependencies = nullptr,
+		.correlatedViewMaskCount = correlated ? 1u : 0u,
+		.pCorrelatedViewMasks = correlated ? &correlatedViewMask : nullptr
 	};
 
-	if (vkCreateRenderPass(*m_pLogicalDevice, &renderPassInfo, nullptr, &m_renderPass) != VK_SUCCESS) {
+	if (vkCreateRenderPass2(*m_pLogicalDevice, &renderPassInfo, nullptr, &m_renderPass) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create render pass!");
 	}
 
+	if (m_transparency) {
+		mDebugPrint("Creating transparent render pass...");
+
+		// Accumulation cleared to nothing and revealage to fully revealed, then blended into. The depth is the finished
+		// frame's, only tested against. Never with MSAA or multiview.
+		std::array<VkAttachmentDescription2, 3> transparentAttachments{
+			VkAttachmentDescription2{
+				.sType = VK_STRUCTURE_TYPE_ATTACHMENT_DESCRIPTION_2,
+				.format = WeightedBlendedOIT::sm_accumulationFormat,
+				.samples = VK_SAMPLE_COUNT_1_BIT,
+				.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+				.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+				.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+				.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+				.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+				.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+			},
+			VkAttachmentDescription2{
+				.sType = VK_STRUCTURE_TYPE_ATTACHMENT_DESCRIPTION_2,
+				.format = WeightedBlendedOIT::sm_revealageFormat,
+				.samples = VK_SAMPLE_COUNT_1_BIT,
+				.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+				.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+				.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+				.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+				.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+				.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+			},
+			VkAttachmentDescription2{
+				.sType = VK_STRUCTURE_TYPE_ATTACHMENT_DESCRIPTION_2,
+				.format = depthAttachment.format,
+				.samples = VK_SAMPLE_COUNT_1_BIT,
+				.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD,
+				.storeOp = VK_ATTACHMENT_STORE_OP_STORE, // Nothing is written, but temporal AA reads it afterwards
+				.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+				.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+				.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+				.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+			}
+		};
+
+		std::array<VkAttachmentReference2, 2> transparentColorRefs = { colorAttachmentRef, colorAttachmentRef };
+		transparentColorRefs[1].attachment = 1;
+
+		VkAttachmentReference2 transparentDepthRef = depthAttachmentRef;
+		transparentDepthRef.attachment = 2;
+		transparentDepthRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+		VkSubpassDescription2 transparentSubpass{
+			.sType = VK_STRUCTURE_TYPE_SUBPASS_DESCRIPTION_2,
+			.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+			.viewMask = m_viewMask,
+			.colorAttachmentCount = static_cast<uint32_t>(transparentColorRefs.size()),
+			.pColorAttachments = transparentColorRefs.data(),
+			.pDepthStencilAttachment = &transparentDepthRef
+		};
+
+		VkRenderPassCreateInfo2 transparentRenderPassInfo{
+			.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO_2,
+			.attachmentCount = static_cast<uint32_t>(transparentAttachments.size()),
+			.pAttachments = transparentAttachments.data(),
+			.subpassCount = 1,
+			.pSubpasses = &transparentSubpass,
+			.dependencyCount = 0,
+			.pDependencies = nullptr
+		};
+
+		if (vkCreateRenderPass2(*m_pLogicalDevice, &transparentRenderPassInfo, nullptr, &m_transparentRenderPass) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create transparent render pass!");
+		}
+	}
+
+	if (!hiZ) return;
+
+
+	mDebugPrint("Creating occlusion render pass...");
+
+	// Same attachments, loaded instead of cleared. Both passes use the same framebuffers, which needs the same resolve
+	// attachments, so each pass resolves both and only stores the one that's used afterwards.
+	attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+	attachments[0].storeOp = msaa ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
+	attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+	attachments[1].storeOp = keepDepth ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	if (msaa) {
+		attachments[2].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		attachments[3].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	}
+
+	if (vkCreateRenderPass2(*m_pLogicalDevice, &renderPassInfo, nullptr, &m_occlusionRenderPass) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create occlusion render pass!");
+	}
 
 }
 
@@ -131,68 +281,228 @@ void GraphicsPipeline::createDescriptorSetLayout()
 	if (vkCreateDescriptorSetLayout(*m_pLogicalDevice, &layoutInfo, nullptr, &m_descriptorSetLayout) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create descriptor set layouts!");
 	}
+
+	// Set 1, the light clusters: parameters, lights and cluster lists. Written by the light binning pass, read when shading.
+	mDebugPrint("Creating light cluster descriptor set layout...");
+	std::array<VkDescriptorSetLayoutBinding, 3> lightBindings{};
+	for (uint32_t i = 0; i < lightBindings.size(); i++) {
+		lightBindings[i] = VkDescriptorSetLayoutBinding{
+			.binding = i,
+			.descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+			.pImmutableSamplers = nullptr
+		};
+	}
+
+	VkDescriptorSetLayoutCreateInfo lightLayoutInfo{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.bindingCount = static_cast<uint32_t>(lightBindings.size()),
+		.pBindings = lightBindings.data()
+	};
+
+	if (vkCreateDescriptorSetLayout(*m_pLogicalDevice, &lightLayoutInfo, nullptr, &m_lightSetLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create light cluster descriptor set layout!");
+	}
+
+	// Set 2, the sun's shadow cascades: their matrices and splits, and the cascade array
+	mDebugPrint("Creating shadow descriptor set layout...");
+	std::array<VkDescriptorSetLayoutBinding, 2> shadowBindings{
+		VkDescriptorSetLayoutBinding{
+			.binding = 0,
+			.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+			.pImmutableSamplers = nullptr
+		},
+		VkDescriptorSetLayoutBinding{
+			.binding = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+			.pImmutableSamplers = nullptr
+		}
+	};
+
+	VkDescriptorSetLayoutCreateInfo shadowLayoutInfo{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.bindingCount = static_cast<uint32_t>(shadowBindings.size()),
+		.pBindings = shadowBindings.data()
+	};
+
+	if (vkCreateDescriptorSetLayout(*m_pLogicalDevice, &shadowLayoutInfo, nullptr, &m_shadowSetLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create shadow descriptor set layout!");
+	}
 }
 
 void GraphicsPipeline::createGraphicsPipeline()
 {
 	mDebugPrint("Creating graphics pipeline layout...");
 
-	mDebugPrint("Creating shader stages...");
+	std::array<VkDescriptorSetLayout, 3> setLayouts = { m_descriptorSetLayout, m_lightSetLayout, m_shadowSetLayout };
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.setLayoutCount = static_cast<uint32_t>(setLayouts.size()),
+		.pSetLayouts = setLayouts.data(),
+		.pushConstantRangeCount = 0, // Optional 
+		.pPushConstantRanges = nullptr // Optional
+	};
+
+	if (vkCreatePipelineLayout(*m_pLogicalDevice, &pipelineLayoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create pipeline layout!");
+	}
+
+	m_pVariantCache = new PipelineVariantCache(m_pLogicalDevice, [this](const sPipelineKey& key) { return buildPipeline(key); });
+	if (m_pGraphicsSettings->graphicsPipelineLibrary) {
+		m_pVariantCache->setFastLinker([this](const sPipelineKey& key) { return linkPipeline(key, false); }, VulkanEngine::getInstance()->m_pDeletionQueue);
+	}
+	m_selectedKey = makePipelineKey(*m_pGraphicsSettings);
+	m_selectedPrepassKey = makeDepthPrepassKey(*m_pGraphicsSettings);
+	m_graphicsPipeline = m_pVariantCache->get(m_selectedKey);
+	m_depthPrepassPipeline = m_pVariantCache->get(m_selectedPrepassKey); // Vertex shader only, cheap enough to have ready for toggling
+	if (m_transparency) {
+		m_selectedTransparentKey = makeTransparentKey(*m_pGraphicsSettings);
+		m_transparentPipeline = m_pVariantCache->get(m_selectedTransparentKey);
+	}
+	m_activeKey = m_selectedKey;
+}
+
+sPipelineKey GraphicsPipeline::makePipelineKey(const sSettings::sGraphicsSettings& settings)
+{
+	sPipelineKey key{
+		.samples = m_msaaSamples,
+		.sampleShading = false, // MSAA shades once per pixel, only coverage and depth are per sample
+		.depthClamp = settings.rasterizerDepthClamp,
+		.blend = true,
+		.vertexLayout = 0,
+		.shaderSet = 0
+	};
 
-	std::vector<VkPipelineShaderStageCreateInfo> shaderStagesV;
-	for (int i = 0; i < Utilities::pCompiledVertShaders->size(); i++) {
-		auto vertShader = Utilities::pCompiledVertShaders->at(i);
+	// Set when recording instead, see recordDynamicState
+	if (!settings.extendedDynamicState) {
+		key.polygonMode = settings.wireframe ? VK_POLYGON_MODE_LINE : VK_POLYGON_MODE_FILL;
+		key.cullMode = settings.wireframe ? VK_CULL_MODE_NONE : VK_CULL_MODE_BACK_BIT;
+	}
 
-		auto vertShaderCode = m_pUtilities->readFile(vertShader);
-		VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
+	// The pre-pass has already written the nearest depth, so only the fragments matching it get shaded
+	if (settings.depthPrepass && !settings.wireframe) {
+		key.depthCompareOp = VK_COMPARE_OP_EQUAL;
+		key.depthWrite = false;
+	}
 
+	return key;
+}
 
-		VkPipelineShaderStageCreateInfo vertShaderStageInfo{
+sPipelineKey GraphicsPipeline::makeDepthPrepassKey(const sSettings::sGraphicsSettings& settings)
+{
+	// Has to rasterise exactly like the main variant, the pre-pass is never used in wireframe so polygon and cull mode
+	// are always the solid ones (and set dynamically to those with extended dynamic state)
+	return sPipelineKey{
+		.samples = m_msaaSamples,
+		.sampleShading = false,
+		.depthClamp = settings.rasterizerDepthClamp,
+		.blend = false,
+		.depthOnly = true,
+		.vertexLayout = 1,
+		.shaderSet = 0
+	};
+}
+
+sPipelineKey GraphicsPipeline::makeTransparentKey(const sSettings::sGraphicsSettings& settings)
+{
+	// Rasterises like the main variant, but blends into the accumulation targets behind whatever depth the opaque models
+	// left, pre-pass or not
+	sPipelineKey key = makePipelineKey(settings);
+	key.blend = true;
+	key.depthCompareOp = VK_COMPARE_OP_LESS;
+	key.depthWrite = false;
+	key.transparent = true;
+	return key;
+}
+
+// Create infos for every part of a graphics pipeline, filled in from a variant key. They point at each other, so a
+// description stays where it was filled in until the pipeline has been created.
+struct GraphicsPipeline::sPipelineDescription
+{
+	std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages = {}; // Vertex, fragment
+	VkVertexInputBindingDescription bindingDescription = {};
+	std::vector<VkVertexInputAttributeDescription> attributeDescriptions = {};
+	VkPipelineVertexInputStateCreateInfo vertexInput = {};
+	VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+	VkPipelineViewportStateCreateInfo viewportState = {};
+	VkPipelineRasterizationStateCreateInfo rasterizer = {};
+	VkPipelineMultisampleStateCreateInfo multisampling = {};
+	VkPipelineDepthStencilStateCreateInfo depthStencil = {};
+	std::array<VkPipelineColorBlendAttachmentState, 2> colorBlendAttachments = {}; // The second is only used when transparent
+	VkPipelineColorBlendStateCreateInfo colorBlending = {};
+	std::vector<VkDynamicState> dynamicStates = {};
+	VkPipelineDynamicStateCreateInfo dynamicState = {};
+	std::array<VkFormat, 2> colorFormats = {};
+	VkPipelineRenderingCreateInfoKHR renderingInfo = {};
+	VkSpecializationMapEntry specializationEntry = {};
+	VkBool32 weightedBlended = VK_FALSE;
+	VkSpecializationInfo specializationInfo = {};
+};
+
+void GraphicsPipeline::describePipeline(const sPipelineKey& key, VkShaderStageFlags shaderStages, sPipelineDescription& description)
+{
+	// Only the stages asked for are loaded, the other entries keep a null module. Depth only variants have no fragment stage.
+	if (shaderStages & VK_SHADER_STAGE_VERTEX_BIT) {
+		description.shaderStages[0] = {
 			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
 			.stage = VK_SHADER_STAGE_VERTEX_BIT,
-			.module = vertShaderModule,
+			.module = key.depthOnly ? loadShaderModule(*m_pLogicalDevice, "depthPrepass.vert") : createShaderModule(m_pUtilities->readFile(Utilities::pCompiledVertShaders->at(key.shaderSet))),
 			.pName = "main"
 		};
-
-		shaderStagesV.push_back(vertShaderStageInfo);
 	}
 
-	for (int i = 0; i < Utilities::pCompiledFragShaders->size(); i++) {
-		auto fragShader = Utilities::pCompiledFragShaders->at(i);
-
-		auto fragShaderCode = m_pUtilities->readFile(fragShader);
-		VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
+	if (shaderStages & VK_SHADER_STAGE_FRAGMENT_BIT && !key.depthOnly) {
+		// WEIGHTED_BLENDED in fragBase.frag
+		description.weightedBlended = key.transparent ? VK_TRUE : VK_FALSE;
+		description.specializationEntry = { .constantID = 0, .offset = 0, .size = sizeof(VkBool32) };
+		description.specializationInfo = {
+			.mapEntryCount = 1,
+			.pMapEntries = &description.specializationEntry,
+			.dataSize = sizeof(VkBool32),
+			.pData = &description.weightedBlended
+		};
 
-		VkPipelineShaderStageCreateInfo fragShaderStageInfo{
+		description.shaderStages[1] = {
 			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
 			.stage = VK_SHADER_STAGE_FRAGMENT_BIT,
-			.module = fragShaderModule,
-			.pName = "main"
+			.module = createShaderModule(m_pUtilities->readFile(Utilities::pCompiledFragShaders->at(key.shaderSet))),
+			.pName = "main",
+			.pSpecializationInfo = &description.specializationInfo
 		};
-		shaderStagesV.push_back(fragShaderStageInfo);
 	}
 
+	if (key.vertexLayout == 1) {
+		auto attributeDescriptions = Vertex::getPositionAttributeDescriptions();
+		description.bindingDescription = Vertex::getPositionBindingDescription();
+		description.attributeDescriptions.assign(attributeDescriptions.begin(), attributeDescriptions.end());
+	}
+	else {
+		auto attributeDescriptions = Vertex::getAttributeDescriptions();
+		description.bindingDescription = Vertex::getBindingDescription();
+		description.attributeDescriptions.assign(attributeDescriptions.begin(), attributeDescriptions.end());
+	}
 
-	VkPipelineShaderStageCreateInfo* shaderStages = &shaderStagesV[0];
-	auto bindingDescription = Vertex::getBindingDescription();
-	auto attributeDescriptions = Vertex::getAttributeDescriptions();
-
-	VkPipelineVertexInputStateCreateInfo vertexInputInfo{
+	description.vertexInput = {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
 		.vertexBindingDescriptionCount = 1,
-		.pVertexBindingDescriptions = &bindingDescription,
-		.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size()),
-		.pVertexAttributeDescriptions = attributeDescriptions.data()
+		.pVertexBindingDescriptions = &description.bindingDescription,
+		.vertexAttributeDescriptionCount = static_cast<uint32_t>(description.attributeDescriptions.size()),
+		.pVertexAttributeDescriptions = description.attributeDescriptions.data()
 	};
 
-	VkPipelineInputAssemblyStateCreateInfo inputAssembly{
+	description.inputAssembly = {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
 		.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
 		.primitiveRestartEnable = VK_FALSE
 	};
 
-	mDebugPrint("Creating viewport state...");
-	VkPipelineViewportStateCreateInfo viewportState{
+	description.viewportState = {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
 		.viewportCount = 1,
 		.pViewports = nullptr, // Dynamic
@@ -200,42 +510,35 @@ void GraphicsPipeline::createGraphicsPipeline()
 		.pScissors = nullptr // Dynamic
 	};
 
-	mDebugPrint("Creating rasterizer...");
-	//Rasterizer
-	VkPipelineRasterizationStateCreateInfo rasterizer{
+	description.rasterizer = {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
-		.depthClampEnable = m_pGraphicsSettings->rasterizerDepthClamp,
+		.depthClampEnable = key.depthClamp,
 		.rasterizerDiscardEnable = VK_FALSE,
-		//rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-		//.cullMode = VK_CULL_MODE_BACK_BIT,
+		.polygonMode = key.polygonMode,
+		.cullMode = key.cullMode,
 		.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE,
 		.depthBiasEnable = VK_FALSE,
 		.depthBiasConstantFactor = 0.0f, // Optional
 		.depthBiasClamp = 0.0f, // Optional
 		.depthBiasSlopeFactor = 0.0f, // Optional
-		.lineWidth = m_pGraphicsSettings->wireframeThickness
+		.lineWidth = 1.0f // Dynamic
 	};
-	m_pGraphicsSettings->wireframe ? rasterizer.polygonMode = VK_POLYGON_MODE_LINE : rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-	m_pGraphicsSettings->wireframe ? rasterizer.cullMode = VK_CULL_MODE_NONE : rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
 
-	mDebugPrint("Creating multisampler...");
-	VkPipelineMultisampleStateCreateInfo multisampling{
+	description.multisampling = {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
-		//multisampling.sampleShadingEnable = VK_FALSE;
-		.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+		.rasterizationSamples = key.samples,
+		.sampleShadingEnable = key.sampleShading ? VK_TRUE : VK_FALSE,
 		.minSampleShading = 1.0f, // Optional
 		.pSampleMask = nullptr, // Optional
 		.alphaToCoverageEnable = VK_FALSE, // Optional
 		.alphaToOneEnable = VK_FALSE, // Optional
 	};
-	m_pGraphicsSettings->multisampling == true ? multisampling.sampleShadingEnable = VK_TRUE : multisampling.sampleShadingEnable = VK_FALSE;
 
-	mDebugPrint("Creating depth stencil...");
-	VkPipelineDepthStencilStateCreateInfo depthStencil{
+	description.depthStencil = {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
 		.depthTestEnable = VK_TRUE,
-		.depthWriteEnable = VK_TRUE,
-		.depthCompareOp = VK_COMPARE_OP_LESS,
+		.depthWriteEnable = key.depthWrite ? VK_TRUE : VK_FALSE,
+		.depthCompareOp = key.depthCompareOp,
 		.depthBoundsTestEnable = VK_FALSE,
 		.stencilTestEnable = VK_FALSE,
 		.front = {}, // Optional
@@ -244,114 +547,337 @@ void GraphicsPipeline::createGraphicsPipeline()
 		.maxDepthBounds = 1.0f // Optional
 	};
 
-	mDebugPrint("Creating color blender...");
-	VkPipelineColorBlendAttachmentState colorBlendAttachment{
-		.blendEnable = VK_TRUE,
+	description.colorBlendAttachments[0] = {
+		.blendEnable = key.blend ? VK_TRUE : VK_FALSE,
 		.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA,
 		.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
 		.colorBlendOp = VK_BLEND_OP_ADD,
 		.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
 		.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
 		.alphaBlendOp = VK_BLEND_OP_ADD,
-		.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT
+		.colorWriteMask = key.depthOnly ? 0u : VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT
 	};
-	/*
-	colorBlendAttachment.blendEnable = VK_FALSE;
-	colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE; // Optional
-	colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO; // Optional
-	colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD; // Optional
-	colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE; // Optional
-	colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO; // Optional
-	colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD; // Optional
-	*/
 
-	VkPipelineColorBlendStateCreateInfo colorBlending{
+	// Weighted blended: the accumulation adds up, the revealage is multiplied by what each surface lets through
+	if (key.transparent) {
+		description.colorBlendAttachments[0].srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+		description.colorBlendAttachments[0].dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+		description.colorBlendAttachments[0].dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+
+		description.colorBlendAttachments[1] = {
+			.blendEnable = VK_TRUE,
+			.srcColorBlendFactor = VK_BLEND_FACTOR_ZERO,
+			.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_COLOR,
+			.colorBlendOp = VK_BLEND_OP_ADD,
+			.srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
+			.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+			.alphaBlendOp = VK_BLEND_OP_ADD,
+			.colorWriteMask = VK_COLOR_COMPONENT_R_BIT
+		};
+	}
+
+	uint32_t colorAttachmentCount = key.transparent ? 2u : 1u;
+
+	description.colorBlending = {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
 		.logicOpEnable = VK_FALSE,
 		.logicOp = VK_LOGIC_OP_COPY, // Optional
-		.attachmentCount = 1,
-		.pAttachments = &colorBlendAttachment
+		.attachmentCount = colorAttachmentCount,
+		.pAttachments = description.colorBlendAttachments.data(),
+		.blendConstants = { 0.0f, 0.0f, 0.0f, 0.0f } // Optional
 	};
-	colorBlending.blendConstants[0] = 0.0f; // Optional
-	colorBlending.blendConstants[1] = 0.0f; // Optional
-	colorBlending.blendConstants[2] = 0.0f; // Optional
-	colorBlending.blendConstants[3] = 0.0f; // Optional
 
-
-	std::vector<VkDynamicState> dynamicStates = {
-	VK_DYNAMIC_STATE_VIEWPORT,
-	VK_DYNAMIC_STATE_SCISSOR
+	description.dynamicStates = {
+		VK_DYNAMIC_STATE_VIEWPORT,
+		VK_DYNAMIC_STATE_SCISSOR,
+		VK_DYNAMIC_STATE_LINE_WIDTH
 	};
+	if (m_pGraphicsSettings->extendedDynamicState) {
+		description.dynamicStates.push_back(VK_DYNAMIC_STATE_POLYGON_MODE_EXT);
+		description.dynamicStates.push_back(VK_DYNAMIC_STATE_CULL_MODE_EXT);
+	}
 
-	VkPipelineDynamicStateCreateInfo dynamicState{
+	description.dynamicState = {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
-		.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size()),
-		.pDynamicStates = dynamicStates.data()
+		.dynamicStateCount = static_cast<uint32_t>(description.dynamicStates.size()),
+		.pDynamicStates = description.dynamicStates.data()
 	};
 
-	VkPipelineLayoutCreateInfo pipelineLayoutInfo{
-		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-		.setLayoutCount = 1, // Optional
-		.pSetLayouts = &m_descriptorSetLayout,
-		.pushConstantRangeCount = 0, // Optional 
-		.pPushConstantRanges = nullptr // Optional
+	// Without a render pass the pipeline only needs to know the attachment formats
+	description.colorFormats = { getColorFormat(), VK_FORMAT_UNDEFINED };
+	if (key.transparent) description.colorFormats = { WeightedBlendedOIT::sm_accumulationFormat, WeightedBlendedOIT::sm_revealageFormat };
+
+	description.renderingInfo = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR,
+		.viewMask = m_viewMask,
+		.colorAttachmentCount = colorAttachmentCount,
+		.pColorAttachmentFormats = description.colorFormats.data(),
+		.depthAttachmentFormat = DepthBuffer::findDepthFormat(m_pPhysicalDevice),
+		.stencilAttachmentFormat = VK_FORMAT_UNDEFINED
 	};
+}
 
-	if (vkCreatePipelineLayout(*m_pLogicalDevice, &pipelineLayoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS) {
-		throw std::runtime_error("failed to create pipeline layout!");
+void GraphicsPipeline::destroyShaderModules(sPipelineDescription& description)
+{
+	for (const VkPipelineShaderStageCreateInfo& shaderStage : description.shaderStages) {
+		if (shaderStage.module != VK_NULL_HANDLE) vkDestroyShaderModule(*m_pLogicalDevice, shaderStage.module, nullptr);
 	}
+}
 
+VkPipeline GraphicsPipeline::buildPipeline(const sPipelineKey& key)
+{
+	// With pipeline libraries the optimised link is the slow path, the fast one is linkPipeline(key, false)
+	if (m_pGraphicsSettings->graphicsPipelineLibrary) return linkPipeline(key, true);
 
+	sPipelineDescription description;
+	describePipeline(key, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, description);
 
-	// Pipeline
-	mDebugPrint("Creating pipeline...");
 	VkGraphicsPipelineCreateInfo pipelineInfo{
 		.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-		.stageCount = 2,
-		.pStages = shaderStages,
-		.pVertexInputState = &vertexInputInfo,
-		.pInputAssemblyState = &inputAssembly,
-		//pTessellationState = nullptr, // Optional
-		.pViewportState = &viewportState,
-		.pRasterizationState = &rasterizer,
-		.pMultisampleState = &multisampling,
-		.pDepthStencilState = &depthStencil,
-		.pColorBlendState = &colorBlending,
-		.pDynamicState = &dynamicState,
-		// Fixed Functions
+		.pNext = m_pGraphicsSettings->dynamicRendering ? &description.renderingInfo : nullptr,
+		.stageCount = key.depthOnly ? 1u : static_cast<uint32_t>(description.shaderStages.size()),
+		.pStages = description.shaderStages.data(),
+		.pVertexInputState = &description.vertexInput,
+		.pInputAssemblyState = &description.inputAssembly,
+		.pViewportState = &description.viewportState,
+		.pRasterizationState = &description.rasterizer,
+		.pMultisampleState = &description.multisampling,
+		.pDepthStencilState = &description.depthStencil,
+		.pColorBlendState = &description.colorBlending,
+		.pDynamicState = &description.dynamicState,
 		.layout = m_pipelineLayout,
-		// Render Pass
-		.renderPass = m_renderPass,
+		.renderPass = key.transparent ? m_transparentRenderPass : m_renderPass,
 		.subpass = 0,
-		// Derivatives
 		.basePipelineHandle = VK_NULL_HANDLE, // Optional
 		.basePipelineIndex = -1 // Optional
 	};
 
-
-	if (vkCreateGraphicsPipelines(*m_pLogicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_graphicsPipeline) != VK_SUCCESS) {
+	VkPipeline pipeline;
+	if (vkCreateGraphicsPipelines(*m_pLogicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create graphics pipeline!");
 	}
 
-	for (auto shaderStage : shaderStagesV) {
-		vkDestroyShaderModule(*m_pLogicalDevice, shaderStage.module, nullptr);
+	destroyShaderModules(description);
+
+	return pipeline;
+}
+
+VkPipeline GraphicsPipeline::getPipelineLibrary(VkGraphicsPipelineLibraryFlagBitsEXT part, const sPipelineKey& key)
+{
+	// Libraries are shared by every variant that agrees on the fields their part uses, everything else is reset
+	sPipelineKey libraryKey{};
+	switch (part)
+	{
+	case VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT:
+		libraryKey.vertexLayout = key.vertexLayout;
+		break;
+	case VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT:
+		libraryKey.shaderSet = key.shaderSet;
+		libraryKey.depthOnly = key.depthOnly;
+		libraryKey.polygonMode = key.polygonMode;
+		libraryKey.cullMode = key.cullMode;
+		libraryKey.depthClamp = key.depthClamp;
+		libraryKey.transparent = key.transparent; // Has to be built against the same render pass as the other parts
+		break;
+	case VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT:
+		libraryKey.shaderSet = key.shaderSet;
+		libraryKey.depthOnly = key.depthOnly;
+		libraryKey.samples = key.samples;
+		libraryKey.sampleShading = key.sampleShading;
+		libraryKey.depthCompareOp = key.depthCompareOp;
+		libraryKey.depthWrite = key.depthWrite;
+		libraryKey.transparent = key.transparent;
+		break;
+	case VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT:
+		libraryKey.samples = key.samples;
+		libraryKey.sampleShading = key.sampleShading;
+		libraryKey.blend = key.blend;
+		libraryKey.depthOnly = key.depthOnly;
+		libraryKey.transparent = key.transparent;
+		break;
+	default:
+		throw std::runtime_error("unknown pipeline library part!");
 	}
+
+	// Optimised links run on the thread pool, the lock keeps them from compiling the same library twice
+	std::lock_guard<std::mutex> lock(m_libraryMutex);
+
+	auto it = m_pipelineLibraries.find({ part, libraryKey });
+	if (it != m_pipelineLibraries.end()) return it->second;
+
+	VkShaderStageFlags shaderStages = 0;
+	if (part == VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT) shaderStages = VK_SHADER_STAGE_VERTEX_BIT;
+	if (part == VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT && !libraryKey.depthOnly) shaderStages = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	sPipelineDescription description;
+	describePipeline(libraryKey, shaderStages, description);
+
+	VkGraphicsPipelineLibraryCreateInfoEXT libraryInfo{
+		.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT,
+		.pNext = m_pGraphicsSettings->dynamicRendering ? &description.renderingInfo : nullptr,
+		.flags = static_cast<VkGraphicsPipelineLibraryFlagsEXT>(part)
+	};
+
+	// Each part only reads the state it covers
+	VkGraphicsPipelineCreateInfo pipelineInfo{
+		.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+		.pNext = &libraryInfo,
+		.flags = VK_PIPELINE_CREATE_LIBRARY_BIT_KHR | VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT,
+		.stageCount = shaderStages != 0 ? 1u : 0u,
+		.pStages = shaderStages == VK_SHADER_STAGE_FRAGMENT_BIT ? &description.shaderStages[1] : &description.shaderStages[0],
+		.pVertexInputState = &description.vertexInput,
+		.pInputAssemblyState = &description.inputAssembly,
+		.pViewportState = &description.viewportState,
+		.pRasterizationState = &description.rasterizer,
+		.pMultisampleState = &description.multisampling,
+		.pDepthStencilState = &description.depthStencil,
+		.pColorBlendState = &description.colorBlending,
+		.pDynamicState = &description.dynamicState,
+		.layout = m_pipelineLayout,
+		.renderPass = libraryKey.transparent ? m_transparentRenderPass : m_renderPass,
+		.subpass = 0
+	};
+
+	VkPipeline library;
+	if (vkCreateGraphicsPipelines(*m_pLogicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &library) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create graphics pipeline library!");
+	}
+
+	destroyShaderModules(description);
+
+	m_pipelineLibraries[{ part, libraryKey }] = library;
+	return library;
 }
 
-void GraphicsPipeline::cleanup()
+VkPipeline GraphicsPipeline::linkPipeline(const sPipelineKey& key, bool optimise)
+{
+	std::array<VkPipeline, 4> libraries = {
+		getPipelineLibrary(VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT, key),
+		getPipelineLibrary(VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT, key),
+		getPipelineLibrary(VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT, key),
+		getPipelineLibrary(VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT, key)
+	};
+
+	VkPipelineLibraryCreateInfoKHR linkInfo{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR,
+		.libraryCount = static_cast<uint32_t>(libraries.size()),
+		.pLibraries = libraries.data()
+	};
+
+	// A link without optimisation only stitches the compiled parts together, cheap enough to do while recording a frame
+	VkGraphicsPipelineCreateInfo pipelineInfo{
+		.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+		.pNext = &linkInfo,
+		.flags = optimise ? static_cast<VkPipelineCreateFlags>(VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT) : 0u,
+		.layout = m_pipelineLayout
+	};
+
+	VkPipeline pipeline;
+	if (vkCreateGraphicsPipelines(*m_pLogicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+		throw std::runtime_error("failed to link graphics pipeline!");
+	}
+
+	return pipeline;
+}
+
+void GraphicsPipeline::prewarmVariants(ThreadPool* pThreadPool)
+{
+	// The variants a runtime settings toggle can switch to. With dynamic polygon and cull mode, wireframe doesn't need one
+	// unless the depth pre-pass is on.
+	std::vector<sPipelineKey> keys;
+
+	sSettings::sGraphicsSettings settings = *m_pGraphicsSettings;
+	settings.wireframe = !settings.wireframe;
+	keys.push_back(makePipelineKey(settings));
+
+	settings = *m_pGraphicsSettings;
+	settings.depthPrepass = !settings.depthPrepass;
+	keys.push_back(makePipelineKey(settings));
+
+	if (m_transparency) {
+		settings = *m_pGraphicsSettings;
+		settings.wireframe = !settings.wireframe;
+		keys.push_back(makeTransparentKey(settings));
+	}
+
+	m_pVariantCache->prewarm(pThreadPool, keys);
+}
+
+void GraphicsPipeline::selectVariant(ThreadPool* pThreadPool, const sSettings::sGraphicsSettings& settings)
+{
+	m_selectedKey = makePipelineKey(settings);
+	m_selectedPrepassKey = makeDepthPrepassKey(settings);
+	if (m_transparency) m_selectedTransparentKey = makeTransparentKey(settings);
+	m_pRequestThreadPool = pThreadPool;
+	swapToSelectedVariant();
+}
+
+void GraphicsPipeline::useVariant(const sSettings::sGraphicsSettings& settings)
+{
+	m_selectedKey = makePipelineKey(settings);
+	m_selectedPrepassKey = makeDepthPrepassKey(settings);
+	m_pRequestThreadPool = nullptr;
+
+	m_graphicsPipeline = m_pVariantCache->get(m_selectedKey);
+	m_depthPrepassPipeline = m_pVariantCache->get(m_selectedPrepassKey);
+	if (m_transparency) {
+		m_selectedTransparentKey = makeTransparentKey(settings);
+		m_transparentPipeline = m_pVariantCache->get(m_selectedTransparentKey);
+	}
+	m_activeKey = m_selectedKey;
+}
+
+bool GraphicsPipeline::swapToSelectedVariant()
+{
+	if (m_pRequestThreadPool == nullptr) return false;
+
+	// The pre-pass has to rasterise exactly like the main variant testing against it, so the two only ever swap together.
+	// The transparent variant goes with them so wireframe switches every model at once.
+	VkPipeline pipeline = m_pVariantCache->request(m_pRequestThreadPool, m_selectedKey);
+	VkPipeline prepassPipeline = m_pVariantCache->request(m_pRequestThreadPool, m_selectedPrepassKey);
+	VkPipeline transparentPipeline = m_transparency ? m_pVariantCache->request(m_pRequestThreadPool, m_selectedTransparentKey) : VK_NULL_HANDLE;
+	if (pipeline == VK_NULL_HANDLE || prepassPipeline == VK_NULL_HANDLE || (m_transparency && transparentPipeline == VK_NULL_HANDLE)) return false; // Still compiling
+
+	// A fast linked variant is replaced by its optimised version later on, so keep polling until then
+	bool optimised = m_pVariantCache->isOptimised(m_selectedKey) && m_pVariantCache->isOptimised(m_selectedPrepassKey) &&
+		(!m_transparency || m_pVariantCache->isOptimised(m_selectedTransparentKey));
+	if (optimised) m_pRequestThreadPool = nullptr;
+	if (pipeline == m_graphicsPipeline && prepassPipeline == m_depthPrepassPipeline && transparentPipeline == m_transparentPipeline) return false;
+
+	// The previous variant stays in the cache, so frames in flight can keep using it
+	m_graphicsPipeline = pipeline;
+	m_depthPrepassPipeline = prepassPipeline;
+	m_transparentPipeline = transparentPipeline;
+	m_activeKey = m_selectedKey;
+
+	mDebugPrint(std::format("Switched to {} pipeline variant {}.", optimised ? "optimised" : "fast linked", m_pVariantCache->getVariantId(m_selectedKey)));
+	return true;
+}
+
+void GraphicsPipeline::recordDynamicState(VkCommandBuffer commandBuffer)
 {
-	vkDestroyImageView(*m_pLogicalDevice, m_colorImageView, nullptr);
-	vkDestroyImage(*m_pLogicalDevice, m_colorImage, nullptr);
-	vkFreeMemory(*m_pLogicalDevice, m_colorImageMemory, nullptr);
+	vkCmdSetLineWidth(commandBuffer, m_pGraphicsSettings->wireframeThickness);
 
-	vkDestroyImageView(*m_pLogicalDevice, m_depthImageView, nullptr);
-	vkDestroyImage(*m_pLogicalDevice, m_depthImage, nullptr);
-	vkFreeMemory(*m_pLogicalDevice, m_depthImageMemory, nullptr);
+	if (!m_pGraphicsSettings->extendedDynamicState) return;
 
+	m_vkCmdSetPolygonMode(commandBuffer, m_pGraphicsSettings->wireframe ? VK_POLYGON_MODE_LINE : VK_POLYGON_MODE_FILL);
+	m_vkCmdSetCullMode(commandBuffer, m_pGraphicsSettings->wireframe ? VK_CULL_MODE_NONE : VK_CULL_MODE_BACK_BIT);
+}
+
+void GraphicsPipeline::cleanup()
+{
 	vkDestroyDescriptorSetLayout(*m_pLogicalDevice, m_descriptorSetLayout, nullptr);
-	vkDestroyPipeline(*m_pLogicalDevice, m_graphicsPipeline, nullptr);
+	vkDestroyDescriptorSetLayout(*m_pLogicalDevice, m_lightSetLayout, nullptr);
+	vkDestroyDescriptorSetLayout(*m_pLogicalDevice, m_shadowSetLayout, nullptr);
+	m_pVariantCache->cleanup(); // Owns m_graphicsPipeline, m_depthPrepassPipeline and m_transparentPipeline
+	delete m_pVariantCache;
+	for (auto& [key, library] : m_pipelineLibraries) {
+		vkDestroyPipeline(*m_pLogicalDevice, library, nullptr);
+	}
 	vkDestroyPipelineLayout(*m_pLogicalDevice, m_pipelineLayout, nullptr);
-	vkDestroyRenderPass(*m_pLogicalDevice, m_renderPass, nullptr);
+	if (m_renderPass != VK_NULL_HANDLE) vkDestroyRenderPass(*m_pLogicalDevice, m_renderPass, nullptr);
+	if (m_occlusionRenderPass != VK_NULL_HANDLE) vkDestroyRenderPass(*m_pLogicalDevice, m_occlusionRenderPass, nullptr);
+	if (m_transparentRenderPass != VK_NULL_HANDLE) vkDestroyRenderPass(*m_pLogicalDevice, m_transparentRenderPass, nullptr);
 }
 
 
@@ -372,15 +898,62 @@ VkShaderModule GraphicsPipeline::createShaderModule(const std::vector<char>& cod
 	return shaderModule;
 }
 
-void GraphicsPipeline::createColorResources() {
+VkShaderModule GraphicsPipeline::loadShaderModule(VkDevice device, const std::string& shaderName)
+{
+	auto shaderCode = Utilities::getInstance()->readFile(Utilities::getCompiledShaderPath(shaderName));
 
-	VkFormat colorFormat = *m_pSwapchain->getSwapchainImageFormat();
-	Image::createImage(m_pSwapchain->getSwapchainExtent()->width, m_pSwapchain->getSwapchainExtent()->height, colorFormat, m_msaaSamples, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_colorImage, m_colorImageMemory);
-	m_colorImageView = Image::createImageView(m_colorImage, colorFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+	VkShaderModuleCreateInfo createInfo{
+		.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+		.codeSize = shaderCode.size(),
+		.pCode = reinterpret_cast<const uint32_t*>(shaderCode.data())
+	};
+
+	VkShaderModule shaderModule;
+	if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create shader module " + shaderName + "!");
+	}
+
+	return shaderModule;
 }
 
-void GraphicsPipeline::createDepthResources() {
-	VkFormat depthFormat = DepthBuffer::findDepthFormat(m_pPhysicalDevice);
-	Image::createImage(m_pSwapchain->getSwapchainExtent()->width, m_pSwapchain->getSwapchainExtent()->height, depthFormat, m_msaaSamples, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_depthImage, m_depthImageMemory);
-	m_depthImageView = Image::createImageView(m_depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
-}
\ No newline at end of file
+VkSampleCountFlagBits GraphicsPipeline::chooseSampleCount()
+{
+	if (!m_pGraphicsSettings->multisampling) return VK_SAMPLE_COUNT_1_BIT;
+
+	// Every sample costs depth testing and attachment bandwidth, so the budget caps the samples per frame rather than per pixel.
+	// It's checked at the starting resolution only, the sample count is baked into the pipelines and render passes.
+	VkExtent2D extent = *m_pSwapchain->getSwapchainExtent();
+	double pixels = static_cast<double>(extent.width) * extent.height;
+	double sampleBudget = m_pGraphicsSettings->msaaSampleBudget * 1000000.0;
+	uint32_t maxSamples = std::min<uint32_t>(VulkanEngine::getInstance()->m_pPhysicalDevice->getMaxUsableSampleCount(), m_pGraphicsSettings->maxMsaaSamples);
+
+	uint32_t samples = 1;
+	while (samples * 2 <= maxSamples && pixels * samples * 2 <= sampleBudget) {
+		samples *= 2;
+	}
+
+	mDebugPrint(std::format("Using {}x MSAA at {}x{}.", samples, extent.width, extent.height));
+	return static_cast<VkSampleCountFlagBits>(samples);
+}
+
+VkResolveModeFlagBits GraphicsPipeline::chooseDepthResolveMode()
+{
+	VkPhysicalDeviceDepthStencilResolveProperties resolveProperties{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DEPTH_STENCIL_RESOLVE_PROPERTIES
+	};
+	VkPhysicalDeviceProperties2 properties2{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+		.pNext = &resolveProperties
+	};
+	vkGetPhysicalDeviceProperties2(*m_pPhysicalDevice, &properties2);
+
+	// The farthest sample keeps the depth pyramid conservative, sample zero (always supported) can cull a model that only
+	// shows through the other samples of an edge pixel for a frame
+	if (resolveProperties.supportedDepthResolveModes & VK_RESOLVE_MODE_MAX_BIT) return VK_RESOLVE_MODE_MAX_BIT;
+	return VK_RESOLVE_MODE_SAMPLE_ZERO_BIT;
+}
+
+VkFormat GraphicsPipeline::getColorFormat()
+{
+	return m_pGraphicsSettings->postProcessing ? PostProcessChain::sm_sceneColorFormat : *m_pSwapchain->getSwapchainImageFormat();
+}
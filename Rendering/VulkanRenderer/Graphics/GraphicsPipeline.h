@@ -3,13 +3,19 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include <map>
+#include <mutex>
+#include <utility>
+
 #include "../Utilities/Utilities.h"
 #include "Swapchain.h"
 #include "Devices.h"
 #include "Vertex.h"
+#include "PipelineVariantCache.h"
 
 
 class Swapchain;
+class ThreadPool;
 
 class GraphicsPipeline
 {
@@ -22,10 +28,47 @@ public:
 	void createGraphicsPipeline();
 	void cleanup();
 
+	// Maps the settings baked into the pipeline to a variant key. Layout and render passes are shared by every variant.
+	sPipelineKey makePipelineKey(const sSettings::sGraphicsSettings& settings);
+	// Compiles the variants runtime settings toggles can switch to, so switching later doesn't have to wait
+	void prewarmVariants(ThreadPool* pThreadPool);
+	// Switches to the settings' variant, right away if it's cached, otherwise once it has compiled on the thread pool.
+	// Rendering carries on with the current variant meanwhile. Render thread only, between frames.
+	void selectVariant(ThreadPool* pThreadPool, const sSettings::sGraphicsSettings& settings);
+	// Picks up a selected variant that has finished compiling, or its optimised version if it was fast linked. Called every frame.
+	bool swapToSelectedVariant();
+	// Switches to the settings' optimised variant straight away, compiling it on the calling thread if needed. For benchmarks
+	// that mustn't time a stand-in. Render thread only, between frames.
+	void useVariant(const sSettings::sGraphicsSettings& settings);
+	// Line width, and polygon and cull mode where they're dynamic. Call before drawing with any variant.
+	void recordDynamicState(VkCommandBuffer commandBuffer);
+
 	VkPipeline* getGraphicsPipeline() { return &m_graphicsPipeline; }
+	// Depth only pipeline drawing the position stream ahead of the main pass, matches the current variant
+	VkPipeline* getDepthPrepassPipeline() { return &m_depthPrepassPipeline; }
+	// Weighted blended pipeline for transparent models, matches the current variant. Only created with order independent transparency.
+	VkPipeline* getTransparentPipeline() { return &m_transparentPipeline; }
+	// Whether the current variant tests against depth written by the pre-pass. This follows the variant in use rather than
+	// the setting, which changes before the variant has compiled.
+	bool usesDepthPrepass() { return m_activeKey.depthCompareOp == VK_COMPARE_OP_EQUAL; }
 	VkPipelineLayout* getVkPipelineLayout() { return &m_pipelineLayout; }
 	VkRenderPass* getRenderPass() { return &m_renderPass; }
+	VkRenderPass* getOcclusionRenderPass() { return &m_occlusionRenderPass; }
+	VkRenderPass* getTransparentRenderPass() { return &m_transparentRenderPass; }
 	VkDescriptorSetLayout* getDescriptorSetLayout() { return &m_descriptorSetLayout; }
+	// Set 1 of the pipeline layout, shared with the light binning pipeline, see ClusteredLighting
+	VkDescriptorSetLayout* getLightSetLayout() { return &m_lightSetLayout; }
+	// Set 2 of the pipeline layout, see CascadedShadows
+	VkDescriptorSetLayout* getShadowSetLayout() { return &m_shadowSetLayout; }
+	// Samples per pixel of the attachments drawn to, VK_SAMPLE_COUNT_1_BIT without MSAA. Fixed for the pipeline's lifetime.
+	VkSampleCountFlagBits getSampleCount() { return m_msaaSamples; }
+	// Format of the colour the passes draw, the scene colour image's with post-processing and the swapchain's without
+	VkFormat getColorFormat();
+	// How the multisampled depth is resolved into the depth buffer the depth pyramid is built from
+	VkResolveModeFlagBits getDepthResolveMode() { return m_depthResolveMode; }
+
+	// Loads a shader compiled from one of the shader subfolders, see Utilities::getCompiledShaderPath.
+	static VkShaderModule loadShaderModule(VkDevice device, const std::string& shaderName);
 
 private:
 	Utilities* m_pUtilities = nullptr;
@@ -35,21 +78,54 @@ private:
 	sSettings::sGraphicsSettings* m_pGraphicsSettings = nullptr;
 
 	VkSampleCountFlagBits m_msaaSamples = VK_SAMPLE_COUNT_1_BIT;
-	VkImage m_colorImage = nullptr;
-	VkDeviceMemory m_colorImageMemory = nullptr;
-	VkImageView m_colorImageView = nullptr;
-	VkImage m_depthImage = nullptr;
-	VkDeviceMemory m_depthImageMemory = nullptr;
-	VkImageView m_depthImageView = nullptr;
+	VkResolveModeFlagBits m_depthResolveMode = VK_RESOLVE_MODE_SAMPLE_ZERO_BIT;
+	uint32_t m_viewMask = 0; // Views every draw is broadcast to, 0 without multiview
+	bool m_transparency = false; // Whether there's a transparent variant to keep up with the main one
 
 	VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE;
+	VkDescriptorSetLayout m_lightSetLayout = VK_NULL_HANDLE;
+	VkDescriptorSetLayout m_shadowSetLayout = VK_NULL_HANDLE;
 	VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
-	VkRenderPass m_renderPass = VK_NULL_HANDLE;
-	VkPipeline m_graphicsPipeline = VK_NULL_HANDLE;
+	VkRenderPass m_renderPass = VK_NULL_HANDLE; // Not created with dynamic rendering
+	VkRenderPass m_occlusionRenderPass = VK_NULL_HANDLE; // Second pass for models found visible by the late occlusion test, keeps the first pass' results
+	VkRenderPass m_transparentRenderPass = VK_NULL_HANDLE; // Accumulates transparent models, tested against the finished depth
+	VkPipeline m_graphicsPipeline = VK_NULL_HANDLE; // The selected variant, replaced in place so everyone can hold a pointer to this
+	VkPipeline m_depthPrepassPipeline = VK_NULL_HANDLE;
+	VkPipeline m_transparentPipeline = VK_NULL_HANDLE;
+
+	PipelineVariantCache* m_pVariantCache = nullptr;
+	sPipelineKey m_activeKey = {}; // Key of m_graphicsPipeline
+	sPipelineKey m_selectedKey = {};
+	sPipelineKey m_selectedPrepassKey = {};
+	sPipelineKey m_selectedTransparentKey = {};
+	ThreadPool* m_pRequestThreadPool = nullptr; // Set while the selected variant is still compiling
+
+	// Pipeline library parts, keyed by the part and the fields of the variant key that part uses. Shared between variants,
+	// so a new variant usually only needs linking. Built by whichever thread links first.
+	std::map<std::pair<VkGraphicsPipelineLibraryFlagBitsEXT, sPipelineKey>, VkPipeline> m_pipelineLibraries = {};
+	std::mutex m_libraryMutex;
+
+	PFN_vkCmdSetPolygonModeEXT m_vkCmdSetPolygonMode = nullptr;
+	PFN_vkCmdSetCullModeEXT m_vkCmdSetCullMode = nullptr;
+
+
+	struct sPipelineDescription;
 
+	sPipelineKey makeDepthPrepassKey(const sSettings::sGraphicsSettings& settings);
+	sPipelineKey makeTransparentKey(const sSettings::sGraphicsSettings& settings);
 
+	// Only reads the key and what's immutable after creation, so it can run on a worker thread
+	VkPipeline buildPipeline(const sPipelineKey& key);
+	// Fills in every create info of the variant, loading the shaders of the stages given
+	void describePipeline(const sPipelineKey& key, VkShaderStageFlags shaderStages, sPipelineDescription& description);
+	void destroyShaderModules(sPipelineDescription& description);
+	// One of the four parts of a graphics pipeline, compiled on first use
+	VkPipeline getPipelineLibrary(VkGraphicsPipelineLibraryFlagBitsEXT part, const sPipelineKey& key);
+	// Links the variant from its libraries. Without link time optimisation this is quick but the pipeline may run slower.
+	VkPipeline linkPipeline(const sPipelineKey& key, bool optimise);
 	VkShaderModule createShaderModule(const std::vector<char>& code);
-	void createColorResources();
-	void createDepthResources();
+	// Highest sample count the device supports that keeps the samples per frame within the settings' budget
+	VkSampleCountFlagBits chooseSampleCount();
+	VkResolveModeFlagBits chooseDepthResolveMode();
 };
 
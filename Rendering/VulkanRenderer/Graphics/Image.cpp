@@ -81,19 +81,19 @@ void Image::createTextureSampler()
 	}
 }
 
-VkImageView Image::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags)
+VkImageView Image::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t baseMipLevel, uint32_t levelCount, uint32_t baseArrayLayer, uint32_t layerCount)
 {
 	VkImageViewCreateInfo viewInfo{
 		.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
 		.image = image,
-		.viewType = VK_IMAGE_VIEW_TYPE_2D,
+		.viewType = layerCount > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D,
 		.format = format,
 		.subresourceRange {
 			.aspectMask = aspectFlags,
-			.baseMipLevel = 0,
-			.levelCount = 1,
-			.baseArrayLayer = 0,
-			.layerCount = 1
+			.baseMipLevel = baseMipLevel,
+			.levelCount = levelCount,
+			.baseArrayLayer = baseArrayLayer,
+			.layerCount = layerCount
 		}
 	};
 
@@ -106,7 +106,7 @@ VkImageView Image::createImageView(VkImage image, VkFormat format, VkImageAspect
 	return imageView;
 }
 
-void Image::createImage(uint32_t width, uint32_t height, VkFormat format, VkSampleCountFlagBits sampleCount, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory)
+void Image::createImage(uint32_t width, uint32_t height, VkFormat format, VkSampleCountFlagBits sampleCount, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory, uint32_t mipLevels, uint32_t arrayLayers)
 {
 	VkImageCreateInfo imageInfo{
 		.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
@@ -118,8 +118,8 @@ void Image::createImage(uint32_t width, uint32_t height, VkFormat format, VkSamp
 			.height = static_cast<uint32_t>(height),
 			.depth = 1,
 		},
-		.mipLevels = 1,
-		.arrayLayers = 1,
+		.mipLevels = mipLevels,
+		.arrayLayers = arrayLayers,
 		.samples = sampleCount,
 		.tiling = tiling,
 		.usage = usage,
@@ -135,6 +135,11 @@ void Image::createImage(uint32_t width, uint32_t height, VkFormat format, VkSamp
 	VkMemoryRequirements memRequirements;
 	vkGetImageMemoryRequirements(*m_pLogicalDevice, image, &memRequirements);
 
+	// Only tile based GPUs have lazily allocated memory, elsewhere transient attachments live in ordinary device memory
+	if ((properties & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) && !BufferManager::hasMemoryType(memRequirements.memoryTypeBits, properties)) {
+		properties &= ~VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+	}
+
 	VkMemoryAllocateInfo allocInfo{
 		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
 		.allocationSize = memRequirements.size,
@@ -156,63 +161,32 @@ void Image::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout
 	CommandBuffer* pCommandBuffer = m_pBufferManager->getCommandBuffer();
 	VkCommandBuffer imgCommandBuffer = pCommandBuffer->beginSingleTimeCommands();
 
+	// Wait for whatever the old layout was used for, and make the image ready for whatever the new one is for
+	VkPipelineStageFlags sourceStage;
+	VkPipelineStageFlags destinationStage;
+	VkAccessFlags sourceAccess;
+	VkAccessFlags destinationAccess;
+	getLayoutSyncState(oldLayout, sourceStage, sourceAccess);
+	getLayoutSyncState(newLayout, destinationStage, destinationAccess);
+
 	VkImageMemoryBarrier barrier{
 		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-		.srcAccessMask = 0, //TODO
-		.dstAccessMask = 0, //TODO
+		.srcAccessMask = sourceAccess,
+		.dstAccessMask = destinationAccess,
 		.oldLayout = oldLayout,
 		.newLayout = newLayout,
 		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
 		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
 		.image = image,
 		.subresourceRange {
-			.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+			.aspectMask = getAspectFlags(format),
 			.baseMipLevel = 0,
-			.levelCount = 1,
+			.levelCount = VK_REMAINING_MIP_LEVELS,
 			.baseArrayLayer = 0,
 			.layerCount = 1
 		}
 	};
 
-	VkPipelineStageFlags sourceStage;
-	VkPipelineStageFlags destinationStage;
-
-	if (newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) {
-		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-
-		if (hasStencilComponent(format)) {
-			barrier.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
-		}
-	}
-	else {
-		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	}
-
-	if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
-		barrier.srcAccessMask = 0;
-		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-		sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-		destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-	}
-	else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
-		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-		sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-		destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-	}
-	else if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) {
-		barrier.srcAccessMask = 0;
-		barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-
-		sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-		destinationStage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-	}
-	else {
-		throw std::invalid_argument("unsupported layout transition!");
-	}
-
 	vkCmdPipelineBarrier(
 		imgCommandBuffer,
 		sourceStage, destinationStage,
@@ -225,6 +199,71 @@ void Image::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout
 	pCommandBuffer->endSingleTimeCommands(imgCommandBuffer);
 }
 
+void Image::getLayoutSyncState(VkImageLayout layout, VkPipelineStageFlags& stages, VkAccessFlags& access)
+{
+	switch (layout)
+	{
+	case VK_IMAGE_LAYOUT_UNDEFINED:
+	case VK_IMAGE_LAYOUT_PREINITIALIZED:
+		stages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+		access = 0;
+		break;
+	case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+		stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		access = VK_ACCESS_TRANSFER_READ_BIT;
+		break;
+	case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+		stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		access = VK_ACCESS_TRANSFER_WRITE_BIT;
+		break;
+	case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+		stages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		access = VK_ACCESS_SHADER_READ_BIT;
+		break;
+	case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
+		stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		access = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		break;
+	case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
+		stages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		break;
+	case VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL:
+		stages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+		break;
+	case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR:
+		stages = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+		access = 0;
+		break;
+	case VK_IMAGE_LAYOUT_GENERAL:
+	default:
+		// No better guess, wait for and make visible everything
+		stages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		access = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+		break;
+	}
+}
+
+VkImageAspectFlags Image::getAspectFlags(VkFormat format)
+{
+	switch (format)
+	{
+	case VK_FORMAT_D16_UNORM:
+	case VK_FORMAT_X8_D24_UNORM_PACK32:
+	case VK_FORMAT_D32_SFLOAT:
+		return VK_IMAGE_ASPECT_DEPTH_BIT;
+	case VK_FORMAT_D16_UNORM_S8_UINT:
+	case VK_FORMAT_D24_UNORM_S8_UINT:
+	case VK_FORMAT_D32_SFLOAT_S8_UINT:
+		return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+	case VK_FORMAT_S8_UINT:
+		return VK_IMAGE_ASPECT_STENCIL_BIT;
+	default:
+		return VK_IMAGE_ASPECT_COLOR_BIT;
+	}
+}
+
 void Image::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height)
 {
 	CommandBuffer* pCommandBuffer = m_pBufferManager->getCommandBuffer();
@@ -27,10 +27,15 @@ public:
 	void createTextureImageView();
 	void createTextureSampler();
 
-	static VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags);
-	static void createImage(uint32_t width, uint32_t height, VkFormat format, VkSampleCountFlagBits sampleCount, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory);
+	// Views of more than one layer are array views
+	static VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t baseMipLevel = 0, uint32_t levelCount = 1, uint32_t baseArrayLayer = 0, uint32_t layerCount = 1);
+	static void createImage(uint32_t width, uint32_t height, VkFormat format, VkSampleCountFlagBits sampleCount, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory, uint32_t mipLevels = 1, uint32_t arrayLayers = 1);
 	static bool hasStencilComponent(VkFormat format);
+	// Works for any pair of layouts, the stages and accesses on both sides come from getLayoutSyncState.
 	static void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout);
+	// The stages and accesses an image in this layout is typically used with.
+	static void getLayoutSyncState(VkImageLayout layout, VkPipelineStageFlags& stages, VkAccessFlags& access);
+	static VkImageAspectFlags getAspectFlags(VkFormat format);
 	void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
 
 	void cleanup();
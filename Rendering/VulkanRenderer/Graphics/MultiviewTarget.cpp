@@ -0,0 +1,88 @@
+#include "../VulkanRenderer.h"
+#include "Buffers.h"
+#include "GraphicsPipeline.h"
+#include "Image.h"
+
+#include "MultiviewTarget.h"
+
+
+
+MultiviewTarget::MultiviewTarget() : m_pUtilities(Utilities::getInstance()), m_pLogicalDevice(VulkanEngine::getInstance()->m_pLogicalDevice->getVkDevice()),
+	m_pBufferManager(VulkanEngine::getInstance()->m_pBufferManager), m_pSwapchain(VulkanEngine::getInstance()->m_pSwapchain)
+{
+	m_colorFormat = VulkanEngine::getInstance()->getGraphicsPipeline()->getColorFormat();
+	createTargets();
+}
+
+
+void MultiviewTarget::createTargets()
+{
+	VkExtent2D swapchainExtent = *m_pSwapchain->getSwapchainExtent();
+	m_viewExtent = { .width = std::max(swapchainExtent.width / sm_viewCount, 1u), .height = swapchainExtent.height };
+
+	mDebugPrint(std::format("Creating multiview targets ({} views of {}x{})...", sm_viewCount, m_viewExtent.width, m_viewExtent.height));
+
+	VkFormat depthFormat = DepthBuffer::findDepthFormat(m_pBufferManager->m_pPhysicalDevice);
+
+	// One layer per view. Only the colour outlives the pass, it's copied out of when the views are composed.
+	Image::createImage(m_viewExtent.width, m_viewExtent.height, m_colorFormat, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_colorImage, m_colorImageMemory, 1, sm_viewCount);
+	m_colorImageView = Image::createImageView(m_colorImage, m_colorFormat, VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, sm_viewCount);
+
+	Image::createImage(m_viewExtent.width, m_viewExtent.height, depthFormat, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_depthImage, m_depthImageMemory, 1, sm_viewCount);
+	m_depthImageView = Image::createImageView(m_depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, sm_viewCount);
+}
+
+void MultiviewTarget::recordCompose(VkCommandBuffer commandBuffer, VkImage frameImage)
+{
+	// Same format on both sides, so a copy does it and the swapchain doesn't need blit support
+	std::array<VkImageCopy, sm_viewCount> regions{};
+	for (uint32_t view = 0; view < sm_viewCount; view++) {
+		regions[view] = VkImageCopy{
+			.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, view, 1 },
+			.srcOffset = { 0, 0, 0 },
+			.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+			.dstOffset = { static_cast<int32_t>(view * m_viewExtent.width), 0, 0 },
+			.extent = { m_viewExtent.width, m_viewExtent.height, 1 }
+		};
+	}
+
+	vkCmdCopyImage(commandBuffer, m_colorImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, frameImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		static_cast<uint32_t>(regions.size()), regions.data());
+}
+
+
+
+void MultiviewTarget::recreateTargets()
+{
+	RenderGraph* pRenderGraph = m_pBufferManager->getRenderGraph();
+	pRenderGraph->forgetImportedState(m_colorImage);
+	pRenderGraph->forgetImportedState(m_depthImage);
+	retireTargets();
+
+	createTargets();
+}
+
+void MultiviewTarget::retireTargets()
+{
+	VulkanEngine::getInstance()->m_pDeletionQueue->push([device = *m_pLogicalDevice, colorView = m_colorImageView, colorImage = m_colorImage, colorMemory = m_colorImageMemory,
+		depthView = m_depthImageView, depthImage = m_depthImage, depthMemory = m_depthImageMemory]() {
+		vkDestroyImageView(device, colorView, nullptr);
+		vkDestroyImage(device, colorImage, nullptr);
+		vkFreeMemory(device, colorMemory, nullptr);
+		vkDestroyImageView(device, depthView, nullptr);
+		vkDestroyImage(device, depthImage, nullptr);
+		vkFreeMemory(device, depthMemory, nullptr);
+	});
+}
+
+void MultiviewTarget::cleanup()
+{
+	vkDestroyImageView(*m_pLogicalDevice, m_colorImageView, nullptr);
+	vkDestroyImage(*m_pLogicalDevice, m_colorImage, nullptr);
+	vkFreeMemory(*m_pLogicalDevice, m_colorImageMemory, nullptr);
+	vkDestroyImageView(*m_pLogicalDevice, m_depthImageView, nullptr);
+	vkDestroyImage(*m_pLogicalDevice, m_depthImage, nullptr);
+	vkFreeMemory(*m_pLogicalDevice, m_depthImageMemory, nullptr);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+
+#include "../Utilities/Utilities.h"
+
+
+class BufferManager;
+class Swapchain;
+
+// Layered colour and depth attachments for drawing several views in a single pass with VK_KHR_multiview. The pass
+// broadcasts every draw to each layer and the shaders pick the layer's camera with gl_ViewIndex, so the views share the
+// culling, the draw list and every bind, and only the vertex work is repeated per view. Each layer is one view, half the
+// swapchain's width, and the finished layers are copied side by side into the frame before post-processing.
+class MultiviewTarget
+{
+public:
+	static constexpr uint32_t sm_viewCount = 2; // Matches MAX_VIEWS in the shaders
+	static constexpr uint32_t sm_viewMask = (1u << sm_viewCount) - 1;
+
+	MultiviewTarget();
+
+	// The render graph has the layered colour as a transfer source and the frame as a transfer destination. The frame is
+	// the scene colour image with post-processing, the swapchain image without, both in the format the views are drawn in.
+	void recordCompose(VkCommandBuffer commandBuffer, VkImage frameImage);
+
+	// Size of a single view, the render area of the multiview pass
+	VkExtent2D getViewExtent() { return m_viewExtent; }
+	VkImage* getColorImage() { return &m_colorImage; }
+	VkImageView* getColorImageView() { return &m_colorImageView; }
+	VkImage* getDepthImage() { return &m_depthImage; }
+	VkImageView* getDepthImageView() { return &m_depthImageView; }
+
+	// Follows the swapchain's size, the old images go through the deletion queue
+	void recreateTargets();
+	void cleanup();
+
+private:
+	Utilities* m_pUtilities = nullptr;
+	VkDevice* m_pLogicalDevice = nullptr;
+	BufferManager* m_pBufferManager = nullptr;
+	Swapchain* m_pSwapchain = nullptr;
+
+	VkExtent2D m_viewExtent = {};
+	VkFormat m_colorFormat = VK_FORMAT_UNDEFINED;
+	VkImage m_colorImage = VK_NULL_HANDLE;
+	VkDeviceMemory m_colorImageMemory = VK_NULL_HANDLE;
+	VkImageView m_colorImageView = VK_NULL_HANDLE; // Every layer, as the pass' attachment
+	VkImage m_depthImage = VK_NULL_HANDLE;
+	VkDeviceMemory m_depthImageMemory = VK_NULL_HANDLE;
+	VkImageView m_depthImageView = VK_NULL_HANDLE;
+
+
+	void createTargets();
+	void retireTargets();
+};
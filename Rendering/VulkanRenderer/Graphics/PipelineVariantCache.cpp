@@ -0,0 +1,102 @@
+#include "../VulkanRenderer.h"
+#include "DeletionQueue.h"
+
+#include "PipelineVariantCache.h"
+
+
+PipelineVariantCache::PipelineVariantCache(VkDevice* pLogicalDevice, Builder builder) : m_pUtilities(Utilities::getInstance()), m_pLogicalDevice(pLogicalDevice), m_builder(std::move(builder))
+{
+}
+
+void PipelineVariantCache::setFastLinker(Builder fastLinker, DeletionQueue* pDeletionQueue)
+{
+	m_fastLinker = std::move(fastLinker);
+	m_pDeletionQueue = pDeletionQueue;
+}
+
+PipelineVariantCache::sVariant& PipelineVariantCache::findOrAdd(const sPipelineKey& key)
+{
+	auto it = m_variants.find(key);
+	if (it != m_variants.end()) return it->second;
+
+	sVariant& variant = m_variants[key];
+	variant.id = static_cast<uint32_t>(m_variants.size() - 1);
+	return variant;
+}
+
+void PipelineVariantCache::setOptimised(sVariant& variant, VkPipeline pipeline)
+{
+	// Frames already submitted may have drawn with the fast linked version
+	if (variant.pipeline != VK_NULL_HANDLE) {
+		m_pDeletionQueue->push([device = *m_pLogicalDevice, fastPipeline = variant.pipeline]() { vkDestroyPipeline(device, fastPipeline, nullptr); });
+	}
+
+	variant.pipeline = pipeline;
+	variant.optimised = true;
+}
+
+bool PipelineVariantCache::poll(sVariant& variant)
+{
+	if (variant.optimised) return true;
+	if (!variant.pending.valid() || variant.pending.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return variant.pipeline != VK_NULL_HANDLE;
+
+	setOptimised(variant, variant.pending.get());
+	return true;
+}
+
+VkPipeline PipelineVariantCache::get(const sPipelineKey& key)
+{
+	sVariant& variant = findOrAdd(key);
+
+	if (!variant.optimised) {
+		setOptimised(variant, variant.pending.valid() ? variant.pending.get() : m_builder(key));
+	}
+
+	return variant.pipeline;
+}
+
+VkPipeline PipelineVariantCache::request(ThreadPool* pThreadPool, const sPipelineKey& key)
+{
+	sVariant& variant = findOrAdd(key);
+	if (poll(variant) && variant.optimised) return variant.pipeline;
+
+	if (!variant.pending.valid()) {
+		mDebugPrint(std::format("Compiling pipeline variant {} in the background...", variant.id));
+		variant.pending = pThreadPool->enqueue([this, key]() { return m_builder(key); });
+	}
+
+	if (variant.pipeline == VK_NULL_HANDLE && m_fastLinker) {
+		mDebugPrint(std::format("Fast linking pipeline variant {}...", variant.id));
+		variant.pipeline = m_fastLinker(key);
+	}
+
+	return variant.pipeline;
+}
+
+void PipelineVariantCache::prewarm(ThreadPool* pThreadPool, const std::vector<sPipelineKey>& keys)
+{
+	for (const sPipelineKey& key : keys) {
+		request(pThreadPool, key);
+	}
+}
+
+uint32_t PipelineVariantCache::getVariantId(const sPipelineKey& key)
+{
+	return findOrAdd(key).id;
+}
+
+bool PipelineVariantCache::isOptimised(const sPipelineKey& key)
+{
+	return findOrAdd(key).optimised;
+}
+
+void PipelineVariantCache::cleanup()
+{
+	for (auto& [key, variant] : m_variants) {
+		// The device is idle by now, so a fast linked pipeline can go straight away
+		if (variant.pending.valid()) vkDestroyPipeline(*m_pLogicalDevice, variant.pending.get(), nullptr);
+		if (variant.pipeline != VK_NULL_HANDLE) vkDestroyPipeline(*m_pLogicalDevice, variant.pipeline, nullptr);
+	}
+
+	m_variants.clear();
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <map>
+#include <future>
+#include <functional>
+#include <cstdint>
+
+#include "../Utilities/Utilities.h"
+
+
+class ThreadPool;
+class DeletionQueue;
+
+// Everything baked into a graphics pipeline that can differ between variants of it.
+// State the device lets us set dynamically is left at a fixed value, so it never creates a new variant.
+struct sPipelineKey
+{
+	VkPolygonMode polygonMode = VK_POLYGON_MODE_FILL;
+	VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+	VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+	bool sampleShading = false;
+	bool depthClamp = false;
+	bool blend = true;
+	VkCompareOp depthCompareOp = VK_COMPARE_OP_LESS;
+	bool depthWrite = true;
+	bool depthOnly = false; // Depth pre-pass, vertex shader only and no colour writes
+	bool transparent = false; // Weighted blended into WeightedBlendedOIT's accumulation and revealage instead of the colour
+	uint32_t vertexLayout = 0; // 0 for Vertex, 1 for positions only
+	uint32_t shaderSet = 0; // Index into the compiled vertex/fragment shader lists, unused when depth only
+
+	auto operator<=>(const sPipelineKey& other) const = default;
+};
+
+// Compiled graphics pipeline variants, keyed by their state. Variants are compiled once and kept for the cache's lifetime,
+// so going back to a state that was used before (or pre-warmed) costs nothing.
+// Only the render thread touches the cache, the thread pool just runs the builder and hands the result back through a future.
+// With a fast linker set, a requested variant is usable straight away in an unoptimised form and replaced by the builder's
+// result once that has compiled.
+class PipelineVariantCache
+{
+public:
+	using Builder = std::function<VkPipeline(const sPipelineKey&)>;
+
+	PipelineVariantCache(VkDevice* pLogicalDevice, Builder builder);
+
+	// Quick build for request() to use while the builder runs in the background. Replaced pipelines are retired through the
+	// deletion queue, so the swap has to happen between frames.
+	void setFastLinker(Builder fastLinker, DeletionQueue* pDeletionQueue);
+
+	// Compiles the variant on the calling thread if it isn't cached yet
+	VkPipeline get(const sPipelineKey& key);
+	// Returns the variant if it's compiled, otherwise starts compiling it on the thread pool and returns VK_NULL_HANDLE,
+	// or the fast linked version if there is a fast linker
+	VkPipeline request(ThreadPool* pThreadPool, const sPipelineKey& key);
+	// Starts compiling whichever of the variants aren't cached yet
+	void prewarm(ThreadPool* pThreadPool, const std::vector<sPipelineKey>& keys);
+
+	// Small id that stays the same for the variant's lifetime, fits the draw sort key's pipeline field
+	uint32_t getVariantId(const sPipelineKey& key);
+	size_t getVariantCount() { return m_variants.size(); }
+	// Whether the variant is the builder's result rather than a fast linked stand-in
+	bool isOptimised(const sPipelineKey& key);
+
+	void cleanup();
+
+private:
+	struct sVariant
+	{
+		uint32_t id = 0;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		bool optimised = false; // False while pipeline is fast linked
+		std::future<VkPipeline> pending = {};
+	};
+
+	Utilities* m_pUtilities = nullptr;
+	VkDevice* m_pLogicalDevice = nullptr;
+	Builder m_builder;
+	Builder m_fastLinker = nullptr;
+	DeletionQueue* m_pDeletionQueue = nullptr;
+
+	std::map<sPipelineKey, sVariant> m_variants = {};
+
+
+	sVariant& findOrAdd(const sPipelineKey& key);
+	// Picks up the result if the background compile has finished
+	bool poll(sVariant& variant);
+	// Replaces whatever the variant has with the builder's result
+	void setOptimised(sVariant& variant, VkPipeline pipeline);
+};
@@ -14,20 +14,28 @@ QueueFamilyIndices::sQueueFamilyIndices QueueFamilyIndices::findQueueFamilies(Vk
 	int i = 0;
 	for (const auto& queueFamily : queueFamilies)
 	{
-		if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+		if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT && !indices.graphicsFamily.has_value())
 		{
 			indices.graphicsFamily = i;
 		}
 
+		// Headless frames never leave the graphics queue
 		VkBool32 presentSupport = false;
-		vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+		if (surface != VK_NULL_HANDLE) vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+		else presentSupport = (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
 
-		if (presentSupport)
+		if (presentSupport && !indices.presentFamily.has_value())
 		{
 			indices.presentFamily = i;
 		}
 
-		if (indices.isComplete())
+		// A family without graphics runs independently of the graphics queue, which is what async compute is after
+		if (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT && !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && !indices.computeFamily.has_value())
+		{
+			indices.computeFamily = i;
+		}
+
+		if (indices.isComplete() && indices.computeFamily.has_value())
 		{
 			break;
 		}
@@ -13,13 +13,15 @@ public:
 	struct sQueueFamilyIndices
 	{
 		std::optional<uint32_t> graphicsFamily;
-		std::optional<uint32_t> presentFamily;
+		std::optional<uint32_t> presentFamily; // The graphics family when headless, nothing is presented
+		std::optional<uint32_t> computeFamily; // Compute without graphics, only set if the device has such a family. Not required.
 
 		bool isComplete() {
 			return graphicsFamily.has_value() && presentFamily.has_value();
 		}
 	};
 
+	// Pass a null surface when running headless
 	static sQueueFamilyIndices findQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surface);
 };
 
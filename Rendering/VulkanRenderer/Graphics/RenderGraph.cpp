@@ -0,0 +1,523 @@
+#include "../VulkanRenderer.h"
+
+#include <algorithm>
+#include <numeric>
+
+#include "Image.h"
+#include "Buffers.h"
+
+#include "RenderGraph.h"
+
+
+namespace
+{
+	constexpr VkAccessFlags WRITE_ACCESS_MASK = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT
+		| VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+	template<typename T>
+	uint64_t handleKey(T handle) { return (uint64_t)handle; }
+}
+
+
+RenderGraph::RenderGraph() : m_pUtilities(Utilities::getInstance()), m_pLogicalDevice(VulkanEngine::getInstance()->m_pLogicalDevice->getVkDevice())
+{
+}
+
+RenderGraph::sUsageState RenderGraph::getUsageState(eResourceUsage usage, VkImageAspectFlags aspect)
+{
+	VkImageLayout sampledLayout = (aspect & VK_IMAGE_ASPECT_DEPTH_BIT) ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	switch (usage)
+	{
+	case eResourceUsage::COLOR_ATTACHMENT:
+		return { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true };
+	case eResourceUsage::DEPTH_ATTACHMENT:
+		return { VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+			VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, true };
+	case eResourceUsage::DEPTH_RESOLVE:
+		return { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, true };
+	case eResourceUsage::DEPTH_READ:
+		return { VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+			VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, false };
+	case eResourceUsage::SAMPLED_FRAGMENT:
+		return { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, sampledLayout, false };
+	case eResourceUsage::SAMPLED_COMPUTE:
+		return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, sampledLayout, false };
+	case eResourceUsage::COMPUTE_READ:
+		return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, false };
+	case eResourceUsage::COMPUTE_WRITE:
+		return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, true };
+	case eResourceUsage::INDIRECT_READ:
+		return { VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false };
+	case eResourceUsage::TRANSFER_READ:
+		return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, false };
+	case eResourceUsage::TRANSFER_WRITE:
+		return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true };
+	case eResourceUsage::PRESENT:
+		return { VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, false };
+	case eResourceUsage::NONE:
+	default:
+		return { 0, 0, VK_IMAGE_LAYOUT_UNDEFINED, false };
+	}
+}
+
+
+
+//// ----------------------------------------------------- //
+/// ---------------------- Building --------------------- //
+// ----------------------------------------------------- //
+
+
+RenderGraph::ResourceHandle RenderGraph::importImage(const std::string& name, VkImage image, VkFormat format, uint32_t mipLevels, VkImageLayout initialLayout)
+{
+	sResource resource{
+		.name = name,
+		.desc = { .format = format, .mipLevels = mipLevels },
+		.aspect = Image::getAspectFlags(format),
+		.image = image
+	};
+
+	auto importedState = m_importedStates.find(handleKey(image));
+	if (importedState != m_importedStates.end()) resource.state = importedState->second;
+	else resource.state.layout = initialLayout;
+
+	m_resources.push_back(resource);
+	return static_cast<ResourceHandle>(m_resources.size() - 1);
+}
+
+void RenderGraph::forgetImportedState(VkImage image)
+{
+	m_importedStates.erase(handleKey(image));
+}
+
+RenderGraph::ResourceHandle RenderGraph::importSwapchainImage(const std::string& name, VkImage image, VkFormat format, VkPipelineStageFlags waitStage)
+{
+	// Whatever was presented is gone, the first use only has to wait for the acquire semaphore
+	sResource resource{
+		.name = name,
+		.desc = { .format = format },
+		.aspect = VK_IMAGE_ASPECT_COLOR_BIT,
+		.image = image,
+		.state = { .writeStages = waitStage, .layout = VK_IMAGE_LAYOUT_UNDEFINED }
+	};
+
+	m_resources.push_back(resource);
+	return static_cast<ResourceHandle>(m_resources.size() - 1);
+}
+
+RenderGraph::ResourceHandle RenderGraph::importBuffer(const std::string& name, VkBuffer buffer)
+{
+	sResource resource{
+		.name = name,
+		.buffer = buffer
+	};
+
+	auto importedState = m_importedStates.find(handleKey(buffer));
+	if (importedState != m_importedStates.end()) resource.state = importedState->second;
+
+	m_resources.push_back(resource);
+	return static_cast<ResourceHandle>(m_resources.size() - 1);
+}
+
+RenderGraph::ResourceHandle RenderGraph::createImage(const std::string& name, const sImageDesc& desc)
+{
+	sResource resource{
+		.name = name,
+		.transient = true,
+		.desc = desc,
+		.aspect = Image::getAspectFlags(desc.format)
+	};
+
+	m_resources.push_back(resource);
+	return static_cast<ResourceHandle>(m_resources.size() - 1);
+}
+
+void RenderGraph::addPass(const std::string& name, const std::function<void(PassBuilder&)>& setup, const std::function<void(VkCommandBuffer)>& execute)
+{
+	m_passes.push_back(sPass{ .name = name, .execute = execute });
+
+	PassBuilder builder{};
+	builder.m_pGraph = this;
+	builder.m_passIndex = static_cast<uint32_t>(m_passes.size() - 1);
+	setup(builder);
+}
+
+void RenderGraph::markOutput(ResourceHandle resource, eResourceUsage finalUsage)
+{
+	m_resources[resource].output = true;
+	m_resources[resource].finalUsage = finalUsage;
+}
+
+void RenderGraph::PassBuilder::read(ResourceHandle resource, eResourceUsage usage)
+{
+	m_pGraph->addAccess(m_passIndex, resource, usage, false, false);
+}
+
+void RenderGraph::PassBuilder::write(ResourceHandle resource, eResourceUsage usage)
+{
+	m_pGraph->addAccess(m_passIndex, resource, usage, true, false);
+}
+
+void RenderGraph::PassBuilder::overwrite(ResourceHandle resource, eResourceUsage usage)
+{
+	m_pGraph->addAccess(m_passIndex, resource, usage, true, true);
+}
+
+void RenderGraph::PassBuilder::sideEffect()
+{
+	m_pGraph->m_passes[m_passIndex].sideEffect = true;
+}
+
+void RenderGraph::addAccess(uint32_t passIndex, ResourceHandle resource, eResourceUsage usage, bool writes, bool discard)
+{
+	if (writes != getUsageState(usage, m_resources[resource].aspect).writes) {
+		throw std::invalid_argument(std::format("pass {} declares {} with a usage that doesn't match read/write!", m_passes[passIndex].name, m_resources[resource].name));
+	}
+
+	m_passes[passIndex].accesses.push_back({ resource, usage, writes, discard });
+}
+
+
+
+//// ----------------------------------------------------- //
+/// --------------------- Compiling --------------------- //
+// ----------------------------------------------------- //
+
+
+void RenderGraph::compile(uint32_t frameIndex)
+{
+	cullPasses();
+	allocateTransients(frameIndex);
+	buildBarriers();
+}
+
+void RenderGraph::cullPasses()
+{
+	// Walk backwards from the outputs, a pass is needed if it writes something a later needed pass (or the frame) reads
+	std::vector<bool> needed(m_resources.size());
+	for (size_t i = 0; i < m_resources.size(); i++) needed[i] = m_resources[i].output;
+
+	for (size_t passIndex = m_passes.size(); passIndex-- > 0;)
+	{
+		sPass& pass = m_passes[passIndex];
+
+		pass.kept = pass.sideEffect || std::any_of(pass.accesses.begin(), pass.accesses.end(), [&](const sAccess& access) { return access.writes && needed[access.resource]; });
+		if (!pass.kept) continue;
+
+		// Anything written without discarding may still be read back, so its earlier writers are needed too
+		for (const sAccess& access : pass.accesses) {
+			if (!access.discard) needed[access.resource] = true;
+		}
+	}
+
+	for (uint32_t passIndex = 0; passIndex < m_passes.size(); passIndex++)
+	{
+		if (!m_passes[passIndex].kept) continue;
+
+		for (const sAccess& access : m_passes[passIndex].accesses) {
+			sResource& resource = m_resources[access.resource];
+			resource.firstPass = std::min(resource.firstPass, passIndex);
+			resource.lastPass = std::max(resource.lastPass, passIndex);
+		}
+	}
+}
+
+void RenderGraph::allocateTransients(uint32_t frameIndex)
+{
+	std::vector<ResourceHandle> transients;
+	std::vector<sImageDesc> descs;
+	std::vector<std::pair<uint32_t, uint32_t>> lifetimes;
+	for (ResourceHandle handle = 0; handle < m_resources.size(); handle++)
+	{
+		const sResource& resource = m_resources[handle];
+		if (!resource.transient || resource.firstPass == UINT32_MAX) continue; // Unused transients are never created
+
+		transients.push_back(handle);
+		descs.push_back(resource.desc);
+		lifetimes.push_back({ resource.firstPass, resource.lastPass });
+	}
+
+	// This frame slot's previous frame has finished by the time it's recorded again, so its transients can be replaced right away
+	sTransientSet& transientSet = m_transientSets[frameIndex];
+	if (transientSet.descs != descs || transientSet.lifetimes != lifetimes)
+	{
+		destroyTransientSet(transientSet);
+		transientSet.descs = descs;
+		transientSet.lifetimes = lifetimes;
+		transientSet.generation = ++m_transientGenerations;
+
+		std::vector<VkMemoryRequirements> requirements(descs.size());
+		transientSet.images.resize(descs.size());
+		for (size_t i = 0; i < descs.size(); i++)
+		{
+			VkImageCreateInfo imageInfo{
+				.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+				.imageType = VK_IMAGE_TYPE_2D,
+				.format = descs[i].format,
+				.extent = { descs[i].width, descs[i].height, 1 },
+				.mipLevels = descs[i].mipLevels,
+				.arrayLayers = 1,
+				.samples = VK_SAMPLE_COUNT_1_BIT,
+				.tiling = VK_IMAGE_TILING_OPTIMAL,
+				.usage = descs[i].usage,
+				.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+				.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+			};
+
+			if (vkCreateImage(*m_pLogicalDevice, &imageInfo, nullptr, &transientSet.images[i]) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create transient image!");
+			}
+			vkGetImageMemoryRequirements(*m_pLogicalDevice, transientSet.images[i], &requirements[i]);
+		}
+
+		// Biggest first, every image goes into the first block it fits whose other images are never alive at the same time
+		struct sMemoryBlock
+		{
+			uint32_t memoryTypeBits;
+			VkDeviceSize size;
+			std::vector<uint32_t> images;
+		};
+		std::vector<sMemoryBlock> blocks;
+
+		std::vector<uint32_t> order(descs.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return requirements[a].size > requirements[b].size; });
+
+		VkDeviceSize requestedSize = 0;
+		for (uint32_t image : order)
+		{
+			requestedSize += requirements[image].size;
+
+			auto overlaps = [&](uint32_t other) { return lifetimes[image].first <= lifetimes[other].second && lifetimes[other].first <= lifetimes[image].second; };
+			auto block = std::find_if(blocks.begin(), blocks.end(), [&](const sMemoryBlock& block) {
+				return (block.memoryTypeBits & requirements[image].memoryTypeBits) != 0 && std::none_of(block.images.begin(), block.images.end(), overlaps);
+			});
+
+			if (block == blocks.end()) {
+				blocks.push_back({ requirements[image].memoryTypeBits, requirements[image].size, { image } });
+			}
+			else {
+				block->memoryTypeBits &= requirements[image].memoryTypeBits;
+				block->size = std::max(block->size, requirements[image].size);
+				block->images.push_back(image);
+			}
+		}
+
+		VkDeviceSize allocatedSize = 0;
+		transientSet.aliasPredecessors.assign(descs.size(), -1);
+		for (sMemoryBlock& block : blocks)
+		{
+			VkMemoryAllocateInfo allocInfo{
+				.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+				.allocationSize = block.size,
+				.memoryTypeIndex = BufferManager::findMemoryType(block.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+			};
+
+			VkDeviceMemory memory;
+			if (vkAllocateMemory(*m_pLogicalDevice, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+				throw std::runtime_error("failed to allocate transient image memory!");
+			}
+			transientSet.memoryBlocks.push_back(memory);
+			allocatedSize += block.size;
+
+			// Images sharing a block are used one after another, each one has to wait for the one before it
+			std::sort(block.images.begin(), block.images.end(), [&](uint32_t a, uint32_t b) { return lifetimes[a].first < lifetimes[b].first; });
+			for (size_t i = 0; i < block.images.size(); i++)
+			{
+				vkBindImageMemory(*m_pLogicalDevice, transientSet.images[block.images[i]], memory, 0);
+				if (i > 0) transientSet.aliasPredecessors[block.images[i]] = static_cast<int32_t>(block.images[i - 1]);
+			}
+		}
+
+		transientSet.imageViews.resize(descs.size());
+		for (size_t i = 0; i < descs.size(); i++) {
+			transientSet.imageViews[i] = Image::createImageView(transientSet.images[i], descs[i].format, Image::getAspectFlags(descs[i].format), 0, descs[i].mipLevels);
+		}
+
+		mDebugPrint(std::format("Frame {}: {} transient images in {} memory blocks, {} KiB instead of {} KiB", frameIndex, descs.size(), blocks.size(), allocatedSize / 1024, requestedSize / 1024));
+	}
+
+	for (size_t i = 0; i < transients.size(); i++)
+	{
+		sResource& resource = m_resources[transients[i]];
+		resource.image = transientSet.images[i];
+		resource.imageView = transientSet.imageViews[i];
+		resource.aliasPredecessor = transientSet.aliasPredecessors[i] < 0 ? -1 : static_cast<int32_t>(transients[transientSet.aliasPredecessors[i]]);
+	}
+}
+
+void RenderGraph::buildBarriers()
+{
+	for (sPass& pass : m_passes)
+	{
+		if (!pass.kept) continue;
+
+		for (const sAccess& access : pass.accesses)
+		{
+			sResource& resource = m_resources[access.resource];
+			bool firstUse = resource.transient && &pass == &m_passes[resource.firstPass];
+
+			if (firstUse && resource.aliasPredecessor >= 0)
+			{
+				// The memory still belongs to the previous image until everything using it has finished
+				const sResourceState& predecessorState = m_resources[resource.aliasPredecessor].state;
+				resource.state = {
+					.writeStages = predecessorState.writeStages | predecessorState.readStages,
+					.writeAccess = predecessorState.writeAccess
+				};
+			}
+
+			// Transient contents never carry over, so the first use can always discard them
+			transition(resource, getUsageState(access.usage, resource.aspect), access.discard || firstUse, pass.srcStages, pass.dstStages, pass.imageBarriers, pass.bufferBarriers);
+		}
+	}
+
+	for (sResource& resource : m_resources)
+	{
+		if (resource.output && resource.finalUsage != eResourceUsage::NONE) {
+			transition(resource, getUsageState(resource.finalUsage, resource.aspect), false, m_finalSrcStages, m_finalDstStages, m_finalImageBarriers, m_finalBufferBarriers);
+		}
+
+		// The next frame picks up where this one left off
+		if (!resource.transient) {
+			if (resource.image != VK_NULL_HANDLE) m_importedStates[handleKey(resource.image)] = resource.state;
+			else m_importedStates[handleKey(resource.buffer)] = resource.state;
+		}
+	}
+}
+
+void RenderGraph::transition(sResource& resource, const sUsageState& usageState, bool discard, VkPipelineStageFlags& srcStages, VkPipelineStageFlags& dstStages,
+	std::vector<VkImageMemoryBarrier>& imageBarriers, std::vector<VkBufferMemoryBarrier>& bufferBarriers)
+{
+	if (usageState.stages == 0) return;
+
+	sResourceState& state = resource.state;
+	bool isImage = resource.image != VK_NULL_HANDLE;
+	bool layoutChange = isImage && usageState.layout != state.layout;
+
+	VkPipelineStageFlags barrierSrcStages = 0;
+	VkAccessFlags barrierSrcAccess = 0;
+	if (layoutChange || usageState.writes)
+	{
+		// Everything that touched the resource has to finish first, and the last write has to be made available
+		barrierSrcStages = state.writeStages | state.readStages;
+		barrierSrcAccess = state.writeAccess;
+	}
+	else if (state.writeAccess != 0 && (usageState.stages & ~state.visibleStages) != 0)
+	{
+		// Read after write, unless an earlier barrier already made the write visible to these stages
+		barrierSrcStages = state.writeStages;
+		barrierSrcAccess = state.writeAccess;
+	}
+
+	if (barrierSrcStages != 0 || layoutChange)
+	{
+		srcStages |= barrierSrcStages != 0 ? barrierSrcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+		dstStages |= usageState.stages;
+
+		if (isImage && (layoutChange || barrierSrcAccess != 0))
+		{
+			imageBarriers.push_back(VkImageMemoryBarrier{
+				.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+				.srcAccessMask = barrierSrcAccess,
+				.dstAccessMask = usageState.access,
+				.oldLayout = discard ? VK_IMAGE_LAYOUT_UNDEFINED : state.layout,
+				.newLayout = usageState.layout,
+				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.image = resource.image,
+				.subresourceRange {
+					.aspectMask = resource.aspect,
+					.baseMipLevel = 0,
+					.levelCount = VK_REMAINING_MIP_LEVELS,
+					.baseArrayLayer = 0,
+					.layerCount = VK_REMAINING_ARRAY_LAYERS
+				}
+			});
+		}
+		else if (!isImage && barrierSrcAccess != 0)
+		{
+			bufferBarriers.push_back(VkBufferMemoryBarrier{
+				.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+				.srcAccessMask = barrierSrcAccess,
+				.dstAccessMask = usageState.access,
+				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.buffer = resource.buffer,
+				.offset = 0,
+				.size = VK_WHOLE_SIZE
+			});
+		}
+		// Otherwise it's a write after read, which only needs the execution dependency
+
+		if (barrierSrcAccess != 0) state.visibleStages |= usageState.stages;
+	}
+
+	if (usageState.writes) {
+		state.writeStages = usageState.stages;
+		state.writeAccess = usageState.access & WRITE_ACCESS_MASK;
+		state.visibleStages = 0;
+		state.readStages = 0;
+	}
+	else {
+		state.readStages |= usageState.stages;
+	}
+
+	if (isImage) state.layout = usageState.layout;
+}
+
+
+
+//// ----------------------------------------------------- //
+/// --------------------- Execution --------------------- //
+// ----------------------------------------------------- //
+
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer)
+{
+	for (sPass& pass : m_passes)
+	{
+		if (!pass.kept) continue;
+
+		if (pass.srcStages != 0) {
+			vkCmdPipelineBarrier(commandBuffer, pass.srcStages, pass.dstStages, 0, 0, nullptr,
+				static_cast<uint32_t>(pass.bufferBarriers.size()), pass.bufferBarriers.data(), static_cast<uint32_t>(pass.imageBarriers.size()), pass.imageBarriers.data());
+		}
+
+		pass.execute(commandBuffer);
+	}
+
+	if (m_finalSrcStages != 0) {
+		vkCmdPipelineBarrier(commandBuffer, m_finalSrcStages, m_finalDstStages, 0, 0, nullptr,
+			static_cast<uint32_t>(m_finalBufferBarriers.size()), m_finalBufferBarriers.data(), static_cast<uint32_t>(m_finalImageBarriers.size()), m_finalImageBarriers.data());
+	}
+
+	reset();
+}
+
+void RenderGraph::reset()
+{
+	m_resources.clear();
+	m_passes.clear();
+	m_finalSrcStages = 0;
+	m_finalDstStages = 0;
+	m_finalImageBarriers.clear();
+	m_finalBufferBarriers.clear();
+}
+
+void RenderGraph::destroyTransientSet(sTransientSet& transientSet)
+{
+	for (VkImageView imageView : transientSet.imageViews) vkDestroyImageView(*m_pLogicalDevice, imageView, nullptr);
+	for (VkImage image : transientSet.images) vkDestroyImage(*m_pLogicalDevice, image, nullptr);
+	for (VkDeviceMemory memory : transientSet.memoryBlocks) vkFreeMemory(*m_pLogicalDevice, memory, nullptr);
+
+	transientSet = {};
+}
+
+void RenderGraph::cleanup()
+{
+	for (auto& [frameIndex, transientSet] : m_transientSets) destroyTransientSet(transientSet);
+	m_transientSets.clear();
+	m_importedStates.clear();
+	reset();
+}
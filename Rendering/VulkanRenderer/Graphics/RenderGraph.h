@@ -0,0 +1,198 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+#include <cstdint>
+
+#include "../Utilities/Utilities.h"
+
+
+// How a pass uses a resource. Every usage maps to one stage, access and image layout, see RenderGraph::getUsageState.
+enum class eResourceUsage
+{
+	NONE,
+	COLOR_ATTACHMENT,
+	DEPTH_ATTACHMENT,
+	DEPTH_RESOLVE, // Single sample target of a subpass depth resolve, resolves are done at the colour output stage
+	DEPTH_READ, // Depth tested against but not written, in the read only depth layout
+	SAMPLED_FRAGMENT, // Sampled in a fragment shader, depth images use the read only depth layout
+	SAMPLED_COMPUTE,
+	COMPUTE_READ, // Storage image/buffer read in a compute shader, images are kept in VK_IMAGE_LAYOUT_GENERAL
+	COMPUTE_WRITE, // Storage image/buffer written (and possibly read) in a compute shader
+	INDIRECT_READ,
+	TRANSFER_READ,
+	TRANSFER_WRITE,
+	PRESENT
+};
+
+// Frame graph of passes that declare which resources they read and write.
+// Compiling it drops passes that don't contribute to an output, works out the barriers between passes (merging them into
+// one vkCmdPipelineBarrier per pass) and places transient images whose lifetimes don't overlap in the same memory.
+// The graph is rebuilt every frame, compiling is cheap and transient images are only recreated when their layout changes.
+class RenderGraph
+{
+public:
+	using ResourceHandle = uint32_t;
+
+	struct sImageDesc
+	{
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		VkImageUsageFlags usage = 0;
+		uint32_t mipLevels = 1;
+
+		bool operator==(const sImageDesc& other) const = default;
+	};
+
+	struct sUsageState
+	{
+		VkPipelineStageFlags stages;
+		VkAccessFlags access;
+		VkImageLayout layout;
+		bool writes;
+	};
+
+	class PassBuilder
+	{
+	public:
+		void read(ResourceHandle resource, eResourceUsage usage);
+		void write(ResourceHandle resource, eResourceUsage usage);
+		// Written without reading what was there before, e.g. a cleared attachment. Lets the layout transition discard the contents.
+		void overwrite(ResourceHandle resource, eResourceUsage usage);
+		// Keeps the pass even if nothing reads what it writes.
+		void sideEffect();
+
+	private:
+		RenderGraph* m_pGraph = nullptr;
+		uint32_t m_passIndex = 0;
+
+		friend class RenderGraph;
+	};
+
+	RenderGraph();
+
+	// Imported resources are owned outside the graph. Their state carries over from the last frame they were used in,
+	// the layout given here is only used the first time an image is seen.
+	ResourceHandle importImage(const std::string& name, VkImage image, VkFormat format, uint32_t mipLevels, VkImageLayout initialLayout);
+	// Swapchain images arrive through the acquire semaphore, which makes them available at waitStage.
+	ResourceHandle importSwapchainImage(const std::string& name, VkImage image, VkFormat format, VkPipelineStageFlags waitStage);
+	ResourceHandle importBuffer(const std::string& name, VkBuffer buffer);
+	// Transient images only live for the frame, their memory is shared with other transients that are never alive at the same time.
+	ResourceHandle createImage(const std::string& name, const sImageDesc& desc);
+
+	void addPass(const std::string& name, const std::function<void(PassBuilder&)>& setup, const std::function<void(VkCommandBuffer)>& execute);
+	// Passes contributing to an output are kept. The resource is left in the given usage's state after the last pass.
+	void markOutput(ResourceHandle resource, eResourceUsage finalUsage = eResourceUsage::NONE);
+
+	// frameIndex picks the set of transient images, so frames in flight never share them.
+	void compile(uint32_t frameIndex);
+	void execute(VkCommandBuffer commandBuffer);
+
+	VkImage getImage(ResourceHandle resource) { return m_resources[resource].image; }
+	VkImageView getImageView(ResourceHandle resource) { return m_resources[resource].imageView; }
+	VkBuffer getBuffer(ResourceHandle resource) { return m_resources[resource].buffer; }
+	// Changes whenever the frame's transient images are recreated, for anything built on them, e.g. views or framebuffers
+	uint64_t getTransientGeneration(uint32_t frameIndex) { return m_transientSets[frameIndex].generation; }
+
+	// Forgets the carried over state of imported resources, call when they have been recreated.
+	void resetImportedStates() { m_importedStates.clear(); }
+	// Forgets a single image's state, for when only some imported images have been replaced
+	void forgetImportedState(VkImage image);
+	void cleanup();
+
+	static sUsageState getUsageState(eResourceUsage usage, VkImageAspectFlags aspect);
+
+private:
+	struct sResourceState
+	{
+		VkPipelineStageFlags writeStages = 0; // Stages of the last write, or that the resource becomes available at
+		VkAccessFlags writeAccess = 0;
+		VkPipelineStageFlags visibleStages = 0; // Stages the last write has been made visible to
+		VkPipelineStageFlags readStages = 0; // Stages that have read since the last write
+		VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	};
+
+	struct sResource
+	{
+		std::string name;
+		bool transient = false;
+		sImageDesc desc = {};
+		VkImageAspectFlags aspect = 0;
+		VkImage image = VK_NULL_HANDLE;
+		VkImageView imageView = VK_NULL_HANDLE;
+		VkBuffer buffer = VK_NULL_HANDLE;
+		sResourceState state = {};
+
+		bool output = false;
+		eResourceUsage finalUsage = eResourceUsage::NONE;
+		uint32_t firstPass = UINT32_MAX; // Lifetime over the kept passes
+		uint32_t lastPass = 0;
+		int32_t aliasPredecessor = -1; // Transient that used the same memory before this one
+	};
+
+	struct sAccess
+	{
+		ResourceHandle resource;
+		eResourceUsage usage;
+		bool writes;
+		bool discard;
+	};
+
+	struct sPass
+	{
+		std::string name;
+		std::vector<sAccess> accesses;
+		std::function<void(VkCommandBuffer)> execute;
+		bool sideEffect = false;
+		bool kept = false;
+
+		VkPipelineStageFlags srcStages = 0;
+		VkPipelineStageFlags dstStages = 0;
+		std::vector<VkImageMemoryBarrier> imageBarriers;
+		std::vector<VkBufferMemoryBarrier> bufferBarriers;
+	};
+
+	// Transient images of one frame in flight, reused while the frame's transients and their lifetimes stay the same
+	struct sTransientSet
+	{
+		std::vector<sImageDesc> descs;
+		std::vector<std::pair<uint32_t, uint32_t>> lifetimes;
+		std::vector<VkImage> images;
+		std::vector<VkImageView> imageViews;
+		std::vector<int32_t> aliasPredecessors;
+		std::vector<VkDeviceMemory> memoryBlocks;
+		uint64_t generation = 0;
+	};
+
+	Utilities* m_pUtilities = nullptr;
+	VkDevice* m_pLogicalDevice = nullptr;
+
+	std::vector<sResource> m_resources = {};
+	std::vector<sPass> m_passes = {};
+	std::map<uint64_t, sResourceState> m_importedStates = {}; // Keyed by the Vulkan handle
+	std::map<uint32_t, sTransientSet> m_transientSets = {}; // Keyed by frame index
+	uint64_t m_transientGenerations = 0;
+
+	// Terminal barriers into the outputs' final usages
+	VkPipelineStageFlags m_finalSrcStages = 0;
+	VkPipelineStageFlags m_finalDstStages = 0;
+	std::vector<VkImageMemoryBarrier> m_finalImageBarriers = {};
+	std::vector<VkBufferMemoryBarrier> m_finalBufferBarriers = {};
+
+
+	void addAccess(uint32_t passIndex, ResourceHandle resource, eResourceUsage usage, bool writes, bool discard);
+	void cullPasses();
+	void allocateTransients(uint32_t frameIndex);
+	void destroyTransientSet(sTransientSet& transientSet);
+	void buildBarriers();
+	// Adds whatever barrier is needed to move the resource into the usage's state to the given lists
+	void transition(sResource& resource, const sUsageState& usageState, bool discard, VkPipelineStageFlags& srcStages, VkPipelineStageFlags& dstStages,
+		std::vector<VkImageMemoryBarrier>& imageBarriers, std::vector<VkBufferMemoryBarrier>& bufferBarriers);
+	void reset();
+};
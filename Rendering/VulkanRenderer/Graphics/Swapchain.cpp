@@ -11,9 +11,11 @@
 
 
 Swapchain::Swapchain() : m_pLogicalDevice(VulkanEngine::getInstance()->m_pLogicalDevice->getVkDevice()), m_pPhysicalDevice(VulkanEngine::getInstance()->m_pPhysicalDevice), m_pWindow(VulkanEngine::getInstance()->m_pWindow->getWindow()),
-	m_pSurface(VulkanEngine::getInstance()->m_pVkSurface), m_pBufferManager(VulkanEngine::getInstance()->m_pBufferManager), m_pUtilities(Utilities::getInstance())
+	m_pSurface(VulkanEngine::getInstance()->m_pVkSurface), m_pBufferManager(VulkanEngine::getInstance()->m_pBufferManager), m_pUtilities(Utilities::getInstance()),
+	m_headless(VulkanEngine::getInstance()->m_pWindow->isHeadless())
 {
-	createSwapchain();
+	if (m_headless) createOffscreenImages();
+	else createSwapchain();
 	createImageViews();
 };
 
@@ -76,7 +78,7 @@ VkExtent2D Swapchain::chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilit
 	}
 }
 
-void Swapchain::createSwapchain()
+void Swapchain::createSwapchain(VkSwapchainKHR oldSwapchain)
 {
 	//mDebugPrint("Creating swap chain...");
 	SwapChainSupportDetails swapChainSupport = m_pPhysicalDevice->querySwapChainSupport(*m_pPhysicalDevice->getVkPhysicalDevice());
@@ -103,6 +105,11 @@ void Swapchain::createSwapchain()
 		.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT
 	};
 
+	// With post-processing the frame is copied in from the scene colour image rather than drawn, with multiview from the views
+	sSettings::sGraphicsSettings& graphicsSettings = VulkanEngine::getInstance()->m_settings->graphicsSettings;
+	if (graphicsSettings.postProcessing || graphicsSettings.multiview != eMultiview::NONE) createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	if (VulkanEngine::getInstance()->m_settings->debugSettings.frameCapture) createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+
 	QueueFamilyIndices::sQueueFamilyIndices indices = QueueFamilyIndices::findQueueFamilies(*m_pPhysicalDevice->getVkPhysicalDevice(), *m_pSurface);
 	uint32_t queueFamilyIndices[] = { indices.graphicsFamily.value(), indices.presentFamily.value() };
 
@@ -125,7 +132,7 @@ void Swapchain::createSwapchain()
 	createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 	createInfo.presentMode = presentMode;
 	createInfo.clipped = VK_TRUE;
-	createInfo.oldSwapchain = VK_NULL_HANDLE;
+	createInfo.oldSwapchain = oldSwapchain;
 
 	if (vkCreateSwapchainKHR(*m_pLogicalDevice, &createInfo, nullptr, &m_swapchain) != VK_SUCCESS)
 	{
@@ -138,6 +145,42 @@ void Swapchain::createSwapchain()
 
 	m_swapchainImageFormat = surfaceFormat.format;
 	m_swapchainExtent = extent;
+	setRenderScale(m_renderScale);
+}
+
+void Swapchain::createOffscreenImages()
+{
+	sSettings::sWindowSettings windowSettings = VulkanEngine::getInstance()->m_settings->windowSettings;
+	uint32_t imageCount = m_pBufferManager->getFrameContexts()->getFrameCount();
+
+	// Same format a window would most likely get, so headless frames cost the same to draw
+	m_swapchainImageFormat = VK_FORMAT_B8G8R8A8_SRGB;
+	m_swapchainExtent = { .width = windowSettings.width, .height = windowSettings.height };
+
+	VkImageUsageFlags usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	sSettings::sGraphicsSettings& graphicsSettings = VulkanEngine::getInstance()->m_settings->graphicsSettings;
+	if (graphicsSettings.postProcessing || graphicsSettings.multiview != eMultiview::NONE) usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+
+	m_swapchainImages.resize(imageCount);
+	m_offscreenImagesMemory.resize(imageCount);
+	for (uint32_t i = 0; i < imageCount; i++)
+	{
+		Image::createImage(m_swapchainExtent.width, m_swapchainExtent.height, m_swapchainImageFormat, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_TILING_OPTIMAL,
+			usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_swapchainImages[i], m_offscreenImagesMemory[i]);
+	}
+
+	setRenderScale(m_renderScale);
+}
+
+void Swapchain::setRenderScale(float scale)
+{
+	m_renderScale = scale;
+
+	// Both sides are scaled together so the projection's aspect ratio still matches
+	m_renderExtent = {
+		.width = glm::clamp(static_cast<uint32_t>(m_swapchainExtent.width * scale + 0.5f), 1u, m_swapchainExtent.width),
+		.height = glm::clamp(static_cast<uint32_t>(m_swapchainExtent.height * scale + 0.5f), 1u, m_swapchainExtent.height)
+	};
 }
 
 void Swapchain::createImageViews()
@@ -153,21 +196,77 @@ void Swapchain::createImageViews()
 
 void Swapchain::recreateSwapchain(GLFWwindow* pWindow)
 {
+	// Offscreen images never go out of date
+	if (m_headless) return;
+
+	// A zero sized swapchain can't be created, Window::drawFrame picks the resize up again once the window is restored
 	int width = 0, height = 0;
 	glfwGetFramebufferSize(pWindow, &width, &height);
-	while (width == 0 || height == 0) {
-		glfwGetFramebufferSize(pWindow, &width, &height);
-		glfwWaitEvents();
-	}
+	if (width == 0 || height == 0) return;
 
-	vkDeviceWaitIdle(*m_pLogicalDevice);
+	DeletionQueue* pDeletionQueue = VulkanEngine::getInstance()->m_pDeletionQueue;
+	RenderGraph* pRenderGraph = m_pBufferManager->getRenderGraph();
+	Framebuffer* pFramebuffer = m_pBufferManager->getFramebuffer(); // Dynamic rendering has none, the views are picked up when recording
 
-	cleanup();
+	// Frames in flight keep using the old objects until they finish. Presentation isn't tracked by the timeline, so the old
+	// swapchain also waits for the frames submitted after the last present to it.
+	VkSwapchainKHR oldSwapchain = m_swapchain;
+	uint64_t presentsDoneValue = VulkanEngine::getInstance()->m_pGpuTimeline->getLastSubmittedValue() + m_pBufferManager->getFrameContexts()->getFrameCount();
+	pDeletionQueue->push(presentsDoneValue, [device = *m_pLogicalDevice, oldSwapchain]() { vkDestroySwapchainKHR(device, oldSwapchain, nullptr); });
 
-	createSwapchain();
+	pDeletionQueue->push([device = *m_pLogicalDevice, imageViews = m_swapchainImageViews]() {
+		for (VkImageView imageView : imageViews) {
+			vkDestroyImageView(device, imageView, nullptr);
+		}
+	});
+	if (pFramebuffer != nullptr) pFramebuffer->retire(pDeletionQueue);
+
+	for (VkImage image : m_swapchainImages) {
+		pRenderGraph->forgetImportedState(image);
+	}
+
+	VkExtent2D oldExtent = m_swapchainExtent;
+
+	createSwapchain(oldSwapchain);
 	createImageViews();
-	m_pBufferManager->getDepthBuffer()->createDepthResources();
-	m_pBufferManager->getFramebuffer()->createFramebuffers();
+
+	// Attachments that follow the swapchain's size are kept when only the swapchain itself went out of date
+	if (m_swapchainExtent.width != oldExtent.width || m_swapchainExtent.height != oldExtent.height)
+	{
+		DepthBuffer* pDepthBuffer = m_pBufferManager->getDepthBuffer();
+		pRenderGraph->forgetImportedState(*pDepthBuffer->getVkImage());
+		pDepthBuffer->retire(pDeletionQueue);
+		pDepthBuffer->createDepthResources();
+
+		MultisampleBuffer* pMultisampleBuffer = m_pBufferManager->getMultisampleBuffer();
+		if (pMultisampleBuffer != nullptr) {
+			pRenderGraph->forgetImportedState(*pMultisampleBuffer->getColorImage());
+			pRenderGraph->forgetImportedState(*pMultisampleBuffer->getDepthImage());
+			pMultisampleBuffer->retire(pDeletionQueue);
+			pMultisampleBuffer->createMultisampleResources();
+		}
+
+		HiZCuller* pHiZCuller = VulkanEngine::getInstance()->m_pHiZCuller;
+		if (pHiZCuller != nullptr) pHiZCuller->recreateDepthPyramid();
+
+		PostProcessChain* pPostProcessChain = VulkanEngine::getInstance()->m_pPostProcessChain;
+		if (pPostProcessChain != nullptr) pPostProcessChain->recreateSceneColor();
+
+		// Only its history follows the swapchain, the depth buffer and scene colour image are bound every frame
+		TemporalAA* pTemporalAA = VulkanEngine::getInstance()->m_pTemporalAA;
+		if (pTemporalAA != nullptr) pTemporalAA->recreateTargets();
+
+		MultiviewTarget* pMultiviewTarget = VulkanEngine::getInstance()->m_pMultiviewTarget;
+		if (pMultiviewTarget != nullptr) pMultiviewTarget->recreateTargets();
+	}
+
+	// Its composite framebuffers point at the swapchain images, so it follows every recreation
+	WeightedBlendedOIT* pWeightedBlendedOIT = VulkanEngine::getInstance()->m_pWeightedBlendedOIT;
+	if (pWeightedBlendedOIT != nullptr) pWeightedBlendedOIT->recreateTargets();
+	VisibilityBuffer* pVisibilityBuffer = VulkanEngine::getInstance()->m_pVisibilityBuffer;
+	if (pVisibilityBuffer != nullptr) pVisibilityBuffer->recreateTargets();
+
+	if (pFramebuffer != nullptr) pFramebuffer->createFramebuffers();
 }
 
 
@@ -176,12 +275,19 @@ void Swapchain::recreateSwapchain(GLFWwindow* pWindow)
 
 void Swapchain::cleanup()
 {
-	m_pBufferManager->getFramebuffer()->cleanup();
+	if (m_pBufferManager->getFramebuffer() != nullptr) m_pBufferManager->getFramebuffer()->cleanup();
 	m_pBufferManager->getDepthBuffer()->cleanup();
+	if (m_pBufferManager->getMultisampleBuffer() != nullptr) m_pBufferManager->getMultisampleBuffer()->cleanup();
 
 	for (auto imageView : m_swapchainImageViews) {
 		vkDestroyImageView(*m_pLogicalDevice, imageView, nullptr);
 	}
 
-	vkDestroySwapchainKHR(*m_pLogicalDevice, m_swapchain, nullptr);
+	if (m_headless) {
+		for (size_t i = 0; i < m_swapchainImages.size(); i++) {
+			vkDestroyImage(*m_pLogicalDevice, m_swapchainImages[i], nullptr);
+			vkFreeMemory(*m_pLogicalDevice, m_offscreenImagesMemory[i], nullptr);
+		}
+	}
+	else vkDestroySwapchainKHR(*m_pLogicalDevice, m_swapchain, nullptr);
 }
\ No newline at end of file
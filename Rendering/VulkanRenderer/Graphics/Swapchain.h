@@ -13,13 +13,26 @@ public:
 
 	void cleanup();
 
-	void createSwapchain();
+	// Passing the swapchain being replaced lets the driver hand its resources over to the new one
+	void createSwapchain(VkSwapchainKHR oldSwapchain = VK_NULL_HANDLE);
+	// Headless stand-in for the swapchain's images, one per frame context at the window settings' size. The frame is drawn
+	// to them exactly as it would be to a swapchain image, and they're left as transfer sources instead of being presented.
+	void createOffscreenImages();
 	void createImageViews();
+	// Replaces the swapchain without waiting for the device, the old objects go through the deletion queue.
+	// Does nothing while the window is minimised.
 	void recreateSwapchain(GLFWwindow* pWindow);
 
-	VkSwapchainKHR* getSwapchain() { return &m_swapchain; }
+	VkSwapchainKHR* getSwapchain() { return &m_swapchain; } // Null when headless
+	bool isHeadless() { return m_headless; }
 	VkExtent2D* getSwapchainExtent() { return &m_swapchainExtent; }
+	// Part of the swapchain sized attachments the frame is drawn into, anchored at the top left. Smaller than the swapchain
+	// only while dynamic resolution scales it down, see DynamicResolution.
+	VkExtent2D* getRenderExtent() { return &m_renderExtent; }
+	float getRenderScale() { return m_renderScale; }
+	void setRenderScale(float scale);
 	VkFormat* getSwapchainImageFormat() { return &m_swapchainImageFormat; }
+	std::vector<VkImage>* getSwapchainImages() { return &m_swapchainImages; }
 	std::vector<VkImageView>* getSwapchainImageViews() { return &m_swapchainImageViews; }
 
 private:
@@ -35,8 +48,12 @@ private:
 	std::vector<VkImage> m_swapchainImages = {};
 	VkFormat m_swapchainImageFormat = VK_FORMAT_UNDEFINED;
 	VkExtent2D m_swapchainExtent = {};
+	VkExtent2D m_renderExtent = {};
+	float m_renderScale = 1.0f;
 	std::vector<VkImageView> m_swapchainImageViews = {};
+	std::vector<VkDeviceMemory> m_offscreenImagesMemory = {}; // Only headless, swapchain images belong to the swapchain
 
+	bool m_headless = false;
 	bool m_firstRun = true;
 
 	VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
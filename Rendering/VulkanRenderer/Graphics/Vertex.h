@@ -63,6 +63,32 @@ struct Vertex {
 
 		return attributeDescriptions;
 	}
+
+	// Positions only, for the depth pre-pass. Split out of the vertices when a mesh is imported, see VertexBuffer.
+	static VkVertexInputBindingDescription getPositionBindingDescription()
+	{
+		VkVertexInputBindingDescription bindingDescription{
+			.binding = 0,
+			.stride = sizeof(glm::vec3),
+			.inputRate = VK_VERTEX_INPUT_RATE_VERTEX
+		};
+
+		return bindingDescription;
+	}
+
+	static std::array<VkVertexInputAttributeDescription, 1> getPositionAttributeDescriptions()
+	{
+		std::array<VkVertexInputAttributeDescription, 1> attributeDescriptions{
+			VkVertexInputAttributeDescription{
+				.location = 0,
+				.binding = 0,
+				.format = VK_FORMAT_R32G32B32_SFLOAT,
+				.offset = 0
+			}
+		};
+
+		return attributeDescriptions;
+	}
 };
 
 namespace std {
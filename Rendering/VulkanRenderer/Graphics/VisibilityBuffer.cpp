@@ -0,0 +1,1034 @@
+#include "../VulkanRenderer.h"
+#include "Buffers.h"
+#include "GraphicsPipeline.h"
+#include "Image.h"
+
+#include "VisibilityBuffer.h"
+
+
+
+VisibilityBuffer::VisibilityBuffer(uint32_t frameCount, std::vector<Model*>& models) : m_pUtilities(Utilities::getInstance()),
+	m_pLogicalDevice(VulkanEngine::getInstance()->m_pLogicalDevice->getVkDevice()), m_pBufferManager(VulkanEngine::getInstance()->m_pBufferManager),
+	m_pSwapchain(VulkanEngine::getInstance()->m_pSwapchain), m_pGraphicsSettings(&VulkanEngine::getInstance()->m_settings->graphicsSettings), m_frameCount(frameCount)
+{
+	m_colorFormat = VulkanEngine::getInstance()->getGraphicsPipeline()->getColorFormat();
+	createSceneBuffers(models);
+	createPerFrameBuffers();
+	createRenderPasses();
+	createPipelines();
+	createSceneDescriptorSets(models);
+	m_visibilityFramebuffers.resize(m_frameCount);
+	createFramebuffers();
+	createTargetDescriptorSets();
+}
+
+
+std::string VisibilityBuffer::findSceneLimit(const std::vector<Model*>& models)
+{
+	if (models.empty()) {
+		return "There are no models to copy into the visibility buffer's scene buffers.";
+	}
+	if (models.size() > sm_maxDraws) {
+		return std::format("{} models don't fit in the visibility buffer's {} draw ids.", models.size(), sm_maxDraws);
+	}
+
+	for (const Model* model : models) {
+		if (model->m_indices.size() / 3 > sm_maxTriangles) {
+			return std::format("The triangles of {} don't fit in the visibility buffer's {} triangle ids.", model->m_modelPath, sm_maxTriangles);
+		}
+		if (model->m_materialId >= sm_maxTextures) {
+			return std::format("The texture of {} doesn't fit in the visibility buffer's {} textures.", model->m_modelPath, sm_maxTextures);
+		}
+	}
+
+	return "";
+}
+
+void VisibilityBuffer::createSceneBuffers(std::vector<Model*>& models)
+{
+	mDebugPrint(std::format("Creating visibility buffer scene buffers ({} models)...", models.size()));
+
+	// The shading pass reads the vertices as an array of floats
+	static_assert(sizeof(Vertex) == 9 * sizeof(float), "VERTEX_FLOATS in visibilityShade.frag doesn't match Vertex");
+
+	// The ids and the texture index fit, findSceneLimit has been checked
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	m_draws.resize(models.size());
+	for (size_t i = 0; i < models.size(); i++) {
+		Model* model = models[i];
+		m_draws[i] = sDrawData{
+			.model = glm::mat4(1.0f),
+			.firstIndex = static_cast<uint32_t>(indices.size()),
+			.vertexOffset = static_cast<int32_t>(vertices.size()),
+			.textureIndex = model->m_materialId,
+			.opacity = 1.0f
+		};
+
+		vertices.insert(vertices.end(), model->m_vertices.begin(), model->m_vertices.end());
+		indices.insert(indices.end(), model->m_indices.begin(), model->m_indices.end());
+	}
+
+	// Vulkan doesn't allow empty buffers
+	if (vertices.empty()) vertices.push_back(Vertex{});
+	if (indices.empty()) indices.push_back(0);
+
+	uploadBuffer(vertices.data(), vertices.size() * sizeof(Vertex), m_sceneVertexBuffer, m_sceneVertexBufferMemory);
+	uploadBuffer(indices.data(), indices.size() * sizeof(uint32_t), m_sceneIndexBuffer, m_sceneIndexBufferMemory);
+}
+
+void VisibilityBuffer::uploadBuffer(const void* pData, VkDeviceSize bufferSize, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+{
+	VkBuffer stagingBuffer;
+	VkDeviceMemory stagingBufferMemory;
+	m_pBufferManager->createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+
+	void* data;
+	vkMapMemory(*m_pLogicalDevice, stagingBufferMemory, 0, bufferSize, 0, &data);
+	memcpy(data, pData, (size_t)bufferSize);
+	vkUnmapMemory(*m_pLogicalDevice, stagingBufferMemory);
+
+	m_pBufferManager->createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, bufferMemory);
+
+	m_pBufferManager->copyBuffer(stagingBuffer, buffer, bufferSize);
+
+	vkDestroyBuffer(*m_pLogicalDevice, stagingBuffer, nullptr);
+	vkFreeMemory(*m_pLogicalDevice, stagingBufferMemory, nullptr);
+}
+
+void VisibilityBuffer::createPerFrameBuffers()
+{
+	VkDeviceSize drawsSize = std::max<size_t>(m_draws.size(), 1) * sizeof(sDrawData);
+
+	m_paramsBuffers.resize(m_frameCount);
+	m_paramsBuffersMemory.resize(m_frameCount);
+	m_paramsBuffersMapped.resize(m_frameCount);
+	m_drawBuffers.resize(m_frameCount);
+	m_drawBuffersMemory.resize(m_frameCount);
+	m_drawBuffersMapped.resize(m_frameCount);
+
+	for (uint32_t i = 0; i < m_frameCount; i++) {
+		m_pBufferManager->createBuffer(sizeof(sFrameParams), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			m_paramsBuffers[i], m_paramsBuffersMemory[i]);
+		vkMapMemory(*m_pLogicalDevice, m_paramsBuffersMemory[i], 0, sizeof(sFrameParams), 0, &m_paramsBuffersMapped[i]);
+
+		m_pBufferManager->createBuffer(drawsSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			m_drawBuffers[i], m_drawBuffersMemory[i]);
+		vkMapMemory(*m_pLogicalDevice, m_drawBuffersMemory[i], 0, drawsSize, 0, &m_drawBuffersMapped[i]);
+	}
+}
+
+void VisibilityBuffer::createRenderPasses()
+{
+	if (m_pGraphicsSettings->dynamicRendering) return;
+
+	mDebugPrint("Creating visibility buffer render passes...");
+
+	// Layout changes are done by the render graph, see GraphicsPipeline::createRenderPass. The depth is kept for whatever
+	// reads it after the frame is drawn, like the transparent models and temporal AA.
+	std::array<VkAttachmentDescription2, 2> visibilityAttachments{
+		VkAttachmentDescription2{
+			.sType = VK_STRUCTURE_TYPE_ATTACHMENT_DESCRIPTION_2,
+			.format = sm_format,
+			.samples = VK_SAMPLE_COUNT_1_BIT,
+			.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+			.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+			.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+			.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+			.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+			.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+		},
+		VkAttachmentDescription2{
+			.sType = VK_STRUCTURE_TYPE_ATTACHMENT_DESCRIPTION_2,
+			.format = DepthBuffer::findDepthFormat(m_pBufferManager->m_pPhysicalDevice),
+			.samples = VK_SAMPLE_COUNT_1_BIT,
+			.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+			.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+			.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+			.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+			.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+			.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+		}
+	};
+
+	VkAttachmentReference2 visibilityAttachmentRef{
+		.sType = VK_STRUCTURE_TYPE_ATTACHMENT_REFERENCE_2,
+		.attachment = 0,
+		.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+		.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT
+	};
+
+	VkAttachmentReference2 depthAttachmentRef{
+		.sType = VK_STRUCTURE_TYPE_ATTACHMENT_REFERENCE_2,
+		.attachment = 1,
+		.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+		.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT
+	};
+
+	VkSubpassDescription2 visibilitySubpass{
+		.sType = VK_STRUCTURE_TYPE_SUBPASS_DESCRIPTION_2,
+		.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+		.colorAttachmentCount = 1,
+		.pColorAttachments = &visibilityAttachmentRef,
+		.pDepthStencilAttachment = &depthAttachmentRef
+	};
+
+	VkRenderPassCreateInfo2 visibilityInfo{
+		.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO_2,
+		.attachmentCount = static_cast<uint32_t>(visibilityAttachments.size()),
+		.pAttachments = visibilityAttachments.data(),
+		.subpassCount = 1,
+		.pSubpasses = &visibilitySubpass,
+		.dependencyCount = 0,
+		.pDependencies = nullptr
+	};
+
+	if (vkCreateRenderPass2(*m_pLogicalDevice, &visibilityInfo, nullptr, &m_visibilityRenderPass) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create visibility render pass!");
+	}
+
+	// Cleared like the main pass, the pixels no triangle covers keep the clear colour
+	VkAttachmentDescription2 colorAttachment{
+		.sType = VK_STRUCTURE_TYPE_ATTACHMENT_DESCRIPTION_2,
+		.format = m_colorFormat,
+		.samples = VK_SAMPLE_COUNT_1_BIT,
+		.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+		.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+		.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+		.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+		.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+		.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+	};
+
+	VkAttachmentReference2 colorAttachmentRef{
+		.sType = VK_STRUCTURE_TYPE_ATTACHMENT_REFERENCE_2,
+		.attachment = 0,
+		.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+		.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT
+	};
+
+	VkSubpassDescription2 shadingSubpass{
+		.sType = VK_STRUCTURE_TYPE_SUBPASS_DESCRIPTION_2,
+		.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+		.colorAttachmentCount = 1,
+		.pColorAttachments = &colorAttachmentRef
+	};
+
+	VkRenderPassCreateInfo2 shadingInfo{
+		.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO_2,
+		.attachmentCount = 1,
+		.pAttachments = &colorAttachment,
+		.subpassCount = 1,
+		.pSubpasses = &shadingSubpass,
+		.dependencyCount = 0,
+		.pDependencies = nullptr
+	};
+
+	if (vkCreateRenderPass2(*m_pLogicalDevice, &shadingInfo, nullptr, &m_shadingRenderPass) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create visibility shading render pass!");
+	}
+}
+
+void VisibilityBuffer::createPipelines()
+{
+	mDebugPrint("Creating visibility buffer pipelines...");
+
+	VkSamplerCreateInfo samplerInfo{
+		.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+		.magFilter = VK_FILTER_NEAREST,
+		.minFilter = VK_FILTER_NEAREST,
+		.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+		.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+		.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+		.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+		.mipLodBias = 0.0f,
+		.anisotropyEnable = VK_FALSE,
+		.maxAnisotropy = 1.0f,
+		.compareEnable = VK_FALSE,
+		.compareOp = VK_COMPARE_OP_ALWAYS,
+		.minLod = 0.0f,
+		.maxLod = 0.0f,
+		.borderColor = VK_BORDER_COLOR_INT_TRANSPARENT_BLACK,
+		.unnormalizedCoordinates = VK_FALSE
+	};
+
+	// The target is only read with texelFetch, the sampler just has to exist
+	if (vkCreateSampler(*m_pLogicalDevice, &samplerInfo, nullptr, &m_targetSampler) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create visibility target sampler!");
+	}
+
+	// Frame parameters, draws, scene vertices, scene indices, material textures
+	std::array<VkDescriptorSetLayoutBinding, 5> sceneBindings{
+		VkDescriptorSetLayoutBinding{
+			.binding = 0,
+			.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT
+		},
+		VkDescriptorSetLayoutBinding{
+			.binding = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT
+		},
+		VkDescriptorSetLayoutBinding{
+			.binding = 2,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT
+		},
+		VkDescriptorSetLayoutBinding{
+			.binding = 3,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT
+		},
+		VkDescriptorSetLayoutBinding{
+			.binding = 4,
+			.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.descriptorCount = sm_maxTextures,
+			.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT
+		}
+	};
+
+	VkDescriptorSetLayoutCreateInfo sceneLayoutInfo{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.bindingCount = static_cast<uint32_t>(sceneBindings.size()),
+		.pBindings = sceneBindings.data()
+	};
+
+	if (vkCreateDescriptorSetLayout(*m_pLogicalDevice, &sceneLayoutInfo, nullptr, &m_sceneSetLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create visibility scene descriptor set layout!");
+	}
+
+	VkDescriptorSetLayoutBinding targetBinding{
+		.binding = 0,
+		.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		.descriptorCount = 1,
+		.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT
+	};
+
+	VkDescriptorSetLayoutCreateInfo targetLayoutInfo{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.bindingCount = 1,
+		.pBindings = &targetBinding
+	};
+
+	if (vkCreateDescriptorSetLayout(*m_pLogicalDevice, &targetLayoutInfo, nullptr, &m_targetSetLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create visibility target descriptor set layout!");
+	}
+
+	VkPipelineLayoutCreateInfo visibilityLayoutInfo{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.setLayoutCount = 1,
+		.pSetLayouts = &m_sceneSetLayout,
+		.pushConstantRangeCount = 0,
+		.pPushConstantRanges = nullptr
+	};
+
+	if (vkCreatePipelineLayout(*m_pLogicalDevice, &visibilityLayoutInfo, nullptr, &m_visibilityPipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create visibility pipeline layout!");
+	}
+
+	GraphicsPipeline* pGraphicsPipeline = VulkanEngine::getInstance()->getGraphicsPipeline();
+	std::array<VkDescriptorSetLayout, 4> shadingSetLayouts = { m_sceneSetLayout, *pGraphicsPipeline->getLightSetLayout(), *pGraphicsPipeline->getShadowSetLayout(), m_targetSetLayout };
+
+	VkPipelineLayoutCreateInfo shadingLayoutInfo{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.setLayoutCount = static_cast<uint32_t>(shadingSetLayouts.size()),
+		.pSetLayouts = shadingSetLayouts.data(),
+		.pushConstantRangeCount = 0,
+		.pPushConstantRanges = nullptr
+	};
+
+	if (vkCreatePipelineLayout(*m_pLogicalDevice, &shadingLayoutInfo, nullptr, &m_shadingPipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create visibility shading pipeline layout!");
+	}
+
+	// State shared by both pipelines
+	VkPipelineInputAssemblyStateCreateInfo inputAssembly{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+		.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+		.primitiveRestartEnable = VK_FALSE
+	};
+
+	VkPipelineViewportStateCreateInfo viewportState{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+		.viewportCount = 1,
+		.pViewports = nullptr, // Dynamic
+		.scissorCount = 1,
+		.pScissors = nullptr // Dynamic
+	};
+
+	VkPipelineMultisampleStateCreateInfo multisampling{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+		.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+		.sampleShadingEnable = VK_FALSE
+	};
+
+	VkPipelineColorBlendAttachmentState colorBlendAttachment{
+		.blendEnable = VK_FALSE,
+		.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT
+	};
+
+	VkPipelineColorBlendStateCreateInfo colorBlending{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+		.logicOpEnable = VK_FALSE,
+		.attachmentCount = 1,
+		.pAttachments = &colorBlendAttachment
+	};
+
+	std::array<VkDynamicState, 2> dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+	VkPipelineDynamicStateCreateInfo dynamicState{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+		.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size()),
+		.pDynamicStates = dynamicStates.data()
+	};
+
+
+	// Visibility pass: the position stream, depth tested and written like the main pass, always solid
+	std::array<VkPipelineShaderStageCreateInfo, 2> visibilityStages{
+		VkPipelineShaderStageCreateInfo{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			.stage = VK_SHADER_STAGE_VERTEX_BIT,
+			.module = GraphicsPipeline::loadShaderModule(*m_pLogicalDevice, "visibility.vert"),
+			.pName = "main"
+		},
+		VkPipelineShaderStageCreateInfo{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			.stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+			.module = GraphicsPipeline::loadShaderModule(*m_pLogicalDevice, "visibility.frag"),
+			.pName = "main"
+		}
+	};
+
+	VkVertexInputBindingDescription bindingDescription = Vertex::getPositionBindingDescription();
+	std::array<VkVertexInputAttributeDescription, 1> attributeDescriptions = Vertex::getPositionAttributeDescriptions();
+	VkPipelineVertexInputStateCreateInfo visibilityVertexInput{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+		.vertexBindingDescriptionCount = 1,
+		.pVertexBindingDescriptions = &bindingDescription,
+		.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size()),
+		.pVertexAttributeDescriptions = attributeDescriptions.data()
+	};
+
+	VkPipelineRasterizationStateCreateInfo visibilityRasterizer{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+		.depthClampEnable = m_pGraphicsSettings->rasterizerDepthClamp,
+		.rasterizerDiscardEnable = VK_FALSE,
+		.polygonMode = VK_POLYGON_MODE_FILL,
+		.cullMode = VK_CULL_MODE_BACK_BIT,
+		.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE,
+		.depthBiasEnable = VK_FALSE,
+		.lineWidth = 1.0f
+	};
+
+	VkPipelineDepthStencilStateCreateInfo visibilityDepthStencil{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+		.depthTestEnable = VK_TRUE,
+		.depthWriteEnable = VK_TRUE,
+		.depthCompareOp = VK_COMPARE_OP_LESS,
+		.depthBoundsTestEnable = VK_FALSE,
+		.stencilTestEnable = VK_FALSE,
+		.minDepthBounds = 0.0f,
+		.maxDepthBounds = 1.0f
+	};
+
+	VkFormat depthFormat = DepthBuffer::findDepthFormat(m_pBufferManager->m_pPhysicalDevice);
+	VkPipelineRenderingCreateInfoKHR visibilityRenderingInfo{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR,
+		.viewMask = 0,
+		.colorAttachmentCount = 1,
+		.pColorAttachmentFormats = &sm_format,
+		.depthAttachmentFormat = depthFormat,
+		.stencilAttachmentFormat = VK_FORMAT_UNDEFINED
+	};
+
+	VkGraphicsPipelineCreateInfo visibilityPipelineInfo{
+		.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+		.pNext = m_pGraphicsSettings->dynamicRendering ? &visibilityRenderingInfo : nullptr,
+		.stageCount = static_cast<uint32_t>(visibilityStages.size()),
+		.pStages = visibilityStages.data(),
+		.pVertexInputState = &visibilityVertexInput,
+		.pInputAssemblyState = &inputAssembly,
+		.pViewportState = &viewportState,
+		.pRasterizationState = &visibilityRasterizer,
+		.pMultisampleState = &multisampling,
+		.pDepthStencilState = &visibilityDepthStencil,
+		.pColorBlendState = &colorBlending,
+		.pDynamicState = &dynamicState,
+		.layout = m_visibilityPipelineLayout,
+		.renderPass = m_visibilityRenderPass,
+		.subpass = 0,
+		.basePipelineHandle = VK_NULL_HANDLE,
+		.basePipelineIndex = -1
+	};
+
+	if (vkCreateGraphicsPipelines(*m_pLogicalDevice, VK_NULL_HANDLE, 1, &visibilityPipelineInfo, nullptr, &m_visibilityPipeline) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create visibility pipeline!");
+	}
+
+
+	// Shading pass: a single triangle covering the screen, made up in the vertex shader
+	std::array<VkPipelineShaderStageCreateInfo, 2> shadingStages{
+		VkPipelineShaderStageCreateInfo{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			.stage = VK_SHADER_STAGE_VERTEX_BIT,
+			.module = GraphicsPipeline::loadShaderModule(*m_pLogicalDevice, "visibilityShade.vert"),
+			.pName = "main"
+		},
+		VkPipelineShaderStageCreateInfo{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			.stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+			.module = GraphicsPipeline::loadShaderModule(*m_pLogicalDevice, "visibilityShade.frag"),
+			.pName = "main"
+		}
+	};
+
+	VkPipelineVertexInputStateCreateInfo shadingVertexInput{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+		.vertexBindingDescriptionCount = 0,
+		.vertexAttributeDescriptionCount = 0
+	};
+
+	VkPipelineRasterizationStateCreateInfo shadingRasterizer{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+		.depthClampEnable = VK_FALSE,
+		.rasterizerDiscardEnable = VK_FALSE,
+		.polygonMode = VK_POLYGON_MODE_FILL,
+		.cullMode = VK_CULL_MODE_NONE,
+		.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE,
+		.depthBiasEnable = VK_FALSE,
+		.lineWidth = 1.0f
+	};
+
+	VkPipelineDepthStencilStateCreateInfo shadingDepthStencil{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+		.depthTestEnable = VK_FALSE,
+		.depthWriteEnable = VK_FALSE,
+		.depthCompareOp = VK_COMPARE_OP_ALWAYS,
+		.depthBoundsTestEnable = VK_FALSE,
+		.stencilTestEnable = VK_FALSE,
+		.minDepthBounds = 0.0f,
+		.maxDepthBounds = 1.0f
+	};
+
+	VkPipelineRenderingCreateInfoKHR shadingRenderingInfo{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR,
+		.viewMask = 0,
+		.colorAttachmentCount = 1,
+		.pColorAttachmentFormats = &m_colorFormat,
+		.depthAttachmentFormat = VK_FORMAT_UNDEFINED,
+		.stencilAttachmentFormat = VK_FORMAT_UNDEFINED
+	};
+
+	VkGraphicsPipelineCreateInfo shadingPipelineInfo{
+		.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+		.pNext = m_pGraphicsSettings->dynamicRendering ? &shadingRenderingInfo : nullptr,
+		.stageCount = static_cast<uint32_t>(shadingStages.size()),
+		.pStages = shadingStages.data(),
+		.pVertexInputState = &shadingVertexInput,
+		.pInputAssemblyState = &inputAssembly,
+		.pViewportState = &viewportState,
+		.pRasterizationState = &shadingRasterizer,
+		.pMultisampleState = &multisampling,
+		.pDepthStencilState = &shadingDepthStencil,
+		.pColorBlendState = &colorBlending,
+		.pDynamicState = &dynamicState,
+		.layout = m_shadingPipelineLayout,
+		.renderPass = m_shadingRenderPass,
+		.subpass = 0,
+		.basePipelineHandle = VK_NULL_HANDLE,
+		.basePipelineIndex = -1
+	};
+
+	if (vkCreateGraphicsPipelines(*m_pLogicalDevice, VK_NULL_HANDLE, 1, &shadingPipelineInfo, nullptr, &m_shadingPipeline) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create visibility shading pipeline!");
+	}
+
+	for (const VkPipelineShaderStageCreateInfo& shaderStage : visibilityStages) {
+		vkDestroyShaderModule(*m_pLogicalDevice, shaderStage.module, nullptr);
+	}
+	for (const VkPipelineShaderStageCreateInfo& shaderStage : shadingStages) {
+		vkDestroyShaderModule(*m_pLogicalDevice, shaderStage.module, nullptr);
+	}
+}
+
+void VisibilityBuffer::createSceneDescriptorSets(std::vector<Model*>& models)
+{
+	// The unused texture slots are filled with the first model's, see below
+	if (models.empty()) {
+		throw std::runtime_error("failed to create visibility scene descriptor sets without models!");
+	}
+
+	std::array<VkDescriptorPoolSize, 3> poolSizes{
+		VkDescriptorPoolSize{ .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, .descriptorCount = m_frameCount },
+		VkDescriptorPoolSize{ .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 3 * m_frameCount },
+		VkDescriptorPoolSize{ .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = sm_maxTextures * m_frameCount }
+	};
+
+	VkDescriptorPoolCreateInfo poolInfo{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.maxSets = m_frameCount,
+		.poolSizeCount = static_cast<uint32_t>(poolSizes.size()),
+		.pPoolSizes = poolSizes.data()
+	};
+
+	if (vkCreateDescriptorPool(*m_pLogicalDevice, &poolInfo, nullptr, &m_sceneDescriptorPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create visibility scene descriptor pool!");
+	}
+
+	std::vector<VkDescriptorSetLayout> layouts(m_frameCount, m_sceneSetLayout);
+	VkDescriptorSetAllocateInfo allocInfo{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.descriptorPool = m_sceneDescriptorPool,
+		.descriptorSetCount = m_frameCount,
+		.pSetLayouts = layouts.data()
+	};
+
+	m_sceneSets.resize(m_frameCount);
+	if (vkAllocateDescriptorSets(*m_pLogicalDevice, &allocInfo, m_sceneSets.data()) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate visibility scene descriptor sets!");
+	}
+
+	// Slot n holds the texture of the models with material id n. Every slot has to be valid, so the unused ones repeat the
+	// first model's.
+	std::array<VkDescriptorImageInfo, sm_maxTextures> textureInfos{};
+	for (int32_t i = static_cast<int32_t>(models.size()) - 1; i >= 0; i--) {
+		Model* model = models[i];
+		textureInfos[model->m_materialId] = VkDescriptorImageInfo{
+			.sampler = *model->m_pTextureImage->getVkTextureSampler(),
+			.imageView = *model->m_pTextureImage->getVkTextureImageView(),
+			.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+		};
+	}
+	for (VkDescriptorImageInfo& textureInfo : textureInfos) {
+		if (textureInfo.imageView == VK_NULL_HANDLE) textureInfo = textureInfos[models.front()->m_materialId];
+	}
+
+	VkDescriptorBufferInfo vertexInfo{ .buffer = m_sceneVertexBuffer, .offset = 0, .range = VK_WHOLE_SIZE };
+	VkDescriptorBufferInfo indexInfo{ .buffer = m_sceneIndexBuffer, .offset = 0, .range = VK_WHOLE_SIZE };
+
+	for (uint32_t i = 0; i < m_frameCount; i++) {
+		VkDescriptorBufferInfo paramsInfo{ .buffer = m_paramsBuffers[i], .offset = 0, .range = sizeof(sFrameParams) };
+		VkDescriptorBufferInfo drawsInfo{ .buffer = m_drawBuffers[i], .offset = 0, .range = VK_WHOLE_SIZE };
+
+		std::array<VkWriteDescriptorSet, 5> descriptorWrites{
+			VkWriteDescriptorSet{
+				.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+				.dstSet = m_sceneSets[i],
+				.dstBinding = 0,
+				.descriptorCount = 1,
+				.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+				.pBufferInfo = &paramsInfo
+			},
+			VkWriteDescriptorSet{
+				.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+				.dstSet = m_sceneSets[i],
+				.dstBinding = 1,
+				.descriptorCount = 1,
+				.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				.pBufferInfo = &drawsInfo
+			},
+			VkWriteDescriptorSet{
+				.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+				.dstSet = m_sceneSets[i],
+				.dstBinding = 2,
+				.descriptorCount = 1,
+				.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				.pBufferInfo = &vertexInfo
+			},
+			VkWriteDescriptorSet{
+				.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+				.dstSet = m_sceneSets[i],
+				.dstBinding = 3,
+				.descriptorCount = 1,
+				.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				.pBufferInfo = &indexInfo
+			},
+			VkWriteDescriptorSet{
+				.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+				.dstSet = m_sceneSets[i],
+				.dstBinding = 4,
+				.descriptorCount = sm_maxTextures,
+				.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				.pImageInfo = textureInfos.data()
+			}
+		};
+
+		vkUpdateDescriptorSets(*m_pLogicalDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+	}
+}
+
+void VisibilityBuffer::createFramebuffers()
+{
+	if (m_pGraphicsSettings->dynamicRendering) return;
+
+	VkExtent2D extent = *m_pSwapchain->getSwapchainExtent();
+
+	// The visibility framebuffers wait for the frames' transients, see getVisibilityFramebuffer
+	m_shadingFramebuffers.resize(m_pSwapchain->getSwapchainImageViews()->size());
+	for (uint32_t i = 0; i < m_shadingFramebuffers.size(); i++) {
+		VkImageView frameImageView = getFrameImageView(i);
+
+		VkFramebufferCreateInfo shadingInfo{
+			.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+			.renderPass = m_shadingRenderPass,
+			.attachmentCount = 1,
+			.pAttachments = &frameImageView,
+			.width = extent.width,
+			.height = extent.height,
+			.layers = 1
+		};
+
+		if (vkCreateFramebuffer(*m_pLogicalDevice, &shadingInfo, nullptr, &m_shadingFramebuffers[i]) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create visibility shading framebuffer!");
+		}
+	}
+}
+
+void VisibilityBuffer::createTargetDescriptorSets()
+{
+	VkDescriptorPoolSize poolSize{
+		.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		.descriptorCount = m_frameCount
+	};
+
+	VkDescriptorPoolCreateInfo poolInfo{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.maxSets = m_frameCount,
+		.poolSizeCount = 1,
+		.pPoolSizes = &poolSize
+	};
+
+	if (vkCreateDescriptorPool(*m_pLogicalDevice, &poolInfo, nullptr, &m_targetDescriptorPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create visibility target descriptor pool!");
+	}
+
+	std::vector<VkDescriptorSetLayout> layouts(m_frameCount, m_targetSetLayout);
+	m_targetSets.resize(m_frameCount);
+
+	VkDescriptorSetAllocateInfo allocInfo{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.descriptorPool = m_targetDescriptorPool,
+		.descriptorSetCount = m_frameCount,
+		.pSetLayouts = layouts.data()
+	};
+
+	if (vkAllocateDescriptorSets(*m_pLogicalDevice, &allocInfo, m_targetSets.data()) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate visibility target descriptor sets!");
+	}
+}
+
+VkFramebuffer VisibilityBuffer::getVisibilityFramebuffer(uint32_t frameIndex, VkImageView visibilityView)
+{
+	// The frame's last use of its framebuffer has finished by the time it's recorded again, so it can go right away
+	sVisibilityFramebuffer& visibilityFramebuffer = m_visibilityFramebuffers[frameIndex];
+	uint64_t transientGeneration = m_pBufferManager->getRenderGraph()->getTransientGeneration(frameIndex);
+	if (visibilityFramebuffer.framebuffer != VK_NULL_HANDLE && visibilityFramebuffer.transientGeneration == transientGeneration) {
+		return visibilityFramebuffer.framebuffer;
+	}
+
+	if (visibilityFramebuffer.framebuffer != VK_NULL_HANDLE) vkDestroyFramebuffer(*m_pLogicalDevice, visibilityFramebuffer.framebuffer, nullptr);
+
+	VkExtent2D extent = *m_pSwapchain->getSwapchainExtent();
+
+	std::array<VkImageView, 2> attachments = { visibilityView, *m_pBufferManager->getDepthBuffer()->getVkImageView() };
+
+	VkFramebufferCreateInfo framebufferInfo{
+		.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+		.renderPass = m_visibilityRenderPass,
+		.attachmentCount = static_cast<uint32_t>(attachments.size()),
+		.pAttachments = attachments.data(),
+		.width = extent.width,
+		.height = extent.height,
+		.layers = 1
+	};
+
+	if (vkCreateFramebuffer(*m_pLogicalDevice, &framebufferInfo, nullptr, &visibilityFramebuffer.framebuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create visibility framebuffer!");
+	}
+	visibilityFramebuffer.transientGeneration = transientGeneration;
+
+	return visibilityFramebuffer.framebuffer;
+}
+
+VkImageView VisibilityBuffer::getFrameImageView(uint32_t imageIndex)
+{
+	PostProcessChain* pPostProcessChain = m_pBufferManager->m_pPostProcessChain;
+	return pPostProcessChain != nullptr ? *pPostProcessChain->getSceneColorImageView() : m_pSwapchain->getSwapchainImageViews()->at(imageIndex);
+}
+
+
+
+void VisibilityBuffer::updateDraws(uint32_t frameIndex, const glm::mat4& view, const glm::mat4& proj, std::vector<Model*>& models)
+{
+	VkExtent2D renderExtent = *m_pSwapchain->getRenderExtent();
+
+	// Safe to write, the frame's fence has already been waited on
+	*static_cast<sFrameParams*>(m_paramsBuffersMapped[frameIndex]) = sFrameParams{
+		.view = view,
+		.proj = proj,
+		.renderSize = glm::vec4(renderExtent.width, renderExtent.height, 1.0f / renderExtent.width, 1.0f / renderExtent.height)
+	};
+
+	for (size_t i = 0; i < models.size(); i++) {
+		m_draws[i].model = models[i]->getTransform();
+		m_draws[i].opacity = models[i]->m_opacity;
+	}
+	memcpy(m_drawBuffersMapped[frameIndex], m_draws.data(), m_draws.size() * sizeof(sDrawData));
+}
+
+void VisibilityBuffer::recordVisibility(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkImageView visibilityView)
+{
+	VkExtent2D renderExtent = *m_pSwapchain->getRenderExtent();
+
+	// No draw or triangle, and the far plane
+	std::array<VkClearValue, 2> clearValues{};
+	clearValues[0].color.uint32[0] = UINT32_MAX;
+	clearValues[1].depthStencil = { 1.0f, 0 };
+
+	if (m_pGraphicsSettings->dynamicRendering) {
+		VkRenderingAttachmentInfoKHR visibilityAttachment{
+			.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR,
+			.imageView = visibilityView,
+			.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+			.resolveMode = VK_RESOLVE_MODE_NONE,
+			.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+			.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+			.clearValue = clearValues[0]
+		};
+
+		VkRenderingAttachmentInfoKHR depthAttachment{
+			.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR,
+			.imageView = *m_pBufferManager->getDepthBuffer()->getVkImageView(),
+			.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+			.resolveMode = VK_RESOLVE_MODE_NONE,
+			.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+			.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+			.clearValue = clearValues[1]
+		};
+
+		VkRenderingInfoKHR renderingInfo{
+			.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR,
+			.renderArea {
+				.offset = { 0, 0 },
+				.extent = renderExtent
+			},
+			.layerCount = 1,
+			.viewMask = 0,
+			.colorAttachmentCount = 1,
+			.pColorAttachments = &visibilityAttachment,
+			.pDepthAttachment = &depthAttachment,
+			.pStencilAttachment = nullptr
+		};
+
+		m_pBufferManager->m_vkCmdBeginRendering(commandBuffer, &renderingInfo);
+	}
+	else {
+		VkRenderPassBeginInfo renderPassInfo{
+			.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+			.renderPass = m_visibilityRenderPass,
+			.framebuffer = getVisibilityFramebuffer(frameIndex, visibilityView),
+			.renderArea {
+				.offset = { 0, 0 },
+				.extent = renderExtent,
+			},
+			.clearValueCount = static_cast<uint32_t>(clearValues.size()),
+			.pClearValues = clearValues.data()
+		};
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+	}
+
+	VkViewport viewport{
+		.x = 0.0f,
+		.y = 0.0f,
+		.width = static_cast<float>(renderExtent.width),
+		.height = static_cast<float>(renderExtent.height),
+		.minDepth = 0.0f,
+		.maxDepth = 1.0f
+	};
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+	VkRect2D scissor{
+		.offset = { 0, 0 },
+		.extent = renderExtent
+	};
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+	// One set for every draw, they only differ in their buffers and in the draw id, which goes in as the first instance
+	DrawEncoder& drawEncoder = m_pBufferManager->m_drawEncoder;
+	drawEncoder.begin(commandBuffer);
+	drawEncoder.bindPipeline(m_visibilityPipeline);
+	drawEncoder.bindDescriptorSet(m_visibilityPipelineLayout, m_sceneSets[frameIndex]);
+
+	for (const sDrawPacket& packet : m_pBufferManager->m_drawQueue.getPassPackets(DrawQueue::PASS_MAIN)) {
+		Model* model = m_pBufferManager->m_pLoadedModels->at(packet.modelIndex);
+
+		drawEncoder.bindVertexBuffer(*model->m_pVertexBuffer->getVkPositionBuffer());
+		drawEncoder.bindIndexBuffer(*model->m_pIndexBuffer->getVkIndexBuffer());
+		vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(model->m_pIndexBuffer->m_indices.size()), 1, 0, 0, packet.modelIndex);
+	}
+
+	if (m_pGraphicsSettings->dynamicRendering) {
+		m_pBufferManager->m_vkCmdEndRendering(commandBuffer);
+	}
+	else {
+		vkCmdEndRenderPass(commandBuffer);
+	}
+}
+
+void VisibilityBuffer::recordShading(VkCommandBuffer commandBuffer, uint32_t frameIndex, uint32_t imageIndex, VkImageView visibilityView)
+{
+	VkExtent2D renderExtent = *m_pSwapchain->getRenderExtent();
+	VkClearValue clearValue{ {{0.1f, 0.1f, 0.1f, 1.0f}} }; // The main pass' clear colour
+
+	// The frame's last use of its set has finished by the time it's recorded again
+	VkDescriptorImageInfo imageInfo{ .sampler = m_targetSampler, .imageView = visibilityView, .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+
+	VkWriteDescriptorSet descriptorWrite{
+		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+		.dstSet = m_targetSets[frameIndex],
+		.dstBinding = 0,
+		.descriptorCount = 1,
+		.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		.pImageInfo = &imageInfo
+	};
+
+	vkUpdateDescriptorSets(*m_pLogicalDevice, 1, &descriptorWrite, 0, nullptr);
+
+	if (m_pGraphicsSettings->dynamicRendering) {
+		VkRenderingAttachmentInfoKHR colorAttachment{
+			.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR,
+			.imageView = getFrameImageView(imageIndex),
+			.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+			.resolveMode = VK_RESOLVE_MODE_NONE,
+			.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+			.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+			.clearValue = clearValue
+		};
+
+		VkRenderingInfoKHR renderingInfo{
+			.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR,
+			.renderArea {
+				.offset = { 0, 0 },
+				.extent = renderExtent
+			},
+			.layerCount = 1,
+			.viewMask = 0,
+			.colorAttachmentCount = 1,
+			.pColorAttachments = &colorAttachment,
+			.pDepthAttachment = nullptr,
+			.pStencilAttachment = nullptr
+		};
+
+		m_pBufferManager->m_vkCmdBeginRendering(commandBuffer, &renderingInfo);
+	}
+	else {
+		VkRenderPassBeginInfo renderPassInfo{
+			.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+			.renderPass = m_shadingRenderPass,
+			.framebuffer = m_shadingFramebuffers[imageIndex],
+			.renderArea {
+				.offset = { 0, 0 },
+				.extent = renderExtent,
+			},
+			.clearValueCount = 1,
+			.pClearValues = &clearValue
+		};
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+	}
+
+	VkViewport viewport{
+		.x = 0.0f,
+		.y = 0.0f,
+		.width = static_cast<float>(renderExtent.width),
+		.height = static_cast<float>(renderExtent.height),
+		.minDepth = 0.0f,
+		.maxDepth = 1.0f
+	};
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+	VkRect2D scissor{
+		.offset = { 0, 0 },
+		.extent = renderExtent
+	};
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+	std::array<VkDescriptorSet, 4> sets = {
+		m_sceneSets[frameIndex],
+		*m_pBufferManager->m_pClusteredLighting->getDescriptorSet(frameIndex),
+		*m_pBufferManager->m_pCascadedShadows->getDescriptorSet(frameIndex),
+		m_targetSets[frameIndex]
+	};
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_shadingPipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_shadingPipelineLayout, 0, static_cast<uint32_t>(sets.size()), sets.data(), 0, nullptr);
+	vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+
+	if (m_pGraphicsSettings->dynamicRendering) {
+		m_pBufferManager->m_vkCmdEndRendering(commandBuffer);
+	}
+	else {
+		vkCmdEndRenderPass(commandBuffer);
+	}
+}
+
+
+
+void VisibilityBuffer::recreateTargets()
+{
+	retireTargets();
+	createFramebuffers();
+}
+
+void VisibilityBuffer::retireTargets()
+{
+	// The visibility framebuffers hold the old depth buffer, they're rebuilt the next time each frame is recorded
+	std::vector<VkFramebuffer> framebuffers = m_shadingFramebuffers;
+	for (sVisibilityFramebuffer& visibilityFramebuffer : m_visibilityFramebuffers) {
+		if (visibilityFramebuffer.framebuffer != VK_NULL_HANDLE) framebuffers.push_back(visibilityFramebuffer.framebuffer);
+		visibilityFramebuffer = {};
+	}
+
+	VulkanEngine::getInstance()->m_pDeletionQueue->push([device = *m_pLogicalDevice, framebuffers]() {
+		for (VkFramebuffer framebuffer : framebuffers) vkDestroyFramebuffer(device, framebuffer, nullptr);
+	});
+
+	m_shadingFramebuffers.clear();
+}
+
+void VisibilityBuffer::cleanup()
+{
+	vkDestroyDescriptorPool(*m_pLogicalDevice, m_targetDescriptorPool, nullptr);
+	vkDestroyDescriptorPool(*m_pLogicalDevice, m_sceneDescriptorPool, nullptr);
+
+	for (const sVisibilityFramebuffer& visibilityFramebuffer : m_visibilityFramebuffers) {
+		if (visibilityFramebuffer.framebuffer != VK_NULL_HANDLE) vkDestroyFramebuffer(*m_pLogicalDevice, visibilityFramebuffer.framebuffer, nullptr);
+	}
+	for (VkFramebuffer framebuffer : m_shadingFramebuffers) vkDestroyFramebuffer(*m_pLogicalDevice, framebuffer, nullptr);
+	if (m_visibilityRenderPass != VK_NULL_HANDLE) vkDestroyRenderPass(*m_pLogicalDevice, m_visibilityRenderPass, nullptr);
+	if (m_shadingRenderPass != VK_NULL_HANDLE) vkDestroyRenderPass(*m_pLogicalDevice, m_shadingRenderPass, nullptr);
+
+	vkDestroyBuffer(*m_pLogicalDevice, m_sceneVertexBuffer, nullptr);
+	vkFreeMemory(*m_pLogicalDevice, m_sceneVertexBufferMemory, nullptr);
+	vkDestroyBuffer(*m_pLogicalDevice, m_sceneIndexBuffer, nullptr);
+	vkFreeMemory(*m_pLogicalDevice, m_sceneIndexBufferMemory, nullptr);
+
+	for (uint32_t i = 0; i < m_frameCount; i++) {
+		vkDestroyBuffer(*m_pLogicalDevice, m_paramsBuffers[i], nullptr);
+		vkFreeMemory(*m_pLogicalDevice, m_paramsBuffersMemory[i], nullptr);
+		vkDestroyBuffer(*m_pLogicalDevice, m_drawBuffers[i], nullptr);
+		vkFreeMemory(*m_pLogicalDevice, m_drawBuffersMemory[i], nullptr);
+	}
+
+	vkDestroySampler(*m_pLogicalDevice, m_targetSampler, nullptr);
+	vkDestroyPipeline(*m_pLogicalDevice, m_visibilityPipeline, nullptr);
+	vkDestroyPipeline(*m_pLogicalDevice, m_shadingPipeline, nullptr);
+	vkDestroyPipelineLayout(*m_pLogicalDevice, m_visibilityPipelineLayout, nullptr);
+	vkDestroyPipelineLayout(*m_pLogicalDevice, m_shadingPipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(*m_pLogicalDevice, m_sceneSetLayout, nullptr);
+	vkDestroyDescriptorSetLayout(*m_pLogicalDevice, m_targetSetLayout, nullptr);
+}
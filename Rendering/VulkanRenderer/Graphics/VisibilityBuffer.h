@@ -0,0 +1,141 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include "../Utilities/Utilities.h"
+
+
+class BufferManager;
+class Swapchain;
+class Model;
+
+// Visibility buffer rendering, drawn in place of the main pass. The visibility pass rasterises the position streams into a
+// 32 bit target that only holds the draw id and the triangle id of the nearest surface, so overdraw costs depth testing
+// and nothing else. A full-screen shading pass then looks each pixel's triangle up in scene wide copies of every model's
+// vertices and indices, interpolates it and shades the pixel once with the material textures indexed per draw. Shading
+// cost follows the pixel count however dense the geometry gets. Not used with MSAA, multiview or Hi-Z occlusion culling.
+// The id target is a transient of the render graph, it only lives from the visibility pass to the shading pass.
+class VisibilityBuffer
+{
+public:
+	static constexpr VkFormat sm_format = VK_FORMAT_R32_UINT;
+	static constexpr uint32_t sm_triangleIdBits = 23; // Matches TRIANGLE_ID_BITS in the shaders, the draw id gets the rest
+	static constexpr uint32_t sm_maxTriangles = 1u << sm_triangleIdBits; // Per model
+	static constexpr uint32_t sm_maxDraws = (1u << (32 - sm_triangleIdBits)) - 1; // Draw ids 0 to 510, all ones is what the target is cleared to
+	static constexpr uint32_t sm_maxTextures = 64; // Matches MAX_TEXTURES in visibilityShade.frag, indexed with the model's material id
+
+	// Why the models can't be drawn with the ids and the texture array (or that there are none), empty if they can. Check before creating one.
+	static std::string findSceneLimit(const std::vector<Model*>& models);
+
+	// The models can't change afterwards, their vertices and indices are copied into the scene buffers here
+	VisibilityBuffer(uint32_t frameCount, std::vector<Model*>& models);
+
+	// Writes this frame's camera and every model's transform, the frame's fence has already been waited on
+	void updateDraws(uint32_t frameIndex, const glm::mat4& view, const glm::mat4& proj, std::vector<Model*>& models);
+
+	// Draws the opaque models that survived culling. The render graph has the target in the colour attachment layout and
+	// the depth buffer in the depth attachment one. The view is the frame's transient.
+	void recordVisibility(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkImageView visibilityView);
+	// The render graph has the target in its sampled layout and the frame in the colour attachment layout. The frame is
+	// the scene colour image with post-processing, the swapchain image without.
+	void recordShading(VkCommandBuffer commandBuffer, uint32_t frameIndex, uint32_t imageIndex, VkImageView visibilityView);
+
+	// Follows the swapchain, call after the depth buffer and the scene colour image have been recreated. The framebuffers
+	// point at the swapchain images, so this is needed whether the extent changed or not. The old objects go through the
+	// deletion queue.
+	void recreateTargets();
+	void cleanup();
+
+private:
+	// Matches FrameParams in the shaders
+	struct sFrameParams
+	{
+		glm::mat4 view;
+		glm::mat4 proj;
+		glm::vec4 renderSize; // Render extent (xy) and its reciprocal (zw)
+	};
+
+	// Matches DrawData in the shaders, one per model indexed by the draw id
+	struct sDrawData
+	{
+		glm::mat4 model;
+		uint32_t firstIndex;
+		int32_t vertexOffset;
+		uint32_t textureIndex;
+		float opacity;
+	};
+
+	struct sVisibilityFramebuffer
+	{
+		VkFramebuffer framebuffer = VK_NULL_HANDLE;
+		uint64_t transientGeneration = 0; // Of the render graph's transients it was built on
+	};
+
+	Utilities* m_pUtilities = nullptr;
+	VkDevice* m_pLogicalDevice = nullptr;
+	BufferManager* m_pBufferManager = nullptr;
+	Swapchain* m_pSwapchain = nullptr;
+	sSettings::sGraphicsSettings* m_pGraphicsSettings = nullptr;
+	uint32_t m_frameCount = 0;
+
+	VkFormat m_colorFormat = VK_FORMAT_UNDEFINED; // Of the frame shaded into
+
+	// Every model's vertices and indices back to back, only read by the shading pass. The draws' offsets point into them.
+	VkBuffer m_sceneVertexBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory m_sceneVertexBufferMemory = VK_NULL_HANDLE;
+	VkBuffer m_sceneIndexBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory m_sceneIndexBufferMemory = VK_NULL_HANDLE;
+	std::vector<sDrawData> m_draws = {}; // Offsets and materials filled in once, the transforms every frame
+
+	// Written by the CPU every frame, one per frame in flight
+	std::vector<VkBuffer> m_paramsBuffers = {};
+	std::vector<VkDeviceMemory> m_paramsBuffersMemory = {};
+	std::vector<void*> m_paramsBuffersMapped = {};
+	std::vector<VkBuffer> m_drawBuffers = {};
+	std::vector<VkDeviceMemory> m_drawBuffersMemory = {};
+	std::vector<void*> m_drawBuffersMapped = {};
+
+	// Not created with dynamic rendering
+	VkRenderPass m_visibilityRenderPass = VK_NULL_HANDLE;
+	VkRenderPass m_shadingRenderPass = VK_NULL_HANDLE;
+	std::vector<sVisibilityFramebuffer> m_visibilityFramebuffers = {}; // One per frame in flight, rebuilt with the frame's transients
+	std::vector<VkFramebuffer> m_shadingFramebuffers = {}; // One per swapchain image
+
+	// Set 0 is the scene and is shared by both passes, sets 1 and 2 are the graphics pipeline's lighting and shadows and
+	// set 3 the target
+	VkSampler m_targetSampler = VK_NULL_HANDLE;
+	VkDescriptorSetLayout m_sceneSetLayout = VK_NULL_HANDLE;
+	VkDescriptorSetLayout m_targetSetLayout = VK_NULL_HANDLE;
+	VkPipelineLayout m_visibilityPipelineLayout = VK_NULL_HANDLE;
+	VkPipelineLayout m_shadingPipelineLayout = VK_NULL_HANDLE;
+	VkPipeline m_visibilityPipeline = VK_NULL_HANDLE;
+	VkPipeline m_shadingPipeline = VK_NULL_HANDLE;
+
+	VkDescriptorPool m_sceneDescriptorPool = VK_NULL_HANDLE;
+	std::vector<VkDescriptorSet> m_sceneSets = {}; // One per frame in flight
+	VkDescriptorPool m_targetDescriptorPool = VK_NULL_HANDLE;
+	std::vector<VkDescriptorSet> m_targetSets = {}; // One per frame in flight, pointed at the frame's transient when it's recorded
+
+
+	void createSceneBuffers(std::vector<Model*>& models);
+	void createPerFrameBuffers();
+	void createRenderPasses();
+	void createPipelines();
+	void createSceneDescriptorSets(std::vector<Model*>& models);
+	void createFramebuffers();
+	void createTargetDescriptorSets();
+	void retireTargets();
+
+	VkFramebuffer getVisibilityFramebuffer(uint32_t frameIndex, VkImageView visibilityView);
+
+	// Copies the data into a new device local storage buffer through a staging buffer
+	void uploadBuffer(const void* pData, VkDeviceSize bufferSize, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
+	// The frame colour the shading pass draws into
+	VkImageView getFrameImageView(uint32_t imageIndex);
+};
@@ -0,0 +1,580 @@
+#include "../VulkanRenderer.h"
+#include "Buffers.h"
+#include "GraphicsPipeline.h"
+#include "Image.h"
+
+#include "WeightedBlendedOIT.h"
+
+
+
+WeightedBlendedOIT::WeightedBlendedOIT(uint32_t frameCount) : m_pUtilities(Utilities::getInstance()), m_pLogicalDevice(VulkanEngine::getInstance()->m_pLogicalDevice->getVkDevice()),
+	m_pBufferManager(VulkanEngine::getInstance()->m_pBufferManager), m_pSwapchain(VulkanEngine::getInstance()->m_pSwapchain),
+	m_pGraphicsSettings(&VulkanEngine::getInstance()->m_settings->graphicsSettings)
+{
+	m_colorFormat = VulkanEngine::getInstance()->getGraphicsPipeline()->getColorFormat();
+	m_accumulationFramebuffers.resize(frameCount);
+	createPipeline();
+	createFramebuffers();
+	createDescriptorSets(frameCount);
+}
+
+
+void WeightedBlendedOIT::createPipeline()
+{
+	mDebugPrint("Creating transparency composite pipeline...");
+
+	VkSamplerCreateInfo samplerInfo{
+		.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+		.magFilter = VK_FILTER_NEAREST,
+		.minFilter = VK_FILTER_NEAREST,
+		.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+		.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+		.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+		.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+		.mipLodBias = 0.0f,
+		.anisotropyEnable = VK_FALSE,
+		.maxAnisotropy = 1.0f,
+		.compareEnable = VK_FALSE,
+		.compareOp = VK_COMPARE_OP_ALWAYS,
+		.minLod = 0.0f,
+		.maxLod = 0.0f,
+		.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK,
+		.unnormalizedCoordinates = VK_FALSE
+	};
+
+	// The targets are only read with texelFetch, the sampler just has to exist
+	if (vkCreateSampler(*m_pLogicalDevice, &samplerInfo, nullptr, &m_sampler) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create transparency sampler!");
+	}
+
+	// Accumulation, revealage
+	std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+	for (uint32_t i = 0; i < bindings.size(); i++) {
+		bindings[i] = VkDescriptorSetLayoutBinding{
+			.binding = i,
+			.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT
+		};
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.bindingCount = static_cast<uint32_t>(bindings.size()),
+		.pBindings = bindings.data()
+	};
+
+	if (vkCreateDescriptorSetLayout(*m_pLogicalDevice, &layoutInfo, nullptr, &m_setLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create transparency descriptor set layout!");
+	}
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.setLayoutCount = 1,
+		.pSetLayouts = &m_setLayout,
+		.pushConstantRangeCount = 0,
+		.pPushConstantRanges = nullptr
+	};
+
+	if (vkCreatePipelineLayout(*m_pLogicalDevice, &pipelineLayoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create transparency composite pipeline layout!");
+	}
+
+	if (!m_pGraphicsSettings->dynamicRendering) {
+		// Draws over the finished frame, the render graph has it in the attachment layout already
+		VkAttachmentDescription2 colorAttachment{
+			.sType = VK_STRUCTURE_TYPE_ATTACHMENT_DESCRIPTION_2,
+			.format = m_colorFormat,
+			.samples = VK_SAMPLE_COUNT_1_BIT,
+			.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD,
+			.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+			.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+			.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+			.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+			.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+		};
+
+		VkAttachmentReference2 colorAttachmentRef{
+			.sType = VK_STRUCTURE_TYPE_ATTACHMENT_REFERENCE_2,
+			.attachment = 0,
+			.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+			.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT
+		};
+
+		VkSubpassDescription2 subpass{
+			.sType = VK_STRUCTURE_TYPE_SUBPASS_DESCRIPTION_2,
+			.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+			.colorAttachmentCount = 1,
+			.pColorAttachments = &colorAttachmentRef
+		};
+
+		VkRenderPassCreateInfo2 renderPassInfo{
+			.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO_2,
+			.attachmentCount = 1,
+			.pAttachments = &colorAttachment,
+			.subpassCount = 1,
+			.pSubpasses = &subpass,
+			.dependencyCount = 0,
+			.pDependencies = nullptr
+		};
+
+		if (vkCreateRenderPass2(*m_pLogicalDevice, &renderPassInfo, nullptr, &m_compositeRenderPass) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create transparency composite render pass!");
+		}
+	}
+
+	std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages{
+		VkPipelineShaderStageCreateInfo{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			.stage = VK_SHADER_STAGE_VERTEX_BIT,
+			.module = GraphicsPipeline::loadShaderModule(*m_pLogicalDevice, "oitComposite.vert"),
+			.pName = "main"
+		},
+		VkPipelineShaderStageCreateInfo{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			.stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+			.module = GraphicsPipeline::loadShaderModule(*m_pLogicalDevice, "oitComposite.frag"),
+			.pName = "main"
+		}
+	};
+
+	// A single triangle covering the screen, made up in the vertex shader
+	VkPipelineVertexInputStateCreateInfo vertexInput{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+		.vertexBindingDescriptionCount = 0,
+		.vertexAttributeDescriptionCount = 0
+	};
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssembly{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+		.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+		.primitiveRestartEnable = VK_FALSE
+	};
+
+	VkPipelineViewportStateCreateInfo viewportState{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+		.viewportCount = 1,
+		.pViewports = nullptr, // Dynamic
+		.scissorCount = 1,
+		.pScissors = nullptr // Dynamic
+	};
+
+	VkPipelineRasterizationStateCreateInfo rasterizer{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+		.depthClampEnable = VK_FALSE,
+		.rasterizerDiscardEnable = VK_FALSE,
+		.polygonMode = VK_POLYGON_MODE_FILL,
+		.cullMode = VK_CULL_MODE_NONE,
+		.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE,
+		.depthBiasEnable = VK_FALSE,
+		.lineWidth = 1.0f
+	};
+
+	VkPipelineMultisampleStateCreateInfo multisampling{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+		.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+		.sampleShadingEnable = VK_FALSE
+	};
+
+	VkPipelineDepthStencilStateCreateInfo depthStencil{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+		.depthTestEnable = VK_FALSE,
+		.depthWriteEnable = VK_FALSE,
+		.depthCompareOp = VK_COMPARE_OP_ALWAYS,
+		.depthBoundsTestEnable = VK_FALSE,
+		.stencilTestEnable = VK_FALSE,
+		.minDepthBounds = 0.0f,
+		.maxDepthBounds = 1.0f
+	};
+
+	// The transparent surfaces' average colour over the frame, as much as the revealage says they cover. The frame's alpha is kept.
+	VkPipelineColorBlendAttachmentState colorBlendAttachment{
+		.blendEnable = VK_TRUE,
+		.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA,
+		.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+		.colorBlendOp = VK_BLEND_OP_ADD,
+		.srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
+		.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+		.alphaBlendOp = VK_BLEND_OP_ADD,
+		.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT
+	};
+
+	VkPipelineColorBlendStateCreateInfo colorBlending{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+		.logicOpEnable = VK_FALSE,
+		.attachmentCount = 1,
+		.pAttachments = &colorBlendAttachment
+	};
+
+	std::array<VkDynamicState, 2> dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+	VkPipelineDynamicStateCreateInfo dynamicState{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+		.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size()),
+		.pDynamicStates = dynamicStates.data()
+	};
+
+	VkPipelineRenderingCreateInfoKHR renderingInfo{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR,
+		.viewMask = 0,
+		.colorAttachmentCount = 1,
+		.pColorAttachmentFormats = &m_colorFormat,
+		.depthAttachmentFormat = VK_FORMAT_UNDEFINED,
+		.stencilAttachmentFormat = VK_FORMAT_UNDEFINED
+	};
+
+	VkGraphicsPipelineCreateInfo pipelineInfo{
+		.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+		.pNext = m_pGraphicsSettings->dynamicRendering ? &renderingInfo : nullptr,
+		.stageCount = static_cast<uint32_t>(shaderStages.size()),
+		.pStages = shaderStages.data(),
+		.pVertexInputState = &vertexInput,
+		.pInputAssemblyState = &inputAssembly,
+		.pViewportState = &viewportState,
+		.pRasterizationState = &rasterizer,
+		.pMultisampleState = &multisampling,
+		.pDepthStencilState = &depthStencil,
+		.pColorBlendState = &colorBlending,
+		.pDynamicState = &dynamicState,
+		.layout = m_pipelineLayout,
+		.renderPass = m_compositeRenderPass,
+		.subpass = 0,
+		.basePipelineHandle = VK_NULL_HANDLE,
+		.basePipelineIndex = -1
+	};
+
+	if (vkCreateGraphicsPipelines(*m_pLogicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_compositePipeline) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create transparency composite pipeline!");
+	}
+
+	for (const VkPipelineShaderStageCreateInfo& shaderStage : shaderStages) {
+		vkDestroyShaderModule(*m_pLogicalDevice, shaderStage.module, nullptr);
+	}
+}
+
+void WeightedBlendedOIT::createFramebuffers()
+{
+	if (m_pGraphicsSettings->dynamicRendering) return;
+
+	VkExtent2D extent = *m_pSwapchain->getSwapchainExtent();
+
+	// The accumulation framebuffers wait for the frames' transients, see getAccumulationFramebuffer
+	m_compositeFramebuffers.resize(m_pSwapchain->getSwapchainImageViews()->size());
+	for (uint32_t i = 0; i < m_compositeFramebuffers.size(); i++) {
+		VkImageView frameImageView = getFrameImageView(i);
+
+		VkFramebufferCreateInfo compositeInfo{
+			.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+			.renderPass = m_compositeRenderPass,
+			.attachmentCount = 1,
+			.pAttachments = &frameImageView,
+			.width = extent.width,
+			.height = extent.height,
+			.layers = 1
+		};
+
+		if (vkCreateFramebuffer(*m_pLogicalDevice, &compositeInfo, nullptr, &m_compositeFramebuffers[i]) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create transparency composite framebuffer!");
+		}
+	}
+}
+
+void WeightedBlendedOIT::createDescriptorSets(uint32_t frameCount)
+{
+	VkDescriptorPoolSize poolSize{
+		.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		.descriptorCount = 2 * frameCount
+	};
+
+	VkDescriptorPoolCreateInfo poolInfo{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.maxSets = frameCount,
+		.poolSizeCount = 1,
+		.pPoolSizes = &poolSize
+	};
+
+	if (vkCreateDescriptorPool(*m_pLogicalDevice, &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create transparency descriptor pool!");
+	}
+
+	std::vector<VkDescriptorSetLayout> layouts(frameCount, m_setLayout);
+	m_descriptorSets.resize(frameCount);
+
+	VkDescriptorSetAllocateInfo allocInfo{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.descriptorPool = m_descriptorPool,
+		.descriptorSetCount = frameCount,
+		.pSetLayouts = layouts.data()
+	};
+
+	if (vkAllocateDescriptorSets(*m_pLogicalDevice, &allocInfo, m_descriptorSets.data()) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate transparency descriptor sets!");
+	}
+}
+
+VkFramebuffer WeightedBlendedOIT::getAccumulationFramebuffer(uint32_t frameIndex, VkImageView accumulationView, VkImageView revealageView)
+{
+	// The frame's last use of its framebuffer has finished by the time it's recorded again, so it can go right away
+	sAccumulationFramebuffer& accumulationFramebuffer = m_accumulationFramebuffers[frameIndex];
+	uint64_t transientGeneration = m_pBufferManager->getRenderGraph()->getTransientGeneration(frameIndex);
+	if (accumulationFramebuffer.framebuffer != VK_NULL_HANDLE && accumulationFramebuffer.transientGeneration == transientGeneration) {
+		return accumulationFramebuffer.framebuffer;
+	}
+
+	if (accumulationFramebuffer.framebuffer != VK_NULL_HANDLE) vkDestroyFramebuffer(*m_pLogicalDevice, accumulationFramebuffer.framebuffer, nullptr);
+
+	VkExtent2D extent = *m_pSwapchain->getSwapchainExtent();
+
+	// Attachments in the order of GraphicsPipeline's transparent render pass
+	std::array<VkImageView, 3> attachments = { accumulationView, revealageView, *m_pBufferManager->getDepthBuffer()->getVkImageView() };
+
+	VkFramebufferCreateInfo framebufferInfo{
+		.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+		.renderPass = *VulkanEngine::getInstance()->getGraphicsPipeline()->getTransparentRenderPass(),
+		.attachmentCount = static_cast<uint32_t>(attachments.size()),
+		.pAttachments = attachments.data(),
+		.width = extent.width,
+		.height = extent.height,
+		.layers = 1
+	};
+
+	if (vkCreateFramebuffer(*m_pLogicalDevice, &framebufferInfo, nullptr, &accumulationFramebuffer.framebuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create transparency accumulation framebuffer!");
+	}
+	accumulationFramebuffer.transientGeneration = transientGeneration;
+
+	return accumulationFramebuffer.framebuffer;
+}
+
+VkImageView WeightedBlendedOIT::getFrameImageView(uint32_t imageIndex)
+{
+	PostProcessChain* pPostProcessChain = m_pBufferManager->m_pPostProcessChain;
+	return pPostProcessChain != nullptr ? *pPostProcessChain->getSceneColorImageView() : m_pSwapchain->getSwapchainImageViews()->at(imageIndex);
+}
+
+
+
+void WeightedBlendedOIT::beginAccumulation(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkImageView accumulationView, VkImageView revealageView)
+{
+	VkExtent2D renderExtent = *m_pSwapchain->getRenderExtent();
+
+	// Nothing accumulated, everything revealed
+	std::array<VkClearValue, 2> clearValues{};
+	clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+	clearValues[1].color = { { 1.0f, 0.0f, 0.0f, 0.0f } };
+
+	if (m_pGraphicsSettings->dynamicRendering) {
+		std::array<VkRenderingAttachmentInfoKHR, 2> colorAttachments{};
+		std::array<VkImageView, 2> imageViews = { accumulationView, revealageView };
+		for (uint32_t i = 0; i < colorAttachments.size(); i++) {
+			colorAttachments[i] = VkRenderingAttachmentInfoKHR{
+				.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR,
+				.imageView = imageViews[i],
+				.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+				.resolveMode = VK_RESOLVE_MODE_NONE,
+				.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+				.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+				.clearValue = clearValues[i]
+			};
+		}
+
+		VkRenderingAttachmentInfoKHR depthAttachment{
+			.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR,
+			.imageView = *m_pBufferManager->getDepthBuffer()->getVkImageView(),
+			.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+			.resolveMode = VK_RESOLVE_MODE_NONE,
+			.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD,
+			.storeOp = VK_ATTACHMENT_STORE_OP_STORE
+		};
+
+		VkRenderingInfoKHR renderingInfo{
+			.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR,
+			.renderArea {
+				.offset = { 0, 0 },
+				.extent = renderExtent
+			},
+			.layerCount = 1,
+			.viewMask = 0,
+			.colorAttachmentCount = static_cast<uint32_t>(colorAttachments.size()),
+			.pColorAttachments = colorAttachments.data(),
+			.pDepthAttachment = &depthAttachment,
+			.pStencilAttachment = nullptr
+		};
+
+		m_pBufferManager->m_vkCmdBeginRendering(commandBuffer, &renderingInfo);
+	}
+	else {
+		VkRenderPassBeginInfo renderPassInfo{
+			.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+			.renderPass = *VulkanEngine::getInstance()->getGraphicsPipeline()->getTransparentRenderPass(),
+			.framebuffer = getAccumulationFramebuffer(frameIndex, accumulationView, revealageView),
+			.renderArea {
+				.offset = { 0, 0 },
+				.extent = renderExtent,
+			},
+			.clearValueCount = static_cast<uint32_t>(clearValues.size()),
+			.pClearValues = clearValues.data()
+		};
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+	}
+
+	VkViewport viewport{
+		.x = 0.0f,
+		.y = 0.0f,
+		.width = static_cast<float>(renderExtent.width),
+		.height = static_cast<float>(renderExtent.height),
+		.minDepth = 0.0f,
+		.maxDepth = 1.0f
+	};
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+	VkRect2D scissor{
+		.offset = { 0, 0 },
+		.extent = renderExtent
+	};
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+}
+
+void WeightedBlendedOIT::endAccumulation(VkCommandBuffer commandBuffer)
+{
+	if (m_pGraphicsSettings->dynamicRendering) {
+		m_pBufferManager->m_vkCmdEndRendering(commandBuffer);
+	}
+	else {
+		vkCmdEndRenderPass(commandBuffer);
+	}
+}
+
+void WeightedBlendedOIT::recordComposite(VkCommandBuffer commandBuffer, uint32_t frameIndex, uint32_t imageIndex, VkImageView accumulationView, VkImageView revealageView)
+{
+	VkExtent2D renderExtent = *m_pSwapchain->getRenderExtent();
+
+	// The frame's last use of its set has finished by the time it's recorded again
+	std::array<VkDescriptorImageInfo, 2> imageInfos{
+		VkDescriptorImageInfo{ .sampler = m_sampler, .imageView = accumulationView, .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL },
+		VkDescriptorImageInfo{ .sampler = m_sampler, .imageView = revealageView, .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL }
+	};
+
+	std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+	for (uint32_t binding = 0; binding < descriptorWrites.size(); binding++) {
+		descriptorWrites[binding] = VkWriteDescriptorSet{
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = m_descriptorSets[frameIndex],
+			.dstBinding = binding,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.pImageInfo = &imageInfos[binding]
+		};
+	}
+
+	vkUpdateDescriptorSets(*m_pLogicalDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+
+	if (m_pGraphicsSettings->dynamicRendering) {
+		VkRenderingAttachmentInfoKHR colorAttachment{
+			.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR,
+			.imageView = getFrameImageView(imageIndex),
+			.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+			.resolveMode = VK_RESOLVE_MODE_NONE,
+			.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD,
+			.storeOp = VK_ATTACHMENT_STORE_OP_STORE
+		};
+
+		VkRenderingInfoKHR renderingInfo{
+			.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR,
+			.renderArea {
+				.offset = { 0, 0 },
+				.extent = renderExtent
+			},
+			.layerCount = 1,
+			.viewMask = 0,
+			.colorAttachmentCount = 1,
+			.pColorAttachments = &colorAttachment,
+			.pDepthAttachment = nullptr,
+			.pStencilAttachment = nullptr
+		};
+
+		m_pBufferManager->m_vkCmdBeginRendering(commandBuffer, &renderingInfo);
+	}
+	else {
+		VkRenderPassBeginInfo renderPassInfo{
+			.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+			.renderPass = m_compositeRenderPass,
+			.framebuffer = m_compositeFramebuffers[imageIndex],
+			.renderArea {
+				.offset = { 0, 0 },
+				.extent = renderExtent,
+			},
+			.clearValueCount = 0,
+			.pClearValues = nullptr
+		};
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+	}
+
+	VkViewport viewport{
+		.x = 0.0f,
+		.y = 0.0f,
+		.width = static_cast<float>(renderExtent.width),
+		.height = static_cast<float>(renderExtent.height),
+		.minDepth = 0.0f,
+		.maxDepth = 1.0f
+	};
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+	VkRect2D scissor{
+		.offset = { 0, 0 },
+		.extent = renderExtent
+	};
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_compositePipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &m_descriptorSets[frameIndex], 0, nullptr);
+	vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+
+	if (m_pGraphicsSettings->dynamicRendering) {
+		m_pBufferManager->m_vkCmdEndRendering(commandBuffer);
+	}
+	else {
+		vkCmdEndRenderPass(commandBuffer);
+	}
+}
+
+
+
+void WeightedBlendedOIT::recreateTargets()
+{
+	retireTargets();
+	createFramebuffers();
+}
+
+void WeightedBlendedOIT::retireTargets()
+{
+	// The accumulation framebuffers hold the old depth buffer, they're rebuilt the next time each frame is recorded
+	std::vector<VkFramebuffer> framebuffers = m_compositeFramebuffers;
+	for (sAccumulationFramebuffer& accumulationFramebuffer : m_accumulationFramebuffers) {
+		if (accumulationFramebuffer.framebuffer != VK_NULL_HANDLE) framebuffers.push_back(accumulationFramebuffer.framebuffer);
+		accumulationFramebuffer = {};
+	}
+
+	VulkanEngine::getInstance()->m_pDeletionQueue->push([device = *m_pLogicalDevice, framebuffers]() {
+		for (VkFramebuffer framebuffer : framebuffers) vkDestroyFramebuffer(device, framebuffer, nullptr);
+	});
+
+	m_compositeFramebuffers.clear();
+}
+
+void WeightedBlendedOIT::cleanup()
+{
+	vkDestroyDescriptorPool(*m_pLogicalDevice, m_descriptorPool, nullptr);
+
+	for (const sAccumulationFramebuffer& accumulationFramebuffer : m_accumulationFramebuffers) {
+		if (accumulationFramebuffer.framebuffer != VK_NULL_HANDLE) vkDestroyFramebuffer(*m_pLogicalDevice, accumulationFramebuffer.framebuffer, nullptr);
+	}
+	for (VkFramebuffer framebuffer : m_compositeFramebuffers) vkDestroyFramebuffer(*m_pLogicalDevice, framebuffer, nullptr);
+	if (m_compositeRenderPass != VK_NULL_HANDLE) vkDestroyRenderPass(*m_pLogicalDevice, m_compositeRenderPass, nullptr);
+
+	vkDestroySampler(*m_pLogicalDevice, m_sampler, nullptr);
+	vkDestroyPipeline(*m_pLogicalDevice, m_compositePipeline, nullptr);
+	vkDestroyPipelineLayout(*m_pLogicalDevice, m_pipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(*m_pLogicalDevice, m_setLayout, nullptr);
+}
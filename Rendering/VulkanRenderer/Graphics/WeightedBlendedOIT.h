@@ -0,0 +1,82 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <vector>
+#include <cstdint>
+
+#include "../Utilities/Utilities.h"
+
+
+class BufferManager;
+class Swapchain;
+
+// Weighted blended order-independent transparency. Transparent models are drawn after the opaque ones, tested against
+// their depth without writing it, into an accumulation target that sums each surface's premultiplied colour and alpha
+// scaled by a weight falling off with depth, and a revealage target that multiplies together how much each one lets
+// through. Both blends are commutative, so the draws need no sorting. A full-screen pass then composites the weighted
+// average colour over the frame with the coverage the revealage leaves. Not used with MSAA or multiview. Both targets are
+// transients of the render graph, they only live from the accumulation to the composite.
+class WeightedBlendedOIT
+{
+public:
+	static constexpr VkFormat sm_accumulationFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
+	static constexpr VkFormat sm_revealageFormat = VK_FORMAT_R16_SFLOAT;
+
+	WeightedBlendedOIT(uint32_t frameCount);
+
+	// Clears the targets and begins the pass the transparent models are drawn in with GraphicsPipeline's transparent
+	// variant. The render graph has the targets in the colour attachment layout and the depth buffer in the read only one.
+	// The views are the frame's transients.
+	void beginAccumulation(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkImageView accumulationView, VkImageView revealageView);
+	void endAccumulation(VkCommandBuffer commandBuffer);
+	// The render graph has the targets in their sampled layouts and the frame in the colour attachment layout. The frame
+	// is the scene colour image with post-processing, the swapchain image without.
+	void recordComposite(VkCommandBuffer commandBuffer, uint32_t frameIndex, uint32_t imageIndex, VkImageView accumulationView, VkImageView revealageView);
+
+	// Follows the swapchain, call after the depth buffer and the scene colour image have been recreated. The framebuffers
+	// point at the swapchain images, so this is needed whether the extent changed or not. The old objects go through the
+	// deletion queue.
+	void recreateTargets();
+	void cleanup();
+
+private:
+	Utilities* m_pUtilities = nullptr;
+	VkDevice* m_pLogicalDevice = nullptr;
+	BufferManager* m_pBufferManager = nullptr;
+	Swapchain* m_pSwapchain = nullptr;
+	sSettings::sGraphicsSettings* m_pGraphicsSettings = nullptr;
+
+	struct sAccumulationFramebuffer
+	{
+		VkFramebuffer framebuffer = VK_NULL_HANDLE;
+		uint64_t transientGeneration = 0; // Of the render graph's transients it was built on
+	};
+
+	VkFormat m_colorFormat = VK_FORMAT_UNDEFINED; // Of the frame composited into
+
+	// Not created with dynamic rendering. The accumulation render pass belongs to the graphics pipeline, whose transparent
+	// variant is built against it.
+	std::vector<sAccumulationFramebuffer> m_accumulationFramebuffers = {}; // One per frame in flight, rebuilt with the frame's transients
+	VkRenderPass m_compositeRenderPass = VK_NULL_HANDLE;
+	std::vector<VkFramebuffer> m_compositeFramebuffers = {}; // One per swapchain image
+
+	VkSampler m_sampler = VK_NULL_HANDLE;
+	VkDescriptorSetLayout m_setLayout = VK_NULL_HANDLE;
+	VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline m_compositePipeline = VK_NULL_HANDLE;
+	VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+	std::vector<VkDescriptorSet> m_descriptorSets = {}; // One per frame in flight, pointed at the frame's transients when it's recorded
+
+
+	void createPipeline();
+	void createFramebuffers();
+	void createDescriptorSets(uint32_t frameCount);
+	void retireTargets();
+
+	VkFramebuffer getAccumulationFramebuffer(uint32_t frameIndex, VkImageView accumulationView, VkImageView revealageView);
+
+	// The frame colour the passes draw into
+	VkImageView getFrameImageView(uint32_t imageIndex);
+};
@@ -8,7 +8,7 @@
 
 
 
-Window::Window() : m_pVkInstance(&VulkanEngine::getInstance()->m_vkInstance), m_MAX_FRAMES_IN_FLIGHT(VulkanEngine::getInstance()->m_MAX_FRAMES_IN_FLIGHT), m_pUtilities(Utilities::getInstance()),
+Window::Window() : m_pVkInstance(&VulkanEngine::getInstance()->m_vkInstance), m_pUtilities(Utilities::getInstance()),
 					m_pGraphicsSettings(&VulkanEngine::getInstance()->m_settings->graphicsSettings), m_pShouldRender(VulkanEngine::getInstance()->getShouldRender())
 {
 	initWindow();
@@ -19,6 +19,19 @@ void Window::initWindow()
 	mDebugPrint("Initializing window...");
 
 	sSettings::sWindowSettings windowSettings = VulkanEngine::getInstance()->m_settings->windowSettings;
+	m_headless = windowSettings.headless;
+
+	// The timer still comes from GLFW, the null platform provides it without needing a display
+	if (m_headless) {
+		glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+		if (glfwInit() != GLFW_TRUE) {
+			throw std::runtime_error("failed to initialise GLFW for headless rendering!");
+		}
+
+		// Nothing is presented, so there's nothing to pace the frames to
+		m_renderTargetDelta = 0.0f;
+		return;
+	}
 
 	glfwInit();
 
@@ -37,12 +50,18 @@ void Window::framebufferResizeCallback(GLFWwindow* window, int width, int height
 {
 	auto app = reinterpret_cast<Window*>(glfwGetWindowUserPointer(window));
 	app->m_framebufferResized = true;
+	app->m_minimised = width == 0 || height == 0;
 	//app->drawFrame(); // Don't do this or it'll break the window when one of the coordinates is 0
 }
 
 
 void Window::createSurface()
 {
+	if (m_headless) {
+		mDebugPrint("Running headless, no surface to create.");
+		return;
+	}
+
 	mDebugPrint("Creating surface...");
 
 	if (glfwCreateWindowSurface(*m_pVkInstance, m_pWindow, nullptr, &m_surface) != VK_SUCCESS) {
@@ -50,47 +69,38 @@ void Window::createSurface()
 	}
 }
 
-void Window::createSyncObjects()
+void Window::prepareRendering()
 {
-	mDebugPrint("Creating sync objects...");
+	mDebugPrint("Preparing rendering...");
 
 	// Define these variables here since we need to use them from now on
 	m_pLogicalDevice = VulkanEngine::getInstance()->m_pLogicalDevice->getVkDevice();
 	m_pGraphicsQueue = VulkanEngine::getInstance()->m_pLogicalDevice->getGraphicsQueue();
 	m_pSwapchain = VulkanEngine::getInstance()->m_pSwapchain;
 	m_pCommandBuffer = VulkanEngine::getInstance()->m_pBufferManager->getCommandBuffer();
-
-	// Resize the vectors to the correct size
-	m_imageAvailableSemaphores.resize(m_MAX_FRAMES_IN_FLIGHT);
-	m_renderFinishedSemaphores.resize(m_MAX_FRAMES_IN_FLIGHT);
-	m_inFlightFences.resize(m_MAX_FRAMES_IN_FLIGHT);
-
-	VkSemaphoreCreateInfo semaphoreInfo{
-		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO
-	};
-
-	VkFenceCreateInfo fenceInfo{
-		.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-		.flags = VK_FENCE_CREATE_SIGNALED_BIT
-	};
-
-	for (size_t i = 0; i < m_MAX_FRAMES_IN_FLIGHT; i++)
-	{
-		if (vkCreateSemaphore(*m_pLogicalDevice, &semaphoreInfo, nullptr, &m_imageAvailableSemaphores[i]) != VK_SUCCESS ||
-			vkCreateSemaphore(*m_pLogicalDevice, &semaphoreInfo, nullptr, &m_renderFinishedSemaphores[i]) != VK_SUCCESS ||
-			vkCreateFence(*m_pLogicalDevice, &fenceInfo, nullptr, &m_inFlightFences[i]) != VK_SUCCESS)
-		{
-			throw std::runtime_error("failed to create synchronization objects for a frame!");
-		}
-	}
+	m_pGpuTimeline = VulkanEngine::getInstance()->m_pGpuTimeline;
+	m_pGpuTimer = VulkanEngine::getInstance()->m_pGpuTimer;
+	m_pFrameContexts = VulkanEngine::getInstance()->m_pBufferManager->getFrameContexts();
+	m_pAsyncCompute = VulkanEngine::getInstance()->m_pAsyncCompute;
+	m_pDeletionQueue = VulkanEngine::getInstance()->m_pDeletionQueue;
+	m_pDynamicResolution = VulkanEngine::getInstance()->m_pDynamicResolution;
+	m_pFrameCapture = VulkanEngine::getInstance()->m_pFrameCapture;
+	m_pMultiviewTarget = VulkanEngine::getInstance()->m_pMultiviewTarget;
 }
 
 
 void Window::mainLoop()
 {
+	if (m_headless) {
+		runHeadless(VulkanEngine::getInstance()->m_settings->windowSettings.headlessFrameCount);
+		return;
+	}
+
 	while (!glfwWindowShouldClose(m_pWindow))
 	{
-		glfwPollEvents();
+		// Sleep until something happens instead of spinning while there's nothing to draw to
+		if (m_minimised) glfwWaitEvents();
+		else glfwPollEvents();
 		drawFrame();
 
 		// Print FPS
@@ -104,92 +114,238 @@ void Window::mainLoop()
 
 void Window::drawFrame()
 {
-	if (!m_pShouldRender) return;
+	if (!m_pShouldRender || m_minimised) return;
 	double currentDelta = glfwGetTime() - m_renderLastTime;
 	if (currentDelta < m_renderTargetDelta) return;
 
 	uint32_t imageIndex;
 
-	std::vector<VkCommandBuffer> commandBuffers = *m_pCommandBuffer->getCommandBuffers();
-
-	vkWaitForFences(*m_pLogicalDevice, 1, &m_inFlightFences[m_currentFrame], VK_TRUE, UINT64_MAX);
+	// Waits until the frame that last used this context is done with its command buffer and uniforms
+	sFrameContext& frame = m_pFrameContexts->beginFrame(m_gpuWaitTime);
+	bool timed = m_pGpuTimer->collect(frame.index);
+	if (timed) m_gpuFrameTime = m_pGpuTimer->getLastFrameMilliseconds() / 1000.0;
+	// Picks the resolution this frame is drawn at from the timings of the last frame drawn with the same context
+	if (m_pDynamicResolution != nullptr) m_pDynamicResolution->update(frame.index, timed ? m_pGpuTimer->getLastFrameMilliseconds() : 0.0);
+	if (m_pFrameCapture != nullptr) m_pFrameCapture->collect(frame.index);
+	m_pDeletionQueue->collect();
+	VulkanEngine::getInstance()->applySettingsChanges(); // May swap in a rebuilt pipeline, nothing is recorded with the old one from here on
 
 	m_cpuWorkTime = glfwGetTime() - m_renderLastTime;
-	double timeAfterFences = glfwGetTime();
+	double timeAfterWait = glfwGetTime();
 
-	VkResult result = vkAcquireNextImageKHR(*m_pLogicalDevice, *m_pSwapchain->getSwapchain(), UINT64_MAX, m_imageAvailableSemaphores[m_currentFrame], VK_NULL_HANDLE, &imageIndex);
-
-	// Ensure swapchain quality
-	if (result == VK_ERROR_OUT_OF_DATE_KHR)
-	{
-		m_pSwapchain->recreateSwapchain(m_pWindow);
-		return;
+	VkResult result = VK_SUCCESS;
+	if (m_headless) {
+		// There's one offscreen image per frame context, and beginFrame has already waited for the frame that last drew to it
+		imageIndex = frame.index;
 	}
-	else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
-		throw std::runtime_error("failed to acquire swap chain image!");
+	else {
+		result = vkAcquireNextImageKHR(*m_pLogicalDevice, *m_pSwapchain->getSwapchain(), UINT64_MAX, frame.imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
+
+		// Ensure swapchain quality
+		if (result == VK_ERROR_OUT_OF_DATE_KHR)
+		{
+			m_pSwapchain->recreateSwapchain(m_pWindow);
+			return;
+		}
+		else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+			throw std::runtime_error("failed to acquire swap chain image!");
+		}
 	}
 
-	updateUniformBuffers(m_currentFrame); // Perform translations
+	updateUniformBuffers(frame.index); // Perform translations
+
+	m_pCommandBuffer->recordCommandBuffer(frame.commandBuffer, frame.index, imageIndex);
+
 
-	vkResetFences(*m_pLogicalDevice, 1, &m_inFlightFences[m_currentFrame]);
+	std::vector<VkSemaphore> waitSemaphores = {};
+	std::vector<VkPipelineStageFlags> waitStages = {};
+	std::vector<uint64_t> waitValues = {};
+	if (!m_headless) {
+		// Same stage the render graph's first write to the swapchain image waits at
+		waitSemaphores.push_back(frame.imageAvailableSemaphore);
+		waitStages.push_back(m_pCommandBuffer->getSwapchainWaitStage());
+	}
+	m_pAsyncCompute->takeGraphicsWaits(waitSemaphores, waitValues, waitStages); // Compute results this frame consumes
 
-	vkResetCommandBuffer(commandBuffers[m_currentFrame], 0);
-	m_pCommandBuffer->recordCommandBuffer(commandBuffers[m_currentFrame],imageIndex);
+	frame.timelineValue = m_pGpuTimeline->nextSubmissionValue();
 
+	// Headless frames are never presented, so nothing would wait on the binary semaphore
+	std::vector<VkSemaphore> signalSemaphores = { *m_pGpuTimeline->getVkSemaphore() };
+	std::vector<uint64_t> signalValues = { frame.timelineValue };
+	if (!m_headless) {
+		signalSemaphores.insert(signalSemaphores.begin(), frame.renderFinishedSemaphore);
+		signalValues.insert(signalValues.begin(), 0); // The binary semaphore's value is ignored
+	}
 
-	VkSemaphore waitSemaphores[] = { m_imageAvailableSemaphores[m_currentFrame] };
-	VkSemaphore signalSemaphores[] = { m_renderFinishedSemaphores[m_currentFrame] };
-	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+	VkTimelineSemaphoreSubmitInfo timelineInfo{
+		.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+		.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size()),
+		.pWaitSemaphoreValues = waitValues.data(),
+		.signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size()),
+		.pSignalSemaphoreValues = signalValues.data()
+	};
 
 	VkSubmitInfo submitInfo{
 		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-		.waitSemaphoreCount = 1,
-		.pWaitSemaphores = waitSemaphores,
-		.pWaitDstStageMask = waitStages,
+		.pNext = &timelineInfo,
+		.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size()),
+		.pWaitSemaphores = waitSemaphores.data(),
+		.pWaitDstStageMask = waitStages.data(),
 		.commandBufferCount = 1,
-		.pCommandBuffers = &commandBuffers[m_currentFrame],
-		.signalSemaphoreCount = 1,
-		.pSignalSemaphores = signalSemaphores
+		.pCommandBuffers = &frame.commandBuffer,
+		.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size()),
+		.pSignalSemaphores = signalSemaphores.data()
 	};
 
-	if (vkQueueSubmit(*m_pGraphicsQueue, 1, &submitInfo, m_inFlightFences[m_currentFrame]) != VK_SUCCESS) {
+	if (vkQueueSubmit(*m_pGraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
 		throw std::runtime_error("failed to submit draw command buffer!");
 	}
 
 
-	VkSwapchainKHR swapChains[] = { *m_pSwapchain->getSwapchain() };
+	if (!m_headless) {
+		VkSwapchainKHR swapChains[] = { *m_pSwapchain->getSwapchain() };
 
-	VkPresentInfoKHR presentInfo{
-		.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
-		.waitSemaphoreCount = 1,
-		.pWaitSemaphores = signalSemaphores,
-		.swapchainCount = 1,
-		.pSwapchains = swapChains,
-		.pImageIndices = &imageIndex,
-		.pResults = nullptr // Optional
-	};
+		VkPresentInfoKHR presentInfo{
+			.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+			.waitSemaphoreCount = 1,
+			.pWaitSemaphores = &frame.renderFinishedSemaphore,
+			.swapchainCount = 1,
+			.pSwapchains = swapChains,
+			.pImageIndices = &imageIndex,
+			.pResults = nullptr // Optional
+		};
 
-	result = vkQueuePresentKHR(*m_pGraphicsQueue, &presentInfo);
+		result = vkQueuePresentKHR(*m_pGraphicsQueue, &presentInfo);
 
-	// Ensure swapchain quality
-	if (result == VK_ERROR_OUT_OF_DATE_KHR || result != VK_SUBOPTIMAL_KHR || m_framebufferResized)
-	{
-		m_framebufferResized = false;
-		m_pSwapchain->recreateSwapchain(m_pWindow);
-	}
-	else if (result != VK_SUCCESS) {
-		throw std::runtime_error("failed to present swap chain image!");
+		// Ensure swapchain quality
+		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || m_framebufferResized)
+		{
+			m_framebufferResized = false;
+			m_pSwapchain->recreateSwapchain(m_pWindow);
+		}
+		else if (result != VK_SUCCESS) {
+			throw std::runtime_error("failed to present swap chain image!");
+		}
 	}
 
 	m_frameCounter++;
-	m_currentFrame = (m_currentFrame + 1) % m_MAX_FRAMES_IN_FLIGHT;
 
-	m_gpuDrawTime = glfwGetTime() - timeAfterFences;
+	m_gpuDrawTime = glfwGetTime() - timeAfterWait;
 
 	m_renderLastTime = glfwGetTime();
 }
 
-void Window::updateUniformBuffers(uint32_t currentImage)
+void Window::runHeadless(uint32_t frameCount)
+{
+	mDebugPrint(std::format("Drawing {} frames headless...", frameCount));
+
+	double totalCpuWork = 0.0;
+	double totalWait = 0.0;
+	double totalGpuTime = 0.0;
+	uint32_t timedFrames = 0;
+
+	double start = glfwGetTime();
+	for (uint32_t i = 0; i < frameCount; i++)
+	{
+		drawFrame();
+		totalCpuWork += m_cpuWorkTime;
+		totalWait += m_gpuWaitTime;
+
+		// Timestamps arrive when a frame context comes round again, so the first ones have none
+		if (m_pGpuTimer->isSupported() && i >= m_pFrameContexts->getFrameCount()) {
+			totalGpuTime += m_gpuFrameTime;
+			timedFrames++;
+		}
+	}
+	m_pGpuTimeline->wait(m_pGpuTimeline->getLastSubmittedValue());
+	double elapsed = glfwGetTime() - start;
+
+	VkExtent2D swapchainExtent = *m_pSwapchain->getSwapchainExtent();
+	mDebugPrint(std::format("Headless run at {}x{}: {:.1f} FPS, {:.3f} ms/frame, {:.3f} ms/frame CPU work, {:.3f} ms/frame waiting on the GPU",
+		swapchainExtent.width, swapchainExtent.height, frameCount / elapsed, elapsed * 1000.0 / frameCount, totalCpuWork * 1000.0 / frameCount, totalWait * 1000.0 / frameCount));
+	if (timedFrames > 0) mDebugPrint(std::format("Headless run GPU time: {:.3f} ms/frame", totalGpuTime * 1000.0 / timedFrames));
+
+	vkDeviceWaitIdle(*m_pLogicalDevice);
+}
+
+void Window::benchmarkFramesInFlight(uint32_t frameCount)
+{
+	mDebugPrint(std::format("Benchmarking frames in flight over {} frames...", frameCount));
+
+	double renderTargetDelta = m_renderTargetDelta;
+	m_renderTargetDelta = 0.0f; // Uncapped, otherwise the frame limiter hides the difference
+
+	for (uint32_t framesInFlight = 1; framesInFlight <= m_pFrameContexts->getFrameCount(); framesInFlight++)
+	{
+		m_pGpuTimeline->wait(m_pGpuTimeline->getLastSubmittedValue());
+		m_pFrameContexts->setActiveFrameCount(framesInFlight);
+
+		double totalWait = 0.0;
+		double start = glfwGetTime();
+		for (uint32_t i = 0; i < frameCount; i++)
+		{
+			glfwPollEvents();
+			drawFrame();
+			totalWait += m_gpuWaitTime;
+		}
+		m_pGpuTimeline->wait(m_pGpuTimeline->getLastSubmittedValue());
+		double elapsed = glfwGetTime() - start;
+
+		// With one frame in flight the CPU idles for the whole GPU frame, overlapping them should turn most of that into throughput
+		mDebugPrint(std::format("{} frame(s) in flight: {:.1f} FPS, {:.3f} ms/frame, {:.3f} ms/frame waiting on the GPU",
+			framesInFlight, frameCount / elapsed, elapsed * 1000.0 / frameCount, totalWait * 1000.0 / frameCount));
+	}
+
+	m_pFrameContexts->setActiveFrameCount(m_pFrameContexts->getFrameCount());
+	m_renderTargetDelta = renderTargetDelta;
+	m_frameCounter = 0;
+}
+
+void Window::benchmarkDepthPrepass(uint32_t frameCount)
+{
+	if (!m_pGpuTimer->isSupported() || m_pGraphicsSettings->wireframe) {
+		mDebugPrint("Skipping the depth pre-pass benchmark, it needs GPU timestamps and isn't used in wireframe.");
+		return;
+	}
+
+	mDebugPrint(std::format("Benchmarking the depth pre-pass over {} frames...", frameCount));
+
+	double renderTargetDelta = m_renderTargetDelta;
+	m_renderTargetDelta = 0.0f;
+
+	GraphicsPipeline* pGraphicsPipeline = VulkanEngine::getInstance()->getGraphicsPipeline();
+	std::array<double, 2> gpuMilliseconds = {};
+
+	// Whether it pays off depends on the scene: it saves shading where surfaces overlap, and costs a second vertex pass everywhere
+	for (int depthPrepass = 0; depthPrepass < 2; depthPrepass++)
+	{
+		m_pGpuTimeline->wait(m_pGpuTimeline->getLastSubmittedValue());
+		m_pGraphicsSettings->depthPrepass = depthPrepass == 1;
+		pGraphicsPipeline->useVariant(*m_pGraphicsSettings);
+
+		// A frame's timings are read when its context comes round again, so the first few are still from before the switch
+		uint32_t skippedFrames = m_pFrameContexts->getFrameCount();
+		double totalGpuTime = 0.0;
+		for (uint32_t i = 0; i < frameCount + skippedFrames; i++)
+		{
+			glfwPollEvents();
+			drawFrame();
+			if (i >= skippedFrames) totalGpuTime += m_gpuFrameTime;
+		}
+
+		gpuMilliseconds[depthPrepass] = totalGpuTime * 1000.0 / frameCount;
+		mDebugPrint(std::format("Depth pre-pass {}: {:.3f} ms GPU time/frame", depthPrepass == 1 ? "on" : "off", gpuMilliseconds[depthPrepass]));
+	}
+
+	m_pGraphicsSettings->depthPrepass = gpuMilliseconds[1] < gpuMilliseconds[0];
+	pGraphicsPipeline->useVariant(*m_pGraphicsSettings);
+	mDebugPrint(std::format("Keeping the depth pre-pass {}.", m_pGraphicsSettings->depthPrepass ? "on" : "off"));
+
+	m_renderTargetDelta = renderTargetDelta;
+	m_frameCounter = 0;
+}
+
+void Window::updateUniformBuffers(uint32_t frameIndex)
 {
 	VulkanEngine* pVulkanEngine = VulkanEngine::getInstance();
 	using std::chrono::high_resolution_clock, std::chrono::duration, std::chrono::seconds;
@@ -201,18 +357,58 @@ void Window::updateUniformBuffers(uint32_t currentImage)
 
 
 	VkExtent2D swapchainExtent = *m_pSwapchain->getSwapchainExtent();
+	VkExtent2D renderExtent = *m_pSwapchain->getRenderExtent();
+
+	// With multiview each view is a layer of its own size, see MultiviewTarget
+	uint32_t viewCount = m_pMultiviewTarget != nullptr ? MultiviewTarget::sm_viewCount : 1;
+	VkExtent2D viewExtent = m_pMultiviewTarget != nullptr ? m_pMultiviewTarget->getViewExtent() : renderExtent;
+	VkExtent2D aspectExtent = m_pMultiviewTarget != nullptr ? viewExtent : swapchainExtent;
+	float aspectRatio = (float)aspectExtent.width / aspectExtent.height;
+
+	// Stereo offsets the eyes either side of the camera, split-screen draws the second camera in the second view
+	std::vector<glm::mat4> views(viewCount);
+	std::vector<glm::mat4> projs(viewCount);
+	std::vector<glm::mat4> viewProjs(viewCount);
+	for (uint32_t v = 0; v < viewCount; v++) {
+		Camera* pCamera = v == 1 && m_pSecondCamera != nullptr ? m_pSecondCamera : m_pCamera;
+		views[v] = pCamera->getViewMatrix();
+		if (m_pGraphicsSettings->multiview == eMultiview::STEREO) {
+			float eyeOffset = (v == 0 ? 0.5f : -0.5f) * m_pGraphicsSettings->stereoSeparation;
+			views[v] = glm::translate(glm::mat4(1.0f), glm::vec3(eyeOffset, 0.0f, 0.0f)) * views[v];
+		}
+		projs[v] = pCamera->getProjectionMatrix(aspectRatio, m_pGraphicsSettings->nearClip, m_pGraphicsSettings->farClip);
+		viewProjs[v] = projs[v] * views[v];
+	}
+
+	// Only models visible from at least one view get drawn this frame
+	pVulkanEngine->cullModels(viewProjs, frameIndex);
+
+	// Bins the lights on the compute queue while the rest of the frame is recorded
+	pVulkanEngine->m_pClusteredLighting->update(frameIndex, views, projs, viewExtent, pVulkanEngine->m_sunDirection);
+	// Reuses the bounding spheres cullModels just gathered to cull each cascade's casters. The cascades follow the first view.
+	pVulkanEngine->m_pCascadedShadows->update(frameIndex, views[0], projs[0], pVulkanEngine->m_sunDirection, pVulkanEngine->m_pFrustumCuller);
+
+	// Culling, lighting and shadows above work with the camera as it is, only what's drawn from it is jittered. TAA is
+	// never on with multiview, so there's only the one view to jitter.
+	std::vector<glm::mat4> drawProjs = projs;
+	if (pVulkanEngine->m_pTemporalAA != nullptr) drawProjs[0] = pVulkanEngine->m_pTemporalAA->jitterProjection(views[0], projs[0]);
+
+	// Views that aren't drawn are left as the first, the shaders declare every view whatever the count
+	UniformBufferObject::sUniformBufferObject ubo{};
+	for (uint32_t v = 0; v < MultiviewTarget::sm_viewCount; v++) {
+		ubo.view[v] = views[v < viewCount ? v : 0];
+		ubo.proj[v] = drawProjs[v < viewCount ? v : 0];
+	}
 
 	for (Model* model : pVulkanEngine->m_LoadedModels) {
-		UniformBufferObject::sUniformBufferObject ubo{
-			.model = model->getTransform(),
-			.view = glm::lookAt(m_pCamera->m_cameraPosition, m_pCamera->m_cameraPosition + m_pCamera->m_cameraFront, m_pCamera->m_cameraUp),
-			.proj = glm::perspective(glm::radians(70.0f), (float)swapchainExtent.width / swapchainExtent.height, m_pGraphicsSettings->nearClip, m_pGraphicsSettings->farClip)
-		};
-		ubo.proj[1][1] *= -1; // Flip the y axis to account for Vulkan's inverted y axis
+		ubo.model = model->getTransform();
+		ubo.opacity = model->m_opacity;
 
-		std::vector<void*> uniformBuffersMapped = *model->m_pUniformBufferObject->getUniformBuffersMapped(); // still fuck this piece of code in particular
-		memcpy(uniformBuffersMapped[currentImage], &ubo, sizeof(ubo));
+		memcpy(m_pFrameContexts->getUniformSlot(frameIndex, model->m_uniformSlot), &ubo, sizeof(ubo));
 	}
+
+	// Its passes read the same camera and transforms from its own buffers, never with multiview
+	if (pVulkanEngine->m_pVisibilityBuffer != nullptr) pVulkanEngine->m_pVisibilityBuffer->updateDraws(frameIndex, views[0], drawProjs[0], pVulkanEngine->m_LoadedModels);
 }
 
 
@@ -229,10 +425,20 @@ void Window::calculateFPS()
 		string cpuWaitString = to_string(m_cpuWorkTime*1000);
 		string gpuDrawString = to_string((m_gpuDrawTime*1000));
 		string vboCount = to_string(m_vboCount);
+		string visibleCount = to_string(VulkanEngine::getInstance()->m_pBufferManager->m_visibleModelIndices.size());
 		mDebugPrint(std::format("\x1b[36;49m{}", "FPS (current): " + fpsString.substr(0, fpsString.find(".") + 3)));
 		mDebugPrint(std::format("\x1b[33;49m{}", "CPU work (ms): " + cpuWaitString.substr(0, cpuWaitString.find(".") + 3)));
 		mDebugPrint(std::format("\x1b[33;49m{}", "GPU draw (ms): " + gpuDrawString.substr(0, gpuDrawString.find(".") + 3)));
+		mDebugPrint(std::format("\x1b[33;49mGPU wait (ms): {:.2f}", m_gpuWaitTime * 1000));
+		if (m_pGpuTimer->isSupported()) mDebugPrint(std::format("\x1b[33;49mGPU frame (ms): {:.2f}", m_gpuFrameTime * 1000));
+		if (m_pDynamicResolution != nullptr) {
+			VkExtent2D renderExtent = *m_pSwapchain->getRenderExtent();
+			mDebugPrint(std::format("\x1b[36;49mResolution: {}x{} ({:.0f}%)", renderExtent.width, renderExtent.height, m_pDynamicResolution->getScale() * 100.0f));
+		}
 		mDebugPrint(std::format("\x1b[36;49m{}", "VBO count: " + vboCount));
+		mDebugPrint(std::format("\x1b[36;49m{}", "Models drawn: " + visibleCount + "/" + vboCount));
+		DrawEncoder::sStats bindStats = VulkanEngine::getInstance()->m_pBufferManager->m_drawEncoder.getStats();
+		mDebugPrint(std::format("\x1b[36;49mBinds (issued/skipped): {}/{}", bindStats.issuedBinds, bindStats.skippedBinds));
 
 		m_frameCounter = 0;
 		m_lastTime = current;
@@ -242,22 +448,13 @@ void Window::calculateFPS()
 
 
 
-void Window::cleanupSyncObjects()
-{
-	for (size_t i = 0; i < m_MAX_FRAMES_IN_FLIGHT; i++) {
-		vkDestroySemaphore(*m_pLogicalDevice, m_renderFinishedSemaphores[i], nullptr);
-		vkDestroySemaphore(*m_pLogicalDevice, m_imageAvailableSemaphores[i], nullptr);
-		vkDestroyFence(*m_pLogicalDevice, m_inFlightFences[i], nullptr);
-	}
-}
-
 void Window::cleanupSurface()
 {
-	vkDestroySurfaceKHR(*m_pVkInstance, m_surface, nullptr);
+	if (m_surface != VK_NULL_HANDLE) vkDestroySurfaceKHR(*m_pVkInstance, m_surface, nullptr);
 }
 
 void Window::cleanupWindow()
 {
-	glfwDestroyWindow(m_pWindow);
+	if (m_pWindow != nullptr) glfwDestroyWindow(m_pWindow);
 	glfwTerminate();
 }
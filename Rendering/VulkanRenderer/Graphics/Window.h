@@ -20,21 +20,34 @@
 //const uint32_t HEIGHT = 720;
 
 class CommandBuffer;
-class UniformBufferObject;
 class Camera;
+class GpuTimeline;
+class GpuTimer;
+class FrameContextRing;
+class AsyncCompute;
+class DeletionQueue;
+class DynamicResolution;
+class FrameCapture;
+class MultiviewTarget;
 
 class Window
 {
 public:
 	Window();
 
+	// Headless runs only initialise GLFW for its timer, there's no window or surface, see sWindowSettings::headless
 	void initWindow();
 	void createSurface();
-	void createSyncObjects();
+	// Fetches what drawFrame needs once the device, swapchain and frame contexts exist
+	void prepareRendering();
 
+	// Runs until the window is closed, or for sWindowSettings::headlessFrameCount frames when headless
 	void mainLoop();
+	// Draws the same number of frames with 1 up to maxFramesInFlight frames in flight and prints the throughput of each
+	void benchmarkFramesInFlight(uint32_t frameCount);
+	// Draws the same number of frames with and without the depth pre-pass, compares their GPU time and keeps the faster
+	void benchmarkDepthPrepass(uint32_t frameCount);
 
-	void cleanupSyncObjects();
 	void cleanupSurface();
 	void cleanupWindow();
 
@@ -42,11 +55,15 @@ public:
 
 	GLFWwindow* getWindow() { return m_pWindow; }
 	VkSurfaceKHR* getSurface() { return &m_surface; }
+	bool isHeadless() { return m_headless; }
 	Camera* getCamera() { return m_pCamera; }
 	void setCamera(Camera* pCamera) { m_pCamera = pCamera; }
+	// Drawn in the second view with split-screen multiview, see eMultiview
+	void setSecondCamera(Camera* pCamera) { m_pSecondCamera = pCamera; }
 	void setVBOCount(size_t count) { m_vboCount = count; }
 
 	bool m_framebufferResized = false;
+	bool m_minimised = false; // Zero sized framebuffer, nothing is rendered until the window is restored
 private:
 	VkInstance* m_pVkInstance = nullptr;
 	Utilities* m_pUtilities = nullptr;
@@ -54,17 +71,21 @@ private:
 	VkQueue* m_pGraphicsQueue = nullptr;
 	Swapchain* m_pSwapchain = nullptr;
 	CommandBuffer* m_pCommandBuffer = nullptr;
-	UniformBufferObject* m_pUniformBufferObject = nullptr;
 	sSettings::sGraphicsSettings* m_pGraphicsSettings = nullptr;
 	Camera* m_pCamera = nullptr;
+	Camera* m_pSecondCamera = nullptr;
 
-	GLFWwindow* m_pWindow = nullptr;
+	GLFWwindow* m_pWindow = nullptr; // Null when headless
 	VkSurfaceKHR m_surface = nullptr;
-	std::vector<VkSemaphore> m_imageAvailableSemaphores = {};
-	std::vector<VkSemaphore> m_renderFinishedSemaphores = {};
-	std::vector<VkFence> m_inFlightFences = {};
-	int m_MAX_FRAMES_IN_FLIGHT = 0;
-	uint32_t m_currentFrame = 0;
+	bool m_headless = false;
+	GpuTimeline* m_pGpuTimeline = nullptr;
+	GpuTimer* m_pGpuTimer = nullptr;
+	FrameContextRing* m_pFrameContexts = nullptr;
+	AsyncCompute* m_pAsyncCompute = nullptr;
+	DeletionQueue* m_pDeletionQueue = nullptr;
+	DynamicResolution* m_pDynamicResolution = nullptr;
+	FrameCapture* m_pFrameCapture = nullptr;
+	MultiviewTarget* m_pMultiviewTarget = nullptr;
 	bool* m_pShouldRender = nullptr;
 
 	// Debug information
@@ -72,13 +93,17 @@ private:
 	int m_frameCounter = 0;
 	double m_cpuWorkTime = 0.0f;
 	double m_gpuDrawTime = 0.0f;
+	double m_gpuWaitTime = 0.0f; // Time the CPU spent waiting for a free frame context
+	double m_gpuFrameTime = 0.0f; // Timestamped GPU time of the last frame that finished, see GpuTimer
 	double m_renderTargetDelta = 0.0f;
 	double m_renderLastTime = 0.0f;
 	size_t m_vboCount = 0;
 
 
 	void drawFrame();
-	void updateUniformBuffers(uint32_t currentImage);
+	// Draws a fixed number of frames as fast as the device allows and prints their average timings
+	void runHeadless(uint32_t frameCount);
+	void updateUniformBuffers(uint32_t frameIndex);
 
 	// Calculates and prints the FPS
 	void calculateFPS();
@@ -0,0 +1,573 @@
+#include "../VulkanRenderer.h"
+#include "../Graphics/Buffers.h"
+#include "../Graphics/GraphicsPipeline.h"
+#include "../Graphics/Image.h"
+#include "../Graphics/Vertex.h"
+#include "../Culling/FrustumCuller.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "CascadedShadows.h"
+
+
+
+CascadedShadows::CascadedShadows(VkDescriptorSetLayout shadowSetLayout) : m_pLogicalDevice(VulkanEngine::getInstance()->m_pLogicalDevice->getVkDevice()),
+	m_pBufferManager(VulkanEngine::getInstance()->m_pBufferManager), m_pGraphicsSettings(&VulkanEngine::getInstance()->m_settings->graphicsSettings),
+	m_MAX_FRAMES_IN_FLIGHT(VulkanEngine::getInstance()->m_MAX_FRAMES_IN_FLIGHT), m_setLayout(shadowSetLayout), m_pUtilities(Utilities::getInstance())
+{
+	createShadowMap();
+	createPipeline();
+	createDescriptorSets();
+}
+
+
+void CascadedShadows::createShadowMap()
+{
+	mDebugPrint(std::format("Creating shadow map ({} cascades of {}x{})...", sm_cascadeCount, sm_resolution, sm_resolution));
+
+	Image::createImage(sm_resolution, sm_resolution, sm_format, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_shadowMap, m_shadowMapMemory, 1, sm_cascadeCount);
+
+	m_shadowMapView = Image::createImageView(m_shadowMap, sm_format, VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, sm_cascadeCount);
+	for (uint32_t i = 0; i < sm_cascadeCount; i++) {
+		m_cascadeViews[i] = Image::createImageView(m_shadowMap, sm_format, VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, i, 1);
+	}
+
+	// Hardware comparison, with linear filtering each tap already blends four texels. Outside the cascade is lit.
+	VkSamplerCreateInfo samplerInfo{
+		.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+		.magFilter = VK_FILTER_LINEAR,
+		.minFilter = VK_FILTER_LINEAR,
+		.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+		.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER,
+		.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER,
+		.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+		.mipLodBias = 0.0f,
+		.anisotropyEnable = VK_FALSE,
+		.maxAnisotropy = 1.0f,
+		.compareEnable = VK_TRUE,
+		.compareOp = VK_COMPARE_OP_LESS_OR_EQUAL,
+		.minLod = 0.0f,
+		.maxLod = 0.0f,
+		.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE,
+		.unnormalizedCoordinates = VK_FALSE,
+	};
+
+	if (vkCreateSampler(*m_pLogicalDevice, &samplerInfo, nullptr, &m_shadowSampler) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create shadow map sampler!");
+	}
+}
+
+void CascadedShadows::createPipeline()
+{
+	mDebugPrint("Creating shadow cascade pipeline...");
+
+	VkPushConstantRange pushConstantRange{
+		.stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+		.offset = 0,
+		.size = sizeof(sCascadePushConstants)
+	};
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.setLayoutCount = 0,
+		.pSetLayouts = nullptr,
+		.pushConstantRangeCount = 1,
+		.pPushConstantRanges = &pushConstantRange
+	};
+
+	if (vkCreatePipelineLayout(*m_pLogicalDevice, &pipelineLayoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create shadow cascade pipeline layout!");
+	}
+
+	if (!m_pGraphicsSettings->dynamicRendering) {
+		// Each cascade is cleared and drawn whole, the render graph has the layer in the attachment layout already
+		VkAttachmentDescription2 depthAttachment{
+			.sType = VK_STRUCTURE_TYPE_ATTACHMENT_DESCRIPTION_2,
+			.format = sm_format,
+			.samples = VK_SAMPLE_COUNT_1_BIT,
+			.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+			.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+			.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+			.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+			.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+			.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+		};
+
+		VkAttachmentReference2 depthAttachmentRef{
+			.sType = VK_STRUCTURE_TYPE_ATTACHMENT_REFERENCE_2,
+			.attachment = 0,
+			.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+			.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT
+		};
+
+		VkSubpassDescription2 subpass{
+			.sType = VK_STRUCTURE_TYPE_SUBPASS_DESCRIPTION_2,
+			.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+			.colorAttachmentCount = 0,
+			.pDepthStencilAttachment = &depthAttachmentRef
+		};
+
+		VkRenderPassCreateInfo2 renderPassInfo{
+			.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO_2,
+			.attachmentCount = 1,
+			.pAttachments = &depthAttachment,
+			.subpassCount = 1,
+			.pSubpasses = &subpass,
+			.dependencyCount = 0,
+			.pDependencies = nullptr
+		};
+
+		if (vkCreateRenderPass2(*m_pLogicalDevice, &renderPassInfo, nullptr, &m_renderPass) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create shadow cascade render pass!");
+		}
+
+		for (uint32_t i = 0; i < sm_cascadeCount; i++) {
+			VkFramebufferCreateInfo framebufferInfo{
+				.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+				.renderPass = m_renderPass,
+				.attachmentCount = 1,
+				.pAttachments = &m_cascadeViews[i],
+				.width = sm_resolution,
+				.height = sm_resolution,
+				.layers = 1
+			};
+
+			if (vkCreateFramebuffer(*m_pLogicalDevice, &framebufferInfo, nullptr, &m_framebuffers[i]) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create shadow cascade framebuffer!");
+			}
+		}
+	}
+
+	VkPipelineShaderStageCreateInfo vertexStage{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+		.stage = VK_SHADER_STAGE_VERTEX_BIT,
+		.module = GraphicsPipeline::loadShaderModule(*m_pLogicalDevice, "shadowCascade.vert"),
+		.pName = "main"
+	};
+
+	// Same position stream as the depth pre-pass
+	VkVertexInputBindingDescription bindingDescription = Vertex::getPositionBindingDescription();
+	auto attributeDescriptions = Vertex::getPositionAttributeDescriptions();
+
+	VkPipelineVertexInputStateCreateInfo vertexInput{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+		.vertexBindingDescriptionCount = 1,
+		.pVertexBindingDescriptions = &bindingDescription,
+		.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size()),
+		.pVertexAttributeDescriptions = attributeDescriptions.data()
+	};
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssembly{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+		.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+		.primitiveRestartEnable = VK_FALSE
+	};
+
+	VkPipelineViewportStateCreateInfo viewportState{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+		.viewportCount = 1,
+		.pViewports = nullptr, // Dynamic
+		.scissorCount = 1,
+		.pScissors = nullptr // Dynamic
+	};
+
+	// Both faces cast, open meshes included. The bias grows with the slope so lit faces at grazing angles don't shadow themselves.
+	VkPipelineRasterizationStateCreateInfo rasterizer{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+		.depthClampEnable = VK_FALSE,
+		.rasterizerDiscardEnable = VK_FALSE,
+		.polygonMode = VK_POLYGON_MODE_FILL,
+		.cullMode = VK_CULL_MODE_NONE,
+		.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE,
+		.depthBiasEnable = VK_TRUE,
+		.depthBiasConstantFactor = 1.25f,
+		.depthBiasClamp = 0.0f,
+		.depthBiasSlopeFactor = 1.75f,
+		.lineWidth = 1.0f
+	};
+
+	VkPipelineMultisampleStateCreateInfo multisampling{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+		.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+		.sampleShadingEnable = VK_FALSE
+	};
+
+	VkPipelineDepthStencilStateCreateInfo depthStencil{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+		.depthTestEnable = VK_TRUE,
+		.depthWriteEnable = VK_TRUE,
+		.depthCompareOp = VK_COMPARE_OP_LESS,
+		.depthBoundsTestEnable = VK_FALSE,
+		.stencilTestEnable = VK_FALSE,
+		.minDepthBounds = 0.0f,
+		.maxDepthBounds = 1.0f
+	};
+
+	VkPipelineColorBlendStateCreateInfo colorBlending{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+		.logicOpEnable = VK_FALSE,
+		.attachmentCount = 0,
+		.pAttachments = nullptr
+	};
+
+	std::array<VkDynamicState, 2> dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+	VkPipelineDynamicStateCreateInfo dynamicState{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+		.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size()),
+		.pDynamicStates = dynamicStates.data()
+	};
+
+	VkPipelineRenderingCreateInfoKHR renderingInfo{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR,
+		.viewMask = 0,
+		.colorAttachmentCount = 0,
+		.pColorAttachmentFormats = nullptr,
+		.depthAttachmentFormat = sm_format,
+		.stencilAttachmentFormat = VK_FORMAT_UNDEFINED
+	};
+
+	VkGraphicsPipelineCreateInfo pipelineInfo{
+		.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+		.pNext = m_pGraphicsSettings->dynamicRendering ? &renderingInfo : nullptr,
+		.stageCount = 1,
+		.pStages = &vertexStage,
+		.pVertexInputState = &vertexInput,
+		.pInputAssemblyState = &inputAssembly,
+		.pViewportState = &viewportState,
+		.pRasterizationState = &rasterizer,
+		.pMultisampleState = &multisampling,
+		.pDepthStencilState = &depthStencil,
+		.pColorBlendState = &colorBlending,
+		.pDynamicState = &dynamicState,
+		.layout = m_pipelineLayout,
+		.renderPass = m_renderPass,
+		.subpass = 0,
+		.basePipelineHandle = VK_NULL_HANDLE,
+		.basePipelineIndex = -1
+	};
+
+	if (vkCreateGraphicsPipelines(*m_pLogicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_pipeline) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create shadow cascade pipeline!");
+	}
+
+	vkDestroyShaderModule(*m_pLogicalDevice, vertexStage.module, nullptr);
+}
+
+void CascadedShadows::createDescriptorSets()
+{
+	uint32_t frameCount = static_cast<uint32_t>(m_MAX_FRAMES_IN_FLIGHT);
+
+	m_paramsBuffers.resize(frameCount);
+	m_paramsBuffersMemory.resize(frameCount);
+	m_paramsBuffersMapped.resize(frameCount);
+
+	for (size_t i = 0; i < frameCount; i++) {
+		m_pBufferManager->createBuffer(sizeof(sShadowParams), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			m_paramsBuffers[i], m_paramsBuffersMemory[i]);
+		vkMapMemory(*m_pLogicalDevice, m_paramsBuffersMemory[i], 0, sizeof(sShadowParams), 0, &m_paramsBuffersMapped[i]);
+	}
+
+	std::array<VkDescriptorPoolSize, 2> poolSizes{
+		VkDescriptorPoolSize{
+			.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+			.descriptorCount = frameCount
+		},
+		VkDescriptorPoolSize{
+			.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.descriptorCount = frameCount
+		}
+	};
+
+	VkDescriptorPoolCreateInfo poolInfo{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.maxSets = frameCount,
+		.poolSizeCount = static_cast<uint32_t>(poolSizes.size()),
+		.pPoolSizes = poolSizes.data()
+	};
+
+	if (vkCreateDescriptorPool(*m_pLogicalDevice, &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create shadow descriptor pool!");
+	}
+
+
+	std::vector<VkDescriptorSetLayout> layouts(frameCount, m_setLayout);
+	m_descriptorSets.resize(frameCount);
+
+	VkDescriptorSetAllocateInfo allocInfo{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.descriptorPool = m_descriptorPool,
+		.descriptorSetCount = frameCount,
+		.pSetLayouts = layouts.data()
+	};
+
+	if (vkAllocateDescriptorSets(*m_pLogicalDevice, &allocInfo, m_descriptorSets.data()) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate shadow descriptor sets!");
+	}
+
+
+	// Sampled in the layout the render graph leaves depth images in for fragment reads
+	VkDescriptorImageInfo imageInfo{
+		.sampler = m_shadowSampler,
+		.imageView = m_shadowMapView,
+		.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+	};
+
+	for (uint32_t i = 0; i < frameCount; i++)
+	{
+		VkDescriptorBufferInfo bufferInfo{ .buffer = m_paramsBuffers[i], .offset = 0, .range = VK_WHOLE_SIZE };
+
+		std::array<VkWriteDescriptorSet, 2> descriptorWrites{
+			VkWriteDescriptorSet{
+				.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+				.dstSet = m_descriptorSets[i],
+				.dstBinding = 0,
+				.descriptorCount = 1,
+				.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+				.pBufferInfo = &bufferInfo
+			},
+			VkWriteDescriptorSet{
+				.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+				.dstSet = m_descriptorSets[i],
+				.dstBinding = 1,
+				.descriptorCount = 1,
+				.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				.pImageInfo = &imageInfo
+			}
+		};
+
+		vkUpdateDescriptorSets(*m_pLogicalDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+	}
+}
+
+
+
+glm::mat4 CascadedShadows::makeLightViewProj(const glm::mat4& lightView, glm::vec3 center, float radius)
+{
+	// Moving the box by whole texels keeps every caster on the same texels, so edges don't crawl as the camera moves
+	float texelSize = 2.0f * radius / sm_resolution;
+	glm::vec3 lightCenter = glm::vec3(lightView * glm::vec4(center, 1.0f));
+	lightCenter.x = std::floor(lightCenter.x / texelSize) * texelSize;
+	lightCenter.y = std::floor(lightCenter.y / texelSize) * texelSize;
+
+	// The near plane is pulled back towards the sun so casters outside the sphere still land in the map
+	glm::mat4 lightProj = glm::orthoRH_ZO(lightCenter.x - radius, lightCenter.x + radius, lightCenter.y - radius, lightCenter.y + radius,
+		-(lightCenter.z + radius + sm_casterDistance), -(lightCenter.z - radius));
+
+	return lightProj * lightView;
+}
+
+void CascadedShadows::update(uint32_t frameIndex, const glm::mat4& view, const glm::mat4& proj, glm::vec3 sunDirection, FrustumCuller* pFrustumCuller)
+{
+	m_drawMask = 0;
+
+	sShadowParams params{};
+	params.texelSize = 1.0f / sm_resolution;
+
+	bool enabled = m_pGraphicsSettings->shadows;
+	if (enabled && !m_wasEnabled) invalidateCache(); // Nothing was kept up to date while off
+	m_wasEnabled = enabled;
+
+	if (!enabled) {
+		params.cascadeCount = 0;
+		memcpy(m_paramsBuffersMapped[frameIndex], &params, sizeof(params));
+		return;
+	}
+
+	// Practical split scheme, a blend of logarithmic and uniform splits
+	float nearClip = m_pGraphicsSettings->nearClip;
+	float shadowDistance = std::min(m_pGraphicsSettings->shadowDistance, m_pGraphicsSettings->farClip);
+	std::array<float, sm_cascadeCount + 1> splits = {};
+	splits[0] = nearClip;
+	for (uint32_t i = 1; i <= sm_cascadeCount; i++) {
+		float fraction = static_cast<float>(i) / sm_cascadeCount;
+		float logSplit = nearClip * std::pow(shadowDistance / nearClip, fraction);
+		float uniformSplit = nearClip + (shadowDistance - nearClip) * fraction;
+		splits[i] = sm_splitLambda * logSplit + (1.0f - sm_splitLambda) * uniformSplit;
+	}
+
+	// Half the frustum's width and height at unit depth, squared and summed gives its corners
+	float tanX = 1.0f / proj[0][0];
+	float tanY = 1.0f / std::abs(proj[1][1]);
+	float cornerSquared = tanX * tanX + tanY * tanY;
+
+	glm::mat4 inverseView = glm::inverse(view);
+	glm::vec3 cameraPosition = glm::vec3(inverseView[3]);
+	glm::vec3 cameraForward = -glm::normalize(glm::vec3(inverseView[2]));
+
+	glm::vec3 sunDir = glm::normalize(sunDirection);
+	glm::vec3 up = std::abs(sunDir.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+	glm::mat4 lightView = glm::lookAt(glm::vec3(0.0f), sunDir, up);
+
+	m_frameCount++;
+	int staleCascade = -1;
+	std::array<float, sm_cascadeCount> cachedRadii = {};
+
+	for (uint32_t c = 0; c < sm_cascadeCount; c++) {
+		float dn = splits[c];
+		float df = splits[c + 1];
+		params.splitDepths[c] = df;
+
+		if (c < sm_firstCachedCascade) {
+			// Smallest sphere around the slice of the frustum. Its radius only depends on the projection, so it stays the
+			// same size as the camera turns.
+			float zc = std::min((df + dn) * (1.0f + cornerSquared) * 0.5f, df);
+			float radius = std::max(std::sqrt((zc - dn) * (zc - dn) + dn * dn * cornerSquared), std::sqrt((df - zc) * (df - zc) + df * df * cornerSquared));
+			radius = std::ceil(radius);
+
+			m_lightViewProjs[c] = makeLightViewProj(lightView, cameraPosition + cameraForward * zc, radius);
+			m_drawMask |= 1u << c;
+			continue;
+		}
+
+		// Covers the whole slice for any view direction, and from anywhere within the threshold of where it was drawn
+		float threshold = df * sm_cacheMoveFraction;
+		cachedRadii[c] = std::ceil(df * std::sqrt(1.0f + cornerSquared) + threshold);
+
+		// An invalid cascade can't be used at all, a stale one still shadows most of what it covers for a few more frames
+		if (!m_cacheValid[c]) {
+			m_drawMask |= 1u << c;
+		}
+		else if (sunDir != m_cachedSunDirections[c] || cachedRadii[c] != m_cachedRadii[c] || glm::distance(cameraPosition, m_cachedCameraPositions[c]) > threshold) {
+			if (staleCascade < 0 || m_drawnFrames[c] < m_drawnFrames[staleCascade]) staleCascade = static_cast<int>(c);
+		}
+	}
+	if (staleCascade >= 0) m_drawMask |= 1u << staleCascade;
+
+	for (uint32_t c = 0; c < sm_cascadeCount; c++) {
+		if (c >= sm_firstCachedCascade && (m_drawMask & (1u << c))) {
+			m_lightViewProjs[c] = makeLightViewProj(lightView, cameraPosition, cachedRadii[c]);
+			m_cachedCameraPositions[c] = cameraPosition;
+			m_cachedRadii[c] = cachedRadii[c];
+			m_cachedSunDirections[c] = sunDir;
+			m_drawnFrames[c] = m_frameCount;
+			m_cacheValid[c] = true;
+		}
+
+		params.cascadeMatrices[c] = m_lightViewProjs[c] * inverseView;
+	}
+
+	for (uint32_t c = 0; c < sm_cascadeCount; c++) {
+		if (m_drawMask & (1u << c)) pFrustumCuller->cull(FrustumCuller::extractFrustum(m_lightViewProjs[c]), m_casterIndices[c]);
+	}
+
+	params.cascadeCount = sm_cascadeCount;
+	memcpy(m_paramsBuffersMapped[frameIndex], &params, sizeof(params));
+}
+
+void CascadedShadows::recordCascades(VkCommandBuffer commandBuffer)
+{
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
+
+	VkExtent2D extent{ sm_resolution, sm_resolution };
+	VkClearValue clearValue{ .depthStencil = { 1.0f, 0 } };
+
+	for (uint32_t c = 0; c < sm_cascadeCount; c++) {
+		if (!(m_drawMask & (1u << c))) continue;
+
+		if (m_pGraphicsSettings->dynamicRendering) {
+			VkRenderingAttachmentInfoKHR depthAttachment{
+				.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR,
+				.imageView = m_cascadeViews[c],
+				.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+				.resolveMode = VK_RESOLVE_MODE_NONE,
+				.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+				.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+				.clearValue = clearValue
+			};
+
+			VkRenderingInfoKHR renderingInfo{
+				.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR,
+				.renderArea {
+					.offset = { 0, 0 },
+					.extent = extent
+				},
+				.layerCount = 1,
+				.viewMask = 0,
+				.colorAttachmentCount = 0,
+				.pColorAttachments = nullptr,
+				.pDepthAttachment = &depthAttachment,
+				.pStencilAttachment = nullptr
+			};
+
+			m_pBufferManager->m_vkCmdBeginRendering(commandBuffer, &renderingInfo);
+		}
+		else {
+			VkRenderPassBeginInfo renderPassInfo{
+				.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+				.renderPass = m_renderPass,
+				.framebuffer = m_framebuffers[c],
+				.renderArea {
+					.offset = { 0, 0 },
+					.extent = extent,
+				},
+				.clearValueCount = 1,
+				.pClearValues = &clearValue
+			};
+
+			vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		}
+
+		VkViewport viewport{
+			.x = 0.0f,
+			.y = 0.0f,
+			.width = static_cast<float>(sm_resolution),
+			.height = static_cast<float>(sm_resolution),
+			.minDepth = 0.0f,
+			.maxDepth = 1.0f
+		};
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+		VkRect2D scissor{
+			.offset = { 0, 0 },
+			.extent = extent
+		};
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		for (uint32_t modelIndex : m_casterIndices[c]) {
+			Model* model = m_pBufferManager->m_pLoadedModels->at(modelIndex);
+
+			sCascadePushConstants pushConstants{
+				.lightViewProj = m_lightViewProjs[c],
+				.model = model->getTransform()
+			};
+			vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(pushConstants), &pushConstants);
+
+			VkDeviceSize offset = 0;
+			vkCmdBindVertexBuffers(commandBuffer, 0, 1, model->m_pVertexBuffer->getVkPositionBuffer(), &offset);
+			vkCmdBindIndexBuffer(commandBuffer, *model->m_pIndexBuffer->getVkIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
+			vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(model->m_pIndexBuffer->m_indices.size()), 1, 0, 0, 0);
+		}
+
+		if (m_pGraphicsSettings->dynamicRendering) {
+			m_pBufferManager->m_vkCmdEndRendering(commandBuffer);
+		}
+		else {
+			vkCmdEndRenderPass(commandBuffer);
+		}
+	}
+}
+
+
+
+void CascadedShadows::cleanup()
+{
+	vkDestroyDescriptorPool(*m_pLogicalDevice, m_descriptorPool, nullptr);
+	for (size_t i = 0; i < m_MAX_FRAMES_IN_FLIGHT; i++) {
+		vkDestroyBuffer(*m_pLogicalDevice, m_paramsBuffers[i], nullptr);
+		vkFreeMemory(*m_pLogicalDevice, m_paramsBuffersMemory[i], nullptr);
+	}
+
+	vkDestroyPipeline(*m_pLogicalDevice, m_pipeline, nullptr);
+	vkDestroyPipelineLayout(*m_pLogicalDevice, m_pipelineLayout, nullptr);
+	for (VkFramebuffer framebuffer : m_framebuffers) {
+		if (framebuffer != VK_NULL_HANDLE) vkDestroyFramebuffer(*m_pLogicalDevice, framebuffer, nullptr);
+	}
+	if (m_renderPass != VK_NULL_HANDLE) vkDestroyRenderPass(*m_pLogicalDevice, m_renderPass, nullptr);
+
+	vkDestroySampler(*m_pLogicalDevice, m_shadowSampler, nullptr);
+	for (VkImageView view : m_cascadeViews) vkDestroyImageView(*m_pLogicalDevice, view, nullptr);
+	vkDestroyImageView(*m_pLogicalDevice, m_shadowMapView, nullptr);
+	vkDestroyImage(*m_pLogicalDevice, m_shadowMap, nullptr);
+	vkFreeMemory(*m_pLogicalDevice, m_shadowMapMemory, nullptr);
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <array>
+#include <cstdint>
+
+#include "../Utilities/Utilities.h"
+
+
+class BufferManager;
+class FrustumCuller;
+
+// Cascaded shadow maps for the sun. The view frustum up to the shadow distance is split into cascades, each drawn from the
+// sun into one layer of a depth array with only the models inside its box. The boxes are bounding spheres snapped to
+// whole shadow map texels, so they don't change size as the camera turns and don't shimmer as it moves.
+// The near cascades follow the view every frame. The far ones cover a sphere around the camera instead, padded so they
+// stay valid while it moves a little, and are only redrawn once it has moved past that or the sun has changed, at most
+// one a frame.
+class CascadedShadows
+{
+public:
+	static constexpr uint32_t sm_cascadeCount = 4; // Matches the array size in fragBase.frag
+	static constexpr uint32_t sm_firstCachedCascade = 2;
+	static constexpr uint32_t sm_resolution = 2048;
+	static constexpr VkFormat sm_format = VK_FORMAT_D32_SFLOAT;
+
+	CascadedShadows(VkDescriptorSetLayout shadowSetLayout);
+
+	// Fits the cascades to the view, picks the ones to redraw and culls their casters against them. Call after the frame's
+	// models have been added to the frustum culler.
+	void update(uint32_t frameIndex, const glm::mat4& view, const glm::mat4& proj, glm::vec3 sunDirection, FrustumCuller* pFrustumCuller);
+	// Redraws the cached cascades next frame, call when shadow casters have moved
+	void invalidateCache() { m_cacheValid.fill(false); }
+
+	// Whether update picked any cascade to draw this frame
+	bool hasCascadesToDraw() { return m_drawMask != 0; }
+	// Draws the picked cascades, the render graph has moved the shadow map into the depth attachment layout
+	void recordCascades(VkCommandBuffer commandBuffer);
+
+	VkImage* getShadowMap() { return &m_shadowMap; }
+	VkDescriptorSet* getDescriptorSet(uint32_t frameIndex) { return &m_descriptorSets[frameIndex]; }
+
+	void cleanup();
+
+private:
+	static constexpr float sm_splitLambda = 0.75f; // 1 splits logarithmically, 0 uniformly
+	static constexpr float sm_cacheMoveFraction = 0.1f; // How far the camera can move before a cached cascade is stale, as a fraction of its reach
+	static constexpr float sm_casterDistance = 100.0f; // How far towards the sun casters outside a cascade still cast into it
+
+	// Matches ShadowParams in fragBase.frag
+	struct sShadowParams
+	{
+		glm::mat4 cascadeMatrices[sm_cascadeCount];
+		glm::vec4 splitDepths;
+		float texelSize;
+		uint32_t cascadeCount;
+	};
+
+	// Matches the push constants in shadowCascade.vert
+	struct sCascadePushConstants
+	{
+		glm::mat4 lightViewProj;
+		glm::mat4 model;
+	};
+
+	Utilities* m_pUtilities = nullptr;
+	VkDevice* m_pLogicalDevice = nullptr;
+	BufferManager* m_pBufferManager = nullptr;
+	sSettings::sGraphicsSettings* m_pGraphicsSettings = nullptr;
+	int m_MAX_FRAMES_IN_FLIGHT = 1;
+
+	VkImage m_shadowMap = VK_NULL_HANDLE; // One layer per cascade
+	VkDeviceMemory m_shadowMapMemory = VK_NULL_HANDLE;
+	VkImageView m_shadowMapView = VK_NULL_HANDLE; // Every layer, sampled
+	std::array<VkImageView, sm_cascadeCount> m_cascadeViews = {}; // One layer each, drawn to
+	VkSampler m_shadowSampler = VK_NULL_HANDLE;
+
+	VkRenderPass m_renderPass = VK_NULL_HANDLE; // Not created with dynamic rendering
+	std::array<VkFramebuffer, sm_cascadeCount> m_framebuffers = {};
+	VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline m_pipeline = VK_NULL_HANDLE;
+
+	std::vector<VkBuffer> m_paramsBuffers = {};
+	std::vector<VkDeviceMemory> m_paramsBuffersMemory = {};
+	std::vector<void*> m_paramsBuffersMapped = {};
+	VkDescriptorSetLayout m_setLayout = VK_NULL_HANDLE; // Owned by the graphics pipeline
+	VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+	std::vector<VkDescriptorSet> m_descriptorSets = {}; // One per frame in flight
+
+	// State of each cascade as it was last drawn, cached cascades keep theirs until they're redrawn
+	std::array<glm::mat4, sm_cascadeCount> m_lightViewProjs = {};
+	std::array<bool, sm_cascadeCount> m_cacheValid = {};
+	std::array<glm::vec3, sm_cascadeCount> m_cachedCameraPositions = {};
+	std::array<float, sm_cascadeCount> m_cachedRadii = {};
+	std::array<glm::vec3, sm_cascadeCount> m_cachedSunDirections = {};
+	std::array<uint64_t, sm_cascadeCount> m_drawnFrames = {}; // Stale cascades are redrawn oldest first
+	uint64_t m_frameCount = 0;
+	bool m_wasEnabled = false;
+
+	uint32_t m_drawMask = 0; // Cascades to draw this frame
+	std::array<std::vector<uint32_t>, sm_cascadeCount> m_casterIndices = {};
+
+
+	void createShadowMap();
+	void createPipeline();
+	void createDescriptorSets();
+
+	// Orthographic projection from the sun around a sphere, with the centre snapped to the cascade's texel grid
+	static glm::mat4 makeLightViewProj(const glm::mat4& lightView, glm::vec3 center, float radius);
+};
@@ -0,0 +1,279 @@
+#include "../VulkanRenderer.h"
+#include "../Graphics/Buffers.h"
+#include "../Graphics/GraphicsPipeline.h"
+#include "../Graphics/AsyncCompute.h"
+
+#include "ClusteredLighting.h"
+
+
+
+ClusteredLighting::ClusteredLighting(VkDescriptorSetLayout lightSetLayout) : m_pLogicalDevice(VulkanEngine::getInstance()->m_pLogicalDevice->getVkDevice()),
+	m_pBufferManager(VulkanEngine::getInstance()->m_pBufferManager), m_pAsyncCompute(VulkanEngine::getInstance()->m_pAsyncCompute),
+	m_pGraphicsSettings(&VulkanEngine::getInstance()->m_settings->graphicsSettings), m_MAX_FRAMES_IN_FLIGHT(VulkanEngine::getInstance()->m_MAX_FRAMES_IN_FLIGHT),
+	m_setLayout(lightSetLayout), m_pUtilities(Utilities::getInstance())
+{
+	m_viewCount = m_pGraphicsSettings->multiview != eMultiview::NONE ? MultiviewTarget::sm_viewCount : 1;
+
+	createBuffers();
+	createPipeline();
+	createDescriptorSets();
+}
+
+
+void ClusteredLighting::createBuffers()
+{
+	mDebugPrint(std::format("Creating light cluster buffers ({}x{}x{} clusters, up to {} lights, {} view(s))...", sm_gridWidth, sm_gridHeight, sm_gridDepth, sm_maxLights, m_viewCount));
+
+	// The shaders declare a block per view whether or not they're all drawn, so the parameters always have room for each
+	std::vector<uint32_t> queueFamilies = { m_pAsyncCompute->getGraphicsFamily(), m_pAsyncCompute->getComputeFamily() };
+	VkDeviceSize paramsSize = MultiviewTarget::sm_viewCount * sizeof(sClusterParams);
+	VkDeviceSize lightsSize = m_viewCount * sm_maxLights * sizeof(sLight);
+	VkDeviceSize clusterCount = sm_gridWidth * sm_gridHeight * sm_gridDepth;
+	VkDeviceSize clustersSize = m_viewCount * (clusterCount + clusterCount * sm_maxLightsPerCluster) * sizeof(uint32_t);
+
+	m_paramsBuffers.resize(m_MAX_FRAMES_IN_FLIGHT);
+	m_paramsBuffersMemory.resize(m_MAX_FRAMES_IN_FLIGHT);
+	m_paramsBuffersMapped.resize(m_MAX_FRAMES_IN_FLIGHT);
+	m_lightBuffers.resize(m_MAX_FRAMES_IN_FLIGHT);
+	m_lightBuffersMemory.resize(m_MAX_FRAMES_IN_FLIGHT);
+	m_lightBuffersMapped.resize(m_MAX_FRAMES_IN_FLIGHT);
+	m_clusterBuffers.resize(m_MAX_FRAMES_IN_FLIGHT);
+	m_clusterBuffersMemory.resize(m_MAX_FRAMES_IN_FLIGHT);
+	m_binned.resize(m_MAX_FRAMES_IN_FLIGHT, false);
+
+	for (size_t i = 0; i < m_MAX_FRAMES_IN_FLIGHT; i++) {
+		// Only read on the GPU, so sharing them costs nothing and saves transferring them with the cluster lists
+		m_pBufferManager->createBuffer(paramsSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			m_paramsBuffers[i], m_paramsBuffersMemory[i], queueFamilies);
+		vkMapMemory(*m_pLogicalDevice, m_paramsBuffersMemory[i], 0, paramsSize, 0, &m_paramsBuffersMapped[i]);
+
+		m_pBufferManager->createBuffer(lightsSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			m_lightBuffers[i], m_lightBuffersMemory[i], queueFamilies);
+		vkMapMemory(*m_pLogicalDevice, m_lightBuffersMemory[i], 0, lightsSize, 0, &m_lightBuffersMapped[i]);
+
+		m_pBufferManager->createBuffer(clustersSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_clusterBuffers[i], m_clusterBuffersMemory[i]);
+	}
+}
+
+void ClusteredLighting::createPipeline()
+{
+	mDebugPrint("Creating light binning pipeline...");
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.setLayoutCount = 1,
+		.pSetLayouts = &m_setLayout,
+		.pushConstantRangeCount = 0,
+		.pPushConstantRanges = nullptr
+	};
+
+	if (vkCreatePipelineLayout(*m_pLogicalDevice, &pipelineLayoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create light binning pipeline layout!");
+	}
+
+	VkShaderModule binningShaderModule = GraphicsPipeline::loadShaderModule(*m_pLogicalDevice, "lightCluster.comp");
+
+	VkComputePipelineCreateInfo pipelineInfo{
+		.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+		.stage {
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			.stage = VK_SHADER_STAGE_COMPUTE_BIT,
+			.module = binningShaderModule,
+			.pName = "main"
+		},
+		.layout = m_pipelineLayout
+	};
+
+	if (vkCreateComputePipelines(*m_pLogicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_binningPipeline) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create light binning pipeline!");
+	}
+
+	vkDestroyShaderModule(*m_pLogicalDevice, binningShaderModule, nullptr);
+}
+
+void ClusteredLighting::createDescriptorSets()
+{
+	uint32_t frameCount = static_cast<uint32_t>(m_MAX_FRAMES_IN_FLIGHT);
+
+	std::array<VkDescriptorPoolSize, 2> poolSizes{
+		VkDescriptorPoolSize{
+			.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+			.descriptorCount = frameCount
+		},
+		VkDescriptorPoolSize{
+			.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.descriptorCount = 2 * frameCount
+		}
+	};
+
+	VkDescriptorPoolCreateInfo poolInfo{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.maxSets = frameCount,
+		.poolSizeCount = static_cast<uint32_t>(poolSizes.size()),
+		.pPoolSizes = poolSizes.data()
+	};
+
+	if (vkCreateDescriptorPool(*m_pLogicalDevice, &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create light cluster descriptor pool!");
+	}
+
+
+	std::vector<VkDescriptorSetLayout> layouts(frameCount, m_setLayout);
+	m_descriptorSets.resize(frameCount);
+
+	VkDescriptorSetAllocateInfo allocInfo{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.descriptorPool = m_descriptorPool,
+		.descriptorSetCount = frameCount,
+		.pSetLayouts = layouts.data()
+	};
+
+	if (vkAllocateDescriptorSets(*m_pLogicalDevice, &allocInfo, m_descriptorSets.data()) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate light cluster descriptor sets!");
+	}
+
+
+	for (uint32_t i = 0; i < frameCount; i++)
+	{
+		std::array<VkDescriptorBufferInfo, 3> bufferInfos{
+			VkDescriptorBufferInfo{ .buffer = m_paramsBuffers[i], .offset = 0, .range = VK_WHOLE_SIZE },
+			VkDescriptorBufferInfo{ .buffer = m_lightBuffers[i], .offset = 0, .range = VK_WHOLE_SIZE },
+			VkDescriptorBufferInfo{ .buffer = m_clusterBuffers[i], .offset = 0, .range = VK_WHOLE_SIZE }
+		};
+
+		std::array<VkWriteDescriptorSet, 3> descriptorWrites{};
+		for (uint32_t binding = 0; binding < descriptorWrites.size(); binding++) {
+			descriptorWrites[binding] = VkWriteDescriptorSet{
+				.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+				.dstSet = m_descriptorSets[i],
+				.dstBinding = binding,
+				.descriptorCount = 1,
+				.descriptorType = binding == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				.pBufferInfo = &bufferInfos[binding]
+			};
+		}
+
+		vkUpdateDescriptorSets(*m_pLogicalDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+	}
+}
+
+
+
+uint32_t ClusteredLighting::addPointLight(glm::vec3 position, glm::vec3 color, float intensity, float range)
+{
+	if (m_lights.size() >= sm_maxLights) {
+		throw std::runtime_error("failed to add point light, too many lights!");
+	}
+
+	m_lights.push_back(sLight{
+		.positionRange = glm::vec4(position, range),
+		.colorIntensity = glm::vec4(color, intensity),
+		.directionCosOuter = glm::vec4(0.0f, 0.0f, -1.0f, -2.0f), // Every direction is inside the cone
+		.cosInner = glm::vec4(-1.0f, 0.0f, 0.0f, 0.0f)
+	});
+
+	return static_cast<uint32_t>(m_lights.size() - 1);
+}
+
+uint32_t ClusteredLighting::addSpotLight(glm::vec3 position, glm::vec3 direction, glm::vec3 color, float intensity, float range, float innerAngle, float outerAngle)
+{
+	if (m_lights.size() >= sm_maxLights) {
+		throw std::runtime_error("failed to add spot light, too many lights!");
+	}
+
+	m_lights.push_back(sLight{
+		.positionRange = glm::vec4(position, range),
+		.colorIntensity = glm::vec4(color, intensity),
+		.directionCosOuter = glm::vec4(glm::normalize(direction), std::cos(glm::radians(outerAngle))),
+		.cosInner = glm::vec4(std::cos(glm::radians(innerAngle)), 0.0f, 0.0f, 0.0f)
+	});
+
+	return static_cast<uint32_t>(m_lights.size() - 1);
+}
+
+
+
+void ClusteredLighting::update(uint32_t frameIndex, const std::vector<glm::mat4>& views, const std::vector<glm::mat4>& projs, VkExtent2D extent, glm::vec3 sunDirection)
+{
+	uint32_t lightCount = m_pGraphicsSettings->clusteredLighting ? std::min(static_cast<uint32_t>(m_lights.size()), sm_maxLights) : 0;
+	uint32_t clusterListSize = sm_gridWidth * sm_gridHeight * sm_gridDepth * (1 + sm_maxLightsPerCluster);
+
+	// Slices are spaced exponentially so clusters stay roughly cube shaped with distance
+	float nearClip = m_pGraphicsSettings->nearClip;
+	float farClip = m_pGraphicsSettings->farClip;
+	float logDepthRange = std::log(farClip / nearClip);
+
+	// Safe to write, the frame's graphics submission has finished and it waited for the frame's last binning
+	sClusterParams* pParams = static_cast<sClusterParams*>(m_paramsBuffersMapped[frameIndex]);
+	sLight* pLights = static_cast<sLight*>(m_lightBuffersMapped[frameIndex]);
+	for (uint32_t v = 0; v < m_viewCount; v++) {
+		const glm::mat4& view = views[v];
+		glm::mat3 viewRotation = glm::mat3(view);
+		uint32_t lightOffset = v * sm_maxLights;
+
+		for (uint32_t i = 0; i < lightCount; i++) {
+			const sLight& light = m_lights[i];
+			pLights[lightOffset + i] = sLight{
+				.positionRange = glm::vec4(glm::vec3(view * glm::vec4(glm::vec3(light.positionRange), 1.0f)), light.positionRange.w),
+				.colorIntensity = light.colorIntensity,
+				.directionCosOuter = glm::vec4(viewRotation * glm::vec3(light.directionCosOuter), light.directionCosOuter.w),
+				.cosInner = light.cosInner
+			};
+		}
+
+		pParams[v] = sClusterParams{
+			.inverseProj = glm::inverse(projs[v]),
+			.gridSize = glm::uvec4(sm_gridWidth, sm_gridHeight, sm_gridDepth, lightCount),
+			.sunDirection = glm::vec4(glm::normalize(viewRotation * -sunDirection), 1.0f),
+			.tileSize = glm::vec2(static_cast<float>(extent.width) / sm_gridWidth, static_cast<float>(extent.height) / sm_gridHeight),
+			.sliceScale = sm_gridDepth / logDepthRange,
+			.sliceBias = sm_gridDepth * std::log(nearClip) / logDepthRange,
+			.maxLightsPerCluster = sm_maxLightsPerCluster,
+			.ambient = 0.1f,
+			.lightOffset = lightOffset,
+			.clusterOffset = v * clusterListSize
+		};
+	}
+
+	// Without lights the fragment shader doesn't read the cluster lists, so there's nothing to bin
+	m_binned[frameIndex] = lightCount > 0;
+	if (!m_binned[frameIndex]) return;
+
+	// The previous contents aren't needed, so the compute queue takes the cluster lists back without an ownership transfer
+	VkCommandBuffer commandBuffer = m_pAsyncCompute->begin(frameIndex);
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_binningPipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &m_descriptorSets[frameIndex], 0, nullptr);
+	vkCmdDispatch(commandBuffer, (sm_gridWidth * sm_gridHeight * sm_gridDepth + 63) / 64, m_viewCount, 1);
+	AsyncCompute::releaseBuffer(commandBuffer, m_clusterBuffers[frameIndex], m_pAsyncCompute->getComputeFamily(), m_pAsyncCompute->getGraphicsFamily(),
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+
+	uint64_t computeValue = m_pAsyncCompute->submit(frameIndex);
+	m_pAsyncCompute->addGraphicsWait(computeValue, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+}
+
+void ClusteredLighting::recordAcquire(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+{
+	if (!m_binned[frameIndex]) return;
+
+	AsyncCompute::acquireBuffer(commandBuffer, m_clusterBuffers[frameIndex], m_pAsyncCompute->getComputeFamily(), m_pAsyncCompute->getGraphicsFamily(),
+		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+}
+
+
+
+void ClusteredLighting::cleanup()
+{
+	vkDestroyDescriptorPool(*m_pLogicalDevice, m_descriptorPool, nullptr);
+
+	vkDestroyPipeline(*m_pLogicalDevice, m_binningPipeline, nullptr);
+	vkDestroyPipelineLayout(*m_pLogicalDevice, m_pipelineLayout, nullptr);
+
+	for (size_t i = 0; i < m_MAX_FRAMES_IN_FLIGHT; i++) {
+		vkDestroyBuffer(*m_pLogicalDevice, m_paramsBuffers[i], nullptr);
+		vkFreeMemory(*m_pLogicalDevice, m_paramsBuffersMemory[i], nullptr);
+		vkDestroyBuffer(*m_pLogicalDevice, m_lightBuffers[i], nullptr);
+		vkFreeMemory(*m_pLogicalDevice, m_lightBuffersMemory[i], nullptr);
+		vkDestroyBuffer(*m_pLogicalDevice, m_clusterBuffers[i], nullptr);
+		vkFreeMemory(*m_pLogicalDevice, m_clusterBuffersMemory[i], nullptr);
+	}
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+#include "../Utilities/Utilities.h"
+
+
+class BufferManager;
+class AsyncCompute;
+
+// Clustered forward lighting. The view frustum is split into a grid of clusters, screen tiles cut into exponential depth
+// slices, and every frame a compute pass lists the lights touching each cluster. Fragments only walk their cluster's list,
+// so the cost of a light stays local to the pixels it can reach.
+// The binning doesn't depend on the frame's rasterisation, so it runs on the async compute queue and the graphics
+// submission only waits for it before fragment shading. With multiview every view is binned into its own clusters, from
+// its own view space copy of the lights, in the same dispatch.
+class ClusteredLighting
+{
+public:
+	// Matches Light in lightCluster.comp and fragBase.frag. Lights are kept in world space and uploaded in view space.
+	struct sLight
+	{
+		glm::vec4 positionRange; // Position (xyz) and range (w), past which the light has no effect
+		glm::vec4 colorIntensity;
+		glm::vec4 directionCosOuter; // Spot direction (xyz) and cosine of the outer cone angle, -2 for point lights
+		glm::vec4 cosInner; // Cosine of the inner cone angle (x)
+	};
+
+	static constexpr uint32_t sm_maxLights = 4096;
+	static constexpr uint32_t sm_gridWidth = 16;
+	static constexpr uint32_t sm_gridHeight = 9;
+	static constexpr uint32_t sm_gridDepth = 24;
+	static constexpr uint32_t sm_maxLightsPerCluster = 256; // Lights past this are dropped from the cluster
+
+	// The set layout is the graphics pipeline's set 1, so the descriptor sets bind to both pipelines
+	ClusteredLighting(VkDescriptorSetLayout lightSetLayout);
+
+	// Return the light's index. Lights can be changed through getLights between frames.
+	uint32_t addPointLight(glm::vec3 position, glm::vec3 color, float intensity, float range);
+	// Angles in degrees, the light fades out between the inner and outer cone
+	uint32_t addSpotLight(glm::vec3 position, glm::vec3 direction, glm::vec3 color, float intensity, float range, float innerAngle, float outerAngle);
+	std::vector<sLight>& getLights() { return m_lights; }
+	void clearLights() { m_lights.clear(); }
+
+	// Uploads the lights in each view's space and submits the frame's binning to the compute queue, which the frame's
+	// graphics submission then waits for. Call once the frame context is free and before recording the frame.
+	// One view and projection per view drawn, the extent is a single view's.
+	void update(uint32_t frameIndex, const std::vector<glm::mat4>& views, const std::vector<glm::mat4>& projs, VkExtent2D extent, glm::vec3 sunDirection);
+	// Takes the frame's cluster lists over from the compute queue, record before any draw
+	void recordAcquire(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+
+	VkDescriptorSet* getDescriptorSet(uint32_t frameIndex) { return &m_descriptorSets[frameIndex]; }
+
+	void cleanup();
+
+private:
+	// Matches ClusterView in lightCluster.comp and fragBase.frag, 128 bytes so it's also the std140 array stride
+	struct sClusterParams
+	{
+		glm::mat4 inverseProj;
+		glm::uvec4 gridSize; // Clusters along x, y and depth, w is the light count
+		glm::vec4 sunDirection; // View space, towards the sun. w is its intensity.
+		glm::vec2 tileSize; // Pixels covered by a cluster
+		float sliceScale; // slice = log(depth) * sliceScale - sliceBias
+		float sliceBias;
+		uint32_t maxLightsPerCluster;
+		float ambient;
+		uint32_t lightOffset; // Where the view's lights start in the light buffer
+		uint32_t clusterOffset; // Where the view's cluster lists start in the cluster buffer
+	};
+
+	Utilities* m_pUtilities = nullptr;
+	VkDevice* m_pLogicalDevice = nullptr;
+	BufferManager* m_pBufferManager = nullptr;
+	AsyncCompute* m_pAsyncCompute = nullptr;
+	sSettings::sGraphicsSettings* m_pGraphicsSettings = nullptr;
+	int m_MAX_FRAMES_IN_FLIGHT = 1;
+	uint32_t m_viewCount = 1; // Views binned every frame, the light and cluster buffers have room for each
+
+	std::vector<sLight> m_lights = {};
+
+	// Parameters and lights are written by the CPU and read on both queues. The cluster lists are written by the compute
+	// queue and handed over to the graphics queue every frame. One of each per frame in flight.
+	std::vector<VkBuffer> m_paramsBuffers = {};
+	std::vector<VkDeviceMemory> m_paramsBuffersMemory = {};
+	std::vector<void*> m_paramsBuffersMapped = {};
+	std::vector<VkBuffer> m_lightBuffers = {};
+	std::vector<VkDeviceMemory> m_lightBuffersMemory = {};
+	std::vector<void*> m_lightBuffersMapped = {};
+	std::vector<VkBuffer> m_clusterBuffers = {};
+	std::vector<VkDeviceMemory> m_clusterBuffersMemory = {};
+	std::vector<bool> m_binned = {}; // Whether the frame's cluster lists were written this time round, and need acquiring
+
+	VkDescriptorSetLayout m_setLayout = VK_NULL_HANDLE; // Owned by the graphics pipeline
+	VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline m_binningPipeline = VK_NULL_HANDLE;
+
+	VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+	std::vector<VkDescriptorSet> m_descriptorSets = {}; // One per frame in flight
+
+
+	void createBuffers();
+	void createPipeline();
+	void createDescriptorSets();
+};
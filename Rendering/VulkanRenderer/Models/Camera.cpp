@@ -40,4 +40,14 @@ void Camera::move(glm::vec3 dirInput, glm::vec3 angInput) {
 	// Clamp camera x rotation
 	if (m_pitch > 80.0f) m_pitch = 80.0f;
 	if (m_pitch < -80.0f) m_pitch = -80.0f;
+}
+
+glm::mat4 Camera::getViewMatrix() {
+	return glm::lookAt(m_cameraPosition, m_cameraPosition + m_cameraFront, m_cameraUp);
+}
+
+glm::mat4 Camera::getProjectionMatrix(float aspectRatio, float nearClip, float farClip) {
+	glm::mat4 proj = glm::perspective(glm::radians(m_fieldOfView), aspectRatio, nearClip, farClip);
+	proj[1][1] *= -1; // Flip the y axis to account for Vulkan's inverted y axis
+	return proj;
 }
\ No newline at end of file
@@ -10,6 +10,10 @@ public:
 
 	void move(glm::vec3 dirInput, glm::vec3 angInput);
 
+	glm::mat4 getViewMatrix();
+	// Projection with the y axis flipped for Vulkan's clip space.
+	glm::mat4 getProjectionMatrix(float aspectRatio, float nearClip, float farClip);
+
 private:
 	Utilities* m_pUtilities = nullptr;
 	friend class VulkanEngine;
@@ -25,4 +29,5 @@ private:
 
 	float m_cameraSpeed;
 	float m_cameraSensitivity;
+	float m_fieldOfView = 70.0f;
 };
\ No newline at end of file
@@ -8,11 +8,16 @@
 #include "Model.h"
 
 BufferManager* Model::m_pBufferManager = nullptr;
+std::map<std::string, uint32_t> Model::sm_materialIds = {};
+std::map<std::string, uint32_t> Model::sm_meshIds = {};
 
 void Model::createModel() {
 	mDebugPrint("Loading OBJ model from path: " + m_modelPath);
 	m_pTextureImage = new Image(m_texturePath);
 
+	m_materialId = sm_materialIds.try_emplace(m_texturePath, static_cast<uint32_t>(sm_materialIds.size())).first->second;
+	m_meshId = sm_meshIds.try_emplace(m_modelPath, static_cast<uint32_t>(sm_meshIds.size())).first->second;
+
 	tinyobj::attrib_t attrib;
 	std::vector<tinyobj::shape_t> shapes;
 	std::vector<tinyobj::material_t> materials;
@@ -53,37 +58,107 @@ void Model::createModel() {
 		}
 	}
 
+	computeBoundingVolumes();
+	loadOccluderMesh();
+
 	m_pVertexBuffer = new VertexBuffer(m_pBufferManager, m_vertices);
 	m_pBufferManager->getVertexBuffers()->push_back(m_pVertexBuffer);
 	m_pIndexBuffer = new IndexBuffer(m_pBufferManager, m_indices);
 	m_pBufferManager->getIndexBuffers()->push_back(m_pIndexBuffer);
-	m_pUniformBufferObject = new UniformBufferObject(m_pBufferManager);
-	m_pBufferManager->getUniformBufferObjects()->push_back(m_pUniformBufferObject);
+	m_uniformSlot = m_pBufferManager->getFrameContexts()->allocateUniformSlot();
+}
+
+void Model::createDescriptorSets() {
+	m_pDescriptorSets = new DescriptorSets(m_pBufferManager); // Creates its pool
+	m_pDescriptorSets->createDescriptorSets(m_pTextureImage->getVkTextureImageView(), m_pTextureImage->getVkTextureSampler(), m_uniformSlot);
+}
+
+void Model::computeBoundingVolumes() {
+	if (m_vertices.empty()) return;
+
+	m_aabbMin = m_vertices[0].pos;
+	m_aabbMax = m_vertices[0].pos;
+	for (const Vertex& vertex : m_vertices) {
+		m_aabbMin = glm::min(m_aabbMin, vertex.pos);
+		m_aabbMax = glm::max(m_aabbMax, vertex.pos);
+	}
 
-	m_pDescriptorSets = new DescriptorSets(m_pBufferManager);
-	m_pDescriptorSets->createDescriptorPool();
-	m_pDescriptorSets->createDescriptorSets(m_pTextureImage->getVkTextureImageView(), m_pTextureImage->getVkTextureSampler(), m_pUniformBufferObject);
+	// Centre the sphere on the AABB, then fit the radius to the furthest vertex (tighter than the half diagonal)
+	m_boundingSphereCenter = (m_aabbMin + m_aabbMax) * 0.5f;
+	float maxDistanceSquared = 0.0f;
+	for (const Vertex& vertex : m_vertices) {
+		glm::vec3 offset = vertex.pos - m_boundingSphereCenter;
+		maxDistanceSquared = glm::max(maxDistanceSquared, glm::dot(offset, offset));
+	}
+	m_boundingSphereRadius = glm::sqrt(maxDistanceSquared);
+}
+
+void Model::loadOccluderMesh() {
+	// A hand made "<model>_occluder.obj" next to the model takes priority
+	std::filesystem::path occluderPath(m_modelPath);
+	occluderPath.replace_filename(occluderPath.stem().string() + "_occluder.obj");
+
+	if (std::filesystem::exists(occluderPath)) {
+		mDebugPrint("Loading occluder mesh from path: " + occluderPath.string());
+
+		tinyobj::attrib_t attrib;
+		std::vector<tinyobj::shape_t> shapes;
+		std::vector<tinyobj::material_t> materials;
+		std::string warn, err;
+
+		if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, occluderPath.string().c_str())) {
+			throw std::runtime_error(warn + err);
+		}
+
+		for (size_t i = 0; i + 2 < attrib.vertices.size(); i += 3) {
+			m_occluderVertices.push_back({ attrib.vertices[i], attrib.vertices[i + 1], attrib.vertices[i + 2] });
+		}
+		for (const auto& shape : shapes) {
+			for (const auto& index : shape.mesh.indices) m_occluderIndices.push_back(static_cast<uint32_t>(index.vertex_index));
+		}
+		return;
+	}
+
+	// Small meshes are cheap enough to rasterise as they are
+	if (m_indices.size() / 3 > sm_maxRenderMeshOccluderTriangles) return;
+
+	m_occluderVertices.reserve(m_vertices.size());
+	for (const Vertex& vertex : m_vertices) m_occluderVertices.push_back(vertex.pos);
+	m_occluderIndices = m_indices;
+}
+
+void Model::getWorldBoundingSphere(glm::vec3& center, float& radius) {
+	center = glm::vec3(getTransform() * glm::vec4(m_boundingSphereCenter, 1.0f));
+
+	glm::vec3 absScale = glm::abs(m_scale);
+	radius = m_boundingSphereRadius * glm::max(absScale.x, glm::max(absScale.y, absScale.z));
+}
+
+// The far shadow cascades are only redrawn when the camera or sun moves, so a moved caster has to redraw them itself
+void Model::invalidateShadows() {
+	CascadedShadows* pCascadedShadows = VulkanEngine::getInstance()->getCascadedShadows();
+	if (pCascadedShadows != nullptr) pCascadedShadows->invalidateCache();
 }
 
 void Model::changePosition(glm::vec3 newPos) {
 	m_position = newPos;
+	invalidateShadows();
 }
 
 void Model::changeRotation(glm::vec3 newRot) {
 	m_rotation = newRot;
+	invalidateShadows();
 }
 
 void Model::changeScale(glm::vec3 newScale) {
 	m_scale = newScale;
+	invalidateShadows();
 }
 
 void Model::cleanup() {
 	m_pDescriptorSets->cleanup();
 	delete m_pDescriptorSets;
 
-	m_pUniformBufferObject->cleanup();
-	delete m_pUniformBufferObject;
-
 	m_pTextureImage->cleanup();
 	delete m_pTextureImage;
 
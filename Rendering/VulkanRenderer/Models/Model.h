@@ -16,6 +16,8 @@ public:
 	};
 
 	void createModel();
+	// Separate from loading, the sets need the graphics pipeline's descriptor set layout and the models are loaded before it
+	void createDescriptorSets();
 
 	glm::mat4 getTransform() { 
 		glm::mat4 transform = glm::mat4(1.0f);
@@ -29,18 +31,32 @@ public:
 	void changePosition(glm::vec3 newPos);
 	void changeRotation(glm::vec3 newRot);
 	void changeScale(glm::vec3 newScale);
+	// Multiplies the texture's alpha. Below 1 the model is drawn as transparent.
+	void setOpacity(float opacity) { m_opacity = opacity; }
+	bool isTransparent() { return m_opacity < 1.0f; }
+	void invalidateShadows();
 	void cleanup();
 
+	// Bounding sphere transformed into world space, radius scaled by the largest scale axis.
+	void getWorldBoundingSphere(glm::vec3& center, float& radius);
+
 private:
 	Utilities* m_pUtilities = nullptr;
 	static BufferManager* m_pBufferManager;
 	friend class VulkanEngine;
 	friend class CommandBuffer;
 	friend class Window;
+	friend class HiZCuller;
+	friend class SoftwareOcclusionCuller;
+	friend class CascadedShadows;
+	friend class VisibilityBuffer;
+
+	static constexpr size_t sm_maxRenderMeshOccluderTriangles = 2048; // Bigger meshes need an _occluder.obj to occlude in software
 
 	glm::vec3 m_position;
 	glm::vec3 m_rotation;
 	glm::vec3 m_scale;
+	float m_opacity = 1.0f;
 
 	std::vector<Vertex> m_vertices;
 	std::vector<uint32_t> m_indices;
@@ -49,6 +65,25 @@ private:
 	Image* m_pTextureImage = nullptr;
 	VertexBuffer* m_pVertexBuffer = nullptr;
 	IndexBuffer* m_pIndexBuffer = nullptr;
-	UniformBufferObject* m_pUniformBufferObject = nullptr;
+	uint32_t m_uniformSlot = 0; // Where the model's uniforms go in each frame context's uniform buffer
 	DescriptorSets* m_pDescriptorSets = nullptr;
+
+	// Draw sort key fields, models sharing a texture or mesh file get the same id
+	uint32_t m_materialId = 0;
+	uint32_t m_meshId = 0;
+	static std::map<std::string, uint32_t> sm_materialIds;
+	static std::map<std::string, uint32_t> sm_meshIds;
+
+	// Model space bounding volumes, computed when the model is loaded
+	glm::vec3 m_aabbMin = glm::vec3(0.0f);
+	glm::vec3 m_aabbMax = glm::vec3(0.0f);
+	glm::vec3 m_boundingSphereCenter = glm::vec3(0.0f);
+	float m_boundingSphereRadius = 0.0f;
+
+	// Simplified mesh for software occlusion culling, must stay inside the render mesh. Empty if the model doesn't occlude.
+	std::vector<glm::vec3> m_occluderVertices;
+	std::vector<uint32_t> m_occluderIndices;
+
+	void computeBoundingVolumes();
+	void loadOccluderMesh();
 };
\ No newline at end of file
@@ -0,0 +1,38 @@
+#include "../VulkanRenderer.h"
+#include "../Graphics/Swapchain.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "DynamicResolution.h"
+
+
+
+DynamicResolution::DynamicResolution(uint32_t frameCount) : m_pUtilities(Utilities::getInstance()),
+	m_pGraphicsSettings(&VulkanEngine::getInstance()->m_settings->graphicsSettings), m_pSwapchain(VulkanEngine::getInstance()->m_pSwapchain)
+{
+	m_scale = m_pGraphicsSettings->maxResolutionScale;
+	m_frameScales.resize(frameCount, m_scale);
+	m_pSwapchain->setRenderScale(m_scale);
+
+	mDebugPrint(std::format("Dynamic resolution targeting {:.2f} ms, between {:.0f}% and {:.0f}% scale.",
+		m_pGraphicsSettings->dynamicResolutionTarget, m_pGraphicsSettings->minResolutionScale * 100.0f, m_pGraphicsSettings->maxResolutionScale * 100.0f));
+}
+
+
+void DynamicResolution::update(uint32_t frameIndex, double gpuMilliseconds)
+{
+	float target = m_pGraphicsSettings->dynamicResolutionTarget;
+	float ratio = static_cast<float>(gpuMilliseconds) / target;
+
+	if (gpuMilliseconds > 0.0 && std::abs(ratio - 1.0f) > sm_tolerance) {
+		// Most of the frame's cost follows the pixel count, which goes with the square of the scale. Shadows and culling
+		// don't, so the estimate overshoots a little and the damping takes the rest over the next frames.
+		float estimate = m_frameScales[frameIndex] / std::sqrt(ratio);
+		m_scale += (estimate - m_scale) * sm_damping;
+		m_scale = std::clamp(m_scale, m_pGraphicsSettings->minResolutionScale, m_pGraphicsSettings->maxResolutionScale);
+	}
+
+	m_frameScales[frameIndex] = m_scale;
+	m_pSwapchain->setRenderScale(m_scale);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <vector>
+#include <cstdint>
+
+#include "../Utilities/Utilities.h"
+
+
+class Swapchain;
+
+// Scales the resolution the frame is drawn at to hold the GPU frame time at a target, fed by GpuTimer's timestamps.
+// The attachments keep the swapchain's size and only their top left part is drawn to, so changing the scale never
+// reallocates anything. The post-processing chain runs at the scaled size and its copy to the swapchain does the upscale.
+class DynamicResolution
+{
+public:
+	DynamicResolution(uint32_t frameCount);
+
+	// Call with the timings GpuTimer collected for the frame context, or 0 if there were none, before this frame is recorded
+	// with it. Sets the swapchain's render scale for the frame.
+	void update(uint32_t frameIndex, double gpuMilliseconds);
+
+	float getScale() { return m_scale; }
+
+private:
+	static constexpr float sm_damping = 0.2f; // Fraction of the way to the estimated scale moved per frame, timings are noisy
+	static constexpr float sm_tolerance = 0.05f; // How far either side of the target the frame time can be before the scale changes
+
+	Utilities* m_pUtilities = nullptr;
+	sSettings::sGraphicsSettings* m_pGraphicsSettings = nullptr;
+	Swapchain* m_pSwapchain = nullptr;
+
+	float m_scale = 1.0f;
+	// The scale each frame context was last recorded at. Timings arrive frames in flight later, by which point the scale
+	// may have moved on, so they're compared with the scale that produced them.
+	std::vector<float> m_frameScales = {};
+};
@@ -0,0 +1,270 @@
+#include "../VulkanRenderer.h"
+#include "../Graphics/Buffers.h"
+#include "../Graphics/GraphicsPipeline.h"
+#include "../Graphics/Image.h"
+
+#include "PostProcessChain.h"
+
+
+
+PostProcessChain::PostProcessChain() : m_pLogicalDevice(VulkanEngine::getInstance()->m_pLogicalDevice->getVkDevice()),
+	m_pBufferManager(VulkanEngine::getInstance()->m_pBufferManager), m_pUtilities(Utilities::getInstance())
+{
+	createPipelineLayout();
+	createSceneColor();
+	createDescriptorSet();
+}
+
+
+void PostProcessChain::createSceneColor()
+{
+	m_extent = *m_pBufferManager->m_pSwapchain->getSwapchainExtent();
+
+	mDebugPrint(std::format("Creating scene colour image ({}x{})...", m_extent.width, m_extent.height));
+
+	// Drawn to by the passes (or resolved into with MSAA), processed in place by the chain and copied to the swapchain.
+	// Temporal AA reads it and copies its resolve back into it. Multiview copies the views into it instead of drawing to it.
+	sSettings::sGraphicsSettings& graphicsSettings = VulkanEngine::getInstance()->m_settings->graphicsSettings;
+	VkImageUsageFlags usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	if (graphicsSettings.temporalAA) usage |= VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	if (graphicsSettings.multiview != eMultiview::NONE) usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+
+	Image::createImage(m_extent.width, m_extent.height, sm_sceneColorFormat, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_TILING_OPTIMAL,
+		usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_sceneColorImage, m_sceneColorImageMemory);
+	m_sceneColorImageView = Image::createImageView(m_sceneColorImage, sm_sceneColorFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+}
+
+void PostProcessChain::createPipelineLayout()
+{
+	mDebugPrint("Creating post-processing pipeline layout...");
+
+	VkDescriptorSetLayoutBinding sceneColorBinding{
+		.binding = 0,
+		.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+		.descriptorCount = 1,
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+		.pImmutableSamplers = nullptr
+	};
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.bindingCount = 1,
+		.pBindings = &sceneColorBinding
+	};
+
+	if (vkCreateDescriptorSetLayout(*m_pLogicalDevice, &layoutInfo, nullptr, &m_setLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create post-processing descriptor set layout!");
+	}
+
+	VkPushConstantRange pushConstantRange{
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+		.offset = 0,
+		.size = sizeof(sPushConstants)
+	};
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.setLayoutCount = 1,
+		.pSetLayouts = &m_setLayout,
+		.pushConstantRangeCount = 1,
+		.pPushConstantRanges = &pushConstantRange
+	};
+
+	if (vkCreatePipelineLayout(*m_pLogicalDevice, &pipelineLayoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create post-processing pipeline layout!");
+	}
+
+	// Every fused run is the same shader with different specialisation constants
+	m_shaderModule = GraphicsPipeline::loadShaderModule(*m_pLogicalDevice, "postProcess.comp");
+}
+
+void PostProcessChain::createDescriptorSet()
+{
+	VkDescriptorPoolSize poolSize{
+		.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+		.descriptorCount = 1
+	};
+
+	VkDescriptorPoolCreateInfo poolInfo{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.maxSets = 1,
+		.poolSizeCount = 1,
+		.pPoolSizes = &poolSize
+	};
+
+	if (vkCreateDescriptorPool(*m_pLogicalDevice, &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create post-processing descriptor pool!");
+	}
+
+	VkDescriptorSetAllocateInfo allocInfo{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.descriptorPool = m_descriptorPool,
+		.descriptorSetCount = 1,
+		.pSetLayouts = &m_setLayout
+	};
+
+	if (vkAllocateDescriptorSets(*m_pLogicalDevice, &allocInfo, &m_descriptorSet) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate post-processing descriptor set!");
+	}
+
+	VkDescriptorImageInfo imageInfo{
+		.sampler = VK_NULL_HANDLE,
+		.imageView = m_sceneColorImageView,
+		.imageLayout = VK_IMAGE_LAYOUT_GENERAL
+	};
+
+	VkWriteDescriptorSet descriptorWrite{
+		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+		.dstSet = m_descriptorSet,
+		.dstBinding = 0,
+		.descriptorCount = 1,
+		.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+		.pImageInfo = &imageInfo
+	};
+
+	vkUpdateDescriptorSets(*m_pLogicalDevice, 1, &descriptorWrite, 0, nullptr);
+}
+
+VkPipeline PostProcessChain::getPipeline(const std::vector<eEffect>& effects)
+{
+	auto it = m_pipelines.find(effects);
+	if (it != m_pipelines.end()) return it->second;
+
+	mDebugPrint(std::format("Creating fused post-processing pipeline for {} effects...", effects.size()));
+
+	// constant_id 0 is the node count, 1 onwards the effect of each node. Unused slots keep their default.
+	std::array<uint32_t, sm_maxFusedNodes + 1> constants = {};
+	std::array<VkSpecializationMapEntry, sm_maxFusedNodes + 1> mapEntries = {};
+	constants[0] = static_cast<uint32_t>(effects.size());
+	for (uint32_t i = 0; i < constants.size(); i++) {
+		if (i > 0 && i <= effects.size()) constants[i] = static_cast<uint32_t>(effects[i - 1]);
+		mapEntries[i] = VkSpecializationMapEntry{
+			.constantID = i,
+			.offset = i * static_cast<uint32_t>(sizeof(uint32_t)),
+			.size = sizeof(uint32_t)
+		};
+	}
+
+	VkSpecializationInfo specializationInfo{
+		.mapEntryCount = static_cast<uint32_t>(mapEntries.size()),
+		.pMapEntries = mapEntries.data(),
+		.dataSize = sizeof(constants),
+		.pData = constants.data()
+	};
+
+	VkComputePipelineCreateInfo pipelineInfo{
+		.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+		.stage {
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			.stage = VK_SHADER_STAGE_COMPUTE_BIT,
+			.module = m_shaderModule,
+			.pName = "main",
+			.pSpecializationInfo = &specializationInfo
+		},
+		.layout = m_pipelineLayout
+	};
+
+	VkPipeline pipeline;
+	if (vkCreateComputePipelines(*m_pLogicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create post-processing pipeline!");
+	}
+
+	m_pipelines[effects] = pipeline;
+	return pipeline;
+}
+
+
+
+uint32_t PostProcessChain::addNode(eEffect effect, glm::vec4 params)
+{
+	m_nodes.push_back(sNode{ .effect = effect, .params = params });
+	return static_cast<uint32_t>(m_nodes.size() - 1);
+}
+
+void PostProcessChain::prepare(VkExtent2D renderExtent)
+{
+	m_stages.clear();
+	m_renderExtent = renderExtent;
+
+	sPushConstants pushConstants{
+		.renderExtent = glm::uvec2(m_renderExtent.width, m_renderExtent.height),
+		.inverseResolution = glm::vec2(1.0f / m_renderExtent.width, 1.0f / m_renderExtent.height),
+		.time = static_cast<float>(glfwGetTime())
+	};
+
+	// Every effect only reads the pixel it writes, so any run of them can share a dispatch. A run only ends when the
+	// push constants can't take another node's parameters.
+	std::vector<eEffect> effects;
+	auto flushStage = [&]() {
+		if (effects.empty()) return;
+		m_stages.push_back(sStage{ .pipeline = getPipeline(effects), .pushConstants = pushConstants });
+		effects.clear();
+	};
+
+	for (const sNode& node : m_nodes) {
+		if (!node.enabled) continue;
+
+		pushConstants.params[effects.size()] = node.params;
+		effects.push_back(node.effect);
+		if (effects.size() == sm_maxFusedNodes) flushStage();
+	}
+	flushStage();
+}
+
+void PostProcessChain::recordStage(VkCommandBuffer commandBuffer, size_t stage)
+{
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_stages[stage].pipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &m_descriptorSet, 0, nullptr);
+	vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(sPushConstants), &m_stages[stage].pushConstants);
+	vkCmdDispatch(commandBuffer, (m_renderExtent.width + 7) / 8, (m_renderExtent.height + 7) / 8, 1);
+}
+
+void PostProcessChain::recordCopyToSwapchain(VkCommandBuffer commandBuffer, VkImage swapchainImage)
+{
+	// The blit converts to the swapchain's format, sRGB encoding included. At full resolution it's a straight copy, below it
+	// the same blit stretches the drawn part over the swapchain, which is the cheapest upscale there is.
+	VkImageBlit region{
+		.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+		.srcOffsets = { { 0, 0, 0 }, { static_cast<int32_t>(m_renderExtent.width), static_cast<int32_t>(m_renderExtent.height), 1 } },
+		.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+		.dstOffsets = { { 0, 0, 0 }, { static_cast<int32_t>(m_extent.width), static_cast<int32_t>(m_extent.height), 1 } }
+	};
+
+	bool upscale = m_renderExtent.width != m_extent.width || m_renderExtent.height != m_extent.height;
+	vkCmdBlitImage(commandBuffer, m_sceneColorImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, swapchainImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region,
+		upscale ? VK_FILTER_LINEAR : VK_FILTER_NEAREST);
+}
+
+
+
+void PostProcessChain::recreateSceneColor()
+{
+	m_pBufferManager->getRenderGraph()->forgetImportedState(m_sceneColorImage);
+
+	VulkanEngine::getInstance()->m_pDeletionQueue->push([device = *m_pLogicalDevice, descriptorPool = m_descriptorPool,
+		imageView = m_sceneColorImageView, image = m_sceneColorImage, memory = m_sceneColorImageMemory]() {
+		vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+		vkDestroyImageView(device, imageView, nullptr);
+		vkDestroyImage(device, image, nullptr);
+		vkFreeMemory(device, memory, nullptr);
+	});
+
+	createSceneColor();
+	createDescriptorSet();
+}
+
+void PostProcessChain::cleanup()
+{
+	for (auto& [effects, pipeline] : m_pipelines) {
+		vkDestroyPipeline(*m_pLogicalDevice, pipeline, nullptr);
+	}
+	vkDestroyShaderModule(*m_pLogicalDevice, m_shaderModule, nullptr);
+	vkDestroyPipelineLayout(*m_pLogicalDevice, m_pipelineLayout, nullptr);
+
+	vkDestroyDescriptorPool(*m_pLogicalDevice, m_descriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(*m_pLogicalDevice, m_setLayout, nullptr);
+
+	vkDestroyImageView(*m_pLogicalDevice, m_sceneColorImageView, nullptr);
+	vkDestroyImage(*m_pLogicalDevice, m_sceneColorImage, nullptr);
+	vkFreeMemory(*m_pLogicalDevice, m_sceneColorImageMemory, nullptr);
+}
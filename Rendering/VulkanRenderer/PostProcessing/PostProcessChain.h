@@ -0,0 +1,111 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <array>
+#include <map>
+#include <cstdint>
+
+#include "../Utilities/Utilities.h"
+
+
+class BufferManager;
+
+// Post-processing over the frame. The passes draw into an HDR scene colour image instead of the swapchain, the chain's
+// effects are declared as nodes and run over it in order, then it's copied into the swapchain image.
+// Runs of consecutive per-pixel nodes are fused into a single compute dispatch that reads and writes each pixel once, so
+// the whole chain costs one read and one write of the frame rather than one per effect. Every built-in effect is per-pixel,
+// so a chain only splits into more dispatches once it's longer than what one dispatch can take.
+class PostProcessChain
+{
+public:
+	// Matches the effect constants in postProcess.comp
+	enum class eEffect : uint32_t
+	{
+		TONEMAP, // x: exposure
+		COLOR_GRADING, // x: contrast, y: saturation, z: brightness
+		VIGNETTE, // x: strength, y: radius the darkening starts at, z: softness
+		FILM_GRAIN // x: amount
+	};
+
+	struct sNode
+	{
+		eEffect effect;
+		glm::vec4 params;
+		bool enabled = true;
+	};
+
+	static constexpr VkFormat sm_sceneColorFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
+	static constexpr uint32_t sm_maxFusedNodes = 6; // Matches MAX_FUSED_NODES in postProcess.comp, bounded by the push constant size
+
+	PostProcessChain();
+
+	// Returns the node's index. Nodes run in the order they were added and can be changed through getNodes between frames.
+	uint32_t addNode(eEffect effect, glm::vec4 params);
+	std::vector<sNode>& getNodes() { return m_nodes; }
+
+	// Fuses the enabled nodes into this frame's dispatches, call before adding the chain's passes to the render graph.
+	// renderExtent is the part of the scene colour image holding the frame, see Swapchain::getRenderExtent.
+	void prepare(VkExtent2D renderExtent);
+	size_t getStageCount() { return m_stages.size(); }
+	// The render graph has the scene colour image in the general layout for compute
+	void recordStage(VkCommandBuffer commandBuffer, size_t stage);
+	// The render graph has the scene colour image as a transfer source and the swapchain image as a transfer destination.
+	// Upscales with a bilinear blit while dynamic resolution draws below the swapchain's size.
+	void recordCopyToSwapchain(VkCommandBuffer commandBuffer, VkImage swapchainImage);
+
+	VkImage* getSceneColorImage() { return &m_sceneColorImage; }
+	VkImageView* getSceneColorImageView() { return &m_sceneColorImageView; }
+	// Follows the swapchain's size, the old image goes through the deletion queue
+	void recreateSceneColor();
+
+	void cleanup();
+
+private:
+	// Matches PushConstants in postProcess.comp
+	struct sPushConstants
+	{
+		glm::vec4 params[sm_maxFusedNodes];
+		glm::uvec2 renderExtent;
+		glm::vec2 inverseResolution;
+		float time;
+	};
+
+	// A run of nodes fused into one dispatch
+	struct sStage
+	{
+		VkPipeline pipeline;
+		sPushConstants pushConstants;
+	};
+
+	Utilities* m_pUtilities = nullptr;
+	VkDevice* m_pLogicalDevice = nullptr;
+	BufferManager* m_pBufferManager = nullptr;
+
+	std::vector<sNode> m_nodes = {};
+
+	VkImage m_sceneColorImage = VK_NULL_HANDLE;
+	VkDeviceMemory m_sceneColorImageMemory = VK_NULL_HANDLE;
+	VkImageView m_sceneColorImageView = VK_NULL_HANDLE;
+	VkExtent2D m_extent = {};
+	VkExtent2D m_renderExtent = {}; // Part of the image holding this frame
+
+	VkDescriptorSetLayout m_setLayout = VK_NULL_HANDLE;
+	VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+	VkDescriptorSet m_descriptorSet = VK_NULL_HANDLE;
+	VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
+	VkShaderModule m_shaderModule = VK_NULL_HANDLE;
+	// One pipeline per fused run of effects, keyed by the effects in order. Chains only change between frames, so this stays small.
+	std::map<std::vector<eEffect>, VkPipeline> m_pipelines = {};
+
+	std::vector<sStage> m_stages = {}; // This frame's dispatches
+
+
+	void createSceneColor();
+	void createDescriptorSet();
+	void createPipelineLayout();
+	VkPipeline getPipeline(const std::vector<eEffect>& effects);
+};
@@ -0,0 +1,411 @@
+#include "../VulkanRenderer.h"
+#include "../Graphics/Buffers.h"
+#include "../Graphics/GraphicsPipeline.h"
+#include "../Graphics/Image.h"
+#include "PostProcessChain.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <cmath>
+
+#include "TemporalAA.h"
+
+
+
+TemporalAA::TemporalAA(uint32_t frameCount) : m_pLogicalDevice(VulkanEngine::getInstance()->m_pLogicalDevice->getVkDevice()),
+	m_pBufferManager(VulkanEngine::getInstance()->m_pBufferManager), m_pSwapchain(VulkanEngine::getInstance()->m_pSwapchain), m_pUtilities(Utilities::getInstance())
+{
+	createPipelines();
+	createTargets();
+	createDescriptorSets(frameCount);
+}
+
+
+void TemporalAA::createPipelines()
+{
+	mDebugPrint("Creating temporal anti-aliasing pipelines...");
+
+	VkSamplerCreateInfo samplerInfo{
+		.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+		.magFilter = VK_FILTER_LINEAR,
+		.minFilter = VK_FILTER_LINEAR,
+		.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+		.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+		.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+		.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+		.mipLodBias = 0.0f,
+		.anisotropyEnable = VK_FALSE,
+		.maxAnisotropy = 1.0f,
+		.compareEnable = VK_FALSE,
+		.compareOp = VK_COMPARE_OP_ALWAYS,
+		.minLod = 0.0f,
+		.maxLod = 0.0f,
+		.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK,
+		.unnormalizedCoordinates = VK_FALSE
+	};
+
+	// Bilinear for the history's bicubic taps, everything else is read with texelFetch
+	if (vkCreateSampler(*m_pLogicalDevice, &samplerInfo, nullptr, &m_sampler) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create temporal anti-aliasing sampler!");
+	}
+
+	// Motion vectors: depth buffer -> motion vectors
+	std::array<VkDescriptorSetLayoutBinding, 2> motionBindings{
+		VkDescriptorSetLayoutBinding{
+			.binding = 0,
+			.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+		},
+		VkDescriptorSetLayoutBinding{
+			.binding = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+		}
+	};
+
+	// Resolve: scene colour, motion vectors, last history -> this history
+	std::array<VkDescriptorSetLayoutBinding, 4> resolveBindings{};
+	for (uint32_t i = 0; i < resolveBindings.size(); i++) {
+		resolveBindings[i] = VkDescriptorSetLayoutBinding{
+			.binding = i,
+			.descriptorType = i < 3 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+		};
+	}
+
+	VkDescriptorSetLayoutCreateInfo motionLayoutInfo{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.bindingCount = static_cast<uint32_t>(motionBindings.size()),
+		.pBindings = motionBindings.data()
+	};
+
+	VkDescriptorSetLayoutCreateInfo resolveLayoutInfo{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.bindingCount = static_cast<uint32_t>(resolveBindings.size()),
+		.pBindings = resolveBindings.data()
+	};
+
+	if (vkCreateDescriptorSetLayout(*m_pLogicalDevice, &motionLayoutInfo, nullptr, &m_motionSetLayout) != VK_SUCCESS ||
+		vkCreateDescriptorSetLayout(*m_pLogicalDevice, &resolveLayoutInfo, nullptr, &m_resolveSetLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create temporal anti-aliasing descriptor set layouts!");
+	}
+
+
+	VkPushConstantRange motionPushConstants{
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+		.offset = 0,
+		.size = sizeof(sMotionPushConstants)
+	};
+
+	VkPushConstantRange resolvePushConstants{
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+		.offset = 0,
+		.size = sizeof(sResolvePushConstants)
+	};
+
+	VkPipelineLayoutCreateInfo motionPipelineLayoutInfo{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.setLayoutCount = 1,
+		.pSetLayouts = &m_motionSetLayout,
+		.pushConstantRangeCount = 1,
+		.pPushConstantRanges = &motionPushConstants
+	};
+
+	VkPipelineLayoutCreateInfo resolvePipelineLayoutInfo{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.setLayoutCount = 1,
+		.pSetLayouts = &m_resolveSetLayout,
+		.pushConstantRangeCount = 1,
+		.pPushConstantRanges = &resolvePushConstants
+	};
+
+	if (vkCreatePipelineLayout(*m_pLogicalDevice, &motionPipelineLayoutInfo, nullptr, &m_motionPipelineLayout) != VK_SUCCESS ||
+		vkCreatePipelineLayout(*m_pLogicalDevice, &resolvePipelineLayoutInfo, nullptr, &m_resolvePipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create temporal anti-aliasing pipeline layouts!");
+	}
+
+
+	VkShaderModule motionShaderModule = GraphicsPipeline::loadShaderModule(*m_pLogicalDevice, "motionVectors.comp");
+	VkShaderModule resolveShaderModule = GraphicsPipeline::loadShaderModule(*m_pLogicalDevice, "temporalResolve.comp");
+
+	std::array<VkComputePipelineCreateInfo, 2> pipelineInfos{
+		VkComputePipelineCreateInfo{
+			.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+			.stage {
+				.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+				.stage = VK_SHADER_STAGE_COMPUTE_BIT,
+				.module = motionShaderModule,
+				.pName = "main"
+			},
+			.layout = m_motionPipelineLayout
+		},
+		VkComputePipelineCreateInfo{
+			.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+			.stage {
+				.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+				.stage = VK_SHADER_STAGE_COMPUTE_BIT,
+				.module = resolveShaderModule,
+				.pName = "main"
+			},
+			.layout = m_resolvePipelineLayout
+		}
+	};
+
+	std::array<VkPipeline, 2> pipelines{};
+	if (vkCreateComputePipelines(*m_pLogicalDevice, VK_NULL_HANDLE, static_cast<uint32_t>(pipelineInfos.size()), pipelineInfos.data(), nullptr, pipelines.data()) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create temporal anti-aliasing pipelines!");
+	}
+	m_motionPipeline = pipelines[0];
+	m_resolvePipeline = pipelines[1];
+
+	vkDestroyShaderModule(*m_pLogicalDevice, motionShaderModule, nullptr);
+	vkDestroyShaderModule(*m_pLogicalDevice, resolveShaderModule, nullptr);
+}
+
+void TemporalAA::createTargets()
+{
+	m_extent = *m_pSwapchain->getSwapchainExtent();
+
+	mDebugPrint(std::format("Creating temporal anti-aliasing targets ({}x{})...", m_extent.width, m_extent.height));
+
+	// Always at the output resolution, and in the scene colour format since it's copied straight into it
+	for (size_t i = 0; i < m_historyImages.size(); i++) {
+		Image::createImage(m_extent.width, m_extent.height, PostProcessChain::sm_sceneColorFormat, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			m_historyImages[i], m_historyImagesMemory[i]);
+		m_historyImageViews[i] = Image::createImageView(m_historyImages[i], PostProcessChain::sm_sceneColorFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+	}
+
+	m_historyValid = false;
+}
+
+void TemporalAA::createDescriptorSets(uint32_t frameCount)
+{
+	std::array<VkDescriptorPoolSize, 2> poolSizes{
+		VkDescriptorPoolSize{
+			.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.descriptorCount = 4 * frameCount
+		},
+		VkDescriptorPoolSize{
+			.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+			.descriptorCount = 2 * frameCount
+		}
+	};
+
+	VkDescriptorPoolCreateInfo poolInfo{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.maxSets = 2 * frameCount,
+		.poolSizeCount = static_cast<uint32_t>(poolSizes.size()),
+		.pPoolSizes = poolSizes.data()
+	};
+
+	if (vkCreateDescriptorPool(*m_pLogicalDevice, &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create temporal anti-aliasing descriptor pool!");
+	}
+
+	std::vector<VkDescriptorSetLayout> motionLayouts(frameCount, m_motionSetLayout);
+	std::vector<VkDescriptorSetLayout> resolveLayouts(frameCount, m_resolveSetLayout);
+	m_motionSets.resize(frameCount);
+	m_resolveSets.resize(frameCount);
+
+	VkDescriptorSetAllocateInfo motionAllocInfo{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.descriptorPool = m_descriptorPool,
+		.descriptorSetCount = frameCount,
+		.pSetLayouts = motionLayouts.data()
+	};
+
+	VkDescriptorSetAllocateInfo resolveAllocInfo{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.descriptorPool = m_descriptorPool,
+		.descriptorSetCount = frameCount,
+		.pSetLayouts = resolveLayouts.data()
+	};
+
+	if (vkAllocateDescriptorSets(*m_pLogicalDevice, &motionAllocInfo, m_motionSets.data()) != VK_SUCCESS ||
+		vkAllocateDescriptorSets(*m_pLogicalDevice, &resolveAllocInfo, m_resolveSets.data()) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate temporal anti-aliasing descriptor sets!");
+	}
+}
+
+
+
+float TemporalAA::halton(uint32_t index, uint32_t base)
+{
+	float result = 0.0f;
+	float fraction = 1.0f;
+	for (; index > 0; index /= base) {
+		fraction /= base;
+		result += fraction * (index % base);
+	}
+	return result;
+}
+
+glm::mat4 TemporalAA::jitterProjection(const glm::mat4& view, const glm::mat4& proj)
+{
+	VkExtent2D renderExtent = *m_pSwapchain->getRenderExtent();
+
+	// Each render pixel covers more output pixels as the resolution drops, which takes more positions to fill in
+	float scale = static_cast<float>(renderExtent.width) / m_extent.width;
+	uint32_t phaseCount = static_cast<uint32_t>(std::ceil(sm_jitterPhases / (scale * scale)));
+	uint32_t phase = m_frameCount++ % phaseCount + 1;
+
+	// Within one render pixel, the shift is applied after projection so it's the same in every pixel whatever its depth
+	glm::vec2 jitterPixels = glm::vec2(halton(phase, 2), halton(phase, 3)) - 0.5f;
+	glm::vec2 jitterNdc = jitterPixels * 2.0f / glm::vec2(renderExtent.width, renderExtent.height);
+
+	// The previous transforms are only the camera's, models barely move between frames and whatever does is caught by the clamp
+	glm::mat4 viewProj = proj * view;
+	if (!m_historyValid) m_previousViewProj = viewProj;
+
+	m_currentHistory = 1 - m_currentHistory;
+	m_motionConstants = sMotionPushConstants{
+		.reprojection = m_previousViewProj * glm::inverse(viewProj),
+		.jitter = jitterNdc,
+		.renderExtent = glm::uvec2(renderExtent.width, renderExtent.height)
+	};
+	m_resolveConstants = sResolvePushConstants{
+		.jitter = jitterPixels,
+		.renderExtent = glm::uvec2(renderExtent.width, renderExtent.height),
+		.outputExtent = glm::uvec2(m_extent.width, m_extent.height),
+		.historyWeight = m_historyValid ? sm_historyWeight : 0.0f
+	};
+
+	m_previousViewProj = viewProj;
+	m_historyValid = true; // From the next frame on, this frame's resolve is its history
+
+	return glm::translate(glm::mat4(1.0f), glm::vec3(jitterNdc, 0.0f)) * proj;
+}
+
+void TemporalAA::recordMotionVectors(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkImageView motionVectorView)
+{
+	// The frame's last use of its sets has finished by the time it's recorded again
+	VkDescriptorImageInfo depthInfo{
+		.sampler = m_sampler,
+		.imageView = *m_pBufferManager->getDepthBuffer()->getVkImageView(),
+		.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+	};
+
+	VkDescriptorImageInfo motionStorageInfo{
+		.imageView = motionVectorView,
+		.imageLayout = VK_IMAGE_LAYOUT_GENERAL
+	};
+
+	std::array<VkWriteDescriptorSet, 2> motionWrites{
+		VkWriteDescriptorSet{
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = m_motionSets[frameIndex],
+			.dstBinding = 0,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.pImageInfo = &depthInfo
+		},
+		VkWriteDescriptorSet{
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = m_motionSets[frameIndex],
+			.dstBinding = 1,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+			.pImageInfo = &motionStorageInfo
+		}
+	};
+
+	vkUpdateDescriptorSets(*m_pLogicalDevice, static_cast<uint32_t>(motionWrites.size()), motionWrites.data(), 0, nullptr);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_motionPipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_motionPipelineLayout, 0, 1, &m_motionSets[frameIndex], 0, nullptr);
+	vkCmdPushConstants(commandBuffer, m_motionPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(m_motionConstants), &m_motionConstants);
+	vkCmdDispatch(commandBuffer, (m_motionConstants.renderExtent.x + 7) / 8, (m_motionConstants.renderExtent.y + 7) / 8, 1);
+}
+
+void TemporalAA::recordResolve(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkImageView motionVectorView)
+{
+	// Writes this frame's history and reads the other one
+	VkImageView sceneColorImageView = *VulkanEngine::getInstance()->m_pPostProcessChain->getSceneColorImageView();
+	std::array<VkDescriptorImageInfo, 4> imageInfos{
+		VkDescriptorImageInfo{ .sampler = m_sampler, .imageView = sceneColorImageView, .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL },
+		VkDescriptorImageInfo{ .sampler = m_sampler, .imageView = motionVectorView, .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL },
+		VkDescriptorImageInfo{ .sampler = m_sampler, .imageView = m_historyImageViews[1 - m_currentHistory], .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL },
+		VkDescriptorImageInfo{ .imageView = m_historyImageViews[m_currentHistory], .imageLayout = VK_IMAGE_LAYOUT_GENERAL }
+	};
+
+	std::array<VkWriteDescriptorSet, 4> resolveWrites{};
+	for (uint32_t binding = 0; binding < resolveWrites.size(); binding++) {
+		resolveWrites[binding] = VkWriteDescriptorSet{
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = m_resolveSets[frameIndex],
+			.dstBinding = binding,
+			.descriptorCount = 1,
+			.descriptorType = binding < 3 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+			.pImageInfo = &imageInfos[binding]
+		};
+	}
+
+	vkUpdateDescriptorSets(*m_pLogicalDevice, static_cast<uint32_t>(resolveWrites.size()), resolveWrites.data(), 0, nullptr);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_resolvePipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_resolvePipelineLayout, 0, 1, &m_resolveSets[frameIndex], 0, nullptr);
+	vkCmdPushConstants(commandBuffer, m_resolvePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(m_resolveConstants), &m_resolveConstants);
+	vkCmdDispatch(commandBuffer, (m_extent.width + 7) / 8, (m_extent.height + 7) / 8, 1);
+}
+
+void TemporalAA::recordCopyToSceneColor(VkCommandBuffer commandBuffer, VkImage sceneColorImage)
+{
+	// The history has to outlive the post-processing chain, which works in place, so the chain gets a copy
+	VkImageCopy region{
+		.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+		.srcOffset = { 0, 0, 0 },
+		.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+		.dstOffset = { 0, 0, 0 },
+		.extent = { m_extent.width, m_extent.height, 1 }
+	};
+
+	vkCmdCopyImage(commandBuffer, m_historyImages[m_currentHistory], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, sceneColorImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+}
+
+
+
+void TemporalAA::recreateTargets()
+{
+	RenderGraph* pRenderGraph = m_pBufferManager->getRenderGraph();
+	for (VkImage image : m_historyImages) {
+		pRenderGraph->forgetImportedState(image);
+	}
+	retireTargets();
+
+	createTargets();
+}
+
+void TemporalAA::retireTargets()
+{
+	// The descriptor sets are rewritten every frame, so they can stay
+	VulkanEngine::getInstance()->m_pDeletionQueue->push([device = *m_pLogicalDevice,
+		historyViews = m_historyImageViews, historyImages = m_historyImages, historyMemory = m_historyImagesMemory]() {
+		for (size_t i = 0; i < historyImages.size(); i++) {
+			vkDestroyImageView(device, historyViews[i], nullptr);
+			vkDestroyImage(device, historyImages[i], nullptr);
+			vkFreeMemory(device, historyMemory[i], nullptr);
+		}
+	});
+}
+
+void TemporalAA::cleanup()
+{
+	vkDestroyDescriptorPool(*m_pLogicalDevice, m_descriptorPool, nullptr);
+
+	for (size_t i = 0; i < m_historyImages.size(); i++) {
+		vkDestroyImageView(*m_pLogicalDevice, m_historyImageViews[i], nullptr);
+		vkDestroyImage(*m_pLogicalDevice, m_historyImages[i], nullptr);
+		vkFreeMemory(*m_pLogicalDevice, m_historyImagesMemory[i], nullptr);
+	}
+
+	vkDestroySampler(*m_pLogicalDevice, m_sampler, nullptr);
+	vkDestroyPipeline(*m_pLogicalDevice, m_motionPipeline, nullptr);
+	vkDestroyPipeline(*m_pLogicalDevice, m_resolvePipeline, nullptr);
+	vkDestroyPipelineLayout(*m_pLogicalDevice, m_motionPipelineLayout, nullptr);
+	vkDestroyPipelineLayout(*m_pLogicalDevice, m_resolvePipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(*m_pLogicalDevice, m_motionSetLayout, nullptr);
+	vkDestroyDescriptorSetLayout(*m_pLogicalDevice, m_resolveSetLayout, nullptr);
+}
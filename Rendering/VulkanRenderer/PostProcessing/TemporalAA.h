@@ -0,0 +1,110 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+
+#include <array>
+#include <vector>
+#include <cstdint>
+
+#include "../Utilities/Utilities.h"
+
+
+class BufferManager;
+class Swapchain;
+
+// Temporal anti-aliasing and upsampling, in place of MSAA. Every frame is drawn with a different sub-pixel jitter in its
+// projection, so over a few frames each output pixel gathers samples from all over its area. Motion vectors are built from
+// the depth buffer and the camera's previous transform, the history is reprojected along them and clamped to this frame's
+// neighbourhood so stale history is rejected, and the result is resolved at the swapchain's resolution whatever size the
+// frame was drawn at. Runs on the post-processing chain's scene colour image before the chain. The motion vectors only live
+// between the two passes, so they're a transient of the render graph and share memory with the frame's other transients.
+class TemporalAA
+{
+public:
+	static constexpr VkFormat sm_motionVectorFormat = VK_FORMAT_R16G16_SFLOAT;
+
+	TemporalAA(uint32_t frameCount);
+
+	// Jitters this frame's projection and works out the reprojection from the last frame. Call once per frame with the
+	// unjittered camera matrices, after the render extent is set and before anything is drawn with the result.
+	glm::mat4 jitterProjection(const glm::mat4& view, const glm::mat4& proj);
+
+	// The render graph has the depth buffer and the scene colour image in their sampled layouts, the outputs in the general layout.
+	// The motion vectors are this frame's transient, the frame's descriptor sets are pointed at it before they're bound.
+	void recordMotionVectors(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkImageView motionVectorView);
+	void recordResolve(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkImageView motionVectorView);
+	// The render graph has this frame's history as a transfer source and the scene colour image as a transfer destination
+	void recordCopyToSceneColor(VkCommandBuffer commandBuffer, VkImage sceneColorImage);
+
+	// Last frame's output, read by this frame's resolve
+	VkImage* getPreviousHistoryImage() { return &m_historyImages[1 - m_currentHistory]; }
+	// Written by this frame's resolve
+	VkImage* getCurrentHistoryImage() { return &m_historyImages[m_currentHistory]; }
+
+	// Follows the swapchain's size. The history starts over and the old images go through the deletion queue.
+	void recreateTargets();
+	void cleanup();
+
+private:
+	// Matches PushConstants in motionVectors.comp
+	struct sMotionPushConstants
+	{
+		glm::mat4 reprojection; // This frame's unjittered NDC to last frame's clip space
+		glm::vec2 jitter; // In NDC
+		glm::uvec2 renderExtent;
+	};
+
+	// Matches PushConstants in temporalResolve.comp
+	struct sResolvePushConstants
+	{
+		glm::vec2 jitter; // In render pixels
+		glm::uvec2 renderExtent;
+		glm::uvec2 outputExtent;
+		float historyWeight;
+	};
+
+	static constexpr float sm_historyWeight = 0.9f; // Share of the history in each resolved pixel while it's valid
+	static constexpr uint32_t sm_jitterPhases = 8; // Jitter positions at full resolution, scaled up with the pixels each render pixel covers
+
+	Utilities* m_pUtilities = nullptr;
+	VkDevice* m_pLogicalDevice = nullptr;
+	BufferManager* m_pBufferManager = nullptr;
+	Swapchain* m_pSwapchain = nullptr;
+
+	VkExtent2D m_extent = {};
+	// Ping-ponged, one is read while the other is written
+	std::array<VkImage, 2> m_historyImages = {};
+	std::array<VkDeviceMemory, 2> m_historyImagesMemory = {};
+	std::array<VkImageView, 2> m_historyImageViews = {};
+	uint32_t m_currentHistory = 0;
+	bool m_historyValid = false;
+
+	uint32_t m_frameCount = 0;
+	glm::mat4 m_previousViewProj = glm::mat4(1.0f);
+	sMotionPushConstants m_motionConstants = {};
+	sResolvePushConstants m_resolveConstants = {};
+
+	VkSampler m_sampler = VK_NULL_HANDLE;
+	VkDescriptorSetLayout m_motionSetLayout = VK_NULL_HANDLE;
+	VkDescriptorSetLayout m_resolveSetLayout = VK_NULL_HANDLE;
+	VkPipelineLayout m_motionPipelineLayout = VK_NULL_HANDLE;
+	VkPipelineLayout m_resolvePipelineLayout = VK_NULL_HANDLE;
+	VkPipeline m_motionPipeline = VK_NULL_HANDLE;
+	VkPipeline m_resolvePipeline = VK_NULL_HANDLE;
+
+	VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+	// One of each per frame in flight, written every frame since the transient and the history they point at change
+	std::vector<VkDescriptorSet> m_motionSets = {};
+	std::vector<VkDescriptorSet> m_resolveSets = {};
+
+
+	void createPipelines();
+	void createTargets();
+	void createDescriptorSets(uint32_t frameCount);
+	void retireTargets();
+
+	// Low discrepancy sequence the jitter positions come from, index starts at 1
+	static float halton(uint32_t index, uint32_t base);
+};
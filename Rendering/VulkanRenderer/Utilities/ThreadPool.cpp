@@ -0,0 +1,72 @@
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <algorithm>
+
+
+ThreadPool::ThreadPool(uint32_t threadCount)
+{
+	if (threadCount == 0) threadCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+
+	m_workers.reserve(threadCount);
+	for (uint32_t i = 0; i < threadCount; i++) {
+		m_workers.emplace_back(&ThreadPool::workerLoop, this);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		m_stopping = true;
+	}
+	m_condition.notify_all();
+
+	for (std::thread& worker : m_workers) {
+		worker.join();
+	}
+}
+
+void ThreadPool::workerLoop()
+{
+	while (true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(m_queueMutex);
+			m_condition.wait(lock, [this]() { return m_stopping || !m_tasks.empty(); });
+
+			// Finish whatever is queued before stopping
+			if (m_stopping && m_tasks.empty()) return;
+
+			task = std::move(m_tasks.front());
+			m_tasks.pop();
+		}
+
+		task();
+	}
+}
+
+void ThreadPool::parallelFor(uint32_t count, const std::function<void(uint32_t)>& task)
+{
+	if (count == 0) return;
+
+	// Indices are handed out one at a time, so uneven work (e.g. screen bands with more triangles) balances itself
+	std::atomic<uint32_t> nextIndex = 0;
+	auto runIndices = [&]() {
+		for (uint32_t i = nextIndex++; i < count; i = nextIndex++) task(i);
+	};
+
+	uint32_t helperCount = std::min(count - 1, getThreadCount());
+	std::vector<std::future<void>> helpers;
+	helpers.reserve(helperCount);
+	for (uint32_t i = 0; i < helperCount; i++) {
+		helpers.push_back(enqueue(runIndices));
+	}
+
+	runIndices();
+
+	for (std::future<void>& helper : helpers) {
+		helper.get();
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <type_traits>
+#include <cstdint>
+
+
+// Fixed size pool of worker threads for CPU side work that can be spread over several cores.
+class ThreadPool
+{
+public:
+	// A thread count of 0 creates one worker per hardware thread, minus one for the render thread.
+	ThreadPool(uint32_t threadCount = 0);
+	~ThreadPool();
+
+	template<typename F>
+	auto enqueue(F&& task) -> std::future<std::invoke_result_t<F>>
+	{
+		using ReturnType = std::invoke_result_t<F>;
+
+		auto pTask = std::make_shared<std::packaged_task<ReturnType()>>(std::forward<F>(task));
+		std::future<ReturnType> result = pTask->get_future();
+		{
+			std::lock_guard<std::mutex> lock(m_queueMutex);
+			m_tasks.emplace([pTask]() { (*pTask)(); });
+		}
+		m_condition.notify_one();
+
+		return result;
+	}
+
+	// Runs task(i) for every i in [0, count) on the workers and the calling thread, returns once every index is done.
+	void parallelFor(uint32_t count, const std::function<void(uint32_t)>& task);
+
+	uint32_t getThreadCount() { return static_cast<uint32_t>(m_workers.size()); }
+
+private:
+	std::vector<std::thread> m_workers = {};
+	std::queue<std::function<void()>> m_tasks = {};
+	std::mutex m_queueMutex;
+	std::condition_variable m_condition;
+	bool m_stopping = false;
+
+	void workerLoop();
+};
@@ -96,6 +96,7 @@ string compileExecPath = "\\shaders";
 string Utilities::EngineWorkingDirectory = "";
 vector<string>* Utilities::pCompiledVertShaders = new vector<string>();
 vector<string>* Utilities::pCompiledFragShaders = new vector<string>();
+std::map<string, string>* Utilities::pCompiledShaders = new std::map<string, string>();
 
 void Utilities::compileShaders(std::filesystem::path folderPath) {
 	string workingCompilerPath = EngineWorkingDirectory + compilerPath;
@@ -141,8 +142,41 @@ void Utilities::compileShaders(std::filesystem::path folderPath) {
 		}
 	};
 
+	// Shaders in subfolders belong to specific passes rather than the base pipeline, so they're looked up by name
+	for (const auto& entry : std::filesystem::recursive_directory_iterator(folderPath)) {
+		if (!entry.is_regular_file() || entry.path().parent_path() == folderPath) continue;
+
+		string ext = entry.path().extension().string();
+		if (ext != ".vert" && ext != ".frag" && ext != ".comp") continue;
+
+		std::filesystem::path shaderPath = entry.path();
+		string shaderName = shaderPath.filename().string();
+		std::filesystem::path outputPath = shaderPath;
+		string outputPathS = EngineWorkingDirectory + "/" + outputPath.replace_extension(ext + ".spv").string();
+		string command = workingCompilerPath + " " + EngineWorkingDirectory + "/" + shaderPath.string() + " -o " + outputPathS;
+
+		getInstance()->iDebugPrint("Compiling shader: " + shaderName + " | Command: " + command, "Utilities");
+
+		int result = system(command.c_str());
+		if (result != 0) {
+			getInstance()->iDebugPrint("Failed to compile shader: " + shaderName, "Utilities");
+		}
+		else {
+			(*Utilities::pCompiledShaders)[shaderName] = outputPathS;
+		}
+	};
+
 	vector<directory_entry> compiledShaders = getFilesOfExtInFolder(folderPath, ".spv");
 	for (const auto& compiledShader : compiledShaders) {
 		getInstance()->iDebugPrint("Compiled shader: " + compiledShader.path().filename().string(), "Utilities");
 	};
+}
+
+string Utilities::getCompiledShaderPath(const string& shaderName) {
+	auto it = pCompiledShaders->find(shaderName);
+	if (it == pCompiledShaders->end()) {
+		throw std::runtime_error("shader " + shaderName + " was not compiled!");
+	}
+
+	return it->second;
 }
\ No newline at end of file
@@ -11,16 +11,34 @@
 #include <fstream>
 #include <iterator>
 #include <filesystem>
+#include <map>
 
 // Macro to print debug messages with class name argument autofilled
 #define mDebugPrint(x) m_pUtilities->debugPrint(x, this)
 
 
+enum class eOcclusionCulling
+{
+	NONE, // Draw everything that passes frustum culling.
+	HIERARCHICAL_Z, // Test bounds on the GPU against a depth pyramid built from last frame's visible models.
+	SOFTWARE // Rasterise occluder meshes on the CPU and test bounds before any draw is recorded.
+};
+
+enum class eMultiview
+{
+	NONE, // Draw a single view.
+	STEREO, // Draw two eyes a stereo separation apart, side by side.
+	SPLIT_SCREEN // Draw two cameras side by side, the second one isn't moved by the input.
+};
+
+
 struct sSettings {
 	struct sWindowSettings {
 		const char* title = "NebulaEngine"; // Window title.
 		uint32_t width = 1280; // Window width.
 		uint32_t height = 720; // Window height.
+		bool headless = false; // Render offscreen without a window or surface, the size above is the size of the images drawn to.
+		uint32_t headlessFrameCount = 1000; // Frames drawn before a headless run exits.
 	} windowSettings;
 	struct sDebugSettings {
 		#ifdef NDEBUG
@@ -32,6 +50,11 @@ struct sSettings {
 			"VK_LAYER_KHRONOS_validation"
 		};
 		bool enableValidationLayers = true; // Enable validation layers.
+		bool runBenchmarks = false; // Run subsystem micro-benchmarks after initialisation.
+		bool frameCapture = false; // Allow frames to be read back and written to disk, see FrameCapture.
+		uint32_t captureInterval = 0; // Capture every Nth frame, 0 only captures the frames asked for with FrameCapture::requestCapture.
+		const char* captureDirectory = "captures"; // Where captures are written, created if it doesn't exist.
+		bool captureRaw = false; // Write the pixels as they are read back instead of encoding PNGs.
 	} debugSettings;
 	struct sGraphicsSettings {
 		int maxFramesInFlight = 2; // How many frames the CPU can queue for rendering at once.
@@ -42,11 +65,33 @@ struct sSettings {
 		bool rasterizerDepthClamp = false; // Enable depth clamping.
 		bool wireframe = true; // Enable Wireframe rendering.
 		float wireframeThickness = 2.0f; // Thickness of wireframes when using Wireframe rendering.
-		bool multisampling = false; // Enable Multisampling.
+		bool multisampling = false; // Enable MSAA.
+		uint32_t maxMsaaSamples = 8; // Most MSAA samples per pixel, fewer are used if the device or the sample budget doesn't allow as many.
+		float msaaSampleBudget = 10.0f; // Millions of samples per frame the MSAA sample count has to fit in at the starting resolution.
 		VkBool32 anisotropicFiltering = false; // Enable Anisotropic filtering.
 		float anisotropyLevel = 4.0f; // Anisotropy level (1.0f = no anisotropy).
 		float nearClip = 0.1f; // Near clipping plane.
 		float farClip = 1000.0f; // Far clipping plane.
+		bool frustumCulling = true; // Skip drawing models outside of the camera's view frustum.
+		eOcclusionCulling occlusionCulling = eOcclusionCulling::HIERARCHICAL_Z; // Skip drawing models hidden behind others.
+		bool dynamicRendering = true; // Begin passes with VK_KHR_dynamic_rendering instead of render pass and framebuffer objects (needs Vulkan 1.2).
+		bool asyncCompute = true; // Submit compute work to a dedicated compute queue so it overlaps rasterisation, if the device has one.
+		bool extendedDynamicState = true; // Set polygon and cull mode when recording (VK_EXT_extended_dynamic_state(3)) so wireframe needs no pipeline variant.
+		bool graphicsPipelineLibrary = true; // Link new pipeline variants from precompiled parts (VK_EXT_graphics_pipeline_library) and optimise them in the background.
+		bool depthPrepass = false; // Draw depth from a position-only stream first so the main pass only shades visible surfaces. Not used in wireframe.
+		bool clusteredLighting = true; // Shade with point and spot lights, binned into view space clusters by a compute pass each frame. Off leaves only the sun.
+		bool shadows = true; // Cascaded shadow maps for the sun. The far cascades are cached and only redrawn once the camera has moved far enough.
+		float shadowDistance = 150.0f; // How far from the camera the sun's shadows reach, split between the cascades.
+		bool postProcessing = true; // Draw into an HDR scene colour image and run the post-processing chain over it before presenting. Startup only.
+		bool dynamicResolution = true; // Scale the resolution the frame is drawn at to hold the GPU frame time. Needs post-processing and GPU timestamps. Startup only.
+		float dynamicResolutionTarget = 16.0f; // GPU frame time in milliseconds dynamic resolution aims for.
+		float minResolutionScale = 0.5f; // Lowest fraction of the swapchain's width and height dynamic resolution draws at.
+		float maxResolutionScale = 1.0f; // Highest fraction of the swapchain's width and height dynamic resolution draws at, at most 1.
+		bool temporalAA = true; // Jittered temporal anti-aliasing, resolved at the swapchain's resolution. Replaces MSAA and needs post-processing. Startup only.
+		eMultiview multiview = eMultiview::NONE; // Draw two views in a single pass with VK_KHR_multiview. Not used with MSAA, temporal AA, dynamic resolution or occlusion culling. Startup only.
+		float stereoSeparation = 0.064f; // Distance between the eyes in stereo, in world units.
+		bool orderIndependentTransparency = true; // Draw transparent models into weighted blended targets composited over the frame, so they need no sorting. Not used with MSAA or multiview. Startup only.
+		bool visibilityBuffer = false; // Rasterise only draw and triangle ids, then shade every pixel once in a full-screen pass. For very dense scenes. Not used with MSAA, multiview or Hi-Z occlusion culling. Startup only.
 	} graphicsSettings;
 	struct sControlSettings {
 		float cameraSensitivity = .1f; // Sensitivity of the camera movement.
@@ -83,7 +128,10 @@ public:
 
 	static std::vector<std::string>* pCompiledVertShaders;
 	static std::vector<std::string>* pCompiledFragShaders;
+	static std::map<std::string, std::string>* pCompiledShaders; // Shaders in subfolders, keyed by file name (e.g. "hizCull.comp")
 	static void compileShaders(std::filesystem::path folderPath);
+	// Returns the SPIR-V path of a shader compiled from one of the shader subfolders.
+	static std::string getCompiledShaderPath(const std::string& shaderName);
 private:
 	Utilities();
 
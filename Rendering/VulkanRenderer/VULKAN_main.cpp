@@ -15,6 +15,7 @@
 
 const std::map<std::string, uint32_t> versions = {
 	{ "engineVersion", VK_MAKE_API_VERSION(0,0,9,0) },
+	{ "apiVersion", VK_API_VERSION_1_2 },
 };
 
 sSettings settings{
@@ -22,22 +23,34 @@ sSettings settings{
 		.title = "NebulaEngine",
 		.width = 1280,
 		.height = 720,
+		.headless = false,
+		.headlessFrameCount = 1000
 	},
 	.debugSettings {
 		#ifdef NDEBUG
 		.debugMode = false,
 		.validationLayers = {},
 		.enableValidationLayers = false,
+		.runBenchmarks = false,
+		.frameCapture = false,
+		.captureInterval = 0,
+		.captureDirectory = "captures",
+		.captureRaw = false,
 		#else
 		.debugMode = true,
 		.validationLayers = {
 			"VK_LAYER_KHRONOS_validation"
 		},
-		.enableValidationLayers = true
+		.enableValidationLayers = true,
+		.runBenchmarks = false,
+		.frameCapture = false,
+		.captureInterval = 0,
+		.captureDirectory = "captures",
+		.captureRaw = false
 		#endif
 	},
 	.graphicsSettings {
-		.maxFramesInFlight = 1,
+		.maxFramesInFlight = 2,
 		.enabledFeatures = {
 			.sampleRateShading = true,
 			.fillModeNonSolid = true,
@@ -51,10 +64,32 @@ sSettings settings{
 		.wireframe = false,
 		.wireframeThickness = 8.0f,
 		.multisampling = true,
+		.maxMsaaSamples = 8,
+		.msaaSampleBudget = 10.0f,
 		.anisotropicFiltering = true,
 		.anisotropyLevel = 16.0f,
 		.nearClip = 0.1f,
-		.farClip = 1000.0f
+		.farClip = 1000.0f,
+		.frustumCulling = true,
+		.occlusionCulling = eOcclusionCulling::HIERARCHICAL_Z,
+		.dynamicRendering = true,
+		.asyncCompute = true,
+		.extendedDynamicState = true,
+		.graphicsPipelineLibrary = true,
+		.depthPrepass = false,
+		.clusteredLighting = true,
+		.shadows = true,
+		.shadowDistance = 150.0f,
+		.postProcessing = true,
+		.dynamicResolution = true,
+		.dynamicResolutionTarget = 16.0f,
+		.minResolutionScale = 0.5f,
+		.maxResolutionScale = 1.0f,
+		.temporalAA = true,
+		.multiview = eMultiview::NONE,
+		.stereoSeparation = 0.064f,
+		.orderIndependentTransparency = true,
+		.visibilityBuffer = false
 	},
 	.controlSettings {
 		.cameraSensitivity = 2.0f,
@@ -83,6 +118,7 @@ bool keyW = false;
 bool keyA = false;
 bool keyS = false;
 bool keyD = false;
+bool keyP = false;
 double lastMouseX = settings.windowSettings.width / 2;
 double lastMouseY = settings.windowSettings.height / 2;
 bool firstMouseInput = true;
@@ -93,6 +129,9 @@ void enableInputProcessing(VulkanEngine *pVulkanEngine)
 	GLFWwindow* pGLFWWindow = pWindow->getWindow();
 	Camera* pCamera = pVulkanEngine->getCamera();
 
+	// Headless runs have no window to take input from
+	if (pWindow->isHeadless()) return;
+
 	glfwSetInputMode(pGLFWWindow, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
 	while (pVulkanEngine->getState() == VkEngineState::RUNNING) {
@@ -110,10 +149,12 @@ void enableInputProcessing(VulkanEngine *pVulkanEngine)
 		if (glfwGetKey(pGLFWWindow, GLFW_KEY_D) == GLFW_PRESS) keyD = true;
 		if (glfwGetKey(pGLFWWindow, GLFW_KEY_D) == GLFW_RELEASE) keyD = false;
 
-		if (glfwGetKey(pGLFWWindow, GLFW_KEY_P) == GLFW_PRESS) {
-			pVulkanEngine->m_settings->graphicsSettings.wireframe = !pVulkanEngine->m_settings->graphicsSettings.wireframe;
-			pVulkanEngine->rebuildGraphicsPipeline();
+		// Only on the press itself, holding P would otherwise queue a toggle every iteration
+		bool pressedP = glfwGetKey(pGLFWWindow, GLFW_KEY_P) == GLFW_PRESS;
+		if (pressedP && !keyP) {
+			pVulkanEngine->changeGraphicsSettings([](sSettings::sGraphicsSettings& graphicsSettings) { graphicsSettings.wireframe = !graphicsSettings.wireframe; });
 		}
+		keyP = pressedP;
 
 		glm::vec3 dirInput = glm::vec3(0.0f);
 		if (keyW) dirInput.z = 1;
@@ -1,5 +1,7 @@
 #include "VulkanRenderer.h"
 
+#include <random>
+
 
 VulkanEngine* VulkanEngine::m_pInstance = nullptr;
 
@@ -93,6 +95,9 @@ void VulkanEngine::initVulkan()
 	m_pVkDevice = m_pLogicalDevice->getVkDevice();
 	Image::m_pLogicalDevice = m_pVkDevice;
 
+	m_pGpuTimeline = new GpuTimeline();
+	m_pDeletionQueue = new DeletionQueue();
+
 	// Buffer Manager
 	m_pBufferManager = new BufferManager();
 	Image::m_pBufferManager = m_pBufferManager;
@@ -100,18 +105,18 @@ void VulkanEngine::initVulkan()
 
 	// Command buffer
 	m_pBufferManager->m_pCommandBuffer = new CommandBuffer(m_pBufferManager);
+	m_pBufferManager->m_pRenderGraph = new RenderGraph();
+
+	// Frame contexts, models take their uniform slots from these
+	m_pBufferManager->m_pFrameContexts = new FrameContextRing(static_cast<uint32_t>(m_MAX_FRAMES_IN_FLIGHT));
+	m_pAsyncCompute = new AsyncCompute(static_cast<uint32_t>(m_MAX_FRAMES_IN_FLIGHT));
+	m_pGpuTimer = new GpuTimer(static_cast<uint32_t>(m_MAX_FRAMES_IN_FLIGHT));
+	if (m_settings->debugSettings.frameCapture) m_pFrameCapture = new FrameCapture(static_cast<uint32_t>(m_MAX_FRAMES_IN_FLIGHT));
 
 	// Swapchain
 	m_pSwapchain = new Swapchain();
 	m_pBufferManager->m_pSwapchain = m_pSwapchain;
 
-	// Graphics pipeline
-	m_pGraphicsPipeline = new GraphicsPipeline();
-	m_pBufferManager->m_pGraphicsPipeline = m_pGraphicsPipeline->getGraphicsPipeline();
-	m_pBufferManager->m_pRenderPass = m_pGraphicsPipeline->getRenderPass();
-	m_pBufferManager->m_pDescriptorSetLayout = m_pGraphicsPipeline->getDescriptorSetLayout();
-	m_pBufferManager->m_pPipelineLayout = m_pGraphicsPipeline->getVkPipelineLayout();
-
 	// Create model
 	Model* model1 = new Model("models/DTO_Crate.obj", "textures/DTO_Crate_Tex_Diffuse.png");
 	Model* model2 = new Model("models/SF_Osprey.obj", "textures/DTO_Crate_Tex_Diffuse.png");
@@ -121,30 +126,132 @@ void VulkanEngine::initVulkan()
 	model2->changeScale(glm::vec3(.1f, .1f, .1f));
 	model3->changePosition(glm::vec3(0.0f, 0.0f, 200.0f));
 	model3->changeRotation(glm::vec3(0.0f, 180.0f, 0.0f));
+	model1->setOpacity(0.5f);
 
 	m_LoadedModels.push_back(model1);
 	m_LoadedModels.push_back(model2);
 	m_LoadedModels.push_back(model3);
 
-	// Command buffer
-	m_pBufferManager->m_pCommandBuffer->createCommandBuffers();
+	// The ids and the texture array of the visibility buffer have room for so much, only known once the models are loaded.
+	// Checked before the pipeline bakes in the sample count and the Hi-Z passes, so what it had turned off can be given back.
+	if (m_settings->graphicsSettings.visibilityBuffer) {
+		std::string sceneLimit = VisibilityBuffer::findSceneLimit(m_LoadedModels);
+		if (!sceneLimit.empty()) {
+			mDebugPrint(sceneLimit + " Falling back to forward shading.");
+			m_settings->graphicsSettings.visibilityBuffer = false;
+			if (m_visibilityBufferDisabledMultisampling) m_settings->graphicsSettings.multisampling = true;
+			if (m_visibilityBufferDisabledHiZ) m_settings->graphicsSettings.occlusionCulling = eOcclusionCulling::HIERARCHICAL_Z;
+			validateSettings(); // What is given back still has to go with the other settings, e.g. OIT isn't used with multisampling
+		}
+	}
 
+	// Graphics pipeline
+	m_pGraphicsPipeline = new GraphicsPipeline();
+	m_pBufferManager->m_pGraphicsPipeline = m_pGraphicsPipeline->getGraphicsPipeline();
+	m_pBufferManager->m_pRenderPass = m_pGraphicsPipeline->getRenderPass();
+	m_pBufferManager->m_pOcclusionRenderPass = m_pGraphicsPipeline->getOcclusionRenderPass();
+	m_pBufferManager->m_pDescriptorSetLayout = m_pGraphicsPipeline->getDescriptorSetLayout();
+	m_pBufferManager->m_pPipelineLayout = m_pGraphicsPipeline->getVkPipelineLayout();
+	for (Model* model : m_LoadedModels) model->createDescriptorSets();
 
-	// Initialise depth buffer
+	// Initialise depth buffer, and the multisampled attachments that resolve into it and the swapchain with MSAA
 	m_pBufferManager->m_pDepthBuffer = new DepthBuffer(m_pBufferManager);
+	if (m_pGraphicsPipeline->getSampleCount() != VK_SAMPLE_COUNT_1_BIT) m_pBufferManager->m_pMultisampleBuffer = new MultisampleBuffer(m_pBufferManager, m_pGraphicsPipeline->getSampleCount());
+
+	// With post-processing the passes draw into its scene colour image, so it has to exist before the framebuffers
+	if (m_settings->graphicsSettings.postProcessing) {
+		m_pPostProcessChain = new PostProcessChain();
+		m_pPostProcessChain->addNode(PostProcessChain::eEffect::TONEMAP, glm::vec4(1.0f, 0.0f, 0.0f, 0.0f));
+		m_pPostProcessChain->addNode(PostProcessChain::eEffect::COLOR_GRADING, glm::vec4(1.05f, 1.1f, 0.0f, 0.0f));
+		m_pPostProcessChain->addNode(PostProcessChain::eEffect::VIGNETTE, glm::vec4(0.35f, 0.6f, 0.5f, 0.0f));
+		m_pPostProcessChain->addNode(PostProcessChain::eEffect::FILM_GRAIN, glm::vec4(0.03f, 0.0f, 0.0f, 0.0f));
+		m_pBufferManager->m_pPostProcessChain = m_pPostProcessChain;
+
+		// The chain's copy to the swapchain is what upscales a frame drawn at a lower resolution
+		if (m_settings->graphicsSettings.dynamicResolution) {
+			if (m_pGpuTimer->isSupported()) m_pDynamicResolution = new DynamicResolution(static_cast<uint32_t>(m_MAX_FRAMES_IN_FLIGHT));
+			else mDebugPrint("Dynamic resolution needs GPU timestamps, drawing at full resolution.");
+		}
+
+		if (m_settings->graphicsSettings.temporalAA) {
+			m_pTemporalAA = new TemporalAA(static_cast<uint32_t>(m_MAX_FRAMES_IN_FLIGHT));
+			m_pBufferManager->m_pTemporalAA = m_pTemporalAA;
+		}
+	}
+
+	// With multiview the passes draw every view into its own layer of these instead, so they have to exist before the framebuffers too
+	if (m_settings->graphicsSettings.multiview != eMultiview::NONE) {
+		m_pMultiviewTarget = new MultiviewTarget();
+		m_pBufferManager->m_pMultiviewTarget = m_pMultiviewTarget;
+	}
+
+	// Composites into the frame, so after the scene colour image
+	if (m_settings->graphicsSettings.orderIndependentTransparency) {
+		m_pWeightedBlendedOIT = new WeightedBlendedOIT(static_cast<uint32_t>(m_MAX_FRAMES_IN_FLIGHT));
+		m_pBufferManager->m_pWeightedBlendedOIT = m_pWeightedBlendedOIT;
+	}
+
+	// Shades into the frame like the composite, and copies the loaded models' geometry into its scene buffers
+	if (m_settings->graphicsSettings.visibilityBuffer) {
+		m_pVisibilityBuffer = new VisibilityBuffer(static_cast<uint32_t>(m_MAX_FRAMES_IN_FLIGHT), m_LoadedModels);
+		m_pBufferManager->m_pVisibilityBuffer = m_pVisibilityBuffer;
+	}
 
 	// Initialise other buffers
-	m_pBufferManager->m_pFramebuffer = new Framebuffer(m_pBufferManager);
+	if (!m_settings->graphicsSettings.dynamicRendering) m_pBufferManager->m_pFramebuffer = new Framebuffer(m_pBufferManager);
 	m_pBufferManager->m_pLoadedModels = &m_LoadedModels;
 
-	// Sync objects
-	m_pWindow->createSyncObjects();
+	m_pWindow->prepareRendering();
 
 	// Camera
 	m_pCamera = new Camera();
 	m_pCamera->m_cameraSensitivity = m_settings->controlSettings.cameraSensitivity;
 	m_pCamera->m_cameraSpeed = m_settings->controlSettings.cameraSpeed;
 	m_pWindow->setCamera(m_pCamera);
+
+	// Starts off to the side of the first one, whatever drives the second player moves it
+	if (m_settings->graphicsSettings.multiview == eMultiview::SPLIT_SCREEN) {
+		m_pSecondCamera = new Camera();
+		m_pSecondCamera->m_cameraPosition = glm::vec3(10.0f, 0.0f, -10.0f);
+		m_pSecondCamera->m_cameraSensitivity = m_settings->controlSettings.cameraSensitivity;
+		m_pSecondCamera->m_cameraSpeed = m_settings->controlSettings.cameraSpeed;
+		m_pWindow->setSecondCamera(m_pSecondCamera);
+	}
+
+	// Culling
+	m_pThreadPool = new ThreadPool();
+	m_pCompileThreadPool = new ThreadPool(sm_compileThreads);
+	m_pGraphicsPipeline->prewarmVariants(m_pCompileThreadPool);
+	m_pFrustumCuller = new FrustumCuller();
+
+	if (m_settings->graphicsSettings.occlusionCulling == eOcclusionCulling::HIERARCHICAL_Z) {
+		m_pHiZCuller = new HiZCuller(static_cast<uint32_t>(m_LoadedModels.size()));
+		m_pBufferManager->m_pHiZCuller = m_pHiZCuller;
+	}
+	else if (m_settings->graphicsSettings.occlusionCulling == eOcclusionCulling::SOFTWARE) {
+		m_pSoftwareOcclusionCuller = new SoftwareOcclusionCuller(m_pThreadPool);
+	}
+
+	// Lighting, the graphics pipeline layout already has the light clusters in set 1
+	m_pClusteredLighting = new ClusteredLighting(*m_pGraphicsPipeline->getLightSetLayout());
+	m_pBufferManager->m_pClusteredLighting = m_pClusteredLighting;
+	// Set 2 samples the sun's shadow cascades
+	m_pCascadedShadows = new CascadedShadows(*m_pGraphicsPipeline->getShadowSetLayout());
+	m_pBufferManager->m_pCascadedShadows = m_pCascadedShadows;
+
+	// Scatter lights through the scene, a quarter of them spot lights pointing down
+	std::mt19937 rng(1337);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	for (uint32_t i = 0; i < 1024; i++)
+	{
+		glm::vec3 position(unit(rng) * 120.0f - 60.0f, unit(rng) * 20.0f - 5.0f, unit(rng) * 240.0f - 20.0f);
+		glm::vec3 color(unit(rng), unit(rng), unit(rng));
+
+		if (i % 4 == 0) m_pClusteredLighting->addSpotLight(position, glm::vec3(0.0f, -1.0f, 0.0f), color, 40.0f, 15.0f, 20.0f, 35.0f);
+		else m_pClusteredLighting->addPointLight(position, color, 20.0f, 4.0f + unit(rng) * 8.0f);
+	}
+
+	if (m_settings->debugSettings.runBenchmarks) runBenchmarks();
 }
 
 void VulkanEngine::createInstance()
@@ -163,7 +270,7 @@ void VulkanEngine::createInstance()
 		.applicationVersion = m_versions["gameVersion"],
 		.pEngineName = "VulkanEngine",
 		.engineVersion = m_versions["engineVersion"],
-		.apiVersion = m_versions["apiVersion"]
+		.apiVersion = std::max(m_versions["apiVersion"], VK_API_VERSION_1_2) // Timeline semaphores are core in 1.2
 	};
 
 	VkInstanceCreateInfo createInfo{
@@ -204,34 +311,94 @@ void VulkanEngine::mainLoop()
 	m_pWindow->mainLoop();
 }
 
-void VulkanEngine::rebuildGraphicsPipeline() {
-	m_shouldRender = false;
+void VulkanEngine::cullModels(const std::vector<glm::mat4>& viewProjs, uint32_t frameIndex)
+{
+	std::vector<uint32_t>& visibleModelIndices = m_pBufferManager->m_visibleModelIndices;
+	const glm::mat4& viewProj = viewProjs[0]; // Occlusion culling and the draw order only follow the first view
 
-	mDebugPrint("Rebuilding graphics pipeline...");
+	// Batch indices match m_LoadedModels indices since every model is added in order
+	m_pFrustumCuller->clear();
+	for (Model* model : m_LoadedModels)
+	{
+		glm::vec3 center;
+		float radius;
+		model->getWorldBoundingSphere(center, radius);
+		m_pFrustumCuller->addSphere(center, radius);
+	}
 
-	//m_pBufferManager->m_pFramebuffer->cleanup();
-	m_pBufferManager->m_pCommandBuffer->cleanup();
+	if (m_settings->graphicsSettings.frustumCulling)
+	{
+		// Every view draws the same list, so a model is kept if any of them can see it
+		std::vector<FrustumCuller::sFrustum> frusta;
+		for (const glm::mat4& matrix : viewProjs) frusta.push_back(FrustumCuller::extractFrustum(matrix));
+		m_pFrustumCuller->cull(frusta, visibleModelIndices);
+	}
+	else
+	{
+		visibleModelIndices.resize(m_LoadedModels.size());
+		for (uint32_t i = 0; i < m_LoadedModels.size(); i++) visibleModelIndices[i] = i;
+	}
 
-	m_pGraphicsPipeline->cleanup();
+	if (m_pSoftwareOcclusionCuller != nullptr) m_pSoftwareOcclusionCuller->cull(viewProj, m_settings->graphicsSettings.nearClip, m_pFrustumCuller, m_LoadedModels, visibleModelIndices);
 
-	m_pSwapchain->cleanup();
+	// Sort by state so the command buffer only rebinds what changes, nearest first within the same state. Transparent models
+	// go after the opaque ones when there's order independent transparency, otherwise they're drawn with them as before.
+	DrawQueue& drawQueue = m_pBufferManager->m_drawQueue;
+	drawQueue.clear();
+	for (uint32_t index : visibleModelIndices)
+	{
+		Model* model = m_LoadedModels[index];
+		if (m_pWeightedBlendedOIT != nullptr && model->isTransparent()) {
+			drawQueue.push(DrawQueue::makeSortKey(DrawQueue::PASS_TRANSPARENT, 0, model->m_materialId, model->m_meshId, 0.0f), index);
+			continue;
+		}
 
-	m_pBufferManager->m_pCommandBuffer = new CommandBuffer(m_pBufferManager);
+		float viewDepth = (viewProj * glm::vec4(glm::vec3(m_pFrustumCuller->getSphere(index)), 1.0f)).w;
+		drawQueue.push(DrawQueue::makeSortKey(DrawQueue::PASS_MAIN, 0, model->m_materialId, model->m_meshId, viewDepth / m_settings->graphicsSettings.farClip), index);
+	}
+	drawQueue.sort();
 
-	m_pSwapchain = new Swapchain();
-	m_pBufferManager->m_pSwapchain = m_pSwapchain;
+	if (m_pHiZCuller != nullptr) m_pHiZCuller->updateObjects(frameIndex, viewProj, m_pFrustumCuller, visibleModelIndices, m_LoadedModels);
+}
 
-	m_pGraphicsPipeline = new GraphicsPipeline();
-	m_pBufferManager->m_pGraphicsPipeline = m_pGraphicsPipeline->getGraphicsPipeline();
-	m_pBufferManager->m_pRenderPass = m_pGraphicsPipeline->getRenderPass();
-	m_pBufferManager->m_pDescriptorSetLayout = m_pGraphicsPipeline->getDescriptorSetLayout();
-	m_pBufferManager->m_pPipelineLayout = m_pGraphicsPipeline->getVkPipelineLayout();
+void VulkanEngine::runBenchmarks()
+{
+	mDebugPrint("Running benchmarks...");
 
-	m_pBufferManager->m_pFramebuffer = new Framebuffer(m_pBufferManager);
+	m_pFrustumCuller->benchmark(16384, 2000);
+	m_pFrustumCuller->benchmark(1 << 20, 20);
 
-	m_pBufferManager->m_pCommandBuffer->createCommandBuffers();
+	SoftwareOcclusionCuller* pOcclusionCuller = m_pSoftwareOcclusionCuller != nullptr ? m_pSoftwareOcclusionCuller : new SoftwareOcclusionCuller(m_pThreadPool);
+	pOcclusionCuller->benchmark(16384, 200);
+	if (pOcclusionCuller != m_pSoftwareOcclusionCuller) delete pOcclusionCuller;
 
-	m_shouldRender = true;
+	m_pWindow->benchmarkFramesInFlight(500);
+	m_pWindow->benchmarkDepthPrepass(500);
+}
+
+void VulkanEngine::changeGraphicsSettings(std::function<void(sSettings::sGraphicsSettings&)> change)
+{
+	std::lock_guard<std::mutex> lock(m_settingsChangeMutex);
+	m_settingsChanges.push_back(std::move(change));
+}
+
+void VulkanEngine::applySettingsChanges()
+{
+	std::vector<std::function<void(sSettings::sGraphicsSettings&)>> changes;
+	{
+		std::lock_guard<std::mutex> lock(m_settingsChangeMutex);
+		changes.swap(m_settingsChanges);
+	}
+
+	if (!changes.empty()) {
+		for (auto& change : changes) {
+			change(m_settings->graphicsSettings);
+		}
+
+		m_pGraphicsPipeline->selectVariant(m_pCompileThreadPool, m_settings->graphicsSettings);
+	}
+
+	m_pGraphicsPipeline->swapToSelectedVariant();
 }
 
 
@@ -239,6 +406,9 @@ void VulkanEngine::cleanup()
 {
 	vkDeviceWaitIdle(*m_pVkDevice);
 
+	m_pDeletionQueue->flush();
+	delete m_pDeletionQueue;
+
 	mDebugPrint("Cleaning up graphics pipeline...");
 	m_pGraphicsPipeline->cleanup();
 	delete m_pGraphicsPipeline;
@@ -251,8 +421,81 @@ void VulkanEngine::cleanup()
 		delete model;
 	}
 
-	mDebugPrint("Cleaning up sync objects...");
-	m_pWindow->cleanupSyncObjects();
+	delete m_pFrustumCuller;
+
+	if (m_pHiZCuller != nullptr)
+	{
+		mDebugPrint("Cleaning up occlusion culling...");
+		m_pHiZCuller->cleanup();
+		delete m_pHiZCuller;
+	}
+
+	delete m_pSoftwareOcclusionCuller;
+
+	mDebugPrint("Cleaning up clustered lighting...");
+	m_pClusteredLighting->cleanup();
+	delete m_pClusteredLighting;
+
+	mDebugPrint("Cleaning up shadows...");
+	m_pCascadedShadows->cleanup();
+	delete m_pCascadedShadows;
+
+	if (m_pPostProcessChain != nullptr) {
+		mDebugPrint("Cleaning up post-processing...");
+		m_pPostProcessChain->cleanup();
+		delete m_pPostProcessChain;
+	}
+
+	if (m_pTemporalAA != nullptr) {
+		mDebugPrint("Cleaning up temporal anti-aliasing...");
+		m_pTemporalAA->cleanup();
+		delete m_pTemporalAA;
+	}
+
+	if (m_pMultiviewTarget != nullptr) {
+		mDebugPrint("Cleaning up multiview targets...");
+		m_pMultiviewTarget->cleanup();
+		delete m_pMultiviewTarget;
+	}
+
+	if (m_pWeightedBlendedOIT != nullptr) {
+		mDebugPrint("Cleaning up order independent transparency...");
+		m_pWeightedBlendedOIT->cleanup();
+		delete m_pWeightedBlendedOIT;
+	}
+
+	if (m_pVisibilityBuffer != nullptr) {
+		mDebugPrint("Cleaning up visibility buffer...");
+		m_pVisibilityBuffer->cleanup();
+		delete m_pVisibilityBuffer;
+	}
+
+	delete m_pDynamicResolution;
+
+	delete m_pThreadPool;
+	delete m_pCompileThreadPool;
+
+	mDebugPrint("Cleaning up render graph...");
+	m_pBufferManager->m_pRenderGraph->cleanup();
+	delete m_pBufferManager->m_pRenderGraph;
+
+	mDebugPrint("Cleaning up frame contexts...");
+	m_pBufferManager->m_pFrameContexts->cleanup();
+	delete m_pBufferManager->m_pFrameContexts;
+
+	mDebugPrint("Cleaning up async compute...");
+	m_pAsyncCompute->cleanup();
+	delete m_pAsyncCompute;
+
+	mDebugPrint("Cleaning up GPU timer...");
+	m_pGpuTimer->cleanup();
+	delete m_pGpuTimer;
+
+	if (m_pFrameCapture != nullptr) {
+		mDebugPrint("Cleaning up frame capture...");
+		m_pFrameCapture->cleanup();
+		delete m_pFrameCapture;
+	}
 
 	//mDebugPrint("Cleaning up buffers...");
 	//m_pBufferManager->cleanup();
@@ -273,6 +516,10 @@ void VulkanEngine::cleanup()
 
 	delete m_pBufferManager;
 
+	mDebugPrint("Cleaning up GPU timeline...");
+	m_pGpuTimeline->cleanup();
+	delete m_pGpuTimeline;
+
 	mDebugPrint("Cleaning up logical device...");
 	m_pLogicalDevice->cleanup();
 	delete m_pLogicalDevice;
@@ -336,11 +583,16 @@ bool VulkanEngine::checkValidationLayerSupport()
 std::vector<const char*> VulkanEngine::getRequiredExtensions()
 {
 	mDebugPrint("Getting required extensions...");
-	uint32_t glfwExtensionCount = 0;
-	const char** glfwExtensions;
-	glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+	std::vector<const char*> extensions = {};
 
-	std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+	// The surface extensions are only needed to present to a window
+	if (!m_settings->windowSettings.headless)
+	{
+		uint32_t glfwExtensionCount = 0;
+		const char** glfwExtensions;
+		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+		extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+	}
 
 	if (m_settings->debugSettings.debugMode)
 	{
@@ -384,11 +636,231 @@ void VulkanEngine::validateSettings()
 		settingsChanged++;
 	}
 
-	if (!features.sampleRateShading) {
-		mDebugPrint("Sample rate shading is not supported by the device. Disabling multisampling.");
+	if (m_settings->graphicsSettings.multisampling && m_pPhysicalDevice->getMaxUsableSampleCount() == VK_SAMPLE_COUNT_1_BIT) {
+		mDebugPrint("Multisampled attachments are not supported by the device. Disabling multisampling.");
+		m_settings->graphicsSettings.multisampling = false;
+		settingsChanged++;
+	}
+
+	// Multiview is core since Vulkan 1.1 and required to support at least six views, so this only guards against odd drivers
+	if (m_settings->graphicsSettings.multiview != eMultiview::NONE)
+	{
+		VkPhysicalDeviceMultiviewProperties multiviewProperties{
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_PROPERTIES
+		};
+		VkPhysicalDeviceProperties2 properties2{
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+			.pNext = &multiviewProperties
+		};
+		vkGetPhysicalDeviceProperties2(*m_pVkPhysicalDevice, &properties2);
+
+		if (multiviewProperties.maxMultiviewViewCount < MultiviewTarget::sm_viewCount)
+		{
+			mDebugPrint(std::format("Multiview with {} views is not supported by the device. Drawing a single view.", MultiviewTarget::sm_viewCount));
+			m_settings->graphicsSettings.multiview = eMultiview::NONE;
+			settingsChanged++;
+		}
+	}
+
+	// The views are drawn into single sampled layers, and the depth pyramid, the temporal history and the resolution scale
+	// all assume a single view covering the whole frame
+	if (m_settings->graphicsSettings.multiview != eMultiview::NONE)
+	{
+		if (m_settings->graphicsSettings.multisampling)
+		{
+			mDebugPrint("Multisampling is not used with multiview. Disabling multisampling.");
+			m_settings->graphicsSettings.multisampling = false;
+			settingsChanged++;
+		}
+		if (m_settings->graphicsSettings.temporalAA)
+		{
+			mDebugPrint("Temporal anti-aliasing is not used with multiview. Disabling temporal anti-aliasing.");
+			m_settings->graphicsSettings.temporalAA = false;
+			settingsChanged++;
+		}
+		if (m_settings->graphicsSettings.dynamicResolution)
+		{
+			mDebugPrint("Dynamic resolution is not used with multiview. Drawing at full resolution.");
+			m_settings->graphicsSettings.dynamicResolution = false;
+			settingsChanged++;
+		}
+		if (m_settings->graphicsSettings.occlusionCulling != eOcclusionCulling::NONE)
+		{
+			mDebugPrint("Occlusion culling is not used with multiview. Only frustum culling the views.");
+			m_settings->graphicsSettings.occlusionCulling = eOcclusionCulling::NONE;
+			settingsChanged++;
+		}
+	}
+
+	// The scale is clamped between the two every frame, which needs them in order and the frame no bigger than the swapchain
+	float minResolutionScale = m_settings->graphicsSettings.minResolutionScale;
+	float maxResolutionScale = m_settings->graphicsSettings.maxResolutionScale;
+	if (m_settings->graphicsSettings.dynamicResolution && !(0.0f < minResolutionScale && minResolutionScale <= maxResolutionScale && maxResolutionScale <= 1.0f))
+	{
+		sSettings::sGraphicsSettings defaults{};
+		mDebugPrint(std::format("Dynamic resolution scales of {} to {} are not between 0 and 1 in order. Falling back to {} to {}.",
+			minResolutionScale, maxResolutionScale, defaults.minResolutionScale, defaults.maxResolutionScale));
+		m_settings->graphicsSettings.minResolutionScale = defaults.minResolutionScale;
+		m_settings->graphicsSettings.maxResolutionScale = defaults.maxResolutionScale;
+		settingsChanged++;
+	}
+
+	// Occlusion culling builds its depth pyramid by sampling the depth buffer
+	VkFormatProperties depthFormatProperties{};
+	vkGetPhysicalDeviceFormatProperties(*m_pVkPhysicalDevice, DepthBuffer::findDepthFormat(m_pVkPhysicalDevice), &depthFormatProperties);
+	if (m_settings->graphicsSettings.occlusionCulling == eOcclusionCulling::HIERARCHICAL_Z && !(depthFormatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT))
+	{
+		mDebugPrint("Sampling the depth buffer is not supported by the device. Falling back to software occlusion culling.");
+		m_settings->graphicsSettings.occlusionCulling = eOcclusionCulling::SOFTWARE;
+		settingsChanged++;
+	}
+
+	// Temporal AA resolves in the post-processing chain's scene colour image and builds its motion vectors from the depth buffer
+	if (m_settings->graphicsSettings.temporalAA && (!m_settings->graphicsSettings.postProcessing || !(depthFormatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)))
+	{
+		mDebugPrint("Temporal anti-aliasing needs post-processing and a depth buffer that can be sampled. Disabling temporal anti-aliasing.");
+		m_settings->graphicsSettings.temporalAA = false;
+		settingsChanged++;
+	}
+	if (m_settings->graphicsSettings.temporalAA && m_settings->graphicsSettings.multisampling)
+	{
+		mDebugPrint("Temporal anti-aliasing replaces multisampling. Disabling multisampling.");
 		m_settings->graphicsSettings.multisampling = false;
 		settingsChanged++;
 	}
 
+	// The shading pass reads gl_PrimitiveID's triangle ids back and indexes the material textures per pixel
+	if (m_settings->graphicsSettings.visibilityBuffer)
+	{
+		VkPhysicalDeviceVulkan12Features vulkan12Features{
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES
+		};
+		VkPhysicalDeviceFeatures2 features2{
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+			.pNext = &vulkan12Features
+		};
+		vkGetPhysicalDeviceFeatures2(*m_pVkPhysicalDevice, &features2);
+
+		if (!features2.features.geometryShader || !vulkan12Features.shaderSampledImageArrayNonUniformIndexing)
+		{
+			mDebugPrint("Primitive ids or non-uniform texture indexing are not supported by the device. Falling back to forward shading.");
+			m_settings->graphicsSettings.visibilityBuffer = false;
+			settingsChanged++;
+		}
+	}
+
+	// The ids can't be resolved, there's one draw per model, and the depth pyramid is built by the main pass it replaces
+	if (m_settings->graphicsSettings.visibilityBuffer)
+	{
+		if (m_settings->graphicsSettings.multiview != eMultiview::NONE)
+		{
+			mDebugPrint("The visibility buffer is not used with multiview. Falling back to forward shading.");
+			m_settings->graphicsSettings.visibilityBuffer = false;
+			settingsChanged++;
+		}
+		else if (m_settings->graphicsSettings.multisampling)
+		{
+			mDebugPrint("Multisampling is not used with the visibility buffer. Disabling multisampling.");
+			m_settings->graphicsSettings.multisampling = false;
+			m_visibilityBufferDisabledMultisampling = true;
+			settingsChanged++;
+		}
+		if (m_settings->graphicsSettings.visibilityBuffer && m_settings->graphicsSettings.occlusionCulling == eOcclusionCulling::HIERARCHICAL_Z)
+		{
+			mDebugPrint("Hi-Z occlusion culling is not used with the visibility buffer. Falling back to software occlusion culling.");
+			m_settings->graphicsSettings.occlusionCulling = eOcclusionCulling::SOFTWARE;
+			m_visibilityBufferDisabledHiZ = true;
+			settingsChanged++;
+		}
+	}
+
+	// The accumulation pass draws single sampled against the depth buffer, and into a single view
+	if (m_settings->graphicsSettings.orderIndependentTransparency && (m_settings->graphicsSettings.multisampling || m_settings->graphicsSettings.multiview != eMultiview::NONE))
+	{
+		mDebugPrint("Order independent transparency is not used with multisampling or multiview. Drawing transparent models with the opaque ones.");
+		m_settings->graphicsSettings.orderIndependentTransparency = false;
+		settingsChanged++;
+	}
+
+	// Dynamic rendering is an extension on top of Vulkan 1.2 (which the device is required to support), where its dependencies are core
+	if (m_settings->graphicsSettings.dynamicRendering && !m_pPhysicalDevice->isExtensionSupported(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME))
+	{
+		mDebugPrint("Dynamic rendering is not supported by the device. Falling back to render pass objects.");
+		m_settings->graphicsSettings.dynamicRendering = false;
+		settingsChanged++;
+	}
+
+	if (m_settings->graphicsSettings.extendedDynamicState)
+	{
+		VkPhysicalDeviceExtendedDynamicState3FeaturesEXT extendedDynamicState3Features{
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT
+		};
+		VkPhysicalDeviceExtendedDynamicStateFeaturesEXT extendedDynamicStateFeatures{
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT,
+			.pNext = &extendedDynamicState3Features
+		};
+		VkPhysicalDeviceFeatures2 features2{
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+			.pNext = &extendedDynamicStateFeatures
+		};
+
+		bool supported = m_pPhysicalDevice->isExtensionSupported(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME) && m_pPhysicalDevice->isExtensionSupported(VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME);
+		if (supported) {
+			vkGetPhysicalDeviceFeatures2(*m_pVkPhysicalDevice, &features2);
+			supported = extendedDynamicStateFeatures.extendedDynamicState && extendedDynamicState3Features.extendedDynamicState3PolygonMode;
+		}
+
+		if (!supported)
+		{
+			mDebugPrint("Dynamic polygon and cull mode are not supported by the device. Wireframe will switch pipeline variants.");
+			m_settings->graphicsSettings.extendedDynamicState = false;
+			settingsChanged++;
+		}
+	}
+
+	if (m_settings->graphicsSettings.asyncCompute && !QueueFamilyIndices::findQueueFamilies(*m_pVkPhysicalDevice, *m_pVkSurface).computeFamily.has_value())
+	{
+		mDebugPrint("The device has no dedicated compute queue family. Compute work will be submitted to the graphics queue.");
+		m_settings->graphicsSettings.asyncCompute = false;
+		settingsChanged++;
+	}
+
+	if (m_settings->graphicsSettings.graphicsPipelineLibrary)
+	{
+		VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT graphicsPipelineLibraryFeatures{
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT
+		};
+		VkPhysicalDeviceFeatures2 features2{
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+			.pNext = &graphicsPipelineLibraryFeatures
+		};
+
+		bool supported = m_pPhysicalDevice->isExtensionSupported(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME) && m_pPhysicalDevice->isExtensionSupported(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+		if (supported) {
+			vkGetPhysicalDeviceFeatures2(*m_pVkPhysicalDevice, &features2);
+			supported = graphicsPipelineLibraryFeatures.graphicsPipelineLibrary;
+		}
+
+		if (!supported)
+		{
+			mDebugPrint("Graphics pipeline libraries are not supported by the device. New pipeline variants will be compiled whole.");
+			m_settings->graphicsSettings.graphicsPipelineLibrary = false;
+			settingsChanged++;
+		}
+	}
+
+	// Captures are copied out of the swapchain image, the offscreen images used headless always allow it
+	if (m_settings->debugSettings.frameCapture && !m_settings->windowSettings.headless)
+	{
+		VkSurfaceCapabilitiesKHR capabilities{};
+		vkGetPhysicalDeviceSurfaceCapabilitiesKHR(*m_pVkPhysicalDevice, *m_pVkSurface, &capabilities);
+		if (!(capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT))
+		{
+			mDebugPrint("Swapchain images can't be copied from on this device. Disabling frame capture.");
+			m_settings->debugSettings.frameCapture = false;
+			settingsChanged++;
+		}
+	}
+
 	settingsChanged != 1 ? mDebugPrint(std::format("Settings validated with {} changes.", settingsChanged)) : mDebugPrint("Settings validated with 1 change.");
 }
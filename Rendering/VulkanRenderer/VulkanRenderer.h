@@ -4,6 +4,8 @@
 #include <string>
 #include <map>
 #include <vector>
+#include <functional>
+#include <mutex>
 
 
 #define GLFW_INCLUDE_VULKAN
@@ -12,14 +14,33 @@
 
 #include "Utilities/Utilities.h"
 #include "Utilities/DebugMessenger.h"
+#include "Utilities/ThreadPool.h"
 #include "Graphics/Window.h"
 #include "Graphics/Devices.h"
 #include "Graphics/Swapchain.h"
 #include "Graphics/GraphicsPipeline.h"
 #include "Graphics/Buffers.h"
 #include "Graphics/Image.h"
+#include "Graphics/RenderGraph.h"
+#include "Graphics/GpuTimeline.h"
+#include "Graphics/GpuTimer.h"
+#include "Graphics/FrameContext.h"
+#include "Graphics/AsyncCompute.h"
+#include "Graphics/DeletionQueue.h"
+#include "Graphics/FrameCapture.h"
+#include "Graphics/MultiviewTarget.h"
+#include "Graphics/WeightedBlendedOIT.h"
+#include "Graphics/VisibilityBuffer.h"
 #include "Models/Model.h"
 #include "Models/Camera.h"
+#include "Culling/FrustumCuller.h"
+#include "Culling/HiZCuller.h"
+#include "Culling/SoftwareOcclusionCuller.h"
+#include "Lighting/ClusteredLighting.h"
+#include "Lighting/CascadedShadows.h"
+#include "PostProcessing/PostProcessChain.h"
+#include "PostProcessing/DynamicResolution.h"
+#include "PostProcessing/TemporalAA.h"
 
 
 enum class VkEngineState
@@ -42,9 +63,27 @@ public:
 	Window* getWindow() { return m_pWindow; }
 	Camera* getCamera() { return m_pCamera; }
 	bool* getShouldRender() { return &m_shouldRender; }
+	GpuTimeline* getGpuTimeline() { return m_pGpuTimeline; }
+	GpuTimer* getGpuTimer() { return m_pGpuTimer; }
+	FrameCapture* getFrameCapture() { return m_pFrameCapture; }
+	AsyncCompute* getAsyncCompute() { return m_pAsyncCompute; }
+	GraphicsPipeline* getGraphicsPipeline() { return m_pGraphicsPipeline; }
+	DeletionQueue* getDeletionQueue() { return m_pDeletionQueue; }
+	ClusteredLighting* getClusteredLighting() { return m_pClusteredLighting; }
+	CascadedShadows* getCascadedShadows() { return m_pCascadedShadows; }
+	PostProcessChain* getPostProcessChain() { return m_pPostProcessChain; }
+	DynamicResolution* getDynamicResolution() { return m_pDynamicResolution; }
+	TemporalAA* getTemporalAA() { return m_pTemporalAA; }
+	MultiviewTarget* getMultiviewTarget() { return m_pMultiviewTarget; }
+	WeightedBlendedOIT* getWeightedBlendedOIT() { return m_pWeightedBlendedOIT; }
+	VisibilityBuffer* getVisibilityBuffer() { return m_pVisibilityBuffer; }
 
 	void run(std::map<std::string,uint32_t> versions, sSettings* settings);
 
+	// Safe to call from any thread. The change is applied between frames on the render thread, which then switches to the
+	// matching graphics pipeline variant, compiling it in the background first if it isn't cached, see applySettingsChanges.
+	void changeGraphicsSettings(std::function<void(sSettings::sGraphicsSettings&)> change);
+
 private:
 	VulkanEngine();
 
@@ -54,6 +93,22 @@ private:
 	friend class GraphicsPipeline;
 	friend class Swapchain;
 	friend class Window;
+	friend class HiZCuller;
+	friend class ClusteredLighting;
+	friend class CascadedShadows;
+	friend class PostProcessChain;
+	friend class DynamicResolution;
+	friend class TemporalAA;
+	friend class MultiviewTarget;
+	friend class WeightedBlendedOIT;
+	friend class VisibilityBuffer;
+	friend class RenderGraph;
+	friend class GpuTimeline;
+	friend class GpuTimer;
+	friend class FrameCapture;
+	friend class FrameContextRing;
+	friend class AsyncCompute;
+	friend class DeletionQueue;
 
 	friend void enableInputProcessing(VulkanEngine* pVulkanEngine);
 
@@ -75,17 +130,43 @@ private:
 	VkPhysicalDevice* m_pVkPhysicalDevice = nullptr;
 	LogicalDevice* m_pLogicalDevice = nullptr;
 	VkDevice* m_pVkDevice = nullptr;
+	GpuTimeline* m_pGpuTimeline = nullptr; // Signalled by every graphics queue submission
+	GpuTimer* m_pGpuTimer = nullptr;
+	FrameCapture* m_pFrameCapture = nullptr; // Only created with frame capture
+	AsyncCompute* m_pAsyncCompute = nullptr;
+	DeletionQueue* m_pDeletionQueue = nullptr; // Objects retired while the GPU may still use them, e.g. on swapchain recreation
 	Swapchain* m_pSwapchain = nullptr;
 	GraphicsPipeline* m_pGraphicsPipeline = nullptr;
 	BufferManager* m_pBufferManager = nullptr;
 	Camera* m_pCamera = nullptr;
+	Camera* m_pSecondCamera = nullptr; // The second split-screen view's
+	FrustumCuller* m_pFrustumCuller = nullptr;
+	HiZCuller* m_pHiZCuller = nullptr;
+	SoftwareOcclusionCuller* m_pSoftwareOcclusionCuller = nullptr;
+	ClusteredLighting* m_pClusteredLighting = nullptr;
+	CascadedShadows* m_pCascadedShadows = nullptr;
+	PostProcessChain* m_pPostProcessChain = nullptr; // Only created with post-processing
+	DynamicResolution* m_pDynamicResolution = nullptr; // Only created with dynamic resolution, which needs post-processing and GPU timestamps
+	TemporalAA* m_pTemporalAA = nullptr; // Only created with temporal anti-aliasing
+	MultiviewTarget* m_pMultiviewTarget = nullptr; // Only created with multiview
+	WeightedBlendedOIT* m_pWeightedBlendedOIT = nullptr; // Only created with order independent transparency
+	VisibilityBuffer* m_pVisibilityBuffer = nullptr; // Only created with the visibility buffer
+	ThreadPool* m_pThreadPool = nullptr;
+	static constexpr uint32_t sm_compileThreads = 2;
+	ThreadPool* m_pCompileThreadPool = nullptr; // Pipeline compiles only, parallelFor on the engine's pool would wait behind them
 
 	bool m_shouldRender = false;
 	int m_MAX_FRAMES_IN_FLIGHT = 1;
 	sSettings* m_settings = nullptr;
+	// What validateSettings turned off for the visibility buffer, given back if the loaded models don't fit it, see initVulkan
+	bool m_visibilityBufferDisabledMultisampling = false;
+	bool m_visibilityBufferDisabledHiZ = false;
 
 	std::map<std::string, uint32_t> m_versions = {};
 
+	std::mutex m_settingsChangeMutex;
+	std::vector<std::function<void(sSettings::sGraphicsSettings&)>> m_settingsChanges = {};
+
 
 	void initVulkan();
 	void createInstance();
@@ -95,8 +176,15 @@ private:
 	bool checkValidationLayerSupport();
 	std::vector<const char*> getRequiredExtensions();
 	void validateSettings();
+	void runBenchmarks();
+
+	// Fills the buffer manager's visible model list with the models inside any of the views' frusta,
+	// then either removes the ones the software occlusion culler finds hidden or hands their bounds to the GPU culler.
+	// The survivors are sorted into the draw queue by state. Occlusion culling only runs with a single view.
+	void cullModels(const std::vector<glm::mat4>& viewProjs, uint32_t frameIndex);
 
-	void rebuildGraphicsPipeline();
+	// Called by Window::drawFrame before a frame is recorded
+	void applySettingsChanges();
 };
 
 inline void nativeDebugPrint(std::string message, bool newLine = false) { std::cout << (newLine ? "\n" : "") << "VulkanEngine NATIVEDEBUG - " << message << std::endl; }
\ No newline at end of file
@@ -0,0 +1,22 @@
+#version 450
+#extension GL_EXT_multiview : require
+
+// Depth pre-pass, draws the position stream so the main pass can test for EQUAL and shade each pixel once.
+// gl_Position has to come out bit for bit the same as in vertBase.vert, so the transform is the same expression in the
+// same order and both declare it invariant.
+
+#define MAX_VIEWS 2
+
+layout(binding = 0) uniform UniformBufferObject {
+	mat4 model;
+	mat4 view[MAX_VIEWS];
+	mat4 proj[MAX_VIEWS];
+} ubo;
+
+layout(location = 0) in vec3 inPosition;
+
+invariant gl_Position;
+
+void main() {
+	gl_Position = ubo.proj[gl_ViewIndex] * ubo.view[gl_ViewIndex] * ubo.model * vec4(inPosition, 1);
+}
@@ -0,0 +1,132 @@
+#version 450
+#extension GL_EXT_multiview : require
+
+// Clustered forward shading. The fragment finds its cluster from its tile and view depth and only walks the lights
+// lightCluster.comp binned into it. Vertices carry no normals, so the face normal comes from the position derivatives.
+// With multiview every view has its own clusters and view space lights, picked with gl_ViewIndex.
+// Transparent models are drawn with WEIGHTED_BLENDED set, which writes weighted blended OIT's accumulation and revealage
+// instead of the colour, see oitComposite.frag.
+
+#define MAX_VIEWS 2
+
+layout(constant_id = 0) const bool WEIGHTED_BLENDED = false;
+
+struct Light {
+	vec4 positionRange; // View space position (xyz) and range (w)
+	vec4 colorIntensity;
+	vec4 directionCosOuter; // View space spot direction (xyz) and cosine of the outer cone angle, -2 for point lights
+	vec4 cosInner; // Cosine of the inner cone angle (x)
+};
+
+layout(set = 0, binding = 1) uniform sampler2D texSampler;
+
+struct ClusterView {
+	mat4 inverseProj;
+	uvec4 gridSize; // Clusters along x, y and depth, w is the light count
+	vec4 sunDirection; // View space, towards the sun. w is its intensity.
+	vec2 tileSize; // Pixels covered by a cluster
+	float sliceScale; // slice = log(depth) * sliceScale - sliceBias
+	float sliceBias;
+	uint maxLightsPerCluster;
+	float ambient;
+	uint lightOffset; // Where the view's lights start in the light buffer
+	uint clusterOffset; // Where the view's cluster lists start in the cluster buffer
+};
+
+layout(std140, set = 1, binding = 0) uniform ClusterParams { ClusterView views[MAX_VIEWS]; };
+
+layout(std430, set = 1, binding = 1) readonly buffer LightBuffer { Light lights[]; };
+layout(std430, set = 1, binding = 2) readonly buffer ClusterBuffer { uint clusterLights[]; };
+
+layout(std140, set = 2, binding = 0) uniform ShadowParams {
+	mat4 cascadeMatrices[4]; // First view's view space to the cascade's clip space
+	vec4 splitDepths; // View depth each cascade reaches
+	float texelSize; // Of the shadow map in UV
+	uint cascadeCount; // 0 without shadows
+} shadows;
+layout(set = 2, binding = 1) uniform sampler2DArrayShadow shadowMap;
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) in vec3 fragViewPosition;
+layout(location = 3) in vec3 fragShadowPosition; // The cascades are fitted to the first view, so they're looked up from its view space
+layout(location = 4) flat in float fragOpacity;
+
+layout(location = 0) out vec4 outColor; // Premultiplied and weighted accumulation when weighted blended
+layout(location = 1) out float outRevealage; // Only written when weighted blended, multiplied into the target by the blend
+
+ClusterView params;
+
+vec3 shadeLight(Light light, vec3 normal) {
+	vec3 toLight = light.positionRange.xyz - fragViewPosition;
+	float distanceSquared = dot(toLight, toLight);
+	float range = light.positionRange.w;
+	if (distanceSquared >= range * range) return vec3(0.0);
+
+	vec3 lightDirection = toLight * inversesqrt(distanceSquared);
+
+	// Inverse square falloff, windowed so it reaches zero at the range the light was binned with
+	float window = clamp(1.0 - pow(distanceSquared / (range * range), 2.0), 0.0, 1.0);
+	float attenuation = window * window / (distanceSquared + 1.0);
+
+	float spot = smoothstep(light.directionCosOuter.w, light.cosInner.x, dot(-lightDirection, light.directionCosOuter.xyz));
+
+	return light.colorIntensity.rgb * light.colorIntensity.a * attenuation * spot * max(dot(normal, lightDirection), 0.0);
+}
+
+// Fraction of the sun reaching the fragment, filtered over 3x3 texels of the nearest cascade that covers it
+float sunVisibility() {
+	float depth = -fragShadowPosition.z;
+	uint cascade = 0;
+	while (cascade < shadows.cascadeCount && depth > shadows.splitDepths[cascade]) cascade++;
+	if (cascade >= shadows.cascadeCount) return 1.0;
+
+	vec4 shadowPosition = shadows.cascadeMatrices[cascade] * vec4(fragShadowPosition, 1.0);
+	vec2 uv = shadowPosition.xy * 0.5 + 0.5;
+
+	float visibility = 0.0;
+	for (int y = -1; y <= 1; y++) {
+		for (int x = -1; x <= 1; x++) {
+			visibility += texture(shadowMap, vec4(uv + vec2(x, y) * shadows.texelSize, float(cascade), shadowPosition.z));
+		}
+	}
+	return visibility / 9.0;
+}
+
+void main() {
+	params = views[gl_ViewIndex];
+
+	vec4 albedo = texture(texSampler, fragTexCoord);
+
+	vec3 normal = normalize(cross(dFdx(fragViewPosition), dFdy(fragViewPosition)));
+	if (dot(normal, fragViewPosition) > 0.0) normal = -normal; // Face the camera
+
+	vec3 lighting = vec3(params.ambient) + params.sunDirection.w * max(dot(normal, params.sunDirection.xyz), 0.0) * sunVisibility();
+
+	if (params.gridSize.w > 0) {
+		uint slice = uint(clamp(log(-fragViewPosition.z) * params.sliceScale - params.sliceBias, 0.0, float(params.gridSize.z - 1)));
+		uvec2 tile = min(uvec2(gl_FragCoord.xy / params.tileSize), params.gridSize.xy - 1);
+		uint clusterIndex = tile.x + tile.y * params.gridSize.x + slice * params.gridSize.x * params.gridSize.y;
+
+		uint clusterCount = params.gridSize.x * params.gridSize.y * params.gridSize.z;
+		uint listStart = params.clusterOffset + clusterCount + clusterIndex * params.maxLightsPerCluster;
+		uint count = clusterLights[params.clusterOffset + clusterIndex];
+
+		for (uint i = 0; i < count; i++) {
+			lighting += shadeLight(lights[params.lightOffset + clusterLights[listStart + i]], normal);
+		}
+	}
+
+	vec3 color = albedo.rgb * lighting;
+	float alpha = albedo.a * fragOpacity;
+
+	if (WEIGHTED_BLENDED) {
+		// Nearer and more opaque surfaces weigh more, so they dominate the average whatever order they were drawn in
+		float weight = clamp(pow(min(1.0, alpha * 10.0) + 0.01, 3.0) * 1e8 * pow(1.0 - gl_FragCoord.z * 0.9, 3.0), 1e-2, 3e3);
+		outColor = vec4(color * alpha, alpha) * weight;
+		outRevealage = alpha;
+		return;
+	}
+
+	outColor = vec4(color, alpha);
+}
@@ -0,0 +1,14 @@
+#version 450
+
+// Draws the position stream into one of the sun's shadow cascades, see CascadedShadows
+
+layout(push_constant) uniform PushConstants {
+	mat4 lightViewProj;
+	mat4 model;
+} pc;
+
+layout(location = 0) in vec3 inPosition;
+
+void main() {
+	gl_Position = pc.lightViewProj * pc.model * vec4(inPosition, 1);
+}
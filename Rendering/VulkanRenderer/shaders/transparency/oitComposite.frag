@@ -0,0 +1,24 @@
+#version 450
+
+// Weighted blended OIT composite. The accumulation holds the weighted sum of the premultiplied colours and alphas of every
+// transparent surface over the pixel, the revealage how much of what's behind them still shows through. Their weighted
+// average colour goes over the frame with the coverage the revealage leaves.
+
+layout(binding = 0) uniform sampler2D accumulation;
+layout(binding = 1) uniform sampler2D revealage;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+
+	float revealed = texelFetch(revealage, pixel, 0).r;
+	if (revealed >= 1.0) discard; // Nothing transparent over this pixel
+
+	vec4 accumulated = texelFetch(accumulation, pixel, 0);
+
+	// Half floats overflow with enough heavily weighted layers, the average of equal colours is then the alpha
+	if (isinf(max(max(abs(accumulated.r), abs(accumulated.g)), abs(accumulated.b)))) accumulated.rgb = vec3(accumulated.a);
+
+	outColor = vec4(accumulated.rgb / max(accumulated.a, 1e-5), 1.0 - revealed);
+}
@@ -0,0 +1,33 @@
+#version 450
+#extension GL_EXT_multiview : require
+
+#define MAX_VIEWS 2
+
+// A camera per view, gl_ViewIndex is always 0 without multiview
+layout(set = 0, binding = 0) uniform UniformBufferObject {
+	mat4 model;
+	mat4 view[MAX_VIEWS];
+	mat4 proj[MAX_VIEWS];
+	float opacity;
+} ubo;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec2 inTexCoord;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) out vec3 fragViewPosition; // Picks the light cluster and is lit in view space, see fragBase.frag
+layout(location = 3) out vec3 fragShadowPosition; // The first view's view space, which the shadow cascades are fitted to
+layout(location = 4) flat out float fragOpacity; // The uniforms are only visible to the vertex stage
+
+invariant gl_Position; // Tested for EQUAL against the depth pre-pass, see depthPrepass.vert
+
+void main() {
+	gl_Position = ubo.proj[gl_ViewIndex] * ubo.view[gl_ViewIndex] * ubo.model * vec4(inPosition, 1);
+	fragViewPosition = (ubo.view[gl_ViewIndex] * ubo.model * vec4(inPosition, 1)).xyz;
+	fragShadowPosition = (ubo.view[0] * ubo.model * vec4(inPosition, 1)).xyz;
+	fragColor = inColor;
+	fragTexCoord = inTexCoord;
+	fragOpacity = ubo.opacity;
+}
@@ -0,0 +1,14 @@
+#version 450
+
+// Writes which draw and which of its triangles covers the pixel, nothing else. gl_PrimitiveID counts the draw's
+// triangles from 0, so it indexes the model's own indices.
+
+#define TRIANGLE_ID_BITS 23 // Matches VisibilityBuffer::sm_triangleIdBits
+
+layout(location = 0) flat in uint drawId;
+
+layout(location = 0) out uint outVisibility;
+
+void main() {
+	outVisibility = (drawId << TRIANGLE_ID_BITS) | uint(gl_PrimitiveID);
+}
@@ -0,0 +1,30 @@
+#version 450
+
+// Visibility pass, the only geometry pass of the visibility buffer path. Draws the position stream, every draw's transform
+// is looked up with the draw id VisibilityBuffer passes as the first instance, see visibilityShade.frag for the shading.
+// The transform is the same expression in the same order as the shading pass' so both land on the same triangle.
+
+struct DrawData {
+	mat4 model;
+	uint firstIndex; // Of the model's indices in the scene index buffer
+	int vertexOffset; // Of the model's vertices in the scene vertex buffer
+	uint textureIndex;
+	float opacity;
+};
+
+layout(std140, set = 0, binding = 0) uniform FrameParams {
+	mat4 view;
+	mat4 proj;
+	vec4 renderSize; // Render extent (xy) and its reciprocal (zw)
+} frame;
+
+layout(std430, set = 0, binding = 1) readonly buffer DrawBuffer { DrawData draws[]; };
+
+layout(location = 0) in vec3 inPosition;
+
+layout(location = 0) flat out uint drawId;
+
+void main() {
+	gl_Position = frame.proj * frame.view * draws[gl_InstanceIndex].model * vec4(inPosition, 1);
+	drawId = gl_InstanceIndex;
+}
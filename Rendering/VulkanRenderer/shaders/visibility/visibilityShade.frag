@@ -0,0 +1,196 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+// Visibility buffer shading. The visibility pass left the draw and triangle covering every pixel, so each pixel is shaded
+// exactly once however many triangles were drawn over it. The triangle's vertices are fetched from the scene buffers and
+// transformed again, and the pixel's perspective correct barycentrics interpolate them. Texture gradients come from the
+// barycentrics one pixel across and down, the neighbours may belong to other triangles so there are no derivatives.
+// Lit like fragBase.frag, which has the details. Never used with multiview, so only the first view's clusters are read.
+
+#define MAX_VIEWS 2
+#define TRIANGLE_ID_BITS 23 // Matches VisibilityBuffer::sm_triangleIdBits
+#define MAX_TEXTURES 64 // Matches VisibilityBuffer::sm_maxTextures
+#define VERTEX_FLOATS 9 // Matches Vertex: position, colour, texture coordinate, colour blend
+#define NO_TRIANGLE 0xFFFFFFFFu // What the visibility target is cleared to
+
+struct DrawData {
+	mat4 model;
+	uint firstIndex; // Of the model's indices in the scene index buffer
+	int vertexOffset; // Of the model's vertices in the scene vertex buffer
+	uint textureIndex;
+	float opacity;
+};
+
+layout(std140, set = 0, binding = 0) uniform FrameParams {
+	mat4 view;
+	mat4 proj;
+	vec4 renderSize; // Render extent (xy) and its reciprocal (zw)
+} frame;
+
+layout(std430, set = 0, binding = 1) readonly buffer DrawBuffer { DrawData draws[]; };
+layout(std430, set = 0, binding = 2) readonly buffer SceneVertices { float vertices[]; };
+layout(std430, set = 0, binding = 3) readonly buffer SceneIndices { uint indices[]; };
+layout(set = 0, binding = 4) uniform sampler2D textures[MAX_TEXTURES];
+
+struct Light {
+	vec4 positionRange;
+	vec4 colorIntensity;
+	vec4 directionCosOuter;
+	vec4 cosInner;
+};
+
+struct ClusterView {
+	mat4 inverseProj;
+	uvec4 gridSize;
+	vec4 sunDirection;
+	vec2 tileSize;
+	float sliceScale;
+	float sliceBias;
+	uint maxLightsPerCluster;
+	float ambient;
+	uint lightOffset;
+	uint clusterOffset;
+};
+
+layout(std140, set = 1, binding = 0) uniform ClusterParams { ClusterView views[MAX_VIEWS]; };
+
+layout(std430, set = 1, binding = 1) readonly buffer LightBuffer { Light lights[]; };
+layout(std430, set = 1, binding = 2) readonly buffer ClusterBuffer { uint clusterLights[]; };
+
+layout(std140, set = 2, binding = 0) uniform ShadowParams {
+	mat4 cascadeMatrices[4];
+	vec4 splitDepths;
+	float texelSize;
+	uint cascadeCount;
+} shadows;
+layout(set = 2, binding = 1) uniform sampler2DArrayShadow shadowMap;
+
+layout(set = 3, binding = 0) uniform usampler2D visibilityTarget;
+
+layout(location = 0) out vec4 outColor;
+
+ClusterView params;
+vec3 viewPosition;
+
+vec3 shadeLight(Light light, vec3 normal) {
+	vec3 toLight = light.positionRange.xyz - viewPosition;
+	float distanceSquared = dot(toLight, toLight);
+	float range = light.positionRange.w;
+	if (distanceSquared >= range * range) return vec3(0.0);
+
+	vec3 lightDirection = toLight * inversesqrt(distanceSquared);
+
+	float window = clamp(1.0 - pow(distanceSquared / (range * range), 2.0), 0.0, 1.0);
+	float attenuation = window * window / (distanceSquared + 1.0);
+
+	float spot = smoothstep(light.directionCosOuter.w, light.cosInner.x, dot(-lightDirection, light.directionCosOuter.xyz));
+
+	return light.colorIntensity.rgb * light.colorIntensity.a * attenuation * spot * max(dot(normal, lightDirection), 0.0);
+}
+
+// The cascades are fitted to the one view there is, so its view space is also the one they're looked up from
+float sunVisibility() {
+	float depth = -viewPosition.z;
+	uint cascade = 0;
+	while (cascade < shadows.cascadeCount && depth > shadows.splitDepths[cascade]) cascade++;
+	if (cascade >= shadows.cascadeCount) return 1.0;
+
+	vec4 shadowPosition = shadows.cascadeMatrices[cascade] * vec4(viewPosition, 1.0);
+	vec2 uv = shadowPosition.xy * 0.5 + 0.5;
+
+	float visibility = 0.0;
+	for (int y = -1; y <= 1; y++) {
+		for (int x = -1; x <= 1; x++) {
+			visibility += texture(shadowMap, vec4(uv + vec2(x, y) * shadows.texelSize, float(cascade), shadowPosition.z));
+		}
+	}
+	return visibility / 9.0;
+}
+
+// Barycentrics of an NDC position in the triangle with the given clip space corners. They're linear on screen, divided by
+// each corner's w and renormalised they interpolate linearly in view space like the rasteriser's varyings.
+vec3 perspectiveBarycentrics(vec4 clip0, vec4 clip1, vec4 clip2, vec2 ndc) {
+	vec3 inverseW = 1.0 / vec3(clip0.w, clip1.w, clip2.w);
+	vec2 p0 = clip0.xy * inverseW.x - ndc;
+	vec2 p1 = clip1.xy * inverseW.y - ndc;
+	vec2 p2 = clip2.xy * inverseW.z - ndc;
+
+	// Twice the signed areas of the triangles the position makes with each edge, opposite the corner they weigh
+	vec3 screen = vec3(p1.x * p2.y - p2.x * p1.y, p2.x * p0.y - p0.x * p2.y, p0.x * p1.y - p1.x * p0.y);
+	vec3 perspective = screen * inverseW;
+	return perspective / (perspective.x + perspective.y + perspective.z);
+}
+
+vec3 fetchPosition(uint vertex) {
+	uint base = vertex * VERTEX_FLOATS;
+	return vec3(vertices[base], vertices[base + 1], vertices[base + 2]);
+}
+
+vec2 fetchTexCoord(uint vertex) {
+	uint base = vertex * VERTEX_FLOATS + 6;
+	return vec2(vertices[base], vertices[base + 1]);
+}
+
+void main() {
+	uint visibility = texelFetch(visibilityTarget, ivec2(gl_FragCoord.xy), 0).r;
+	if (visibility == NO_TRIANGLE) discard; // Keeps the clear colour
+
+	DrawData draw = draws[visibility >> TRIANGLE_ID_BITS];
+	uint triangle = visibility & ((1u << TRIANGLE_ID_BITS) - 1u);
+
+	uvec3 corners = uvec3(
+		uint(int(indices[draw.firstIndex + triangle * 3 + 0]) + draw.vertexOffset),
+		uint(int(indices[draw.firstIndex + triangle * 3 + 1]) + draw.vertexOffset),
+		uint(int(indices[draw.firstIndex + triangle * 3 + 2]) + draw.vertexOffset));
+
+	vec4 position0 = vec4(fetchPosition(corners.x), 1);
+	vec4 position1 = vec4(fetchPosition(corners.y), 1);
+	vec4 position2 = vec4(fetchPosition(corners.z), 1);
+
+	// Same expression as visibility.vert
+	vec4 clip0 = frame.proj * frame.view * draw.model * position0;
+	vec4 clip1 = frame.proj * frame.view * draw.model * position1;
+	vec4 clip2 = frame.proj * frame.view * draw.model * position2;
+
+	mat4 modelView = frame.view * draw.model;
+	vec3 view0 = (modelView * position0).xyz;
+	vec3 view1 = (modelView * position1).xyz;
+	vec3 view2 = (modelView * position2).xyz;
+
+	// A pixel is two NDC units over the render extent
+	vec2 ndc = gl_FragCoord.xy * frame.renderSize.zw * 2.0 - 1.0;
+	vec2 pixel = frame.renderSize.zw * 2.0;
+	vec3 barycentrics = perspectiveBarycentrics(clip0, clip1, clip2, ndc);
+	vec3 barycentricsX = perspectiveBarycentrics(clip0, clip1, clip2, ndc + vec2(pixel.x, 0.0));
+	vec3 barycentricsY = perspectiveBarycentrics(clip0, clip1, clip2, ndc + vec2(0.0, pixel.y));
+
+	mat3x2 texCoords = mat3x2(fetchTexCoord(corners.x), fetchTexCoord(corners.y), fetchTexCoord(corners.z));
+	vec2 texCoord = texCoords * barycentrics;
+	vec4 albedo = textureGrad(textures[nonuniformEXT(draw.textureIndex)], texCoord, texCoords * barycentricsX - texCoord, texCoords * barycentricsY - texCoord);
+
+	viewPosition = mat3(view0, view1, view2) * barycentrics;
+
+	// The face normal the forward path gets from the position derivatives
+	vec3 normal = normalize(cross(view1 - view0, view2 - view0));
+	if (dot(normal, viewPosition) > 0.0) normal = -normal; // Face the camera
+
+	params = views[0];
+
+	vec3 lighting = vec3(params.ambient) + params.sunDirection.w * max(dot(normal, params.sunDirection.xyz), 0.0) * sunVisibility();
+
+	if (params.gridSize.w > 0) {
+		uint slice = uint(clamp(log(-viewPosition.z) * params.sliceScale - params.sliceBias, 0.0, float(params.gridSize.z - 1)));
+		uvec2 tile = min(uvec2(gl_FragCoord.xy / params.tileSize), params.gridSize.xy - 1);
+		uint clusterIndex = tile.x + tile.y * params.gridSize.x + slice * params.gridSize.x * params.gridSize.y;
+
+		uint clusterCount = params.gridSize.x * params.gridSize.y * params.gridSize.z;
+		uint listStart = params.clusterOffset + clusterCount + clusterIndex * params.maxLightsPerCluster;
+		uint count = clusterLights[params.clusterOffset + clusterIndex];
+
+		for (uint i = 0; i < count; i++) {
+			lighting += shadeLight(lights[params.lightOffset + clusterLights[listStart + i]], normal);
+		}
+	}
+
+	outColor = vec4(albedo.rgb * lighting, albedo.a * draw.opacity);
+}